@@ -0,0 +1,32 @@
+#ifndef BENCHMARKS_BENCHMARK_COMMON_H_
+#define BENCHMARKS_BENCHMARK_COMMON_H_
+
+#include <algorithm>
+#include <chrono>
+
+namespace benchmark {
+
+    // best wall time of `repetitions` runs in seconds, the minimum filters out
+    // preemption and frequency ramp-up better than the mean does
+    template <typename Func>
+    double BestOf(int repetitions, Func&& func) {
+        double best = 1e30;
+        for(int i = 0; i < repetitions; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            func();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+
+    // keeps the optimizer from dropping results nobody reads
+    template <typename T>
+    inline void DoNotOptimize(const T& value) {
+        volatile T sink = value;
+        (void)sink;
+    }
+
+} // namespace benchmark
+
+#endif // BENCHMARKS_BENCHMARK_COMMON_H_
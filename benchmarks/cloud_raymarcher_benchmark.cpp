@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_common.h"
+#include "cloud_test_scene.h"
+
+using namespace ninmath;
+using namespace ninmath::noise;
+
+//
+// Single threaded CPU raymarcher: scalar against the ray packets of every simd level the
+// binary and the cpu support, bit-exact and with fast math. The configurations take turns,
+// so a clock change hits all of them instead of skewing the speedups.
+//
+int main() {
+    constexpr int Repetitions = 9;
+    constexpr uint32_t Width = 160;
+    constexpr uint32_t Height = 90;
+
+    const CloudTestScene scene = MakeCloudTestScene(Width, Height);
+    const CloudMarchTextures textures = scene.GetTextures();
+
+    struct Config {
+        SimdLevel level;
+        bool fastMath;
+        double seconds = 1e30;
+        CloudImageComparison comparison;
+    };
+    std::vector<Config> configs = { { SimdLevel::Scalar, false } };
+    for(SimdLevel level : { SimdLevel::AVX2, SimdLevel::AVX512 }) {
+        if(level <= GetSimdLevel()) {
+            configs.push_back({ level, false });
+            configs.push_back({ level, true });
+        }
+    }
+
+    CloudRaymarcher raymarcher(1);
+    auto render = [&](const Config& config) {
+        raymarcher.SetSimdLevel(config.level);
+        raymarcher.SetFastMath(config.fastMath);
+        return raymarcher.Render(scene.view, scene.params, textures);
+    };
+
+    const AtmosphereLUT reference = render(configs[0]);
+    for(Config& config : configs) {
+        config.comparison = CompareCloudImages(reference, render(config), 1e-3f);
+    }
+
+    for(int i = 0; i < Repetitions; i++) {
+        for(Config& config : configs) {
+            config.seconds = std::min(config.seconds, benchmark::BestOf(1, [&]() { render(config); }));
+        }
+    }
+
+    // Render() logs every frame, the table goes last
+    std::cout << std::endl << Width << "x" << Height << ", 1 thread, best of " << Repetitions << std::endl;
+    std::cout << std::left << std::setw(16) << "level" << std::right << std::setw(12) << "ms" << std::setw(10) << "speedup"
+              << std::setw(14) << "max error" << std::endl;
+    for(const Config& config : configs) {
+        const std::string name = std::string(SimdLevelToString(config.level)) + (config.fastMath ? " fast" : "");
+        std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << config.seconds * 1000.0 << std::setw(9) << configs[0].seconds / config.seconds << "x"
+                  << std::scientific << std::setprecision(2) << std::setw(14) << config.comparison.maxAbsError << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "benchmark_common.h"
+#include "ninmath/noise_simd.h"
+
+using namespace ninmath;
+using namespace ninmath::noise;
+
+//
+// Samples/sec of the batch noise functions at every simd level the binary and
+// the cpu support, single threaded.
+//
+int main() {
+    constexpr size_t NumSamples = 1 << 16;
+    constexpr int Repetitions = 5;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+    std::vector<float> x(NumSamples), y(NumSamples), z(NumSamples), out(NumSamples);
+    for(size_t i = 0; i < NumSamples; i++) {
+        x[i] = dist(rng);
+        y[i] = dist(rng);
+        z[i] = dist(rng);
+    }
+
+    struct Kernel {
+        const char* name;
+        void (*func)(const float*, const float*, const float*, float*, size_t, SimdLevel);
+    };
+
+    const Kernel kernels[] = {
+        { "PerlinN", [](const float* x, const float* y, const float* z, float* out, size_t count, SimdLevel level) {
+            PerlinN(x, y, z, out, count, DefaultPerlinSeed, level);
+        } },
+        { "WorleyN (scale 16)", [](const float* x, const float* y, const float* z, float* out, size_t count, SimdLevel level) {
+            WorleyN(x, y, z, 16.f, out, count, level);
+        } },
+        { "PerlinFBMN", [](const float* x, const float* y, const float* z, float* out, size_t count, SimdLevel level) {
+            PerlinFBMN(x, y, z, out, count, DefaultPerlinSeed, level);
+        } },
+    };
+
+    std::cout << "best of " << Repetitions << " runs over " << NumSamples << " samples" << std::endl;
+    std::cout << std::left << std::setw(20) << "kernel" << std::setw(10) << "level"
+              << std::right << std::setw(16) << "Msamples/s" << std::setw(12) << "speedup" << std::endl;
+
+    for(const Kernel& kernel : kernels) {
+        double scalarRate = 0.0;
+        for(int level = 0; level <= (int)GetSimdLevel(); level++) {
+            const double seconds = benchmark::BestOf(Repetitions, [&]() {
+                kernel.func(x.data(), y.data(), z.data(), out.data(), NumSamples, (SimdLevel)level);
+            });
+            benchmark::DoNotOptimize(out[NumSamples / 2]);
+
+            const double rate = NumSamples / seconds;
+            if(level == 0) {
+                scalarRate = rate;
+            }
+
+            std::cout << std::left << std::setw(20) << kernel.name << std::setw(10) << SimdLevelToString((SimdLevel)level)
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(16) << rate / 1e6 << std::setw(11) << rate / scalarRate << "x" << std::endl;
+        }
+    }
+    return 0;
+}
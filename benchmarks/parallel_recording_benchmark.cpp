@@ -0,0 +1,180 @@
+#include <d3d12.h>
+#include <d3dcompiler.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_common.h"
+#include "command_list_pool.h"
+#include "multithreading/work_stealing_scheduler.h"
+
+//
+// Command list recording throughput split over 1, 2, 4, ... lists on the work-stealing scheduler,
+// the way Renderer::RecordParallel records the frame graph's passes: the lists are acquired from a
+// CommandListPool on the main thread, every job records and closes its own list.
+//
+// Every command is one compute pipeline execution like ComputePipelineState::Execute records it
+// (pipeline state, root signature, root constant and UAV, dispatch). Nothing is submitted, so
+// the pool's allocators can be reset for every run. Needs a D3D12 device, Windows only.
+//
+namespace {
+
+    constexpr uint32_t NumCommands = 100000;
+    constexpr int Repetitions = 5;
+
+    const char* ShaderSource = R"(
+        cbuffer Constants : register(b0) { uint index; };
+        RWByteAddressBuffer output : register(u0);
+
+        [numthreads(64, 1, 1)]
+        void main(uint3 id : SV_DispatchThreadID) {
+            output.Store(index * 4, id.x);
+        }
+    )";
+
+    struct Pipeline {
+        winrt::com_ptr<ID3D12RootSignature> rootSignature;
+        winrt::com_ptr<ID3D12PipelineState> pso;
+        winrt::com_ptr<ID3D12Resource> output;
+    };
+
+    Pipeline CreatePipeline(winrt::com_ptr<ID3D12Device2> device) {
+        Pipeline pipeline;
+
+        D3D12_ROOT_PARAMETER params[2] = {};
+        params[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+        params[0].Constants = { 0, 0, 1 };
+        params[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+        params[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+        params[1].Descriptor = { 0, 0 };
+        params[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+        D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc = {};
+        rootSignatureDesc.NumParameters = 2;
+        rootSignatureDesc.pParameters = params;
+
+        winrt::com_ptr<ID3DBlob> rootSignatureBlob;
+        winrt::com_ptr<ID3DBlob> errors;
+        winrt::check_hresult(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+                                                         rootSignatureBlob.put(), errors.put()));
+        winrt::check_hresult(device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(), rootSignatureBlob->GetBufferSize(),
+                                                         __uuidof(ID3D12RootSignature), pipeline.rootSignature.put_void()));
+
+        winrt::com_ptr<ID3DBlob> shaderBlob;
+        const HRESULT hr = D3DCompile(ShaderSource, strlen(ShaderSource), "parallel_recording_benchmark", nullptr, nullptr,
+                                      "main", "cs_5_1", 0, 0, shaderBlob.put(), errors.put());
+        if(FAILED(hr)) {
+            std::cerr << static_cast<const char*>(errors->GetBufferPointer()) << std::endl;
+            winrt::throw_hresult(hr);
+        }
+
+        D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.pRootSignature = pipeline.rootSignature.get();
+        psoDesc.CS = { shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize() };
+        winrt::check_hresult(device->CreateComputePipelineState(&psoDesc, __uuidof(ID3D12PipelineState), pipeline.pso.put_void()));
+
+        // never written to, the root UAV only needs a valid address
+        D3D12_HEAP_PROPERTIES heapProps = {};
+        heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+        D3D12_RESOURCE_DESC bufferDesc = {};
+        bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        bufferDesc.Width = 64 * 1024;
+        bufferDesc.Height = 1;
+        bufferDesc.DepthOrArraySize = 1;
+        bufferDesc.MipLevels = 1;
+        bufferDesc.SampleDesc.Count = 1;
+        bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        bufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+        winrt::check_hresult(device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COMMON,
+                                                             nullptr, __uuidof(ID3D12Resource), pipeline.output.put_void()));
+        return pipeline;
+    }
+
+    void RecordCommands(ID3D12GraphicsCommandList* cmdList, const Pipeline& pipeline, uint32_t first, uint32_t count) {
+        const D3D12_GPU_VIRTUAL_ADDRESS outputAddress = pipeline.output->GetGPUVirtualAddress();
+        for(uint32_t i = first; i < first + count; i++) {
+            cmdList->SetPipelineState(pipeline.pso.get());
+            cmdList->SetComputeRootSignature(pipeline.rootSignature.get());
+            cmdList->SetComputeRoot32BitConstant(0, i, 0);
+            cmdList->SetComputeRootUnorderedAccessView(1, outputAddress);
+            cmdList->Dispatch(1, 1, 1);
+        }
+    }
+
+    // NumCommands recorded into numJobs lists, acquiring the lists included
+    void RecordJobs(CommandListPool& pool, WorkStealingScheduler& scheduler, const Pipeline& pipeline, uint32_t numJobs) {
+        pool.BeginFrame(0);
+
+        std::vector<CommandListPool::Entry*> entries;
+        for(uint32_t i = 0; i < numJobs; i++) {
+            HRESULT hr;
+            entries.push_back(pool.Acquire(hr));
+            winrt::check_hresult(hr);
+        }
+
+        std::vector<std::future<HRESULT>> recorded;
+        uint32_t first = 0;
+        for(uint32_t i = 0; i < numJobs; i++) {
+            const uint32_t count = NumCommands / numJobs + (i < NumCommands % numJobs ? 1 : 0);
+            std::packaged_task<HRESULT()> task([&pipeline, entry = entries[i], first, count]() {
+                RecordCommands(entry->cmdList.get(), pipeline, first, count);
+                return entry->cmdList->Close();
+            });
+            recorded.push_back(task.get_future());
+            scheduler.AddTask(std::move(task));
+            first += count;
+        }
+
+        for(std::future<HRESULT>& jobResult : recorded) {
+            winrt::check_hresult(jobResult.get());
+        }
+    }
+
+} // namespace
+
+int main() {
+    winrt::com_ptr<ID3D12Device2> device;
+    if(FAILED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, __uuidof(ID3D12Device2), device.put_void()))) {
+        std::cerr << "No D3D12 device" << std::endl;
+        return 1;
+    }
+
+    const Pipeline pipeline = CreatePipeline(device);
+    CommandListPool pool(device, 1);
+
+    WorkStealingScheduler scheduler;
+    scheduler.Start();
+    const uint32_t maxJobs = std::max<uint32_t>(1, scheduler.GetNumThreads());
+
+    struct Result {
+        uint32_t numJobs;
+        double seconds;
+    };
+    std::vector<Result> results;
+    for(uint32_t numJobs = 1;; numJobs = std::min(numJobs * 2, maxJobs)) {
+        // the first run creates the pool's lists, BestOf drops it
+        results.push_back({ numJobs, benchmark::BestOf(Repetitions, [&]() { RecordJobs(pool, scheduler, pipeline, numJobs); }) });
+        if(numJobs == maxJobs) {
+            break;
+        }
+    }
+
+    std::cout << std::endl << NumCommands << " compute pipeline executions, " << scheduler.GetNumThreads() << " workers, "
+              << std::thread::hardware_concurrency() << " hardware threads, best of " << Repetitions << std::endl;
+    std::cout << std::setw(8) << "lists" << std::setw(12) << "ms" << std::setw(16) << "Mcommands/s" << std::setw(10) << "speedup" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(2);
+    for(const Result& result : results) {
+        std::cout << std::setw(8) << result.numJobs << std::setw(12) << result.seconds * 1000.0
+                  << std::setw(16) << NumCommands / result.seconds / 1e6
+                  << std::setw(9) << results[0].seconds / result.seconds << "x" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <cstdint>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark_common.h"
+#include "multithreading/thread_pool.h"
+#include "multithreading/work_stealing_scheduler.h"
+
+//
+// Task throughput of WorkStealingScheduler vs ThreadPool<void> at 1-64 threads.
+//
+// flat:    every task is submitted from the main thread, so both schedulers
+//          go through a single shared queue (the injection queue for the work stealer)
+// fan-out: the main thread submits a few root tasks that submit the rest from
+//          the workers, the case the per-worker deques are built for
+//
+// Tasks are tiny on purpose, the numbers are dominated by queueing and wake-ups.
+//
+namespace {
+
+    constexpr uint32_t NumTasks = 1 << 16;
+    constexpr uint32_t NumRootTasks = 64;
+    constexpr uint32_t ChildrenPerRoot = NumTasks / NumRootTasks;
+    constexpr uint32_t WorkPerTask = 256;
+    constexpr int Repetitions = 3;
+
+    void DoWork(std::atomic<uint64_t>& sink) {
+        uint64_t v = 0x9e3779b97f4a7c15ull;
+        for(uint32_t i = 0; i < WorkPerTask; i++) {
+            v ^= v << 13;
+            v ^= v >> 7;
+            v ^= v << 17;
+        }
+        sink.fetch_add(v & 1, std::memory_order_relaxed);
+    }
+
+    template <typename Scheduler>
+    void Submit(Scheduler& scheduler, std::function<void()> func) {
+        scheduler.AddTask(std::packaged_task<void()>(std::move(func)));
+    }
+
+    template <typename Scheduler>
+    void RunFlat(Scheduler& scheduler, std::atomic<uint64_t>& sink) {
+        std::latch done(NumTasks);
+        for(uint32_t i = 0; i < NumTasks; i++) {
+            Submit(scheduler, [&]() {
+                DoWork(sink);
+                done.count_down();
+            });
+        }
+        done.wait();
+    }
+
+    template <typename Scheduler>
+    void RunFanOut(Scheduler& scheduler, std::atomic<uint64_t>& sink) {
+        std::latch done(NumRootTasks * ChildrenPerRoot);
+        for(uint32_t i = 0; i < NumRootTasks; i++) {
+            Submit(scheduler, [&]() {
+                for(uint32_t c = 0; c < ChildrenPerRoot; c++) {
+                    Submit(scheduler, [&]() {
+                        DoWork(sink);
+                        done.count_down();
+                    });
+                }
+            });
+        }
+        done.wait();
+    }
+
+    // tasks per second, best of Repetitions, the thread start-up isn't timed
+    template <typename Scheduler>
+    double Measure(uint16_t numThreads, bool fanOut) {
+        Scheduler scheduler(numThreads);
+        scheduler.Start();
+
+        std::atomic<uint64_t> sink = 0;
+        const double seconds = benchmark::BestOf(Repetitions, [&]() {
+            if(fanOut) {
+                RunFanOut(scheduler, sink);
+            }
+            else {
+                RunFlat(scheduler, sink);
+            }
+        });
+        benchmark::DoNotOptimize(sink.load());
+        return NumTasks / seconds;
+    }
+
+    struct Result {
+        uint16_t numThreads;
+        double threadPoolRate[2];
+        double workStealingRate[2];
+    };
+
+} // namespace
+
+int main() {
+    const uint16_t threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    // ThreadPool logs every worker shutdown, so the table is printed at the end
+    std::vector<Result> results;
+    for(uint16_t numThreads : threadCounts) {
+        Result result = {};
+        result.numThreads = numThreads;
+        for(int fanOut = 0; fanOut < 2; fanOut++) {
+            result.threadPoolRate[fanOut] = Measure<ThreadPool<void>>(numThreads, fanOut != 0);
+            result.workStealingRate[fanOut] = Measure<WorkStealingScheduler>(numThreads, fanOut != 0);
+        }
+        results.push_back(result);
+    }
+
+    std::cout << std::endl << NumTasks << " tasks, " << std::thread::hardware_concurrency()
+              << " hardware threads, Mtasks/s (best of " << Repetitions << ")" << std::endl;
+    std::cout << std::setw(8) << "threads"
+              << std::setw(14) << "pool flat" << std::setw(14) << "ws flat" << std::setw(10) << "ratio"
+              << std::setw(14) << "pool fan-out" << std::setw(14) << "ws fan-out" << std::setw(10) << "ratio" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(2);
+    for(const Result& r : results) {
+        std::cout << std::setw(8) << r.numThreads;
+        for(int fanOut = 0; fanOut < 2; fanOut++) {
+            std::cout << std::setw(14) << r.threadPoolRate[fanOut] / 1e6
+                      << std::setw(14) << r.workStealingRate[fanOut] / 1e6
+                      << std::setw(9) << r.workStealingRate[fanOut] / r.threadPoolRate[fanOut] << "x";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
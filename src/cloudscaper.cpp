@@ -1,5 +1,6 @@
 #include "cloudscaper.h"
 
+#include <algorithm>
 #include <iostream>
 #include <renderer_common.h>
 
@@ -8,14 +9,77 @@
 #include "resources.h"
 #include "window.h"
 #include "memory/static_memory_allocator.h"
+#include "memory/transient_resource_planner.h"
+#include "frame_graph_d3d12.h"
 #include "pipeline_state.h"
 #include "memory/static_descriptor_allocator.h"
 #include "pipeline_builder.h"
 #include "ui/ui_framework.h"
+#include "cloudscapes/model_noise_baker.h"
+#include "cloudscapes/noise_volume_cache.h"
+#include "ninmath/hash.h"
 
+namespace {
+    const char* NoiseVolumeCacheDirectory = "cache/noise";
+
+    // written on startup and whenever the telemetry button is pressed
+    const char* MemoryTelemetryPath = "telemetry/memory.json";
+
+    // texel format of the cached noise volumes, see MeasureNoiseVolumeQuality for the error each one adds
+    const NoiseVolumeFormat CachedNoiseVolumeFormat = NoiseVolumeFormat::RGBA16F;
+
+    // How far (in radians) the light can move before the multiscattering/skyview LUTs are rebaked. At this
+    // tolerance a stale skyview LUT is off by up to a few percent. The multiscattering LUT reads the light
+    // direction too, but it only reaches the screen through skyview, and a stale one changes that by less
+    // than 1e-4 (see atmosphere_lut_baker_test). Without the tolerance it would rerun, and skyview with it,
+    // on every light change.
+    const float LUTLightDirTolerance = 0.005f;
+
+    // debug output: the frame graph's barrier plan and the transient aliasing plan, printed the first frame the clouds render
+    const bool PrintFrameGraphPlans = false;
+
+    void AddToHash(ninmath::hash::Hasher& hasher, const ninmath::Vector3f& v) {
+        hasher.Add(v.x).Add(v.y).Add(v.z);
+    }
+
+    DXGI_FORMAT GetNoiseVolumeDXGIFormat(NoiseVolumeFormat format) {
+        switch(format) {
+        case NoiseVolumeFormat::RGBA32F:
+            return DXGI_FORMAT_R32G32B32A32_FLOAT;
+        case NoiseVolumeFormat::RGBA16F:
+            return DXGI_FORMAT_R16G16B16A16_FLOAT;
+        case NoiseVolumeFormat::RGBA8:
+            return DXGI_FORMAT_R8G8B8A8_UNORM;
+        default:
+            // BC4Planes needs one texture per channel, raymarch_quad_ps.hlsl samples a single float4 volume
+            WINRT_ASSERT("Noise volume format can't be sampled as a single texture" && false);
+            return DXGI_FORMAT_UNKNOWN;
+        }
+    }
+
+    std::vector<StaticTexture3D::MipData> GetCachedNoiseMips(const MappedNoiseVolume& volume) {
+        std::vector<StaticTexture3D::MipData> mips;
+        for(uint32_t i = 0; i < volume.GetNumMips(); i++) {
+            const NoiseVolumeMipInfo& info = volume.GetMipInfo(i);
+            const uint64_t rowPitch = GetNoiseVolumeRowPitch(volume.GetFormat(), info.width);
+            mips.push_back({ volume.GetMipData(i), rowPitch, rowPitch * GetNoiseVolumeNumRows(volume.GetFormat(), info.height) });
+        }
+        return mips;
+    }
+
+    std::vector<EncodedNoiseVolume> EncodeNoiseMips(const std::vector<NoiseVolume>& mips, NoiseVolumeFormat format) {
+        std::vector<EncodedNoiseVolume> encodedMips;
+        for(const NoiseVolume& mip : mips) {
+            encodedMips.push_back(EncodeNoiseVolume(mip, format));
+        }
+
+        PrintNoiseVolumeQualityReport(MeasureNoiseVolumeQuality(mips[0], encodedMips[0]));
+        return encodedMips;
+    }
+}
 
 Cloudscaper::Cloudscaper(HINSTANCE hinst)
-    : Application(hinst, ApplicationParams("Cloudscaper")), curFrame_(0), elapsedTime_(0) {
+    : Application(hinst, ApplicationParams("Cloudscaper")), skyViewLUTReadIndex_(0), noiseBakeCancelled_(false), curFrame_(0), elapsedTime_(0), frameGraphPrinted_(false) {
 
     mainWindow_ = CreateAppWindow("First window");
     mainWindow_->Show();
@@ -38,9 +102,18 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
     imageTex_ = memAllocator_->CreateResource<ImageTexture2D>("Image", "assets/fonts/Montserrat/sdf_atlas_montserrat_regular.png");
     computeTex_ = memAllocator_->CreateResource<Texture2D>("Compute", DXGI_FORMAT_R8G8B8A8_UNORM, 256, 256, true, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
     
-    transmittanceLUT_ = memAllocator_->CreateResource<Texture2D>("Transmittance LUT", DXGI_FORMAT_R32G32B32A32_FLOAT, 256, 64, true, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    multiScatteringLUT_ = memAllocator_->CreateResource<Texture2D>("MultiScattering LUT", DXGI_FORMAT_R32G32B32A32_FLOAT, 32, 32, true, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    skyViewLUT_ = memAllocator_->CreateResource<Texture2D>("SkyView LUT", DXGI_FORMAT_R32G32B32A32_FLOAT, 256, 128, true, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    // written on the compute queue, see ExecuteComputePass
+    transmittanceLUT_ = memAllocator_->CreateResource<Texture2D>("Transmittance LUT", DXGI_FORMAT_R32G32B32A32_FLOAT, 256, 64, true, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    multiScatteringLUT_ = memAllocator_->CreateResource<Texture2D>("MultiScattering LUT", DXGI_FORMAT_R32G32B32A32_FLOAT, 32, 32, true, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    for(uint32_t i = 0; i < 2; i++) {
+        const std::string name = "SkyView LUT " + std::to_string(i);
+        skyViewLUTs_[i] = memAllocator_->CreateResource<Texture2D>(name, DXGI_FORMAT_R32G32B32A32_FLOAT, 256, 128, true, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        skyViewLUTQueueRes_[i] = renderer_->GetQueueScheduler().AddResource(name);
+    }
+
+    transmittanceLUTIndex_ = lutTracker_.AddLUT("Transmittance LUT");
+    multiScatteringLUTIndex_ = lutTracker_.AddLUT("MultiScattering LUT", { transmittanceLUTIndex_ });
+    skyViewLUTIndex_ = lutTracker_.AddLUT("SkyView LUT", { transmittanceLUTIndex_, multiScatteringLUTIndex_ });
 
     VertexBufferLayout layout({
         {"POSITION", 0, ShaderDataType::Float4},
@@ -74,6 +147,7 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
 
     ninmath::Vector3f lightDir = ninmath::Vector3f(0, 1, 0.9).Normal();
     lightDirAngle_ = 0;
+    lutLightDir_ = lightDir;
 
     skyContext_ = {
         .cameraPos = {0,0,0.1}, // in km
@@ -176,7 +250,16 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
     rootWidget_->AddChild(testSlider_, HorizontalAlignment::Left);
     rootWidget_->AddChild(lightDirSlider_, HorizontalAlignment::Left);
     rootWidget_->AddChild(camSpinSlider_, HorizontalAlignment::Left);
-    
+
+    telemetryButton_ = uiFramework_->CreateWidget<Button>("telemetry button");
+    telemetryButton_->SetText("Dump memory telemetry", 16);
+    telemetryButton_->SetHoverColor(ninmath::Vector4f{0.3,0.3,0.3,1});
+    telemetryButton_->SetPressedColor(ninmath::Vector4f{0.5,0.5,0.5,1});
+    telemetryButton_->SetOnPressed([this]() {
+        renderer_->DumpAllocationTelemetry(MemoryTelemetryPath);
+    });
+    rootWidget_->AddChild(telemetryButton_, HorizontalAlignment::Left);
+
     rootWidget_->AddChild(text_, HorizontalAlignment::Left);
 
     mainRT_ = renderer_->CreateRenderTarget("main_rt", DXGI_FORMAT_R8G8B8A8_UNORM, true, D3D12_RESOURCE_STATE_COMMON);
@@ -188,7 +271,7 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
         renderer_->BuildComputePipeline("Transmittance LUT Calculation")
         .ComputeShader("shaders/atmosphere/transmittance_lut_cs.hlsl")
         .UAV(transmittanceLUT_, 0)
-        .CBV(atmosphereContextBuffer_, 0)
+        .CBV(atmosphereContextBuffer_, 0, ResourceBindMethod::RootDescriptor)
         .SyncThreadCountsWithTexture2DSize(transmittanceLUT_)
         .Build();
 
@@ -205,12 +288,16 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
     skyviewCPSO_ =
         renderer_->BuildComputePipeline("SkyView LUT Calculation")
         .ComputeShader("shaders/atmosphere/skyview_lut_cs.hlsl")
-        .UAV(skyViewLUT_, 0)
+        .UAV(skyViewLUTs_[0], 0)
         .SRV(transmittanceLUT_, 0)
         .SRV(multiScatteringLUT_, 1)
         .CBV(atmosphereContextBuffer_, 0, ResourceBindMethod::RootDescriptor)
         .CBV(skyContextBuffer_, 1, ResourceBindMethod::RootDescriptor)
-        .SyncThreadCountsWithTexture2DSize(skyViewLUT_)
+        .ResourceConfiguration(1,
+            ResourceConfiguration()
+            .UAV(skyViewLUTs_[1], 0)
+        )
+        .SyncThreadCountsWithTexture2DSize(skyViewLUTs_[0])
         .Build();
     
     renderSkyGPSO_ =
@@ -219,11 +306,15 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
         .PixelShader("shaders/atmosphere/sky_raymarch_quad_ps.hlsl")
         .VertexBuffer(vertexBuffer_, 0)
         .IndexBuffer(indexBuffer_)
-        .SRV(skyViewLUT_, 0)
+        .SRV(skyViewLUTs_[0], 0)
         .StaticSampler(renderer_common::samplerLinearClamp, 0)
         .CBV(atmosphereContextBuffer_, 0, ResourceBindMethod::RootDescriptor)
         .CBV(skyContextBuffer_, 1, ResourceBindMethod::RootDescriptor)
         .CBV(renderContextBuffer_, 2, ResourceBindMethod::RootDescriptor)
+        .ResourceConfiguration(1,
+            ResourceConfiguration()
+            .SRV(skyViewLUTs_[1], 0)
+        )
         .RenderTargetConfiguration(0,
         RenderTargetConfiguration()
             .RenderTarget("main_rt", 0)
@@ -231,49 +322,96 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
         .Build();
 
     // clouds
-    noiseGenDone_ = false;
-
     const uint32_t modelResolution = 256;
     const uint32_t detailResolution = 32;
+    const uint32_t numNoiseMips = 6;
     blueNoise_ = memAllocator_->CreateResource<ImageTexture2D>("Blue Noise", "assets/blue_noise_128x128.png");
     weatherTexture_ = memAllocator_->CreateResource<ImageTexture2D>("Weather Texture", "assets/weather_texture_sparse.png");
-    modelNoise_ = memAllocator_->CreateResource<Texture3D>("Cloud Model Noise", DXGI_FORMAT_R32G32B32A32_FLOAT, modelResolution, modelResolution, modelResolution, true, 6, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    detailNoise_ = memAllocator_->CreateResource<Texture3D>("Cloud Detail Noise", DXGI_FORMAT_R32G32B32A32_FLOAT, detailResolution, detailResolution, detailResolution, true, 6, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    
-    computeModelNoiseCPSO_ =
-        renderer_->BuildComputePipeline("Compute Model Noise")
-        .ComputeShader("shaders/cloudscapes/compute_model_noise_cs.hlsl")
-        .UAV(modelNoise_, 0)
-        .SyncThreadCountsWithTexture3DSize(modelNoise_)
-        .Build();
+
+    // noise volumes baked by a previous run are mapped straight from disk and uploaded,
+    // only a cold start generates them on the GPU
+    const ninmath::noise::ModelNoiseParameters noiseParams;
+    const NoiseVolumeCache noiseCache(NoiseVolumeCacheDirectory);
+    const uint64_t modelNoiseKey = ComputeNoiseVolumeKey(NoiseVolumeType::Model, noiseParams, modelResolution, numNoiseMips, CachedNoiseVolumeFormat);
+    const uint64_t detailNoiseKey = ComputeNoiseVolumeKey(NoiseVolumeType::Detail, noiseParams, detailResolution, numNoiseMips, CachedNoiseVolumeFormat);
+    std::shared_ptr<MappedNoiseVolume> cachedModelNoise = noiseCache.Load(modelNoiseKey);
+    std::shared_ptr<MappedNoiseVolume> cachedDetailNoise = noiseCache.Load(detailNoiseKey);
+
+    noiseGenDone_ = cachedModelNoise && cachedDetailNoise;
     
-    computeDetailNoiseCPSO_ =
-        renderer_->BuildComputePipeline("Compute Detail Noise")
-        .ComputeShader("shaders/cloudscapes/compute_detail_noise_cs.hlsl")
-        .UAV(detailNoise_, 0)
-        .SyncThreadCountsWithTexture3DSize(detailNoise_)
-        .Build();
+    if(noiseGenDone_) {
+        std::cout << "Using cached cloud noise volumes" << std::endl;
 
-    gen3DMipMapsCPSO_ =
-        renderer_->BuildComputePipeline("Cloud Noise 3D Mip Maps")
-        .ComputeShader("shaders/cloudscapes/texture_3d_mip_maps_cs.hlsl")
-        .ResourceConfiguration(0,
-            ResourceConfiguration()
-            .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(0, 0, 256), 0)
-            .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(1, 0, 128), 1)
-        )
-        .ResourceConfiguration(1,
-            ResourceConfiguration()
-            .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(1, 0, 128), 0)
-            .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(2, 0, 64), 1)
-        )
-        .ResourceConfiguration(2,
-            ResourceConfiguration()
-            .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(2, 0, 64), 0)
-            .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(3, 0, 32), 1)
-        )
-        .SyncThreadCountsWithTexture3DSize(modelNoise_)
-        .Build();
+        const DXGI_FORMAT cachedFormat = GetNoiseVolumeDXGIFormat(CachedNoiseVolumeFormat);
+        modelNoise_ = memAllocator_->CreateResource<StaticTexture3D>("Cloud Model Noise", cachedFormat, modelResolution, modelResolution, modelResolution, false, D3D12_RESOURCE_STATE_COMMON, GetCachedNoiseMips(*cachedModelNoise), cachedModelNoise);
+        detailNoise_ = memAllocator_->CreateResource<StaticTexture3D>("Cloud Detail Noise", cachedFormat, detailResolution, detailResolution, detailResolution, false, D3D12_RESOURCE_STATE_COMMON, GetCachedNoiseMips(*cachedDetailNoise), cachedDetailNoise);
+    }
+    else {
+        modelNoise_ = memAllocator_->CreateResource<Texture3D>("Cloud Model Noise", DXGI_FORMAT_R32G32B32A32_FLOAT, modelResolution, modelResolution, modelResolution, true, numNoiseMips, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        detailNoise_ = memAllocator_->CreateResource<Texture3D>("Cloud Detail Noise", DXGI_FORMAT_R32G32B32A32_FLOAT, detailResolution, detailResolution, detailResolution, true, numNoiseMips, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+        // bake the same volumes (with every mip) on the CPU in the background, so the next launch hits the cache.
+        // Leaves half of the cores to the renderer. A cancelled (partial) volume is never stored
+        noiseBakeThread_ = std::thread([=, cancelled = &noiseBakeCancelled_, modelHit = cachedModelNoise != nullptr, detailHit = cachedDetailNoise != nullptr]() {
+            ModelNoiseBaker baker(noiseParams, std::max(1u, std::thread::hardware_concurrency() / 2));
+            baker.SetCancelFlag(cancelled);
+            const NoiseVolumeCache cache(NoiseVolumeCacheDirectory);
+
+            if(!modelHit) {
+                NoiseVolume volume = baker.Bake(modelResolution);
+                if(baker.IsCancelled()) {
+                    return;
+                }
+                cache.Store(modelNoiseKey, NoiseVolumeType::Model, EncodeNoiseMips(GenerateNoiseVolumeMipChain(std::move(volume), numNoiseMips), CachedNoiseVolumeFormat));
+            }
+            if(!detailHit) {
+                NoiseVolume volume = baker.BakeDetail(detailResolution);
+                if(baker.IsCancelled()) {
+                    return;
+                }
+                cache.Store(detailNoiseKey, NoiseVolumeType::Detail, EncodeNoiseMips(GenerateNoiseVolumeMipChain(std::move(volume), numNoiseMips), CachedNoiseVolumeFormat));
+            }
+        });
+
+        computeModelNoiseCPSO_ =
+            renderer_->BuildComputePipeline("Compute Model Noise")
+            .ComputeShader("shaders/cloudscapes/compute_model_noise_cs.hlsl")
+            .UAV(modelNoise_, 0)
+            .SyncThreadCountsWithTexture3DSize(modelNoise_)
+            .Build();
+    
+        computeDetailNoiseCPSO_ =
+            renderer_->BuildComputePipeline("Compute Detail Noise")
+            .ComputeShader("shaders/cloudscapes/compute_detail_noise_cs.hlsl")
+            .UAV(detailNoise_, 0)
+            .SyncThreadCountsWithTexture3DSize(detailNoise_)
+            .Build();
+
+        gen3DMipMapsCPSO_ =
+            renderer_->BuildComputePipeline("Cloud Noise 3D Mip Maps")
+            .ComputeShader("shaders/cloudscapes/texture_3d_mip_maps_cs.hlsl")
+            .ResourceConfiguration(0,
+                ResourceConfiguration()
+                .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(0, 0, 256), 0)
+                .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(1, 0, 128), 1)
+            )
+            .ResourceConfiguration(1,
+                ResourceConfiguration()
+                .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(1, 0, 128), 0)
+                .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(2, 0, 64), 1)
+            )
+            .ResourceConfiguration(2,
+                ResourceConfiguration()
+                .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(2, 0, 64), 0)
+                .UAV<Texture3D::UAVConfig>(modelNoise_, Texture3D::UAVConfig(3, 0, 32), 1)
+            )
+            .SyncThreadCountsWithTexture3DSize(modelNoise_)
+            .Build();
+    }
+
+    // generated noise is written on the compute queue, the clouds read it on the direct one
+    modelNoiseQueueRes_ = renderer_->GetQueueScheduler().AddResource("Cloud Model Noise");
+    detailNoiseQueueRes_ = renderer_->GetQueueScheduler().AddResource("Cloud Detail Noise");
 
     D3D12_BLEND_DESC cloudsBlendDesc = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
     cloudsBlendDesc.RenderTarget[0].BlendEnable = TRUE;
@@ -302,7 +440,7 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
         .SRV(detailNoise_, 1)
         .SRV(blueNoise_, 2)
         .SRV(weatherTexture_, 3)
-        .SRV(skyViewLUT_, 4)
+        .SRV(skyViewLUTs_[0], 4)
     
     
         .CBV(renderContextBuffer_, 0, ResourceBindMethod::RootDescriptor)
@@ -313,6 +451,17 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
             ResourceConfiguration()
             .SRV(cloudRT0_, 5) // render to 1 => prevFrame is 0
         )
+        // + 2: reading the other SkyView LUT
+        .ResourceConfiguration(2,
+            ResourceConfiguration()
+            .SRV(skyViewLUTs_[1], 4)
+            .SRV(cloudRT1_, 5)
+        )
+        .ResourceConfiguration(3,
+            ResourceConfiguration()
+            .SRV(skyViewLUTs_[1], 4)
+            .SRV(cloudRT0_, 5)
+        )
     
         .StaticSampler(renderer_common::samplerLinearWrap, 0)
         .StaticSampler(renderer_common::samplerPointClamp, 1)
@@ -584,13 +733,119 @@ Cloudscaper::Cloudscaper(HINSTANCE hinst)
      */
     
     memAllocator_->Commit();
+
+    renderer_->DumpAllocationTelemetry(MemoryTelemetryPath);
 }
 
 Cloudscaper::~Cloudscaper() {
+    noiseBakeCancelled_ = true;
+    if(noiseBakeThread_.joinable()) {
+        noiseBakeThread_.join();
+    }
+
+    for(uint32_t i = 0; i < lutTracker_.GetNumLUTs(); i++) {
+        const LUTRecomputeTracker::LUTStats& stats = lutTracker_.GetStats(i);
+        std::cout << lutTracker_.GetName(i) << ": " << stats.numRecomputes << " recomputes, " << stats.numSkips << " skipped" << std::endl;
+    }
+
     memAllocator_.reset();
     renderer_.reset();
 }
 
+void Cloudscaper::UpdateAtmosphereLUTs(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::vector<GPUQueueAccess>& accesses) {
+    // The GPU still reads the exact light direction, the tolerance only decides when the LUTs catch up.
+    if(lutLightDir_.Dot(skyContext_.lightDir) < std::cos(LUTLightDirTolerance)) {
+        lutLightDir_ = skyContext_.lightDir;
+    }
+
+    const std::shared_ptr<PipelineState> transmittancePSO = transmittanceCPSO_.lock();
+    const std::shared_ptr<PipelineState> multiScatteringPSO = multiScatteringCPSO_.lock();
+    const std::shared_ptr<PipelineState> skyviewPSO = skyviewCPSO_.lock();
+
+    ninmath::hash::Hasher transmittanceInputs;
+    transmittanceInputs.Add(atmosphereContext_.Rb)
+                       .Add(atmosphereContext_.Rt)
+                       .Add(transmittancePSO->GetStateGeneration());
+
+    lutTracker_.Update(transmittanceLUTIndex_, transmittanceInputs.Get(), [&]() {
+        return ExecuteComputePass(cmdList, transmittancePSO, { transmittanceLUT_.lock() });
+    });
+
+    ninmath::hash::Hasher multiScatteringInputs;
+    multiScatteringInputs.Add(atmosphereContext_.Rb)
+                         .Add(atmosphereContext_.Rt)
+                         .Add(multiScatteringPSO->GetStateGeneration());
+    AddToHash(multiScatteringInputs, lutLightDir_);
+    AddToHash(multiScatteringInputs, skyContext_.sunIlluminance);
+    AddToHash(multiScatteringInputs, skyContext_.groundAlbedo);
+
+    lutTracker_.Update(multiScatteringLUTIndex_, multiScatteringInputs.Get(), [&]() {
+        return ExecuteComputePass(cmdList, multiScatteringPSO, { multiScatteringLUT_.lock() });
+    });
+
+    // The skyview shader only sees the camera's distance to the planet's center and the sun's zenith angle
+    // there, so moving at a constant altitude under a fixed sun doesn't rerun it. The ground albedo only
+    // reaches it through the multiscattering LUT.
+    const ninmath::Vector3f skyViewPos = skyContext_.cameraPos + ninmath::Vector3f(0, 0, atmosphereContext_.Rb);
+    const float skyViewR = skyViewPos.Length();
+
+    ninmath::hash::Hasher skyViewInputs;
+    skyViewInputs.Add(atmosphereContext_.Rb)
+                 .Add(atmosphereContext_.Rt)
+                 .Add(skyviewPSO->GetStateGeneration())
+                 .Add(skyViewR)
+                 .Add((skyViewPos / skyViewR).Dot(lutLightDir_.Normal()));
+    AddToHash(skyViewInputs, skyContext_.sunIlluminance);
+
+    // the draws switch over to the new one once it's written, the direct queue waits for that
+    const uint32_t skyViewWriteIndex = 1 - skyViewLUTReadIndex_;
+    const bool skyViewRecomputed = lutTracker_.Update(skyViewLUTIndex_, skyViewInputs.Get(), [&]() {
+        skyviewPSO->SetResourceConfigurationIndex(skyViewWriteIndex);
+        return ExecuteComputePass(cmdList, skyviewPSO, { skyViewLUTs_[skyViewWriteIndex].lock() });
+    });
+
+    if(skyViewRecomputed) {
+        accesses.push_back({ skyViewLUTQueueRes_[skyViewWriteIndex], true });
+        skyViewLUTReadIndex_ = skyViewWriteIndex;
+    }
+}
+
+bool Cloudscaper::ExecuteComputePass(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::shared_ptr<PipelineState> pso,
+                                     std::initializer_list<std::shared_ptr<Resource>> outputs) {
+    ResourceBarrierBatcher& batcher = renderer_->GetBarrierBatcher(cmdList);
+    for(const std::shared_ptr<Resource>& output : outputs) {
+        output->ChangeState(D3D12_RESOURCE_STATE_UNORDERED_ACCESS, batcher);
+    }
+
+    const bool executed = renderer_->ExecutePipeline(cmdList, pso);
+
+    // If the next pass writes it again the transitions cancel out and the UAV barrier orders the two,
+    // otherwise the transition does. Nothing goes out if the pipeline didn't run.
+    for(const std::shared_ptr<Resource>& output : outputs) {
+        output->ChangeState(D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, batcher);
+        if(executed) {
+            batcher.UAV(output->GetNativeResource().get());
+        }
+    }
+    return executed;
+}
+
+void Cloudscaper::PrintTransientAliasingPlan(const FrameGraph& graph, std::initializer_list<std::pair<uint32_t, std::shared_ptr<Resource>>> heapResources,
+                                             std::initializer_list<uint32_t> transientResources) const {
+    std::vector<TransientResourceDesc> descs(graph.GetNumResources());
+    for(const std::pair<uint32_t, std::shared_ptr<Resource>>& heapResource : heapResources) {
+        const D3D12_RESOURCE_DESC desc = heapResource.second->CreateResourceDesc();
+        const D3D12_RESOURCE_ALLOCATION_INFO info = renderer_->GetDevice()->GetResourceAllocationInfo(0, 1, &desc);
+        descs[heapResource.first].size = info.SizeInBytes;
+        descs[heapResource.first].alignment = info.Alignment;
+        descs[heapResource.first].persistent = std::find(transientResources.begin(), transientResources.end(), heapResource.first) == transientResources.end();
+    }
+
+    TransientResourcePlanner planner;
+    planner.AddFrameGraph(graph, descs);
+    planner.PrintPlan(planner.Plan());
+}
+
 void Cloudscaper::Tick(double deltaTime) {
     Application::Tick(deltaTime);
 
@@ -644,81 +899,146 @@ void Cloudscaper::Tick(double deltaTime) {
     renderer_->Tick(deltaTime);
     uiFramework_->Tick(deltaTime);
 
-    renderer_->ExecutePipeline(cmdList, transmittanceCPSO_.lock());
-    renderer_->ExecutePipeline(cmdList, multiScatteringCPSO_.lock());
-    renderer_->ExecutePipeline(cmdList, skyviewCPSO_.lock());
-    renderer_->ExecutePipeline(cmdList, renderSkyGPSO_.lock());
+    // The LUTs and the noise only need compute, they go to the async compute queue ahead of this
+    // frame's draws, so they can run while the GPU is still drawing the previous frame.
+    winrt::com_ptr<ID3D12GraphicsCommandList> computeCmdList = renderer_->StartComputeCommandList(hr);
+    HandleHRESULT(hr);
+
+    std::vector<GPUQueueAccess> computeAccesses;
+    UpdateAtmosphereLUTs(computeCmdList, computeAccesses);
     
     std::shared_ptr<RenderTarget> swapChainRes_ = renderer_->GetCurrentSwapChainBufferResource();
     const bool usingFrame0 = (curFrame_ % 2) == 0;
 
-    if(computeModelNoiseCPSO_.lock()->IsReadyAndOk() && computeDetailNoiseCPSO_.lock()->IsReadyAndOk()) {
+    // noise generation pipelines only exist when the noise volumes weren't cached
+    bool renderClouds = false;
+    bool noiseGenerated = false;
+    if(noiseGenDone_ || (computeModelNoiseCPSO_.lock()->IsReadyAndOk() && computeDetailNoiseCPSO_.lock()->IsReadyAndOk())) {
         if(!noiseGenDone_) {
-            renderer_->ExecutePipeline(cmdList, computeModelNoiseCPSO_.lock());
-            renderer_->ExecutePipeline(cmdList, computeDetailNoiseCPSO_.lock());
+            ExecuteComputePass(computeCmdList, computeModelNoiseCPSO_.lock(), { modelNoise_.lock() });
+            ExecuteComputePass(computeCmdList, computeDetailNoiseCPSO_.lock(), { detailNoise_.lock() });
             
+            // every mip reads the one before, written by the previous pass
             for(int i = 0; i < gen3DMipMapsCPSO_.lock()->GetNumResourceConfigurations(); i++) {
                 gen3DMipMapsCPSO_.lock()->SetResourceConfigurationIndex(i);
-                renderer_->ExecutePipeline(cmdList, gen3DMipMapsCPSO_.lock());
+                ExecuteComputePass(computeCmdList, gen3DMipMapsCPSO_.lock(), { modelNoise_.lock() });
             }
 
+            computeAccesses.push_back({ modelNoiseQueueRes_, true });
+            computeAccesses.push_back({ detailNoiseQueueRes_, true });
             noiseGenDone_ = true;
+            noiseGenerated = true;
         }
         else {
-            std::shared_ptr<GraphicsPipelineState> cloudsGPSO = std::static_pointer_cast<GraphicsPipelineState>(renderCloudsGPSO_.lock());
-            cloudsGPSO->SetResourceConfigurationIndex(usingFrame0? 0 : 1);
-            cloudsGPSO->SetRenderTargetConfigurationIndex(usingFrame0? 0 : 1);
+            renderClouds = true;
+        }
+    }
 
-            D3D12_RESOURCE_STATES shaderResState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
-            if(usingFrame0) {
-                cloudRT1_.lock()->ChangeStateDirect(shaderResState, cmdList);
-                cloudRT0_.lock()->ChangeStateDirect(D3D12_RESOURCE_STATE_RENDER_TARGET, cmdList);
-            }
-            else {
-                cloudRT0_.lock()->ChangeStateDirect(shaderResState, cmdList);
-                cloudRT1_.lock()->ChangeStateDirect(D3D12_RESOURCE_STATE_RENDER_TARGET, cmdList);
-            }
+    renderer_->FinishComputeCommandList(computeCmdList, computeAccesses, hr);
+    HandleHRESULT(hr);
 
-            renderer_->ExecutePipeline(cmdList, renderCloudsGPSO_.lock());
+    // The direct queue waits for the compute work before any of this runs, the generated noise goes on to
+    // pixel shader reads here, once. RecordParallel flushes the transitions before the passes.
+    if(noiseGenerated) {
+        modelNoise_.lock()->ChangeState(D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, renderer_->GetBarrierBatcher(cmdList));
+        detailNoise_.lock()->ChangeState(D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, renderer_->GetBarrierBatcher(cmdList));
+    }
 
-            if(usingFrame0) {
-                cloudRT0_.lock()->ChangeStateDirect(shaderResState, cmdList);
-            }
-            else {
-                cloudRT1_.lock()->ChangeStateDirect(shaderResState, cmdList);
-            }
+    // the graph derives the barriers between these passes from what they declare
+    FrameGraph graph;
+    D3D12FrameGraphCommandList graphCmdList(cmdList, renderer_->GetBarrierBatcher(cmdList));
+
+    const uint32_t skyViewRes = graphCmdList.ImportResource(graph, "SkyView LUT", skyViewLUTs_[skyViewLUTReadIndex_].lock());
+    const uint32_t mainRTRes = graphCmdList.ImportResource(graph, "main_rt", mainRT_.lock());
+    const uint32_t cloudRT0Res = graphCmdList.ImportResource(graph, "RT0", cloudRT0_.lock());
+    const uint32_t cloudRT1Res = graphCmdList.ImportResource(graph, "RT1", cloudRT1_.lock());
+    const uint32_t blurOutRes = graphCmdList.ImportResource(graph, "Blur Output", blurOutRT_.lock());
+    const uint32_t swapChainRes = graphCmdList.ImportResource(graph, "swap chain", swapChainRes_, true);
+
+    // render to 0 => prevFrame is 1
+    const uint32_t cloudRTRes = usingFrame0? cloudRT0Res : cloudRT1Res;
+    const uint32_t prevCloudRTRes = usingFrame0? cloudRT1Res : cloudRT0Res;
+
+    // passes are recorded in parallel, each into the list it gets
+    const uint32_t skyPass = graph.AddPass("Sky Render", [&](FrameGraphCommandList& passCmdList) {
+        renderSkyGPSO_.lock()->SetResourceConfigurationIndex(skyViewLUTReadIndex_);
+        renderer_->ExecutePipeline(D3D12FrameGraphCommandList::GetNativeCommandList(passCmdList), renderSkyGPSO_.lock());
+    });
+    graph.Read(skyPass, skyViewRes, frame_graph_states::PixelShaderResource);
+    graph.Write(skyPass, mainRTRes, frame_graph_states::RenderTarget);
+
+    if(renderClouds) {
+        const uint32_t cloudsPass = graph.AddPass("Clouds Render", [&](FrameGraphCommandList& passCmdList) {
+            std::shared_ptr<GraphicsPipelineState> cloudsGPSO = std::static_pointer_cast<GraphicsPipelineState>(renderCloudsGPSO_.lock());
+            cloudsGPSO->SetResourceConfigurationIndex((usingFrame0? 0 : 1) + 2 * skyViewLUTReadIndex_);
+            cloudsGPSO->SetRenderTargetConfigurationIndex(usingFrame0? 0 : 1);
+            renderer_->ExecutePipeline(D3D12FrameGraphCommandList::GetNativeCommandList(passCmdList), cloudsGPSO);
 
             taaCurInd_.SetValue(usingFrame0? 0 : 1);
             //renderer_->ExecutePipeline(cmdList, cloudsTAACPSO_.lock());
-            
-
-            blurOutRT_.lock()->ChangeStateDirect(D3D12_RESOURCE_STATE_UNORDERED_ACCESS, cmdList);
+        });
+        graph.Read(cloudsPass, skyViewRes, frame_graph_states::PixelShaderResource);
+        graph.Read(cloudsPass, prevCloudRTRes, frame_graph_states::PixelShaderResource);
+        graph.Write(cloudsPass, cloudRTRes, frame_graph_states::RenderTarget);
 
+        // nothing reads the blurred clouds yet, so the graph culls this
+        const uint32_t blurPass = graph.AddPass("blur cloud rt", [&](FrameGraphCommandList& passCmdList) {
             gaussianBlurCPSO_.lock()->SetResourceConfigurationIndex(usingFrame0? 0 : 1);
-            renderer_->ExecutePipeline(cmdList, gaussianBlurCPSO_.lock());
-
-            mainRT_.lock()->ChangeStateDirect(D3D12_RESOURCE_STATE_UNORDERED_ACCESS, cmdList);
+            renderer_->ExecutePipeline(D3D12FrameGraphCommandList::GetNativeCommandList(passCmdList), gaussianBlurCPSO_.lock());
+        });
+        graph.Read(blurPass, cloudRTRes, frame_graph_states::NonPixelShaderResource);
+        graph.Write(blurPass, blurOutRes, frame_graph_states::UnorderedAccess);
 
+        const uint32_t blendPass = graph.AddPass("copy clouds to main", [&](FrameGraphCommandList& passCmdList) {
             copyCloudsToMainCPSO_.lock()->SetResourceConfigurationIndex(usingFrame0? 0 : 1);
-            renderer_->ExecutePipeline(cmdList, copyCloudsToMainCPSO_.lock());
-        }
+            renderer_->ExecutePipeline(D3D12FrameGraphCommandList::GetNativeCommandList(passCmdList), copyCloudsToMainCPSO_.lock());
+        });
+        graph.Read(blendPass, cloudRTRes, frame_graph_states::UnorderedAccess);
+        graph.Write(blendPass, mainRTRes, frame_graph_states::UnorderedAccess);
     }
 
-    swapChainRes_->ChangeStateDirect(D3D12_RESOURCE_STATE_COPY_DEST, cmdList);
-    mainRT_.lock()->ChangeStateDirect(D3D12_RESOURCE_STATE_COPY_SOURCE, cmdList);
-
     // TODO: 
     // copy cloud render target to final frame
-    cmdList->CopyResource(swapChainRes_->GetNativeResource().get(),
-                          mainRT_.lock()->GetNativeResource().get());
+    const uint32_t presentCopyPass = graph.AddPass("copy to swap chain", [&](FrameGraphCommandList& passCmdList) {
+        D3D12FrameGraphCommandList::GetNativeCommandList(passCmdList)->CopyResource(swapChainRes_->GetNativeResource().get(),
+                              mainRT_.lock()->GetNativeResource().get());
+    });
+    graph.Read(presentCopyPass, mainRTRes, frame_graph_states::CopySource);
+    graph.Write(presentCopyPass, swapChainRes, frame_graph_states::CopyDest);
+
+    graph.Compile();
+    if(PrintFrameGraphPlans && renderClouds && !frameGraphPrinted_) {
+        graph.PrintPlan();
+        PrintTransientAliasingPlan(graph, {
+            { skyViewRes, skyViewLUTs_[skyViewLUTReadIndex_].lock() },
+            { mainRTRes, mainRT_.lock() },
+            { cloudRT0Res, cloudRT0_.lock() },
+            { cloudRT1Res, cloudRT1_.lock() },
+            { blurOutRes, blurOutRT_.lock() }
+        }, { mainRTRes, blurOutRes });
+        frameGraphPrinted_ = true;
+    }
+
+    // cmdList is closed after this, the rest of the frame goes into the list it returns
+    cmdList = graphCmdList.RecordParallel(*renderer_, graph, hr);
+    HandleHRESULT(hr);
 
-    // already done in Renderer::FinishCommandList
-    swapChainRes_->ChangeStateDirect(D3D12_RESOURCE_STATE_PRESENT, cmdList);
-    mainRT_.lock()->ChangeStateDirect(D3D12_RESOURCE_STATE_RENDER_TARGET, cmdList);
+    // the UI moves the swap chain to RENDER_TARGET and Renderer::FinishCommandList to PRESENT,
+    // main_rt goes back to RENDER_TARGET in next frame's graph
 
     uiFramework_->Render(deltaTime, cmdList);
+
+    // the compute queue may write this LUT again in a later frame, it can't transition it out of PIXEL_SHADER_RESOURCE
+    skyViewLUTs_[skyViewLUTReadIndex_].lock()->ChangeState(D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, renderer_->GetBarrierBatcher(cmdList));
     
     // tick render logic
 
-    renderer_->FinishCommandList(cmdList, hr);
+    // waits for the compute work these were written by
+    std::vector<GPUQueueAccess> drawAccesses = { { skyViewLUTQueueRes_[skyViewLUTReadIndex_], false } };
+    if(renderClouds || noiseGenerated) {
+        drawAccesses.push_back({ modelNoiseQueueRes_, false });
+        drawAccesses.push_back({ detailNoiseQueueRes_, false });
+    }
+
+    renderer_->FinishCommandList(cmdList, hr, drawAccesses);
 }
@@ -3,10 +3,18 @@
 
 #define NOMINMAX
 
+#include <atomic>
+#include <initializer_list>
+#include <thread>
+#include <utility>
+
 #include "application.h"
+#include "queue_scheduler.h"
 #include "resources.h"
 #include "root_constant_value.h"
+#include "cloudscapes/lut_recompute_tracker.h"
 #include "ninmath/ninmath.h"
+#include "ui/widgets/button.h"
 #include "ui/widgets/labeled_numeric_input.h"
 #include "ui/widgets/slider.h"
 #include "ui/widgets/text.h"
@@ -20,6 +28,7 @@ class PipelineState;
 class GraphicsPipelineState;
 class DepthBuffer;
 class RenderTarget;
+class FrameGraph;
 
 class VertexBufferBase;
 class IndexBufferBase;
@@ -36,6 +45,22 @@ public:
     virtual void Tick(double deltaTime) override;
 
 private:
+    // Lifetime analysis of the passes the compiled graph runs, see TransientResourcePlanner. Only a report: the
+    // allocator still gives every resource a range of its own and nothing emits aliasing barriers.
+    // Resources that aren't in transientResources keep their contents across frames, the swap chain isn't in a heap.
+    void PrintTransientAliasingPlan(const FrameGraph& graph, std::initializer_list<std::pair<uint32_t, std::shared_ptr<Resource>>> heapResources,
+                                    std::initializer_list<uint32_t> transientResources) const;
+
+    // runs the transmittance/multiscattering/skyview passes whose inputs changed since they were last written,
+    // cmdList is a compute list, what the direct queue reads of it goes into accesses
+    void UpdateAtmosphereLUTs(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::vector<GPUQueueAccess>& accesses);
+
+    // Compute lists can't use PIXEL_SHADER_RESOURCE: a pass on one moves its outputs to UNORDERED_ACCESS and
+    // leaves them in NON_PIXEL_SHADER_RESOURCE for the compute passes after it. The direct list takes them
+    // from there to pixel shader reads, and has to bring them back before the compute queue writes them again.
+    bool ExecuteComputePass(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::shared_ptr<PipelineState> pso,
+                            std::initializer_list<std::shared_ptr<Resource>> outputs);
+
     std::weak_ptr<Resource> imageTex_;
     std::weak_ptr<Resource> computeTex_;
     std::weak_ptr<VertexBufferBase> vertexBuffer_;
@@ -138,7 +163,9 @@ private:
 	// atmosphere resources
     std::weak_ptr<Texture2D> transmittanceLUT_;
     std::weak_ptr<Texture2D> multiScatteringLUT_;
-    std::weak_ptr<Texture2D> skyViewLUT_;
+    // a recompute writes the one the draws don't read, the previous frame may still be drawing with it
+    std::weak_ptr<Texture2D> skyViewLUTs_[2];
+    uint32_t skyViewLUTReadIndex_;
 
 	// atmosphere pipelines
     std::weak_ptr<PipelineState> transmittanceCPSO_;
@@ -146,6 +173,18 @@ private:
     std::weak_ptr<PipelineState> skyviewCPSO_;
     std::weak_ptr<PipelineState> renderSkyGPSO_;
 
+    LUTRecomputeTracker lutTracker_;
+    uint32_t transmittanceLUTIndex_;
+    uint32_t multiScatteringLUTIndex_;
+    uint32_t skyViewLUTIndex_;
+    // light direction the multiscattering/skyview LUTs are baked with, follows the sun in steps
+    ninmath::Vector3f lutLightDir_;
+
+    // written on the async compute queue, read on the direct one (Renderer::GetQueueScheduler)
+    uint32_t skyViewLUTQueueRes_[2];
+    uint32_t modelNoiseQueueRes_;
+    uint32_t detailNoiseQueueRes_;
+
 	// cloud resources
     std::weak_ptr<Texture2D> blueNoise_;
     std::weak_ptr<Texture2D> weatherTexture_;
@@ -171,9 +210,15 @@ private:
 	
 
 	bool noiseGenDone_;
+	// fills the noise volume cache after a cold start
+	std::thread noiseBakeThread_;
+	// set on shutdown, so the bake stops instead of blocking the exit
+	std::atomic_bool noiseBakeCancelled_;
 
 	uint32_t curFrame_;
 	float elapsedTime_;
+	// with PrintFrameGraphPlans the plans are printed once, the first frame the clouds render
+	bool frameGraphPrinted_;
 
 	std::shared_ptr<VerticalLayout> rootWidget_;
 	std::shared_ptr<Text> text_;
@@ -183,6 +228,7 @@ private:
 	std::shared_ptr<Slider<float>> testSlider_;
 	std::shared_ptr<Slider<float>> lightDirSlider_;
 	std::shared_ptr<Slider<float>> camSpinSlider_;
+	std::shared_ptr<Button> telemetryButton_;
 	ninmath::Vector3f camPos_;
 	float lightDirAngle_;
 	float camSpinAngle_;
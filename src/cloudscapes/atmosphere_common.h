@@ -0,0 +1,283 @@
+#ifndef CLOUDSCAPES_ATMOSPHERE_COMMON_H_
+#define CLOUDSCAPES_ATMOSPHERE_COMMON_H_
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include "atmosphere_types.h"
+#include "ninmath/ninmath.h"
+
+//
+// CPU mirror of shaders/atmosphere/atmosphere_common.hlsl, plus the bits of
+// common/math.hlsl and common/volumetric_rendering.hlsl the LUT and cloud shaders use.
+// Kept line by line close to the HLSL (same float math, same names), so the
+// explanations over there apply here too.
+//
+namespace atmosphere {
+
+    inline constexpr float PI = std::numbers::pi_v<float>;
+
+    struct MediumSample {
+        ninmath::Vector3f scattering;
+        ninmath::Vector3f absorption;
+        ninmath::Vector3f extinction;
+
+        ninmath::Vector3f scatteringMie;
+        ninmath::Vector3f absorptionMie;
+        ninmath::Vector3f extinctionMie;
+
+        ninmath::Vector3f scatteringRayleigh;
+        ninmath::Vector3f absorptionRayleigh;
+        ninmath::Vector3f extinctionRayleigh;
+
+        ninmath::Vector3f scatteringOzone;
+        ninmath::Vector3f absorptionOzone;
+        ninmath::Vector3f extinctionOzone;
+
+        ninmath::Vector3f albedo;
+    };
+
+    inline ninmath::Vector3f Exp(const ninmath::Vector3f& v) {
+        return { std::exp(v.x), std::exp(v.y), std::exp(v.z) };
+    }
+
+    inline ninmath::Vector3f Max(const ninmath::Vector3f& v, float m) {
+        return { std::max(v.x, m), std::max(v.y, m), std::max(v.z, m) };
+    }
+
+    inline float Saturate(float v) {
+        return std::clamp(v, 0.f, 1.f);
+    }
+
+    // @param X - sample position
+    inline MediumSample GetMediumSample(const ninmath::Vector3f& X, const AtmosphereContext& atmosphere) {
+        // Hillaire's Earth setup, see the HLSL for where the numbers come from
+        const float density0_layerWidth = 25.0f;
+        const float density0_constantTerm = -2.0f / 3.0f;
+        const float density0_linearTerm = 1.0f / 15.0f;
+        const float density1_constantTerm = 8.0f / 3.0f;
+        const float density1_linearTerm = -1.0f / 15.0f;
+        const ninmath::Vector3f absorptionExtinction(0.000650f, 0.001881f, 0.000085f);
+
+        // altitude is how far X is above ground level
+        const float alt = X.Length() - atmosphere.Rb;
+
+        const float densityRayleigh = std::exp(-alt / 8.0f);
+        const float densityMie = std::exp(-alt / 1.2f);
+        const float densityOzone = Saturate(alt < density0_layerWidth ?
+            density0_linearTerm * alt + density0_constantTerm :
+            density1_linearTerm * alt + density1_constantTerm);
+
+        MediumSample ret;
+
+        // Rayleigh, absorption = 0
+        const ninmath::Vector3f rayScattering(0.005802f, 0.013558f, 0.033100f);
+        ret.scatteringRayleigh = densityRayleigh * rayScattering;
+        ret.absorptionRayleigh = ninmath::Vector3f();
+        ret.extinctionRayleigh = ret.scatteringRayleigh + ret.absorptionRayleigh;
+
+        // Mie
+        const ninmath::Vector3f mieScattering(0.003996f, 0.003996f, 0.003996f);
+        const ninmath::Vector3f mieExtinction(0.004440f, 0.004440f, 0.004440f);
+        const ninmath::Vector3f mieAbsorption = mieExtinction - mieScattering;
+
+        ret.scatteringMie = densityMie * mieScattering;
+        ret.absorptionMie = densityMie * mieAbsorption;
+        ret.extinctionMie = ret.scatteringMie + ret.absorptionMie;
+
+        // Ozone
+        ret.scatteringOzone = ninmath::Vector3f();
+        ret.absorptionOzone = densityOzone * absorptionExtinction;
+        ret.extinctionOzone = ret.scatteringOzone + ret.absorptionOzone;
+
+        ret.scattering = ret.scatteringRayleigh + ret.scatteringMie + ret.scatteringOzone;
+        ret.absorption = ret.absorptionRayleigh + ret.absorptionMie + ret.absorptionOzone;
+        ret.extinction = ret.extinctionRayleigh + ret.extinctionMie + ret.extinctionOzone;
+
+        ret.albedo = ret.scattering / Max(ret.extinction, 0.001f);
+
+        return ret;
+    }
+
+    // assumes ray(r, mu) does hit the top of the atmosphere
+    inline float DistanceToTopAtmosphere(const AtmosphereContext& atmosphere, float r, float mu) {
+        const float Rt = atmosphere.Rt;
+        return std::sqrt(r * r * (mu * mu - 1) + Rt * Rt) - r * mu;
+    }
+
+    // Real-Time Rendering (4th ed.) 22.6.2, nearest intersection or -1 if there's none
+    inline float GetNearestRaySphereDistance(const ninmath::Vector3f& rayOrigin, const ninmath::Vector3f& rayDir,
+                                             const ninmath::Vector3f& sphereCenter, float sphereRadius) {
+        const ninmath::Vector3f l = sphereCenter - rayOrigin;
+        const float len_l = l.Length();
+        const float len_l_squared = len_l * len_l;
+        const float r_squared = sphereRadius * sphereRadius;
+
+        const bool originIsInsideSphere = len_l_squared < r_squared;
+
+        const float s = l.Dot(rayDir);
+        const float m_squared = len_l_squared - s * s;
+
+        if(!originIsInsideSphere) {
+            if(s < 0) {
+                return -1.0f;
+            }
+            if(m_squared > r_squared) {
+                return -1.0f;
+            }
+        }
+
+        const float q = std::sqrt(r_squared - m_squared);
+        return originIsInsideSphere ? s + q : s - q;
+    }
+
+    // both intersections, returns how many there are: 0, 1 (origin inside the sphere, only nearDist is set) or 2
+    inline uint32_t GetRaySphereDistances(const ninmath::Vector3f& rayOrigin, const ninmath::Vector3f& rayDir,
+                                          const ninmath::Vector3f& sphereCenter, float sphereRadius,
+                                          float& nearDist, float& farDist) {
+        const ninmath::Vector3f l = sphereCenter - rayOrigin;
+        const float len_l = l.Length();
+        const float len_l_squared = len_l * len_l;
+        const float r_squared = sphereRadius * sphereRadius;
+
+        const bool originIsInsideSphere = len_l_squared < r_squared;
+
+        const float s = l.Dot(rayDir);
+        const float m_squared = len_l_squared - s * s;
+
+        if(!originIsInsideSphere) {
+            if(s < 0) {
+                return 0;
+            }
+            if(m_squared > r_squared) {
+                return 0;
+            }
+        }
+
+        const float q = std::sqrt(r_squared - m_squared);
+        if(originIsInsideSphere) {
+            nearDist = s + q;
+            farDist = -1;
+            return 1;
+        }
+
+        nearDist = s - q;
+        farDist = s + q;
+        return 2;
+    }
+
+    //
+    // Transmittance parameterization (Bruneton)
+    //
+    inline void UVToLightTransmittanceParameters(const AtmosphereContext& atmosphere, ninmath::Vector2f uv, float& r, float& mu) {
+        const float Rt = atmosphere.Rt;
+        const float Rb = atmosphere.Rb;
+
+        const float H = std::sqrt(Rt * Rt - Rb * Rb);
+        const float rho = H * uv.y;
+        r = std::sqrt(rho * rho + Rb * Rb);
+
+        const float d_min = Rt - r;
+        const float d_max = rho + H;
+        const float d = d_min + uv.x * (d_max - d_min);
+
+        mu = (H * H - rho * rho - d * d) / (2 * r * d);
+    }
+
+    inline ninmath::Vector2f LightTransmittanceParametersToUV(const AtmosphereContext& atmosphere, float r, float mu) {
+        const float Rt = atmosphere.Rt;
+        const float Rb = atmosphere.Rb;
+
+        const float H = std::sqrt(Rt * Rt - Rb * Rb);
+        const float rho = std::sqrt(r * r - Rb * Rb);
+
+        const float d = std::sqrt(r * r * (mu * mu - 1) + Rt * Rt) - r * mu;
+        const float d_min = Rt - r;
+        const float d_max = rho + H;
+
+        return { (d - d_min) / (d_max - d_min), rho / H };
+    }
+
+    //
+    // MultiScattering parameterization (Hillaire 5.5.2)
+    //
+    inline void UVToMultiScatteringParameters(const AtmosphereContext& atmosphere, ninmath::Vector2f uv, float& cosTheta_Zl, float& r) {
+        cosTheta_Zl = 2 * uv.x - 1;
+        r = uv.y * (atmosphere.Rt - atmosphere.Rb) + atmosphere.Rb;
+    }
+
+    inline ninmath::Vector2f MultiScatteringParametersToUV(const AtmosphereContext& atmosphere, float cosTheta_Zl, float r) {
+        const float Rb = atmosphere.Rb;
+        const float Rt = atmosphere.Rt;
+        return { 0.5f + 0.5f * cosTheta_Zl, std::clamp((r - Rb) / (Rt - Rb), 0.f, 1.f) };
+    }
+
+    //
+    // SkyView parameterization, more texels towards the horizon and the light
+    //
+    inline void UVToSkyViewParameters(const AtmosphereContext& atmosphere, ninmath::Vector2f uv, float r, float& cosTheta_lv, float& cosTheta_Zv) {
+        const float u = uv.x;
+        const float v = uv.y;
+
+        const float d_horizon = std::sqrt(r * r - atmosphere.Rb * atmosphere.Rb);
+        const float cosBeta = d_horizon / r;
+        const float beta = std::acos(cosBeta);
+        const float theta_Zh = PI - beta;
+
+        if(v < 0.5f) {
+            const float CA = 1 - (1 - 2 * v) * (1 - 2 * v);
+            cosTheta_Zv = std::cos(theta_Zh * CA);
+        }
+        else {
+            const float CB = (2 * v - 1) * (2 * v - 1);
+            cosTheta_Zv = std::cos(theta_Zh + beta * CB);
+        }
+
+        cosTheta_lv = -(2.0f * u * u - 1.0f);
+    }
+
+    inline ninmath::Vector2f SkyViewParametersToUV(const AtmosphereContext& atmosphere, float r, float cosTheta_lv, float cosTheta_Zv) {
+        const float Rb = atmosphere.Rb;
+
+        const float d_horizon = std::sqrt(r * r - Rb * Rb);
+        const float cosBeta = d_horizon / r;
+        const float beta = std::acos(cosBeta);
+        const float theta_Zh = PI - beta;
+
+        const float theta_Zv = std::acos(cosTheta_Zv);
+
+        float v;
+        if(cosTheta_Zv > std::cos(theta_Zh)) {
+            v = 0.5f * (1 - std::sqrt(1 - (theta_Zv / theta_Zh)));
+        }
+        else {
+            v = 0.5f * (std::sqrt((theta_Zv - theta_Zh) / beta) + 1);
+        }
+
+        return { std::sqrt((1 - cosTheta_lv) / 2), v };
+    }
+
+    //
+    // Phase functions (common/volumetric_rendering.hlsl)
+    //
+    inline float RayleighPhase(float cosTheta) {
+        return (3 * (1 + cosTheta * cosTheta)) / (16 * PI);
+    }
+
+    inline float MiePhaseApproximation_CornetteShanks(float cosTheta) {
+        const float g = 0.8f;
+        const float g_sq = g * g;
+        const float cosT_sq = cosTheta * cosTheta;
+
+        return (3 / (8 * PI)) * ((1 - g_sq) * (1 + cosT_sq)) /
+               ((2 + g_sq) * std::pow(1 + g_sq - 2 * g * -cosTheta, 1.5f));
+    }
+
+    inline float MiePhaseApproximation_HenyeyGreenstein(float cosTheta, float g) {
+        const float g_sq = g * g;
+        return (1 - g_sq) / ((4 * PI) * std::pow(1 + g_sq - 2 * g * cosTheta, 1.5f));
+    }
+
+} // namespace atmosphere
+
+#endif // CLOUDSCAPES_ATMOSPHERE_COMMON_H_
@@ -0,0 +1,345 @@
+#include "atmosphere_lut_baker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "atmosphere_common.h"
+#include "multithreading/work_stealing_scheduler.h"
+
+using namespace ninmath;
+using namespace atmosphere;
+
+namespace {
+    // step and sample counts of the shaders
+    const float NumTransmittanceIntegrationSteps = 40;
+    const float NumMultiScatteringIntegrationSteps = 20;
+    const float SqrtMultiScatteringSampleCount = 8;
+    const float NumSkyViewIntegrationSteps = 30;
+
+    // the shaders start every segment a bit into the step, see transmittance_lut_cs.hlsl
+    const float StepOffset = 0.3f;
+
+    Vector3f ToVector3(const Vector4f& v) {
+        return { v.x, v.y, v.z };
+    }
+
+    // uv of a texel as the LUT shaders compute it: Cell / size, the corner rather than the center
+    Vector2f GetTexelUV(uint32_t x, uint32_t y, const AtmosphereLUT& lut) {
+        return { (float)x / (float)lut.width, (float)y / (float)lut.height };
+    }
+}
+
+Vector4f AtmosphereLUT::Sample(Vector2f uv) const {
+    // texel centers are at (i + 0.5) / size; NaN coordinates end up at texel 0
+    const float x = std::isnan(uv.x) ? 0.f : uv.x * width - 0.5f;
+    const float y = std::isnan(uv.y) ? 0.f : uv.y * height - 0.5f;
+
+    const float x0f = std::floor(x);
+    const float y0f = std::floor(y);
+    const float fx = x - x0f;
+    const float fy = y - y0f;
+
+    auto clampX = [this](float v) { return (uint32_t)std::clamp(v, 0.f, (float)width - 1); };
+    auto clampY = [this](float v) { return (uint32_t)std::clamp(v, 0.f, (float)height - 1); };
+    const uint32_t x0 = clampX(x0f);
+    const uint32_t x1 = clampX(x0f + 1);
+    const uint32_t y0 = clampY(y0f);
+    const uint32_t y1 = clampY(y0f + 1);
+
+    auto lerp4 = [](const Vector4f& a, const Vector4f& b, float t) {
+        return Vector4f(Lerp(a.x, b.x, t), Lerp(a.y, b.y, t), Lerp(a.z, b.z, t), Lerp(a.w, b.w, t));
+    };
+
+    return lerp4(lerp4(At(x0, y0), At(x1, y0), fx), lerp4(At(x0, y1), At(x1, y1), fx), fy);
+}
+
+Vector4f AtmosphereLUT::SampleWrap(Vector2f uv) const {
+    const float x = std::isnan(uv.x) ? 0.f : uv.x * width - 0.5f;
+    const float y = std::isnan(uv.y) ? 0.f : uv.y * height - 0.5f;
+
+    const float x0f = std::floor(x);
+    const float y0f = std::floor(y);
+    const float fx = x - x0f;
+    const float fy = y - y0f;
+
+    auto wrap = [](float v, uint32_t size) {
+        const float wrapped = v - (float)size * std::floor(v / (float)size);
+        return std::min((uint32_t)wrapped, size - 1);
+    };
+    const uint32_t x0 = wrap(x0f, width);
+    const uint32_t x1 = wrap(x0f + 1, width);
+    const uint32_t y0 = wrap(y0f, height);
+    const uint32_t y1 = wrap(y0f + 1, height);
+
+    auto lerp4 = [](const Vector4f& a, const Vector4f& b, float t) {
+        return Vector4f(Lerp(a.x, b.x, t), Lerp(a.y, b.y, t), Lerp(a.z, b.z, t), Lerp(a.w, b.w, t));
+    };
+
+    return lerp4(lerp4(At(x0, y0), At(x1, y0), fx), lerp4(At(x0, y1), At(x1, y1), fx), fy);
+}
+
+AtmosphereLUTBaker::AtmosphereLUTBaker(const AtmosphereContext& atmosphere, uint32_t numThreads)
+    : atmosphere_(atmosphere), scheduler_(std::make_shared<WorkStealingScheduler>(numThreads)) {
+    scheduler_->Start();
+}
+
+template <typename TexelFunc>
+void AtmosphereLUTBaker::BakeRows(AtmosphereLUT& lut, const char* name, const TexelFunc& texelFunc) {
+    const auto start = std::chrono::steady_clock::now();
+
+    // a row is a few hundred texels of a few hundred steps each, plenty to amortize the atomic
+    const uint32_t numThreads = std::min<uint32_t>(scheduler_->GetNumThreads(), std::max(lut.height, 1u));
+
+    scheduler_->ParallelFor(lut.height, numThreads, [&lut, &texelFunc](uint32_t y, uint32_t) {
+        for(uint32_t x = 0; x < lut.width; x++) {
+            lut.At(x, y) = texelFunc(GetTexelUV(x, y, lut));
+        }
+    });
+
+    lastBakeStats_ = BakeStats {
+        .seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+        .numThreads = numThreads,
+        .numTexels = lut.GetNumTexels()
+    };
+
+    std::cout << "Baked " << lut.width << "x" << lut.height << " " << name << " LUT in "
+              << lastBakeStats_.seconds * 1000.0 << "ms (" << numThreads << " threads)" << std::endl;
+}
+
+AtmosphereLUT AtmosphereLUTBaker::BakeTransmittance(uint32_t width, uint32_t height) {
+    AtmosphereLUT lut(width, height);
+    BakeRows(lut, "transmittance", [this](Vector2f uv) {
+        return ComputeTransmittance(uv);
+    });
+    return lut;
+}
+
+AtmosphereLUT AtmosphereLUTBaker::BakeMultiScattering(const AtmosphereLUT& transmittance, const SkyBuffer& sky, uint32_t width, uint32_t height) {
+    AtmosphereLUT lut(width, height);
+    BakeRows(lut, "multiscattering", [this, &transmittance, &sky](Vector2f uv) {
+        return ComputeMultiScattering(uv, transmittance, sky);
+    });
+    return lut;
+}
+
+AtmosphereLUT AtmosphereLUTBaker::BakeSkyView(const AtmosphereLUT& transmittance, const AtmosphereLUT& multiScattering,
+                                              const SkyBuffer& sky, uint32_t width, uint32_t height) {
+    AtmosphereLUT lut(width, height);
+    BakeRows(lut, "skyview", [this, &transmittance, &multiScattering, &sky](Vector2f uv) {
+        return ComputeSkyView(uv, transmittance, multiScattering, sky);
+    });
+    return lut;
+}
+
+AtmosphereLUTBaker::AtmosphereLUTs AtmosphereLUTBaker::BakeAll(const SkyBuffer& sky) {
+    AtmosphereLUTs luts;
+    luts.transmittance = BakeTransmittance();
+    luts.multiScattering = BakeMultiScattering(luts.transmittance, sky);
+    luts.skyView = BakeSkyView(luts.transmittance, luts.multiScattering, sky);
+    return luts;
+}
+
+Vector3f AtmosphereLUTBaker::GetLightTransmittance(const AtmosphereLUT& transmittance, float r, float cosTheta_Zv) const {
+    return ToVector3(transmittance.Sample(LightTransmittanceParametersToUV(atmosphere_, r, cosTheta_Zv)));
+}
+
+Vector3f AtmosphereLUTBaker::GetMultiScattering(const AtmosphereLUT& multiScattering, float cosTheta_Zl, float r) const {
+    return ToVector3(multiScattering.Sample(MultiScatteringParametersToUV(atmosphere_, cosTheta_Zl, r)));
+}
+
+// transmittance_lut_cs.hlsl
+Vector4f AtmosphereLUTBaker::ComputeTransmittance(Vector2f uv) const {
+    float r;
+    float mu;
+    UVToLightTransmittanceParameters(atmosphere_, uv, r, mu);
+
+    const Vector3f startPos(0, 0, r);
+    const Vector3f rayDir = Vector3f(0, std::sqrt(1.f - mu * mu), mu).Normal();
+
+    // IntegrateTransmittance()
+    const float cosTheta_Zv = (startPos / r).Dot(rayDir);
+    const float sampleRayLength = DistanceToTopAtmosphere(atmosphere_, r, cosTheta_Zv);
+
+    float t = 0.0f;
+    Vector3f transmittance(1, 1, 1);
+    for(float i = 0.0f; i < NumTransmittanceIntegrationSteps; i += 1.0f) {
+        const float newT = sampleRayLength * (i + StepOffset) / NumTransmittanceIntegrationSteps;
+        const float dt = newT - t;
+        t = newT;
+
+        const MediumSample medium = GetMediumSample(startPos + t * rayDir, atmosphere_);
+        transmittance = transmittance * Exp(-1.f * (medium.extinction * dt));
+    }
+
+    return std::isnan(transmittance.x) ? Vector4f(1, 1, 1, 1) : Vector4f(transmittance.x, transmittance.y, transmittance.z, 1.0f);
+}
+
+// multiscattering_lut_cs.hlsl
+void AtmosphereLUTBaker::IntegrateLuminanceAndEnergyTransfer(const Vector3f& rayOrigin, const Vector3f& rayDir,
+                                                             const AtmosphereLUT& transmittanceLUT, const SkyBuffer& sky,
+                                                             Vector3f& integratedLuminance, Vector3f& integratedEnergyTransfer) const {
+    const float distToAtmo = GetNearestRaySphereDistance(rayOrigin, rayDir, Vector3f(), atmosphere_.Rt);
+    const float distToGround = GetNearestRaySphereDistance(rayOrigin, rayDir, Vector3f(), atmosphere_.Rb);
+    const bool hitGround = distToGround != -1.0f;
+    const float sampleRayLength = hitGround ? distToGround : distToAtmo;
+
+    const float isotropicPhase = 1.0f / (4.0f * PI);
+
+    // like the shader, this uses the sky's light direction, not the one of the texel
+    const Vector3f lightDir = sky.lightDir.Normal();
+
+    Vector3f luminance;
+    Vector3f energyTransfer;
+    Vector3f transmittance(1, 1, 1);
+    float t = 0.0f;
+
+    for(float i = 0; i < NumMultiScatteringIntegrationSteps; i += 1.0f) {
+        const float newT = sampleRayLength * (i + StepOffset) / NumMultiScatteringIntegrationSteps;
+        const float dt = newT - t;
+        t = newT;
+
+        const Vector3f samplePos = rayOrigin + t * rayDir;
+        const float r = samplePos.Length();
+        const Vector3f zenith = samplePos / r;
+
+        const MediumSample sampleMedium = GetMediumSample(samplePos, atmosphere_);
+        const Vector3f sampleTransmittance = Exp(-1.f * (sampleMedium.extinction * dt));
+        const Vector3f scattering = sampleMedium.scattering;
+
+        const float cosTheta_Zl = zenith.Dot(lightDir);
+        const Vector3f lightTransmittance = GetLightTransmittance(transmittanceLUT, r, cosTheta_Zl);
+
+        const Vector3f curLuminance = sky.sunIlluminance * (lightTransmittance * isotropicPhase * scattering);
+
+        // analytic integral over the segment, see the shader
+        const Vector3f integralOverSegment_lum = (curLuminance - curLuminance * sampleTransmittance) / sampleMedium.extinction;
+        luminance = luminance + integralOverSegment_lum * transmittance;
+
+        const Vector3f integralOverSegment_energy = (scattering - scattering * sampleTransmittance) / sampleMedium.extinction;
+        energyTransfer = energyTransfer + integralOverSegment_energy * transmittance;
+
+        transmittance = transmittance * sampleTransmittance;
+    }
+
+    // light reflected off the ground
+    if(hitGround) {
+        const Vector3f groundPos = rayOrigin + distToGround * rayDir;
+        const float r = groundPos.Length();
+        const Vector3f zenith = groundPos / r;
+        const float cosTheta_Zl = zenith.Dot(lightDir);
+
+        const Vector3f lightTransmittance = GetLightTransmittance(transmittanceLUT, r, cosTheta_Zl);
+        const float cosTheta_Nl = Saturate(cosTheta_Zl);
+        luminance = luminance + sky.sunIlluminance * lightTransmittance * transmittance * cosTheta_Nl * sky.groundAlbedo / PI;
+    }
+
+    integratedLuminance = luminance;
+    integratedEnergyTransfer = energyTransfer;
+}
+
+Vector4f AtmosphereLUTBaker::ComputeMultiScattering(Vector2f uv, const AtmosphereLUT& transmittance, const SkyBuffer& sky) const {
+    float cosTheta_Zl;
+    float r;
+    UVToMultiScatteringParameters(atmosphere_, uv, cosTheta_Zl, r);
+
+    const Vector3f startPos(0, 0, r);
+    const float totalSamples = SqrtMultiScatteringSampleCount * SqrtMultiScatteringSampleCount;
+
+    Vector3f secondOrderL;
+    Vector3f fms;
+
+    // uniformly distributed directions over the sphere
+    for(float i = 0; i < SqrtMultiScatteringSampleCount; i += 1.0f) {
+        for(float j = 0; j < SqrtMultiScatteringSampleCount; j += 1.0f) {
+            const float theta = 2 * PI * (i / SqrtMultiScatteringSampleCount);
+            const float phi = std::acos(2 * (j / SqrtMultiScatteringSampleCount) - 1);
+
+            const Vector3f rayDir(std::cos(theta) * std::sin(phi), std::sin(theta) * std::sin(phi), std::cos(phi));
+
+            Vector3f L_prime;
+            Vector3f Lf;
+            IntegrateLuminanceAndEnergyTransfer(startPos, rayDir, transmittance, sky, L_prime, Lf);
+
+            secondOrderL = secondOrderL + L_prime * (1.0f / totalSamples);
+            fms = fms + Lf * (1.0f / totalSamples);
+        }
+    }
+
+    const float isotropicPhase = 1 / (4 * PI);
+    secondOrderL = secondOrderL * isotropicPhase;
+    fms = fms * isotropicPhase;
+
+    // F_ms = 1 + fms + fms^2 + ... (Eq. 9), psi_ms (Eq. 10)
+    const Vector3f F_ms(1.0f / (1.0f - fms.x), 1.0f / (1.0f - fms.y), 1.0f / (1.0f - fms.z));
+    const Vector3f psi_ms = secondOrderL * F_ms;
+
+    return Vector4f(psi_ms.x, psi_ms.y, psi_ms.z, 1.0f);
+}
+
+// skyview_lut_cs.hlsl
+Vector4f AtmosphereLUTBaker::ComputeSkyView(Vector2f uv, const AtmosphereLUT& transmittanceLUT, const AtmosphereLUT& multiScattering,
+                                            const SkyBuffer& sky) const {
+    const Vector3f worldPos = sky.cameraPos + Vector3f(0, 0, atmosphere_.Rb);
+    const float r = worldPos.Length();
+
+    float cosTheta_lv;
+    float cosTheta_Zv;
+    UVToSkyViewParameters(atmosphere_, uv, r, cosTheta_lv, cosTheta_Zv);
+
+    // light moved onto the xz plane, so cosTheta_lv is measured against it
+    Vector3f lightDir;
+    {
+        const Vector3f upAxis = worldPos / r;
+        const float cosTheta_Zl = upAxis.Dot(sky.lightDir.Normal());
+        lightDir = Vector3f(std::sqrt(1 - cosTheta_Zl * cosTheta_Zl), 0, cosTheta_Zl);
+    }
+
+    const float sinTheta_Zv = std::sqrt(1 - cosTheta_Zv * cosTheta_Zv);
+    const float sinTheta_lv = std::sqrt(1 - cosTheta_lv * cosTheta_lv);
+
+    const Vector3f rayOrigin(0, 0, r);
+    const Vector3f rayDir(sinTheta_Zv * cosTheta_lv, sinTheta_Zv * sinTheta_lv, cosTheta_Zv);
+
+    // IntegrateLuminance()
+    const float distToAtmo = GetNearestRaySphereDistance(rayOrigin, rayDir, Vector3f(), atmosphere_.Rt);
+    const float distToGround = GetNearestRaySphereDistance(rayOrigin, rayDir, Vector3f(), atmosphere_.Rb);
+    const bool hitGround = distToGround != -1.0f;
+    const float sampleRayLength = hitGround ? distToGround : distToAtmo;
+
+    const float cosTheta_dl = rayDir.Dot(lightDir);
+    const float miePhase = MiePhaseApproximation_CornetteShanks(-1.f * cosTheta_dl);
+    const float rayleighPhase = RayleighPhase(-1.f * cosTheta_dl);
+
+    Vector3f transmittance(1, 1, 1);
+    Vector3f luminance;
+    float t = 0.0f;
+
+    for(float i = 0.0f; i < NumSkyViewIntegrationSteps; i += 1.0f) {
+        const float newT = sampleRayLength * (i + StepOffset) / NumSkyViewIntegrationSteps;
+        const float dt = newT - t;
+        t = newT;
+
+        const Vector3f samplePos = rayOrigin + t * rayDir;
+        const float sampleR = samplePos.Length();
+        const Vector3f zenith = samplePos / sampleR;
+
+        const MediumSample sampleMedium = GetMediumSample(samplePos, atmosphere_);
+        const Vector3f sampleTransmittance = Exp(-1.f * (sampleMedium.extinction * dt));
+        const Vector3f scattering = sampleMedium.scattering;
+
+        const float cosTheta_Zl = zenith.Dot(lightDir);
+        const Vector3f lightTransmittance = GetLightTransmittance(transmittanceLUT, sampleR, cosTheta_Zl);
+
+        const Vector3f phaseTimesScattering = sampleMedium.scatteringMie * miePhase + sampleMedium.scatteringRayleigh * rayleighPhase;
+        const Vector3f psi_ms = GetMultiScattering(multiScattering, cosTheta_Zl, sampleR);
+
+        const Vector3f curLuminance = sky.sunIlluminance * (lightTransmittance * phaseTimesScattering + psi_ms * scattering);
+
+        const Vector3f integralOverSegment_lum = (curLuminance - curLuminance * sampleTransmittance) / sampleMedium.extinction;
+        luminance = luminance + integralOverSegment_lum * transmittance;
+
+        transmittance = transmittance * sampleTransmittance;
+    }
+
+    return Vector4f(luminance.x, luminance.y, luminance.z, 1.0f);
+}
@@ -0,0 +1,104 @@
+#ifndef CLOUDSCAPES_ATMOSPHERE_LUT_BAKER_H_
+#define CLOUDSCAPES_ATMOSPHERE_LUT_BAKER_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "atmosphere_types.h"
+#include "ninmath/ninmath.h"
+
+class WorkStealingScheduler;
+
+//
+// CPU side float4 2D buffer, laid out like a Texture2D subresource.
+//
+struct AtmosphereLUT {
+    AtmosphereLUT() = default;
+
+    AtmosphereLUT(uint32_t width, uint32_t height)
+        : width(width), height(height), texels((size_t)width * height) {}
+
+    size_t GetNumTexels() const { return texels.size(); }
+    size_t GetRowPitch() const { return (size_t)width * sizeof(ninmath::Vector4f); }
+
+    ninmath::Vector4f& At(uint32_t x, uint32_t y) { return texels[(size_t)y * width + x]; }
+    const ninmath::Vector4f& At(uint32_t x, uint32_t y) const { return texels[(size_t)y * width + x]; }
+
+    // bilinear with clamped addressing, what the LUT shaders' static sampler does
+    ninmath::Vector4f Sample(ninmath::Vector2f uv) const;
+
+    // bilinear with wrapped addressing, for textures bound with a linear wrap sampler
+    ninmath::Vector4f SampleWrap(ninmath::Vector2f uv) const;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<ninmath::Vector4f> texels;
+};
+
+//
+// Generates the sky LUTs on the CPU, texel for texel what
+//   transmittance_lut_cs.hlsl, multiscattering_lut_cs.hlsl and skyview_lut_cs.hlsl
+// write (same uv mapping, step counts and sampling). Meant as a reference to validate the
+// GPU passes against, and for tooling that needs sky LUTs without a device.
+// Rows are handed out to the worker threads one at a time (WorkStealingScheduler::ParallelFor).
+//
+class AtmosphereLUTBaker {
+public:
+    struct BakeStats {
+        double seconds = 0.0;
+        uint32_t numThreads = 0;
+        size_t numTexels = 0;
+    };
+
+    struct AtmosphereLUTs {
+        AtmosphereLUT transmittance;
+        AtmosphereLUT multiScattering;
+        AtmosphereLUT skyView;
+    };
+
+    // sizes the renderer uses
+    static constexpr uint32_t TransmittanceWidth = 256;
+    static constexpr uint32_t TransmittanceHeight = 64;
+    static constexpr uint32_t MultiScatteringSize = 32;
+    static constexpr uint32_t SkyViewWidth = 256;
+    static constexpr uint32_t SkyViewHeight = 128;
+
+    // numThreads == 0 uses every hardware thread
+    AtmosphereLUTBaker(const AtmosphereContext& atmosphere, uint32_t numThreads = 0);
+
+    AtmosphereLUT BakeTransmittance(uint32_t width = TransmittanceWidth, uint32_t height = TransmittanceHeight);
+
+    AtmosphereLUT BakeMultiScattering(const AtmosphereLUT& transmittance, const SkyBuffer& sky,
+                                      uint32_t width = MultiScatteringSize, uint32_t height = MultiScatteringSize);
+
+    AtmosphereLUT BakeSkyView(const AtmosphereLUT& transmittance, const AtmosphereLUT& multiScattering, const SkyBuffer& sky,
+                              uint32_t width = SkyViewWidth, uint32_t height = SkyViewHeight);
+
+    // all three in dependency order, at the renderer's sizes
+    AtmosphereLUTs BakeAll(const SkyBuffer& sky);
+
+    const AtmosphereContext& GetAtmosphere() const { return atmosphere_; }
+    const BakeStats& GetLastBakeStats() const { return lastBakeStats_; }
+
+private:
+    template <typename TexelFunc>
+    void BakeRows(AtmosphereLUT& lut, const char* name, const TexelFunc& texelFunc);
+
+    ninmath::Vector4f ComputeTransmittance(ninmath::Vector2f uv) const;
+    ninmath::Vector4f ComputeMultiScattering(ninmath::Vector2f uv, const AtmosphereLUT& transmittance, const SkyBuffer& sky) const;
+    ninmath::Vector4f ComputeSkyView(ninmath::Vector2f uv, const AtmosphereLUT& transmittance, const AtmosphereLUT& multiScattering,
+                                     const SkyBuffer& sky) const;
+
+    void IntegrateLuminanceAndEnergyTransfer(const ninmath::Vector3f& rayOrigin, const ninmath::Vector3f& rayDir,
+                                             const AtmosphereLUT& transmittance, const SkyBuffer& sky,
+                                             ninmath::Vector3f& integratedLuminance, ninmath::Vector3f& integratedEnergyTransfer) const;
+
+    ninmath::Vector3f GetLightTransmittance(const AtmosphereLUT& transmittance, float r, float cosTheta_Zv) const;
+    ninmath::Vector3f GetMultiScattering(const AtmosphereLUT& multiScattering, float cosTheta_Zl, float r) const;
+
+    AtmosphereContext atmosphere_;
+    std::shared_ptr<WorkStealingScheduler> scheduler_;
+    BakeStats lastBakeStats_;
+};
+
+#endif // CLOUDSCAPES_ATMOSPHERE_LUT_BAKER_H_
@@ -0,0 +1,269 @@
+#include "cloud_occupancy_grid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+using namespace ninmath;
+
+namespace {
+    // slack on the density bounds, covers the rounding of the lerps and pow in the density math
+    const float BoundEpsilon = 1e-3f;
+
+    // height fractions this far outside [0, 1] are outside the cloud layer for sure
+    const float HeightEpsilon = 1e-4f;
+
+    struct Interval {
+        float lo;
+        float hi;
+    };
+
+    // Remap() of the cloud march over an interval, it's linear in val
+    Interval Remap(Interval val, float oldMin, float oldMax, float newMin, float newMax) {
+        auto remap = [&](float v) { return newMin + (v - oldMin) / (oldMax - oldMin) * (newMax - newMin); };
+        const float a = remap(val.lo);
+        const float b = remap(val.hi);
+        return { std::min(a, b), std::max(a, b) };
+    }
+
+    float MaxProduct(Interval a, Interval b) {
+        return std::max({ a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi });
+    }
+
+    // Upper bound of CloudLayerDensity over a range of heights. Cloud types in [0, 1] only
+    // blend the three profiles, so the largest profile bounds every type.
+    float MaxCloudLayerDensity(Interval relativeHeight) {
+        const Interval h { std::clamp(relativeHeight.lo, 0.f, 1.f), std::clamp(relativeHeight.hi, 0.f, 1.f) };
+
+        const float cumulus = MaxProduct(Remap(h, 0.f, 0.2f, 0.f, 1.f), Remap(h, 0.7f, 0.9f, 1.f, 0.f));
+        const float stratocumulus = MaxProduct(Remap(h, 0.f, 0.2f, 0.f, 1.f), Remap(h, 0.2f, 0.7f, 1.f, 0.f));
+        const float stratus = MaxProduct(Remap(h, 0.f, 0.1f, 0.f, 1.f), Remap(h, 0.2f, 0.3f, 1.f, 0.f));
+        return std::max({ 0.f, cumulus, stratocumulus, stratus });
+    }
+
+    // Upper bound of Remap(perlinWorley, lowFreqFBM - 1, 1, 0, 1) over all model noise texels,
+    // trilinear filtering stays within their range. Infinity if there's none.
+    float MaxBaseCloudNoise(const NoiseVolume& noise) {
+        const float inf = std::numeric_limits<float>::infinity();
+        float maxPerlinWorley = -inf;
+        float minFBM = inf;
+        float maxFBM = -inf;
+
+        for(const Vector4f& texel : noise.texels) {
+            const float fbm = texel.y * 0.625f + texel.z * 0.25f + texel.w * 0.125f;
+            if(std::isnan(texel.x) || std::isnan(fbm)) {
+                return inf;
+            }
+
+            maxPerlinWorley = std::max(maxPerlinWorley, texel.x);
+            minFBM = std::min(minFBM, fbm);
+            maxFBM = std::max(maxFBM, fbm);
+        }
+
+        // the remap divides by 2 - fbm
+        if(!(maxFBM < 2.f - BoundEpsilon) || noise.texels.empty()) {
+            return inf;
+        }
+
+        // increasing in perlinWorley, monotonic in the fbm
+        auto remap = [&](float fbm) { return (maxPerlinWorley - (fbm - 1.f)) / (1.f - (fbm - 1.f)); };
+        return std::max(remap(minFBM), remap(maxFBM)) + BoundEpsilon;
+    }
+
+    // Whether the high frequency erosion, Remap(x, modifier * highFreqModScale, 1, 0, 1), keeps
+    // every x <= 0 at or below 0. It does as long as the remap's lower end stays in [0, 1).
+    bool ErosionKeepsEmptySpaceEmpty(const NoiseVolume& noise, float highFreqModScale) {
+        float minFBM = std::numeric_limits<float>::infinity();
+        float maxFBM = -std::numeric_limits<float>::infinity();
+
+        for(const Vector4f& texel : noise.texels) {
+            const float fbm = texel.x * 0.625f + texel.y * 0.25f + texel.z * 0.125f;
+            if(std::isnan(fbm)) {
+                return false;
+            }
+
+            minFBM = std::min(minFBM, fbm);
+            maxFBM = std::max(maxFBM, fbm);
+        }
+
+        if(noise.texels.empty()) {
+            return false;
+        }
+
+        // the modifier lerps between fbm and 1 - fbm
+        const float minModifier = std::min(minFBM, 1.f - maxFBM);
+        const float maxModifier = std::max(maxFBM, 1.f - minFBM);
+        const float a = minModifier * highFreqModScale;
+        const float b = maxModifier * highFreqModScale;
+        return std::min(a, b) >= 0.f && std::max(a, b) < 1.f - BoundEpsilon;
+    }
+
+    // Chebyshev distance transform along one line of cells: d(i) = min over j of max(|j|, d(i + j)).
+    // Cells past the ends of a line that doesn't wrap are empty.
+    void DistanceTransformLine(std::vector<uint8_t>& line, std::vector<uint8_t>& padded, bool wrap) {
+        const int n = (int)line.size();
+        const int pad = CloudOccupancyGrid::MaxDistance;
+
+        padded.resize(n + 2 * pad);
+        for(int i = -pad; i < n + pad; i++) {
+            const bool inside = i >= 0 && i < n;
+            padded[i + pad] = inside ? line[i] : wrap ? line[((i % n) + n) % n] : CloudOccupancyGrid::MaxDistance;
+        }
+
+        for(int i = 0; i < n; i++) {
+            const uint8_t* cell = &padded[i + pad];
+            uint8_t best = cell[0];
+            for(int j = 1; j < best; j++) {
+                best = std::min(best, std::max((uint8_t)j, std::min(cell[-j], cell[j])));
+            }
+            line[i] = best;
+        }
+    }
+}
+
+bool CloudOccupancyGrid::IsEmpty(const Vector3f& pos, float& emptyDistance) const {
+    emptyDistance = 0.f;
+
+    const float innerShellRadius = CloudGroundRadius + params.innerShellRadius;
+    const float outerShellRadius = CloudGroundRadius + params.outerShellRadius;
+    const float heightFraction = (pos.Length() - innerShellRadius) / (outerShellRadius - innerShellRadius);
+    if(std::isnan(heightFraction)) {
+        return false;
+    }
+
+    // GetCloudDensityByPos returns 0 outside the layer
+    if(heightFraction < -HeightEpsilon || heightFraction > 1.f + HeightEpsilon) {
+        return true;
+    }
+
+    // same texel coordinates as the weather lookup, see AtmosphereLUT::SampleWrap
+    const float texelX = (pos.x + 150.f + params.weatherRadius.x / 2.f) / params.weatherRadius.x * width - 0.5f;
+    const float texelY = (pos.y + params.weatherRadius.y / 2.f) / params.weatherRadius.y * height - 0.5f;
+    if(!std::isfinite(texelX) || !std::isfinite(texelY)) {
+        return false;
+    }
+
+    auto wrap = [](float v, uint32_t size) {
+        const float wrapped = v - (float)size * std::floor(v / (float)size);
+        return std::min((uint32_t)wrapped, size - 1);
+    };
+    const uint32_t x = wrap(std::floor(texelX), width);
+    const uint32_t y = wrap(std::floor(texelY), height);
+    const uint32_t z = std::min((uint32_t)std::max(heightFraction * depth, 0.f), depth - 1);
+
+    const uint8_t distance = distances[((size_t)z * height + y) * width + x];
+    if(distance == 0) {
+        return false;
+    }
+
+    // a move of s changes every cell coordinate by at most s / cellSize cells
+    emptyDistance = (distance - 1) * cellSize;
+    return true;
+}
+
+bool CloudOccupancyGrid::IsBuiltFor(const CloudMarchParameters& p, const CloudMarchTextures& t) const {
+    return !distances.empty() &&
+           t.weather == textures.weather && t.modelNoise == textures.modelNoise && t.detailNoise == textures.detailNoise &&
+           p.weatherRadius.x == params.weatherRadius.x && p.weatherRadius.y == params.weatherRadius.y &&
+           p.minWeatherCoverage == params.minWeatherCoverage && p.highFreqModScale == params.highFreqModScale &&
+           p.innerShellRadius == params.innerShellRadius && p.outerShellRadius == params.outerShellRadius;
+}
+
+CloudOccupancyGrid BuildCloudOccupancyGrid(const CloudMarchParameters& params, const CloudMarchTextures& textures) {
+    assert(textures.modelNoise && textures.detailNoise && textures.weather && "Missing cloud texture.");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const AtmosphereLUT& weather = *textures.weather;
+
+    CloudOccupancyGrid grid;
+    grid.width = weather.width;
+    grid.height = weather.height;
+    grid.depth = CloudOccupancyGrid::NumHeightSlabs;
+    grid.distances.resize((size_t)grid.width * grid.height * grid.depth);
+    grid.params = params;
+    grid.textures = textures;
+
+    const float shellThickness = params.outerShellRadius - params.innerShellRadius;
+    grid.cellSize = std::min({ params.weatherRadius.x / grid.width, params.weatherRadius.y / grid.height, shellThickness / grid.depth });
+
+    const float maxNoise = MaxBaseCloudNoise(*textures.modelNoise);
+    const bool canBeEmpty = std::isfinite(maxNoise) && ErosionKeepsEmptySpaceEmpty(*textures.detailNoise, params.highFreqModScale);
+
+    std::vector<float> maxBaseCloud(grid.depth);
+    for(uint32_t z = 0; z < grid.depth; z++) {
+        const Interval heightFraction { (float)z / grid.depth - HeightEpsilon, (float)(z + 1) / grid.depth + HeightEpsilon };
+        maxBaseCloud[z] = std::max(maxNoise, 0.f) * (MaxCloudLayerDensity(heightFraction) + BoundEpsilon);
+    }
+
+    for(uint32_t y = 0; y < grid.height; y++) {
+        for(uint32_t x = 0; x < grid.width; x++) {
+            // Bilinear lookups in cell (x, y) read texels x..x+1, y..y+1. One more on every side
+            // covers rounding differences between the lookup here and the one in the march.
+            float minCoverage = std::numeric_limits<float>::infinity();
+            float maxCoverage = -std::numeric_limits<float>::infinity();
+            float minType = std::numeric_limits<float>::infinity();
+            float maxType = -std::numeric_limits<float>::infinity();
+            bool hasNaN = false;
+
+            for(uint32_t dy = 0; dy < 4; dy++) {
+                for(uint32_t dx = 0; dx < 4; dx++) {
+                    const Vector4f& texel = weather.At((x + dx + grid.width - 1) % grid.width, (y + dy + grid.height - 1) % grid.height);
+                    hasNaN |= std::isnan(texel.x) || std::isnan(texel.z);
+                    minCoverage = std::min(minCoverage, texel.x);
+                    maxCoverage = std::max(maxCoverage, texel.x);
+                    minType = std::min(minType, texel.z);
+                    maxType = std::max(maxType, texel.z);
+                }
+            }
+
+            // the coverage the density uses is min(minWeatherCoverage, weather)^e, e in [0.8, 1], which is at least min(...) below 1
+            const float minCloudCoverage = std::min(params.minWeatherCoverage, minCoverage);
+            const float maxCloudCoverage = std::min(params.minWeatherCoverage, maxCoverage);
+            const bool coverageBounded = canBeEmpty && !hasNaN && minCloudCoverage >= 0.f && maxCloudCoverage < 1.f;
+
+            for(uint32_t z = 0; z < grid.depth; z++) {
+                bool isEmpty = false;
+                if(coverageBounded) {
+                    // Remap(baseCloud, coverage, 1, 0, 1) * coverage is <= 0 for baseCloud <= coverage, and 0 without coverage
+                    isEmpty = maxCloudCoverage == 0.f ||
+                              (minType >= 0.f && maxType <= 1.f && minCloudCoverage >= maxBaseCloud[z]);
+                }
+
+                grid.distances[((size_t)z * grid.height + y) * grid.width + x] = isEmpty ? CloudOccupancyGrid::MaxDistance : 0;
+                grid.numEmptyCells += isEmpty ? 1 : 0;
+            }
+        }
+    }
+
+    // distance field, one axis at a time; the weather wraps, there's no cloud above or below the layer
+    std::vector<uint8_t> line, scratch;
+    auto transformAxis = [&](uint32_t numLines, uint32_t length, bool wrap, auto index) {
+        line.resize(length);
+        for(uint32_t l = 0; l < numLines; l++) {
+            for(uint32_t i = 0; i < length; i++) {
+                line[i] = grid.distances[index(l, i)];
+            }
+            DistanceTransformLine(line, scratch, wrap);
+            for(uint32_t i = 0; i < length; i++) {
+                grid.distances[index(l, i)] = line[i];
+            }
+        }
+    };
+
+    const size_t sliceSize = (size_t)grid.width * grid.height;
+    transformAxis(grid.height * grid.depth, grid.width, true, [&](uint32_t l, uint32_t i) { return (size_t)l * grid.width + i; });
+    transformAxis(grid.width * grid.depth, grid.height, true, [&](uint32_t l, uint32_t i) {
+        return (size_t)(l / grid.width) * sliceSize + (size_t)i * grid.width + l % grid.width;
+    });
+    transformAxis(grid.width * grid.height, grid.depth, false, [&](uint32_t l, uint32_t i) { return i * sliceSize + l; });
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Built " << grid.width << "x" << grid.height << "x" << grid.depth << " cloud occupancy grid in "
+              << seconds * 1000.0 << "ms (" << 100.0 * grid.numEmptyCells / grid.GetNumCells() << "% empty)" << std::endl;
+
+    return grid;
+}
@@ -0,0 +1,56 @@
+#ifndef CLOUDSCAPES_CLOUD_OCCUPANCY_GRID_H_
+#define CLOUDSCAPES_CLOUD_OCCUPANCY_GRID_H_
+
+#include <cstdint>
+#include <vector>
+#include "cloud_raymarcher.h"
+#include "ninmath/ninmath.h"
+
+//
+// Conservative empty-space grid for the CPU cloud march (cloud_raymarcher.h).
+//
+// Cells are one weather texel wide and deep and one of NumHeightSlabs slices of the cloud layer high.
+// A cell is empty when GetCloudDensityByPos provably returns 0 everywhere in it: its weather coverage
+// is 0, or the coverage is at least the largest base cloud value its weather, height and the model
+// noise's value range allow. The bounds come from the texel ranges, no density is evaluated.
+//
+// Every cell also stores the Chebyshev distance (in cells) to the closest cell that may hold cloud,
+// which turns into a distance along any ray that only crosses empty space.
+//
+// Built for one set of parameters and textures, it has to be rebuilt when those change.
+//
+struct CloudOccupancyGrid {
+    static constexpr uint32_t NumHeightSlabs = 8;
+
+    // distance field cap, in cells
+    static constexpr uint8_t MaxDistance = 16;
+
+    // true if every density sample at pos is 0, emptyDistance is then how far pos can
+    // move in any direction and stay in empty space (0 for no leap)
+    bool IsEmpty(const ninmath::Vector3f& pos, float& emptyDistance) const;
+
+    // whether the grid bounds the density of these parameters and textures
+    bool IsBuiltFor(const CloudMarchParameters& params, const CloudMarchTextures& textures) const;
+
+    size_t GetNumCells() const { return distances.size(); }
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t depth = 0;
+
+    // 0 for cells that may hold cloud, x fastest like NoiseVolume
+    std::vector<uint8_t> distances;
+
+    // world size of the smallest cell edge, in km
+    float cellSize = 0.f;
+
+    size_t numEmptyCells = 0;
+
+    CloudMarchParameters params {};
+    CloudMarchTextures textures;
+};
+
+// single threaded, around 100ms for a 512x512 weather texture
+CloudOccupancyGrid BuildCloudOccupancyGrid(const CloudMarchParameters& params, const CloudMarchTextures& textures);
+
+#endif // CLOUDSCAPES_CLOUD_OCCUPANCY_GRID_H_
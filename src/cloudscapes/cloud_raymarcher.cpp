@@ -0,0 +1,1523 @@
+#include "cloud_raymarcher.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "atmosphere_common.h"
+#include "cloud_occupancy_grid.h"
+#include "multithreading/work_stealing_scheduler.h"
+
+using namespace ninmath;
+using namespace atmosphere;
+
+namespace {
+    const float Rb = CloudGroundRadius;
+
+    // offsets of the light march (cone) samples, scaled up with every sample
+    const Vector3f RandomVectors[6] = {
+        { 0.38051305f,  0.92453449f, -0.02111345f},
+        {-0.50625799f, -0.03590792f, -0.86163418f},
+        {-0.32509218f, -0.94557439f,  0.01428793f},
+        { 0.09026238f, -0.27376545f,  0.95755165f},
+        { 0.28128598f,  0.42443639f, -0.86065785f},
+        {-0.16852403f,  0.14748697f,  0.97460106f}
+    };
+
+    const float NumLightSamples = 6.f;
+
+    // number of (nearly) empty samples after which the march switches to large steps
+    const int LargeDtThreshold = 6;
+
+    // sample counts of one render thread, see CloudRaymarcher::RenderStats
+    struct MarchCounters {
+        uint64_t numSamples = 0;
+        uint64_t numSkippedSamples = 0;
+        uint64_t numLeapedSamples = 0;
+        uint64_t numLightSamples = 0;
+        uint64_t numSkippedLightSamples = 0;
+    };
+
+    struct CloudMarchContext {
+        const CloudMarchParameters& params;
+        const CloudMarchTextures& textures;
+        const CloudOccupancyGrid* occupancyGrid;
+        bool leapEmptySpace;
+        bool fastMath;
+        Vector3f skyColor; // see GetSkyColor
+        MarchCounters& counters;
+    };
+
+    Vector3f ToVector3(const Vector4f& v) {
+        return { v.x, v.y, v.z };
+    }
+
+    // mul(M, v) of the shader, matrices are compiled row major
+    Vector4f Mul(const Matrix4x4f& m, const Vector4f& v) {
+        return { m.Row(0).Dot(v), m.Row(1).Dot(v), m.Row(2).Dot(v), m.Row(3).Dot(v) };
+    }
+
+    Vector3f Mul3x3(const Matrix4x4f& m, const Vector3f& v) {
+        return { ToVector3(m.Row(0)).Dot(v), ToVector3(m.Row(1)).Dot(v), ToVector3(m.Row(2)).Dot(v) };
+    }
+
+    float Remap(float val, float oldMin, float oldMax, float newMin, float newMax) {
+        const float p = (val - oldMin) / (oldMax - oldMin);
+        return newMin + p * (newMax - newMin);
+    }
+
+    // blended density gradient of stratus, stratocumulus and cumulus, cloudType is the weather texture's blue channel
+    float CloudLayerDensity(float relativeHeight, float cloudType) {
+        relativeHeight = std::clamp(relativeHeight, 0.f, 1.f);
+
+        const float cumulus = std::max(0.f, Remap(relativeHeight, 0.f, 0.2f, 0.f, 1.f) * Remap(relativeHeight, 0.7f, 0.9f, 1.f, 0.f));
+        const float stratocumulus = std::max(0.f, Remap(relativeHeight, 0.f, 0.2f, 0.f, 1.f) * Remap(relativeHeight, 0.2f, 0.7f, 1.f, 0.f));
+        const float stratus = std::max(0.f, Remap(relativeHeight, 0.f, 0.1f, 0.f, 1.f) * Remap(relativeHeight, 0.2f, 0.3f, 1.f, 0.f));
+
+        const float d1 = Lerp(stratus, stratocumulus, std::clamp(cloudType * 2.f, 0.f, 1.f));
+        const float d2 = Lerp(stratocumulus, cumulus, std::clamp((cloudType - 0.5f) * 2.f, 0.f, 1.f));
+        return Lerp(d1, d2, cloudType);
+    }
+
+    float GetHeightFraction(const CloudMarchParameters& params, float r) {
+        const float innerShellRadius = Rb + params.innerShellRadius;
+        const float outerShellRadius = Rb + params.outerShellRadius;
+        return (r - innerShellRadius) / (outerShellRadius - innerShellRadius);
+    }
+
+    float HeightBiasCoverage(float coverage, float height) {
+        return std::pow(coverage, std::clamp(Remap(height, 0.7f, 0.8f, 1.f, 0.8f), 0.8f, 1.f));
+    }
+
+    // the shader's wind offset is always zero, so it's left out
+    float GetCloudDensityByPos(const CloudMarchContext& ctx, const Vector3f& pos, bool highQuality) {
+        const CloudMarchParameters& params = ctx.params;
+
+        const float heightFraction = GetHeightFraction(params, pos.Length());
+        if(heightFraction > 1 || heightFraction < 0) {
+            return 0.f;
+        }
+
+        Vector3f samplePos = pos;
+        samplePos.z -= Rb;
+
+        const Vector2f weatherUV(
+            (samplePos.x + 150.f + params.weatherRadius.x / 2.f) / params.weatherRadius.x,
+            (samplePos.y + params.weatherRadius.y / 2.f) / params.weatherRadius.y
+        );
+        const Vector4f weatherData = ctx.textures.weather->SampleWrap(weatherUV);
+
+        const Vector4f noises = ctx.textures.modelNoise->Sample(samplePos * params.modelNoiseScale);
+
+        const float lowFreqFBM = noises.y * 0.625f + noises.z * 0.25f + noises.w * 0.125f;
+        const float perlinWorley = noises.x;
+        float baseCloud = Remap(perlinWorley, lowFreqFBM - 1.f, 1.f, 0.f, 1.f);
+
+        baseCloud *= CloudLayerDensity(heightFraction, weatherData.z);
+
+        const float cloudCoverage = HeightBiasCoverage(std::min(params.minWeatherCoverage, weatherData.x), heightFraction);
+
+        float baseCloudWithCoverage = Remap(baseCloud, cloudCoverage, 1.f, 0.f, 1.f);
+        baseCloudWithCoverage *= cloudCoverage;
+
+        float finalCloud = baseCloudWithCoverage;
+
+        if(highQuality) {
+            const Vector4f highFreqNoises = ctx.textures.detailNoise->Sample(samplePos * params.highFreqScale);
+
+            const float highFreqFBM = highFreqNoises.x * 0.625f + highFreqNoises.y * 0.25f + highFreqNoises.z * 0.125f;
+            const float highFreqNoiseModifier = Lerp(highFreqFBM, 1.f - highFreqFBM, Saturate(heightFraction * params.highFreqHFScale));
+
+            finalCloud = Remap(baseCloudWithCoverage, highFreqNoiseModifier * params.highFreqModScale, 1.f, 0.f, 1.f);
+        }
+
+        return Saturate(finalCloud);
+    }
+
+    // How many of the march's next steps stay within emptyDistance of the empty sample at t, and would
+    // only find nothing. Follows the switch to large steps, every step gets the current step's jitter.
+    // leapT is where the steps end.
+    float GetNumLeapedSteps(float t, float maxT, float emptyDistance, float smallDt, float largeDt, float numDensityZero,
+                            float maxSteps, float& leapT) {
+        leapT = t;
+
+        // the sample at t counts as empty too
+        numDensityZero += 1.f;
+
+        float numSteps = 0.f;
+        while(numSteps < maxSteps) {
+            const float nextT = leapT + (numDensityZero > LargeDtThreshold ? largeDt : smallDt);
+            if(nextT > maxT || !(nextT - t <= emptyDistance)) {
+                break;
+            }
+
+            leapT = nextT;
+            numSteps += 1.f;
+            numDensityZero += 1.f;
+        }
+
+        return numSteps;
+    }
+
+    // what CloudMarch works out before its loop
+    struct CloudRay {
+        bool radianceValid = false;
+        float t = 0.f;
+        float maxT = 0.f;
+        float stepSize = 0.f;
+        float miePhase = 0.f;
+    };
+
+    CloudRay SetupCloudRay(const CloudMarchContext& ctx, const Vector3f& rayOrigin, const Vector3f& rayDir, float rayOffset) {
+        const CloudMarchParameters& params = ctx.params;
+        const Vector3f center;
+
+        const float innerShellRadius = Rb + params.innerShellRadius;
+        const float outerShellRadius = Rb + params.outerShellRadius;
+
+        // left unset by a miss, and then never read
+        float innerNearDist = 0.f, innerFarDist = 0.f;
+        const uint32_t numHitInnerShell = GetRaySphereDistances(rayOrigin, rayDir, center, innerShellRadius, innerNearDist, innerFarDist);
+        const bool hitInnerShell = numHitInnerShell > 0;
+
+        float outerNearDist = 0.f, outerFarDist = 0.f;
+        const uint32_t numHitOuterShell = GetRaySphereDistances(rayOrigin, rayDir, center, outerShellRadius, outerNearDist, outerFarDist);
+        const bool hitOuterShell = numHitOuterShell > 0;
+
+        // see the shader for which case is which
+        float raySampleLength = 10.f;
+        if(hitInnerShell && hitOuterShell) {
+            if(numHitOuterShell == 1 && numHitInnerShell == 1) {
+                raySampleLength = std::abs(outerNearDist - innerNearDist);
+            }
+            else if(numHitOuterShell == 2 && numHitInnerShell == 2) {
+                raySampleLength = std::abs(outerNearDist - innerNearDist);
+            }
+            else if(numHitOuterShell == 1 && numHitInnerShell == 2) {
+                raySampleLength = innerNearDist + std::abs(outerNearDist - innerNearDist);
+            }
+        }
+        else if(hitOuterShell) {
+            if(numHitInnerShell == 0) {
+                raySampleLength = std::abs(outerFarDist - outerNearDist);
+            }
+            else if(numHitInnerShell == 1) {
+                raySampleLength = std::abs(outerNearDist);
+            }
+        }
+
+        raySampleLength = std::min(raySampleLength, params.beersScale.w);
+
+        const float stepSize = params.fixedDt ? params.lodThresholds.x : raySampleLength / (float)params.numSamples;
+
+        float groundNearDist = 0.f, groundFarDist = 0.f;
+        const uint32_t numHitGround = GetRaySphereDistances(rayOrigin, rayDir, center, Rb, groundNearDist, groundFarDist);
+        const bool hitGround = numHitGround > 0;
+
+        const bool hitGroundFirst = hitGround && groundNearDist < innerNearDist;
+        const bool noIntersection = !hitInnerShell && !hitOuterShell && !hitGround;
+        const float originRadius = rayOrigin.Length();
+        const bool inBetweenShells = originRadius > innerShellRadius && originRadius < outerShellRadius;
+
+        CloudRay ray;
+
+        // the shader still marches these rays, but never accumulates anything
+        ray.radianceValid = !noIntersection && !hitGroundFirst;
+        if(!ray.radianceValid) {
+            return ray;
+        }
+
+        float t = 0.f;
+        float maxT = hitGround ? groundNearDist :
+                     (hitInnerShell && hitOuterShell) ? std::max(outerNearDist, innerNearDist) :
+                     numHitOuterShell == 1 ? outerNearDist : outerFarDist;
+
+        if(inBetweenShells) {
+            t = 0.f;
+            maxT = numHitInnerShell <= 0 ? outerNearDist : innerNearDist;
+        }
+        else if(originRadius < innerShellRadius) {
+            t = innerNearDist;
+            maxT = outerNearDist;
+        }
+        else if(originRadius > outerShellRadius) {
+            t = outerNearDist;
+            maxT = numHitInnerShell <= 0 ? outerFarDist : innerNearDist;
+        }
+
+        t += stepSize * rayOffset;
+
+        ray.t = t;
+        ray.maxT = maxT;
+        ray.stepSize = stepSize;
+
+        // pos to light
+        const Vector3f lightDir = params.lightDir.Normal();
+
+        const float cosTheta_lv = lightDir.Dot(rayDir);
+        const float miePhase1 = MiePhaseApproximation_HenyeyGreenstein(cosTheta_lv, -0.2f);
+        const float miePhase2 = MiePhaseApproximation_HenyeyGreenstein(cosTheta_lv, 0.9f);
+        ray.miePhase = Lerp(miePhase1, miePhase2, params.phaseG);
+
+        return ray;
+    }
+
+    // All color channels of the shader's transmittance are the same, it's a scalar here.
+    Vector3f CloudMarch(const CloudMarchContext& ctx, const Vector3f& rayOrigin, const Vector3f& rayDir, const CloudRay& ray,
+                        float& finalTransmittance) {
+        const CloudMarchParameters& params = ctx.params;
+
+        if(!ray.radianceValid) {
+            finalTransmittance = 1.f;
+            return {};
+        }
+
+        const float extinction = params.extinction;
+        const float scattering = extinction / 2.f;
+
+        const Vector3f lightDir = params.lightDir.Normal();
+        const float lightAlpha = Saturate(lightDir.z);
+        const float lightLuminance = Lerp(0.001f, 1.f, lightAlpha);
+
+        const float numSamples = (float)params.numSamples;
+        const float largeDtBase = params.largeDtScale;
+        const float stepSize = ray.stepSize;
+        const float maxT = ray.maxT;
+        float t = ray.t;
+        int numDensityZero = 0;
+
+        float transmittance = 1.f;
+        Vector3f L;
+
+        for(float i = 0; i < numSamples; i += 1.f) {
+            const bool isSearching = numDensityZero > LargeDtThreshold;
+
+            float blueRand = 0.f;
+            if(params.useBlueNoise) {
+                const Vector3f pos = rayOrigin + t * rayDir;
+                blueRand = ctx.textures.blueNoise->SampleWrap(Vector2f(pos.x, pos.y) * params.beersScale.x).x;
+            }
+
+            const float largeDt = largeDtBase + largeDtBase * blueRand;
+            const float smallDt = stepSize + stepSize * blueRand;
+            const float dt = isSearching ? largeDt : smallDt;
+            t += dt;
+
+            bool reachedEnd = t > maxT;
+            if(transmittance < .01f) {
+                reachedEnd = true;
+                transmittance = 0.f;
+            }
+
+            // the shader keeps looping past the end, but nothing it does there is kept
+            if(reachedEnd) {
+                break;
+            }
+
+            const Vector3f samplePos = rayOrigin + t * rayDir;
+
+            float density = 0.f;
+            float emptyDistance;
+            if(ctx.occupancyGrid && ctx.occupancyGrid->IsEmpty(samplePos, emptyDistance)) {
+                ctx.counters.numSkippedSamples++;
+
+                // the steps that fit into the empty space would only have found nothing, jump over them
+                if(ctx.leapEmptySpace) {
+                    float leapT;
+                    const float numLeapedSteps = GetNumLeapedSteps(t, maxT, emptyDistance, smallDt, largeDt, (float)numDensityZero,
+                                                                   numSamples - (i + 1.f), leapT);
+                    t = leapT;
+                    i += numLeapedSteps;
+                    numDensityZero += (int)numLeapedSteps;
+                    ctx.counters.numLeapedSamples += (uint64_t)numLeapedSteps;
+                }
+            }
+            else {
+                density = GetCloudDensityByPos(ctx, samplePos, !isSearching);
+                ctx.counters.numSamples++;
+            }
+
+            if(density <= 0.01f) {
+                numDensityZero++;
+            }
+
+            if(density <= 0.f) {
+                continue;
+            }
+
+            numDensityZero = 0;
+
+            // a large step ran into a cloud, step back and walk into it with small steps instead
+            if(isSearching) {
+                t -= dt;
+                continue;
+            }
+
+            const float sampleTransmittance = std::exp(-1.f * (extinction * density * dt));
+
+            const float lightSampleLength = params.beersScale.z;
+            const float lightDt = lightSampleLength / NumLightSamples;
+            float lightT = 0.f;
+            float lightDensity = 0.f;
+
+            for(float j = 0.f; j < NumLightSamples; j += 1.f) {
+                const float newLightT = lightSampleLength * (j + 0.1f) / NumLightSamples;
+                lightT += std::abs(newLightT - lightT);
+
+                const Vector3f lightSamplePos = samplePos + lightT * (lightDir + RandomVectors[(int)j] * j);
+                float lightEmptyDistance;
+                if(ctx.occupancyGrid && ctx.occupancyGrid->IsEmpty(lightSamplePos, lightEmptyDistance)) {
+                    ctx.counters.numSkippedLightSamples++;
+                }
+                else {
+                    lightDensity += GetCloudDensityByPos(ctx, lightSamplePos, j < 3);
+                    ctx.counters.numLightSamples++;
+                }
+            }
+
+            // Beer-powder
+            const float cd = lightDensity * lightDt * extinction;
+            const float beers = std::max(std::exp(-1.f * cd), 0.7f * std::exp(-1.f * 0.25f * cd));
+            const float powShug = 2.f * (1.f - std::exp(-1.f * cd * 2.f));
+            const float lightTransmittance = beers * powShug;
+
+            const Vector3f curL = (ctx.skyColor + lightLuminance * (lightTransmittance * ray.miePhase) * scattering) * density;
+            const Vector3f intS = curL - curL * sampleTransmittance;
+
+            L = L + intS * transmittance;
+            transmittance *= sampleTransmittance;
+        }
+
+        finalTransmittance = transmittance;
+        return L;
+    }
+
+    // what main() works out before it calls CloudMarch
+    struct PrimaryRay {
+        Vector3f origin;
+        Vector3f dir;
+        float rayOffset;
+    };
+
+    // The shader always looks the sky color up towards the zenith, from the camera. The lookup
+    // doesn't depend on the pixel, so it's done once per frame.
+    Vector3f GetSkyColor(const CloudMarchView& view, const CloudMarchParameters& params, const CloudMarchTextures& textures) {
+        const Vector3f origin = view.cameraPos + Vector3f(0.f, 0.f, Rb);
+        const Vector3f queryDir(0.f, 0.f, 1.f);
+
+        const float r = origin.Length();
+        const Vector3f zenith = origin.Normal();
+        const float cosTheta_Zv = zenith.Dot(queryDir);
+
+        const Vector3f sideDir = zenith.Cross(queryDir).Normal();
+        const Vector3f fwdDir = sideDir.Cross(zenith).Normal();
+        const Vector3f lightDir = params.lightDir.Normal();
+        const Vector2f lightOnPlane(lightDir.Dot(fwdDir), lightDir.Dot(sideDir));
+        const float cosTheta_lv = lightOnPlane.x / std::sqrt(lightOnPlane.x * lightOnPlane.x + lightOnPlane.y * lightOnPlane.y);
+
+        // only Rb is read
+        const AtmosphereContext atmosphere { Rb, 0.f };
+        return ToVector3(textures.skyView->SampleWrap(SkyViewParametersToUV(atmosphere, r, cosTheta_lv, cosTheta_Zv)));
+    }
+
+    PrimaryRay GetPrimaryRay(uint32_t x, uint32_t y, const CloudMarchView& view, const CloudMarchParameters& params,
+                             const CloudMarchTextures& textures) {
+        PrimaryRay ray;
+
+        // SV_Position is the pixel center, (0,0) the top left corner
+        Vector2f uv(((float)x + 0.5f) / (float)view.screenSize.x, ((float)y + 0.5f) / (float)view.screenSize.y);
+
+        const float ar = (float)view.screenSize.x / (float)view.screenSize.y;
+
+        uv.y = 1.f - uv.y;
+        uv = uv - Vector2f(0.5f, 0.5f);
+        uv.x *= ar;
+
+        const Vector4f viewPos = Mul(view.invProjectionMat, Vector4f(uv.x, uv.y, 1.f, 1.f));
+        ray.dir = Mul3x3(view.invViewMat, ToVector3(viewPos) / viewPos.w).Normal();
+        ray.origin = view.cameraPos + Vector3f(0.f, 0.f, Rb);
+
+        ray.rayOffset = params.useBlueNoise ? textures.blueNoise->SampleWrap(uv).x : 0.f;
+
+        return ray;
+    }
+
+    float ResolveAlpha(const CloudMarchParameters& params, float transmittance) {
+        return params.useAlpha == 0 ? (transmittance > 0 ? 1.f : 0.f) : transmittance;
+    }
+
+    Vector4f ResolvePixel(const CloudMarchParameters& params, const Vector3f& cloudColor, float transmittance) {
+        const float alpha = ResolveAlpha(params, transmittance);
+
+        auto toneMap = [](float c) {
+            const float gamma = 2.2f;
+            return std::pow(1.f - std::exp(-c * 3.f), 1.f / gamma);
+        };
+
+        return { toneMap(cloudColor.x), toneMap(cloudColor.y), toneMap(cloudColor.z), alpha };
+    }
+
+    Vector4f ShadePixel(const CloudMarchContext& ctx, uint32_t x, uint32_t y, const CloudMarchView& view) {
+        const PrimaryRay primary = GetPrimaryRay(x, y, view, ctx.params, ctx.textures);
+        const CloudRay ray = SetupCloudRay(ctx, primary.origin, primary.dir, primary.rayOffset);
+
+        float transmittance;
+        const Vector3f cloudColor = CloudMarch(ctx, primary.origin, primary.dir, ray, transmittance);
+        return ResolvePixel(ctx.params, cloudColor, transmittance);
+    }
+
+#if defined(NINMATH_NOISE_SIMD_AVX2) || defined(NINMATH_NOISE_SIMD_AVX512)
+    //
+    // Ray packets: L::Width neighbouring rays marched together, one per lane, structure of arrays.
+    // Every lane goes through the same IEEE operations CloudMarch does for its ray, so a packet
+    // gives bit-identical pixels (given no FMA contraction, see noise_simd.h). std::exp/std::pow
+    // have no vector versions that would match them, those run per lane, for the lanes that need them,
+    // unless fast math swaps them for FastExpLanes/FastLogLanes.
+    // Finished lanes are masked off, a packet stops once all of them are done.
+    //
+
+    static_assert(sizeof(Vector4f) == 4 * sizeof(float), "Texels are loaded with 4 float loads.");
+
+    // Where a lane's filter footprint is, in texels: the first corner and the steps to the next texel
+    // along x, y and z (1 row/slice, or back across the wrap). The corners are scalar adds from there.
+    template <size_t Width>
+    struct TexelOffsets {
+        alignas(64) int32_t base[Width];
+        alignas(64) int32_t dx[Width];
+        alignas(64) int32_t dy[Width];
+        alignas(64) int32_t dz[Width];
+    };
+
+    // the 2^D corners of one lane's bilinear/trilinear footprint, x first
+    template <int D, size_t Width>
+    void LoadLaneCorners(const Vector4f* texels, const TexelOffsets<Width>& offsets, uint32_t lane, __m128 (&out)[1 << D]) {
+        static_assert(D == 2 || D == 3, "Images and volumes only.");
+        const float* p = &texels[offsets.base[lane]].x;
+        const ptrdiff_t dx = 4 * (ptrdiff_t)offsets.dx[lane];
+        const ptrdiff_t dy = 4 * (ptrdiff_t)offsets.dy[lane];
+
+        out[0] = _mm_loadu_ps(p);
+        out[1] = _mm_loadu_ps(p + dx);
+        out[2] = _mm_loadu_ps(p + dy);
+        out[3] = _mm_loadu_ps(p + dy + dx);
+        if constexpr(D == 3) {
+            p += 4 * (ptrdiff_t)offsets.dz[lane];
+            out[4] = _mm_loadu_ps(p);
+            out[5] = _mm_loadu_ps(p + dx);
+            out[6] = _mm_loadu_ps(p + dy);
+            out[7] = _mm_loadu_ps(p + dy + dx);
+        }
+    }
+
+    // what the march needs on top of the noise lanes
+#if defined(NINMATH_NOISE_SIMD_AVX2)
+    // for every mask of 8 lanes, the numbers of its lanes packed to the front, a byte each
+    constexpr std::array<uint64_t, 256> MakeCompressIndices() {
+        std::array<uint64_t, 256> indices {};
+        for(uint32_t bits = 0; bits < 256; bits++) {
+            uint32_t numLanes = 0;
+            for(uint32_t lane = 0; lane < 8; lane++) {
+                if(bits & (1u << lane)) {
+                    indices[bits] |= (uint64_t)lane << (8 * numLanes++);
+                }
+            }
+        }
+        return indices;
+    }
+
+    constexpr std::array<uint64_t, 256> CompressIndices = MakeCompressIndices();
+
+    struct PacketLanesAVX2 : ninmath::noise::simd_detail::LanesAVX2 {
+        static Float Sqrt(Float a) { return _mm256_sqrt_ps(a); }
+        // every AVX2 cpu has FMA, but gcc/clang only take the intrinsic with -mfma
+#if defined(__FMA__) || defined(_MSC_VER)
+        static Float MulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+        static Float MulAdd(Float a, Float b, Float c) { return Add(Mul(a, b), c); }
+#endif
+        static Mask IsNaN(Float a) { return _mm256_cmp_ps(a, a, _CMP_UNORD_Q); }
+        static Mask Not(Mask a) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+        static bool Any(Mask a) { return _mm256_movemask_ps(a) != 0; }
+        static uint32_t ToBits(Mask a) { return (uint32_t)_mm256_movemask_ps(a); }
+        static Mask FromBits(uint32_t bits) {
+            const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)bits), laneBits), laneBits));
+        }
+
+        static Int AddInt(Int a, Int b) { return _mm256_add_epi32(a, b); }
+        static Int ClampInt(Int a, int lo, int hi) { return _mm256_min_epi32(_mm256_max_epi32(a, _mm256_set1_epi32(lo)), _mm256_set1_epi32(hi)); }
+        static Int SubInt(Int a, Int b) { return _mm256_sub_epi32(a, b); }
+        static Int AndInt(Int a, Int b) { return _mm256_and_si256(a, b); }
+        static Int OrInt(Int a, Int b) { return _mm256_or_si256(a, b); }
+        template <int N>
+        static Int ShiftLeftInt(Int a) { return _mm256_slli_epi32(a, N); }
+        static Float ToFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+        static Int AsInt(Float a) { return _mm256_castps_si256(a); }
+        static Float AsFloat(Int a) { return _mm256_castsi256_ps(a); }
+
+        static Float GatherFloats(const float* base, Int index) { return _mm256_i32gather_ps(base, index, 4); }
+
+        // the lanes in mask packed to the front of p, all Width floats get written
+        static void CompressStore(float* p, Mask mask, Float a) {
+            _mm256_storeu_ps(p, _mm256_permutevar8x32_ps(a, GetCompressIndices(mask)));
+        }
+
+        // the numbers of the lanes in mask, packed the same way
+        static void CompressLaneNumbers(uint32_t* p, Mask mask) { _mm256_storeu_si256((__m256i*)p, GetCompressIndices(mask)); }
+
+        static Int GetCompressIndices(Mask mask) {
+            return _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long)CompressIndices[ToBits(mask)]));
+        }
+
+        static void StoreInt(int32_t* p, Int a) { _mm256_store_si256((__m256i*)p, a); }
+
+        // the texels as they are in memory, out[c] holds corner c of lanes k and k + 4
+        template <int D>
+        static void LoadCorners(const Vector4f* texels, const TexelOffsets<Width>& offsets, uint32_t k, Float (&out)[1 << D]) {
+            __m128 lo[1 << D], hi[1 << D];
+            LoadLaneCorners<D>(texels, offsets, k, lo);
+            LoadLaneCorners<D>(texels, offsets, k + 4, hi);
+            for(int c = 0; c < (1 << D); c++) {
+                out[c] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[c]), hi[c], 1);
+            }
+        }
+
+        // a lane value next to the texels of its lane: out[k] is lane k 4 times, then lane k + 4 4 times
+        static void SpreadLanes(Float a, Float (&out)[4]) {
+            out[0] = _mm256_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0));
+            out[1] = _mm256_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1));
+            out[2] = _mm256_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2));
+            out[3] = _mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+
+        // LoadCorners' layout to x/y/z/w lanes
+        static void TransposeTexels(const Float (&t)[4], Float (&out)[4]) {
+            const __m256 t0 = t[0], t1 = t[1], t2 = t[2], t3 = t[3];
+            const __m256 xy01 = _mm256_unpacklo_ps(t0, t1);
+            const __m256 xy23 = _mm256_unpacklo_ps(t2, t3);
+            const __m256 zw01 = _mm256_unpackhi_ps(t0, t1);
+            const __m256 zw23 = _mm256_unpackhi_ps(t2, t3);
+            out[0] = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(1, 0, 1, 0));
+            out[1] = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+            out[2] = _mm256_shuffle_ps(zw01, zw23, _MM_SHUFFLE(1, 0, 1, 0));
+            out[3] = _mm256_shuffle_ps(zw01, zw23, _MM_SHUFFLE(3, 2, 3, 2));
+        }
+    };
+#endif
+
+#if defined(NINMATH_NOISE_SIMD_AVX512)
+    struct PacketLanesAVX512 : ninmath::noise::simd_detail::LanesAVX512 {
+        static Float Sqrt(Float a) { return _mm512_sqrt_ps(a); }
+        static Float MulAdd(Float a, Float b, Float c) { return _mm512_fmadd_ps(a, b, c); }
+        static Mask IsNaN(Float a) { return _mm512_cmp_ps_mask(a, a, _CMP_UNORD_Q); }
+        static Mask Not(Mask a) { return (Mask)~a; }
+        static bool Any(Mask a) { return a != 0; }
+        static uint32_t ToBits(Mask a) { return a; }
+        static Mask FromBits(uint32_t bits) { return (Mask)bits; }
+
+        static Int AddInt(Int a, Int b) { return _mm512_add_epi32(a, b); }
+        static Int ClampInt(Int a, int lo, int hi) { return _mm512_min_epi32(_mm512_max_epi32(a, _mm512_set1_epi32(lo)), _mm512_set1_epi32(hi)); }
+        static Int SubInt(Int a, Int b) { return _mm512_sub_epi32(a, b); }
+        static Int AndInt(Int a, Int b) { return _mm512_and_si512(a, b); }
+        static Int OrInt(Int a, Int b) { return _mm512_or_si512(a, b); }
+        template <int N>
+        static Int ShiftLeftInt(Int a) { return _mm512_slli_epi32(a, N); }
+        static Float ToFloat(Int a) { return _mm512_cvtepi32_ps(a); }
+        static Int AsInt(Float a) { return _mm512_castps_si512(a); }
+        static Float AsFloat(Int a) { return _mm512_castsi512_ps(a); }
+
+        static Float GatherFloats(const float* base, Int index) { return _mm512_i32gather_ps(index, base, 4); }
+
+        static void CompressStore(float* p, Mask mask, Float a) { _mm512_storeu_ps(p, _mm512_maskz_compress_ps(mask, a)); }
+        static void CompressLaneNumbers(uint32_t* p, Mask mask) {
+            const __m512i laneNumbers = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+            _mm512_storeu_si512(p, _mm512_maskz_compress_epi32(mask, laneNumbers));
+        }
+
+        static void StoreInt(int32_t* p, Int a) { _mm512_store_si512(p, a); }
+
+        // see PacketLanesAVX2, out[c] holds corner c of lanes k, k + 4, k + 8 and k + 12
+        template <int D>
+        static void LoadCorners(const Vector4f* texels, const TexelOffsets<Width>& offsets, uint32_t k, Float (&out)[1 << D]) {
+            __m128 t[4][1 << D];
+            for(uint32_t j = 0; j < 4; j++) {
+                LoadLaneCorners<D>(texels, offsets, k + 4 * j, t[j]);
+            }
+            for(int c = 0; c < (1 << D); c++) {
+                __m512 v = _mm512_castps128_ps512(t[0][c]);
+                v = _mm512_insertf32x4(v, t[1][c], 1);
+                v = _mm512_insertf32x4(v, t[2][c], 2);
+                out[c] = _mm512_insertf32x4(v, t[3][c], 3);
+            }
+        }
+
+        static void SpreadLanes(Float a, Float (&out)[4]) {
+            out[0] = _mm512_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0));
+            out[1] = _mm512_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1));
+            out[2] = _mm512_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2));
+            out[3] = _mm512_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+
+        static void TransposeTexels(const Float (&t)[4], Float (&out)[4]) {
+            const __m512 t0 = t[0], t1 = t[1], t2 = t[2], t3 = t[3];
+            const __m512 xy01 = _mm512_unpacklo_ps(t0, t1);
+            const __m512 xy23 = _mm512_unpacklo_ps(t2, t3);
+            const __m512 zw01 = _mm512_unpackhi_ps(t0, t1);
+            const __m512 zw23 = _mm512_unpackhi_ps(t2, t3);
+            out[0] = _mm512_shuffle_ps(xy01, xy23, _MM_SHUFFLE(1, 0, 1, 0));
+            out[1] = _mm512_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+            out[2] = _mm512_shuffle_ps(zw01, zw23, _MM_SHUFFLE(1, 0, 1, 0));
+            out[3] = _mm512_shuffle_ps(zw01, zw23, _MM_SHUFFLE(3, 2, 3, 2));
+        }
+    };
+#endif
+
+
+    template <typename L>
+    struct Vector3Lanes {
+        typename L::Float x;
+        typename L::Float y;
+        typename L::Float z;
+    };
+
+    // std::min/std::max/std::clamp, down to which operand comes back for NaNs
+    template <typename L>
+    typename L::Float StdMin(typename L::Float a, typename L::Float b) {
+        return L::Select(L::Less(b, a), b, a);
+    }
+
+    template <typename L>
+    typename L::Float StdMax(typename L::Float a, typename L::Float b) {
+        return L::Select(L::Less(a, b), b, a);
+    }
+
+    template <typename L>
+    typename L::Float StdClamp(typename L::Float v, float lo, float hi) {
+        return L::Select(L::Less(v, L::Set(lo)), L::Set(lo), L::Select(L::Less(L::Set(hi), v), L::Set(hi), v));
+    }
+
+    template <typename L>
+    typename L::Float LerpLanes(typename L::Float a, typename L::Float b, typename L::Float alpha) {
+        return L::Add(a, L::Mul(L::Sub(b, a), alpha));
+    }
+
+    template <typename L>
+    typename L::Float RemapLanes(typename L::Float val, typename L::Float oldMin, typename L::Float oldMax, float newMin, float newMax) {
+        const typename L::Float p = L::Div(L::Sub(val, oldMin), L::Sub(oldMax, oldMin));
+        return L::Add(L::Set(newMin), L::Mul(p, L::Sub(L::Set(newMax), L::Set(newMin))));
+    }
+
+    template <typename L>
+    typename L::Float RemapLanes(typename L::Float val, float oldMin, float oldMax, float newMin, float newMax) {
+        return RemapLanes<L>(val, L::Set(oldMin), L::Set(oldMax), newMin, newMax);
+    }
+
+    // func(a[, b]) on the lanes in mask, the others keep a
+    template <typename L, typename Func>
+    typename L::Float MapLanes(typename L::Mask mask, typename L::Float a, Func func) {
+        alignas(64) float values[L::Width];
+        L::Store(values, a);
+        const uint32_t bits = L::ToBits(mask);
+        for(uint32_t i = 0; i < L::Width; i++) {
+            if(bits & (1u << i)) {
+                values[i] = func(values[i]);
+            }
+        }
+        return L::Load(values);
+    }
+
+    template <typename L, typename Func>
+    typename L::Float MapLanes(typename L::Mask mask, typename L::Float a, typename L::Float b, Func func) {
+        alignas(64) float aValues[L::Width];
+        alignas(64) float bValues[L::Width];
+        L::Store(aValues, a);
+        L::Store(bValues, b);
+        const uint32_t bits = L::ToBits(mask);
+        for(uint32_t i = 0; i < L::Width; i++) {
+            if(bits & (1u << i)) {
+                aValues[i] = func(aValues[i], bValues[i]);
+            }
+        }
+        return L::Load(aValues);
+    }
+
+    // Fast math: Cephes' expf/logf, range reduction and a polynomial evaluated with fused multiply-adds.
+    // Within 2 ulp of std::exp/std::log for the arguments the march produces, but not bit-identical to them.
+    template <typename L>
+    typename L::Float FastExpLanes(typename L::Float x) {
+        typedef typename L::Float Float;
+        x = L::Min(L::Max(x, L::Set(-87.33654f)), L::Set(88.3762626647949f));
+
+        // x = n ln2 + r, |r| <= ln2 / 2, ln2 split in two so n ln2 stays exact
+        const Float n = L::Floor(L::Add(L::Mul(x, L::Set(1.44269504088896341f)), L::Set(0.5f)));
+        Float r = L::Sub(x, L::Mul(n, L::Set(0.693359375f)));
+        r = L::Add(r, L::Mul(n, L::Set(2.12194440e-4f)));
+
+        Float p = L::Set(1.9875691500e-4f);
+        p = L::MulAdd(p, r, L::Set(1.3981999507e-3f));
+        p = L::MulAdd(p, r, L::Set(8.3334519073e-3f));
+        p = L::MulAdd(p, r, L::Set(4.1665795894e-2f));
+        p = L::MulAdd(p, r, L::Set(1.6666665459e-1f));
+        p = L::MulAdd(p, r, L::Set(5.0000001201e-1f));
+        p = L::Add(L::MulAdd(L::Mul(p, r), r, r), L::Set(1.f));
+
+        // times 2^n, built in the exponent bits
+        const typename L::Int exponent = L::template ShiftLeftInt<23>(L::AddInt(L::ToInt(n), L::SetInt(127)));
+        return L::Mul(p, L::AsFloat(exponent));
+    }
+
+    // x > 0 and finite, other lanes return garbage
+    template <typename L>
+    typename L::Float FastLogLanes(typename L::Float x) {
+        typedef typename L::Float Float;
+        typedef typename L::Int Int;
+
+        // x = m 2^e, m in [0.5, 1)
+        const Int bits = L::AsInt(x);
+        Float e = L::ToFloat(L::SubInt(L::template ShiftRightInt<23>(bits), L::SetInt(126)));
+        Float m = L::AsFloat(L::OrInt(L::AndInt(bits, L::SetInt(0x007fffff)), L::SetInt(0x3f000000)));
+
+        // m in [sqrt(0.5), sqrt(2)), minus 1
+        const typename L::Mask small = L::Less(m, L::Set(0.707106781186547524f));
+        e = L::Select(small, L::Sub(e, L::Set(1.f)), e);
+        m = L::Sub(L::Select(small, L::Add(m, m), m), L::Set(1.f));
+
+        const Float z = L::Mul(m, m);
+        Float p = L::Set(7.0376836292e-2f);
+        p = L::MulAdd(p, m, L::Set(-1.1514610310e-1f));
+        p = L::MulAdd(p, m, L::Set(1.1676998740e-1f));
+        p = L::MulAdd(p, m, L::Set(-1.2420140846e-1f));
+        p = L::MulAdd(p, m, L::Set(1.4249322787e-1f));
+        p = L::MulAdd(p, m, L::Set(-1.6668057665e-1f));
+        p = L::MulAdd(p, m, L::Set(2.0000714765e-1f));
+        p = L::MulAdd(p, m, L::Set(-2.4999993993e-1f));
+        p = L::MulAdd(p, m, L::Set(3.3333331174e-1f));
+        p = L::Mul(L::Mul(p, m), z);
+
+        p = L::Add(p, L::Mul(e, L::Set(-2.12194440e-4f)));
+        p = L::Sub(p, L::Mul(z, L::Set(0.5f)));
+        return L::Add(L::Add(m, p), L::Mul(e, L::Set(0.693359375f)));
+    }
+
+    // one value per ray, lanes past numRays are zero
+    template <typename L, typename Func>
+    typename L::Float LoadLanes(uint32_t numRays, Func func) {
+        alignas(64) float values[L::Width] = {};
+        for(uint32_t i = 0; i < numRays; i++) {
+            values[i] = func(i);
+        }
+        return L::Load(values);
+    }
+
+    // GetWrappedTexels for sizes that aren't a power of two, or coordinates too large for the texel
+    // coordinates to be exact integers. The clamp's low end also keeps inf coordinates (and masked off
+    // lanes) inside the texture.
+    template <typename L>
+    void GetWrappedTexelsSlow(typename L::Float x0f, uint32_t size, typename L::Int& i0, typename L::Int& i1) {
+        typedef typename L::Float Float;
+        const Float sizeF = L::Set((float)size);
+        auto wrap = [&](Float v) {
+            const Float wrapped = L::Sub(v, L::Mul(sizeF, L::Floor(L::Div(v, sizeF))));
+            return L::ClampInt(L::ToInt(wrapped), 0, (int)size - 1);
+        };
+        i0 = wrap(x0f);
+        i1 = wrap(L::Add(x0f, L::Set(1.f)));
+    }
+
+    // Same texel coordinates and weights as NoiseVolume::Sample/AtmosphereLUT::SampleWrap. Below 2^24
+    // the texel coordinates are exact integers, and for power of two sizes the float wrap comes out
+    // as their low bits.
+    template <typename L>
+    inline void GetWrappedTexels(typename L::Float coord, uint32_t size, typename L::Int& i0, typename L::Int& i1, typename L::Float& frac) {
+        typedef typename L::Float Float;
+        const Float x = L::Select(L::IsNaN(coord), L::Set(0.f), L::Sub(L::Mul(coord, L::Set((float)size)), L::Set(0.5f)));
+        const Float x0f = L::Floor(x);
+        frac = L::Sub(x, x0f);
+
+        if((size & (size - 1)) != 0 || L::Any(L::GreaterEqual(L::Abs(x0f), L::Set(16777216.f)))) {
+            GetWrappedTexelsSlow<L>(x0f, size, i0, i1);
+            return;
+        }
+
+        const typename L::Int texel = L::ToInt(x0f);
+        const typename L::Int mask = L::SetInt(size - 1);
+        i0 = L::AndInt(texel, mask);
+        i1 = L::AndInt(L::AddInt(texel, L::SetInt(1)), mask);
+    }
+
+    // trilinear, wrapped, first N channels
+    template <typename L, size_t N>
+    void SampleVolumeLanes(const NoiseVolume& volume, const Vector3Lanes<L>& uvw, typename L::Float (&out)[N]) {
+        typedef typename L::Float Float;
+        typedef typename L::Int Int;
+        static_assert(N <= 4, "Texels have 4 channels.");
+
+        Int x0, x1, y0, y1, z0, z1;
+        Float fx, fy, fz;
+        GetWrappedTexels<L>(uvw.x, volume.width, x0, x1, fx);
+        GetWrappedTexels<L>(uvw.y, volume.height, y0, y1, fy);
+        GetWrappedTexels<L>(uvw.z, volume.depth, z0, z1, fz);
+
+        const Int width = L::SetInt(volume.width);
+        const Int sliceSize = L::SetInt(volume.width * volume.height);
+        TexelOffsets<L::Width> offsets;
+        L::StoreInt(offsets.base, L::AddInt(L::AddInt(L::MulInt(z0, sliceSize), L::MulInt(y0, width)), x0));
+        L::StoreInt(offsets.dx, L::SubInt(x1, x0));
+        L::StoreInt(offsets.dy, L::MulInt(L::SubInt(y1, y0), width));
+        L::StoreInt(offsets.dz, L::MulInt(L::SubInt(z1, z0), sliceSize));
+
+        Float wx[4], wy[4], wz[4];
+        L::SpreadLanes(fx, wx);
+        L::SpreadLanes(fy, wy);
+        L::SpreadLanes(fz, wz);
+
+        // The channels get filtered side by side like the scalar Sample does, only the result is transposed.
+        // A quarter of the lanes at a time, all corners of every lane wouldn't fit into registers.
+        Float filtered[4];
+        for(uint32_t k = 0; k < 4; k++) {
+            Float v[8];
+            L::template LoadCorners<3>(volume.texels.data(), offsets, k, v);
+            const Float front = LerpLanes<L>(LerpLanes<L>(v[0], v[1], wx[k]), LerpLanes<L>(v[2], v[3], wx[k]), wy[k]);
+            const Float back = LerpLanes<L>(LerpLanes<L>(v[4], v[5], wx[k]), LerpLanes<L>(v[6], v[7], wx[k]), wy[k]);
+            filtered[k] = LerpLanes<L>(front, back, wz[k]);
+        }
+
+        Float channels[4];
+        L::TransposeTexels(filtered, channels);
+        std::copy_n(channels, N, out);
+    }
+
+    // bilinear, wrapped, first N channels
+    template <typename L, size_t N>
+    void SampleImageLanes(const AtmosphereLUT& image, typename L::Float u, typename L::Float v, typename L::Float (&out)[N]) {
+        typedef typename L::Float Float;
+        typedef typename L::Int Int;
+        static_assert(N <= 4, "Texels have 4 channels.");
+
+        Int x0, x1, y0, y1;
+        Float fx, fy;
+        GetWrappedTexels<L>(u, image.width, x0, x1, fx);
+        GetWrappedTexels<L>(v, image.height, y0, y1, fy);
+
+        // a single channel is cheaper to gather float by float
+        if constexpr(N == 1) {
+            const Int rowSize = L::SetInt(image.width * 4);
+            const Int row0 = L::MulInt(y0, rowSize);
+            const Int row1 = L::MulInt(y1, rowSize);
+            const Int column0 = L::template ShiftLeftInt<2>(x0);
+            const Int column1 = L::template ShiftLeftInt<2>(x1);
+
+            const float* channel = &image.texels.data()->x;
+            const Float v00 = L::GatherFloats(channel, L::AddInt(row0, column0));
+            const Float v10 = L::GatherFloats(channel, L::AddInt(row0, column1));
+            const Float v01 = L::GatherFloats(channel, L::AddInt(row1, column0));
+            const Float v11 = L::GatherFloats(channel, L::AddInt(row1, column1));
+            out[0] = LerpLanes<L>(LerpLanes<L>(v00, v10, fx), LerpLanes<L>(v01, v11, fx), fy);
+            return;
+        }
+
+        const Int width = L::SetInt(image.width);
+        TexelOffsets<L::Width> offsets;
+        L::StoreInt(offsets.base, L::AddInt(L::MulInt(y0, width), x0));
+        L::StoreInt(offsets.dx, L::SubInt(x1, x0));
+        L::StoreInt(offsets.dy, L::MulInt(L::SubInt(y1, y0), width));
+
+        Float wx[4], wy[4];
+        L::SpreadLanes(fx, wx);
+        L::SpreadLanes(fy, wy);
+
+        // see SampleVolumeLanes
+        Float filtered[4];
+        for(uint32_t k = 0; k < 4; k++) {
+            Float corners[4];
+            L::template LoadCorners<2>(image.texels.data(), offsets, k, corners);
+            filtered[k] = LerpLanes<L>(LerpLanes<L>(corners[0], corners[1], wx[k]), LerpLanes<L>(corners[2], corners[3], wx[k]), wy[k]);
+        }
+
+        Float channels[4];
+        L::TransposeTexels(filtered, channels);
+        std::copy_n(channels, N, out);
+    }
+
+    template <typename L>
+    typename L::Float CloudLayerDensityLanes(typename L::Float relativeHeight, typename L::Float cloudType) {
+        typedef typename L::Float Float;
+        relativeHeight = StdClamp<L>(relativeHeight, 0.f, 1.f);
+
+        const Float zero = L::Set(0.f);
+        const Float cumulus = StdMax<L>(zero, L::Mul(RemapLanes<L>(relativeHeight, 0.f, 0.2f, 0.f, 1.f), RemapLanes<L>(relativeHeight, 0.7f, 0.9f, 1.f, 0.f)));
+        const Float stratocumulus = StdMax<L>(zero, L::Mul(RemapLanes<L>(relativeHeight, 0.f, 0.2f, 0.f, 1.f), RemapLanes<L>(relativeHeight, 0.2f, 0.7f, 1.f, 0.f)));
+        const Float stratus = StdMax<L>(zero, L::Mul(RemapLanes<L>(relativeHeight, 0.f, 0.1f, 0.f, 1.f), RemapLanes<L>(relativeHeight, 0.2f, 0.3f, 1.f, 0.f)));
+
+        const Float d1 = LerpLanes<L>(stratus, stratocumulus, StdClamp<L>(L::Mul(cloudType, L::Set(2.f)), 0.f, 1.f));
+        const Float d2 = LerpLanes<L>(stratocumulus, cumulus, StdClamp<L>(L::Mul(L::Sub(cloudType, L::Set(0.5f)), L::Set(2.f)), 0.f, 1.f));
+        return LerpLanes<L>(d1, d2, cloudType);
+    }
+
+    template <typename L>
+    typename L::Float HeightBiasCoverageLanes(typename L::Mask lanes, typename L::Float coverage, typename L::Float height, bool fastMath) {
+        const typename L::Float exponent = StdClamp<L>(RemapLanes<L>(height, 0.7f, 0.8f, 1.f, 0.8f), 0.8f, 1.f);
+
+        // pow(c, 1) is c, only the top of the layer pays for std::pow
+        const typename L::Mask needsPow = L::And(lanes, L::Not(L::GreaterEqual(exponent, L::Set(1.f))));
+        if(!L::Any(needsPow)) {
+            return coverage;
+        }
+
+        if(fastMath) {
+            // pow(0, e) is 0, coverage is never negative
+            const typename L::Mask positive = L::And(needsPow, L::Less(L::Set(0.f), coverage));
+            return L::Select(positive, FastExpLanes<L>(L::Mul(exponent, FastLogLanes<L>(coverage))), coverage);
+        }
+        return MapLanes<L>(needsPow, coverage, exponent, [](float c, float e) { return std::pow(c, e); });
+    }
+
+    // GetCloudDensityByPos for every lane in lanes (the others return 0), highQuality per lane
+    template <typename L>
+    typename L::Float GetCloudDensityByPosLanes(const CloudMarchContext& ctx, const Vector3Lanes<L>& pos,
+                                                typename L::Mask lanes, typename L::Mask highQuality) {
+        typedef typename L::Float Float;
+        typedef typename L::Mask Mask;
+        const CloudMarchParameters& params = ctx.params;
+
+        const Float r = L::Sqrt(L::Add(L::Add(L::Mul(pos.x, pos.x), L::Mul(pos.y, pos.y)), L::Mul(pos.z, pos.z)));
+        const Float innerShellRadius = L::Set(Rb + params.innerShellRadius);
+        const Float outerShellRadius = L::Set(Rb + params.outerShellRadius);
+        const Float heightFraction = L::Div(L::Sub(r, innerShellRadius), L::Sub(outerShellRadius, innerShellRadius));
+
+        const Mask outsideLayer = L::Or(L::Less(L::Set(1.f), heightFraction), L::Less(heightFraction, L::Set(0.f)));
+        const Mask inLayer = L::And(lanes, L::Not(outsideLayer));
+        if(!L::Any(inLayer)) {
+            return L::Set(0.f);
+        }
+
+        const Vector3Lanes<L> samplePos { pos.x, pos.y, L::Sub(pos.z, L::Set(Rb)) };
+
+        const Float weatherU = L::Div(L::Add(L::Add(samplePos.x, L::Set(150.f)), L::Set(params.weatherRadius.x / 2.f)), L::Set(params.weatherRadius.x));
+        const Float weatherV = L::Div(L::Add(samplePos.y, L::Set(params.weatherRadius.y / 2.f)), L::Set(params.weatherRadius.y));
+        Float weatherData[3];
+        SampleImageLanes<L>(*ctx.textures.weather, weatherU, weatherV, weatherData);
+
+        const Float modelScale = L::Set(params.modelNoiseScale);
+        Float noises[4];
+        SampleVolumeLanes<L>(*ctx.textures.modelNoise, { L::Mul(samplePos.x, modelScale), L::Mul(samplePos.y, modelScale), L::Mul(samplePos.z, modelScale) }, noises);
+
+        const Float lowFreqFBM = L::Add(L::Add(L::Mul(noises[1], L::Set(0.625f)), L::Mul(noises[2], L::Set(0.25f))), L::Mul(noises[3], L::Set(0.125f)));
+        Float baseCloud = RemapLanes<L>(noises[0], L::Sub(lowFreqFBM, L::Set(1.f)), L::Set(1.f), 0.f, 1.f);
+
+        baseCloud = L::Mul(baseCloud, CloudLayerDensityLanes<L>(heightFraction, weatherData[2]));
+
+        const Float cloudCoverage = HeightBiasCoverageLanes<L>(inLayer, StdMin<L>(L::Set(params.minWeatherCoverage), weatherData[0]), heightFraction,
+                                                                 ctx.fastMath);
+
+        const Float baseCloudWithCoverage = L::Mul(RemapLanes<L>(baseCloud, cloudCoverage, L::Set(1.f), 0.f, 1.f), cloudCoverage);
+
+        Float finalCloud = baseCloudWithCoverage;
+
+        const Mask highQualityLanes = L::And(inLayer, highQuality);
+        if(L::Any(highQualityLanes)) {
+            const Float highFreqScale = L::Set(params.highFreqScale);
+            Float highFreqNoises[3];
+            SampleVolumeLanes<L>(*ctx.textures.detailNoise, { L::Mul(samplePos.x, highFreqScale), L::Mul(samplePos.y, highFreqScale), L::Mul(samplePos.z, highFreqScale) }, highFreqNoises);
+
+            const Float highFreqFBM = L::Add(L::Add(L::Mul(highFreqNoises[0], L::Set(0.625f)), L::Mul(highFreqNoises[1], L::Set(0.25f))), L::Mul(highFreqNoises[2], L::Set(0.125f)));
+            const Float highFreqNoiseModifier = LerpLanes<L>(highFreqFBM, L::Sub(L::Set(1.f), highFreqFBM),
+                                                             StdClamp<L>(L::Mul(heightFraction, L::Set(params.highFreqHFScale)), 0.f, 1.f));
+
+            finalCloud = L::Select(highQualityLanes,
+                                   RemapLanes<L>(baseCloudWithCoverage, L::Mul(highFreqNoiseModifier, L::Set(params.highFreqModScale)), L::Set(1.f), 0.f, 1.f),
+                                   finalCloud);
+        }
+
+        return L::Select(inLayer, StdClamp<L>(finalCloud, 0.f, 1.f), L::Set(0.f));
+    }
+
+    // bits of the lanes in mask whose position the grid knows to be empty, and their empty distances
+    template <typename L>
+    uint32_t GetEmptyLanes(const CloudOccupancyGrid& grid, const Vector3Lanes<L>& pos, typename L::Mask mask, float* emptyDistances) {
+        alignas(64) float x[L::Width], y[L::Width], z[L::Width];
+        L::Store(x, pos.x);
+        L::Store(y, pos.y);
+        L::Store(z, pos.z);
+
+        const uint32_t bits = L::ToBits(mask);
+        uint32_t emptyBits = 0;
+        for(uint32_t i = 0; i < L::Width; i++) {
+            if((bits & (1u << i)) && grid.IsEmpty({ x[i], y[i], z[i] }, emptyDistances[i])) {
+                emptyBits |= 1u << i;
+            }
+        }
+        return emptyBits;
+    }
+
+    // CloudMarch for up to L::Width rays
+    template <typename L>
+    void CloudMarchPacket(const CloudMarchContext& ctx, const PrimaryRay* primaries, const CloudRay* rays, uint32_t numRays,
+                          Vector3f* outColors, float* outTransmittances) {
+        typedef typename L::Float Float;
+        typedef typename L::Mask Mask;
+        const CloudMarchParameters& params = ctx.params;
+
+        const Vector3Lanes<L> origin {
+            LoadLanes<L>(numRays, [&](uint32_t i) { return primaries[i].origin.x; }),
+            LoadLanes<L>(numRays, [&](uint32_t i) { return primaries[i].origin.y; }),
+            LoadLanes<L>(numRays, [&](uint32_t i) { return primaries[i].origin.z; })
+        };
+        const Vector3Lanes<L> dir {
+            LoadLanes<L>(numRays, [&](uint32_t i) { return primaries[i].dir.x; }),
+            LoadLanes<L>(numRays, [&](uint32_t i) { return primaries[i].dir.y; }),
+            LoadLanes<L>(numRays, [&](uint32_t i) { return primaries[i].dir.z; })
+        };
+        const Float maxT = LoadLanes<L>(numRays, [&](uint32_t i) { return rays[i].maxT; });
+        const Float stepSize = LoadLanes<L>(numRays, [&](uint32_t i) { return rays[i].stepSize; });
+        const Float miePhase = LoadLanes<L>(numRays, [&](uint32_t i) { return rays[i].miePhase; });
+        Float t = LoadLanes<L>(numRays, [&](uint32_t i) { return rays[i].t; });
+
+        uint32_t validBits = 0;
+        for(uint32_t i = 0; i < numRays; i++) {
+            validBits |= rays[i].radianceValid ? 1u << i : 0u;
+        }
+        Mask active = L::FromBits(validBits);
+
+        const Float extinction = L::Set(params.extinction);
+        const Float scattering = L::Set(params.extinction / 2.f);
+
+        const Vector3f lightDir = params.lightDir.Normal();
+        const Float lightLuminance = L::Set(Lerp(0.001f, 1.f, Saturate(lightDir.z)));
+
+        // the light samples sit at the same offsets from every sample position
+        const float lightSampleLength = params.beersScale.z;
+        const float lightDt = lightSampleLength / NumLightSamples;
+        Vector3f lightOffsets[(int)NumLightSamples];
+        {
+            float lightT = 0.f;
+            for(float j = 0.f; j < NumLightSamples; j += 1.f) {
+                const float newLightT = lightSampleLength * (j + 0.1f) / NumLightSamples;
+                lightT += std::abs(newLightT - lightT);
+                lightOffsets[(int)j] = lightT * (lightDir + RandomVectors[(int)j] * j);
+            }
+        }
+
+        const float numSamples = (float)params.numSamples;
+        const Float largeDtBase = L::Set(params.largeDtScale);
+        const Float blueNoiseScale = L::Set(params.beersScale.x);
+        const Float searchThreshold = L::Set((float)LargeDtThreshold);
+        const Mask noLanes = L::FromBits(0);
+
+        // per lane, leaps use up samples
+        Float sampleIndex = L::Set(0.f);
+        Float numDensityZero = L::Set(0.f);
+        Float transmittance = L::Set(1.f);
+        auto expLanes = [&ctx](Mask mask, Float v) {
+            if(ctx.fastMath) {
+                return FastExpLanes<L>(v);
+            }
+            return MapLanes<L>(mask, v, [](float x) { return std::exp(x); });
+        };
+
+        // The rays of a packet rarely all sit in a cloud at once, so contributing samples queue up and
+        // get their light march once a full vector of them is waiting. Every ray still adds up its
+        // radiance in sample order, the queue is first in, first out.
+        constexpr uint32_t QueueSize = 2 * (uint32_t)L::Width;
+        alignas(64) float queuedX[QueueSize], queuedY[QueueSize], queuedZ[QueueSize];
+        alignas(64) float queuedDensity[QueueSize], queuedSampleTransmittance[QueueSize], queuedTransmittance[QueueSize];
+        alignas(64) float queuedMiePhase[QueueSize];
+        uint32_t queuedRay[QueueSize];
+        uint32_t numQueued = 0;
+
+        Vector3f radiance[L::Width] = {};
+
+        // the light march of the first count queued samples, the compressed pushes need Width - 1 spare slots
+        auto marchQueuedLights = [&](uint32_t count) {
+            const Mask lanes = L::FromBits((1u << count) - 1u);
+            const Vector3Lanes<L> samplePos { L::Load(queuedX), L::Load(queuedY), L::Load(queuedZ) };
+
+            Float lightDensity = L::Set(0.f);
+            for(int j = 0; j < (int)NumLightSamples; j++) {
+                const Vector3Lanes<L> lightSamplePos {
+                    L::Add(samplePos.x, L::Set(lightOffsets[j].x)),
+                    L::Add(samplePos.y, L::Set(lightOffsets[j].y)),
+                    L::Add(samplePos.z, L::Set(lightOffsets[j].z))
+                };
+
+                Mask lightEvaluated = lanes;
+                if(ctx.occupancyGrid) {
+                    alignas(64) float emptyDistances[L::Width];
+                    const uint32_t emptyBits = GetEmptyLanes<L>(*ctx.occupancyGrid, lightSamplePos, lanes, emptyDistances);
+                    ctx.counters.numSkippedLightSamples += std::popcount(emptyBits);
+                    lightEvaluated = L::And(lanes, L::Not(L::FromBits(emptyBits)));
+                }
+                ctx.counters.numLightSamples += std::popcount(L::ToBits(lightEvaluated));
+
+                lightDensity = L::Add(lightDensity, GetCloudDensityByPosLanes<L>(ctx, lightSamplePos, lightEvaluated, j < 3 ? lightEvaluated : noLanes));
+            }
+
+            // Beer-powder
+            const Float cd = L::Mul(L::Mul(lightDensity, L::Set(lightDt)), extinction);
+            const Float beers = StdMax<L>(expLanes(lanes, L::Mul(L::Set(-1.f), cd)),
+                                          L::Mul(L::Set(0.7f), expLanes(lanes, L::Mul(L::Set(-1.f * 0.25f), cd))));
+            const Float powShug = L::Mul(L::Set(2.f), L::Sub(L::Set(1.f), expLanes(lanes, L::Mul(L::Mul(L::Set(-1.f), cd), L::Set(2.f)))));
+            const Float lightTransmittance = L::Mul(beers, powShug);
+
+            const Float sunLight = L::Mul(L::Mul(lightLuminance, L::Mul(lightTransmittance, L::Load(queuedMiePhase))), scattering);
+
+            const Float density = L::Load(queuedDensity);
+            const Float sampleTransmittance = L::Load(queuedSampleTransmittance);
+            const Float transmittance = L::Load(queuedTransmittance);
+
+            alignas(64) float r[L::Width], g[L::Width], b[L::Width];
+            auto contribution = [&](float* out, Float sky) {
+                const Float curL = L::Mul(L::Add(sky, sunLight), density);
+                const Float intS = L::Sub(curL, L::Mul(curL, sampleTransmittance));
+                L::Store(out, L::Mul(intS, transmittance));
+            };
+            contribution(r, L::Set(ctx.skyColor.x));
+            contribution(g, L::Set(ctx.skyColor.y));
+            contribution(b, L::Set(ctx.skyColor.z));
+
+            for(uint32_t i = 0; i < count; i++) {
+                Vector3f& rayRadiance = radiance[queuedRay[i]];
+                rayRadiance = { rayRadiance.x + r[i], rayRadiance.y + g[i], rayRadiance.z + b[i] };
+            }
+
+            numQueued -= count;
+            for(float* queue : { queuedX, queuedY, queuedZ, queuedDensity, queuedSampleTransmittance, queuedTransmittance, queuedMiePhase }) {
+                std::copy_n(queue + count, numQueued, queue);
+            }
+            std::copy_n(queuedRay + count, numQueued, queuedRay);
+        };
+
+        while(true) {
+            active = L::And(active, L::Less(sampleIndex, L::Set(numSamples)));
+            if(!L::Any(active)) {
+                break;
+            }
+            sampleIndex = L::Select(active, L::Add(sampleIndex, L::Set(1.f)), sampleIndex);
+
+            const Mask isSearching = L::Less(searchThreshold, numDensityZero);
+
+            Float blueRand = L::Set(0.f);
+            if(params.useBlueNoise) {
+                const Float u = L::Mul(L::Add(origin.x, L::Mul(t, dir.x)), blueNoiseScale);
+                const Float v = L::Mul(L::Add(origin.y, L::Mul(t, dir.y)), blueNoiseScale);
+                Float blue[1];
+                SampleImageLanes<L>(*ctx.textures.blueNoise, u, v, blue);
+                blueRand = blue[0];
+            }
+
+            const Float largeDt = L::Add(largeDtBase, L::Mul(largeDtBase, blueRand));
+            const Float smallDt = L::Add(stepSize, L::Mul(stepSize, blueRand));
+            const Float dt = L::Select(isSearching, largeDt, smallDt);
+            t = L::Select(active, L::Add(t, dt), t);
+
+            const Mask reachedEnd = L::Less(maxT, t);
+            const Mask opaque = L::Less(transmittance, L::Set(.01f));
+            transmittance = L::Select(L::And(active, opaque), L::Set(0.f), transmittance);
+            active = L::And(active, L::Not(L::Or(reachedEnd, opaque)));
+            if(!L::Any(active)) {
+                break;
+            }
+
+            const Vector3Lanes<L> samplePos {
+                L::Add(origin.x, L::Mul(t, dir.x)),
+                L::Add(origin.y, L::Mul(t, dir.y)),
+                L::Add(origin.z, L::Mul(t, dir.z))
+            };
+
+            Mask evaluated = active;
+            if(ctx.occupancyGrid) {
+                alignas(64) float emptyDistances[L::Width];
+                const uint32_t emptyBits = GetEmptyLanes<L>(*ctx.occupancyGrid, samplePos, active, emptyDistances);
+                ctx.counters.numSkippedSamples += std::popcount(emptyBits);
+
+                if(emptyBits && ctx.leapEmptySpace) {
+                    // same leaps as CloudMarch, lane by lane
+                    alignas(64) float ts[L::Width], maxTs[L::Width], smallDts[L::Width], largeDts[L::Width];
+                    alignas(64) float zeros[L::Width], sampleIndices[L::Width], leapTs[L::Width], numLeapedSteps[L::Width];
+                    L::Store(ts, t);
+                    L::Store(maxTs, maxT);
+                    L::Store(smallDts, smallDt);
+                    L::Store(largeDts, largeDt);
+                    L::Store(zeros, numDensityZero);
+                    L::Store(sampleIndices, sampleIndex);
+                    for(uint32_t lane = 0; lane < L::Width; lane++) {
+                        leapTs[lane] = ts[lane];
+                        numLeapedSteps[lane] = 0.f;
+                        if(emptyBits & (1u << lane)) {
+                            numLeapedSteps[lane] = GetNumLeapedSteps(ts[lane], maxTs[lane], emptyDistances[lane], smallDts[lane], largeDts[lane],
+                                                                     zeros[lane], numSamples - sampleIndices[lane], leapTs[lane]);
+                            ctx.counters.numLeapedSamples += (uint64_t)numLeapedSteps[lane];
+                        }
+                    }
+
+                    const Float leaps = L::Load(numLeapedSteps);
+                    t = L::Load(leapTs);
+                    sampleIndex = L::Add(sampleIndex, leaps);
+                    numDensityZero = L::Add(numDensityZero, leaps);
+                }
+
+                evaluated = L::And(active, L::Not(L::FromBits(emptyBits)));
+            }
+            ctx.counters.numSamples += std::popcount(L::ToBits(evaluated));
+
+            const Float density = GetCloudDensityByPosLanes<L>(ctx, samplePos, evaluated, L::Not(isSearching));
+
+            // density <= x as x >= density, so NaN densities count as non-empty like in the scalar march
+            const Mask nearlyEmpty = L::And(active, L::GreaterEqual(L::Set(0.01f), density));
+            numDensityZero = L::Select(nearlyEmpty, L::Add(numDensityZero, L::Set(1.f)), numDensityZero);
+
+            const Mask hit = L::And(active, L::Not(L::GreaterEqual(L::Set(0.f), density)));
+            numDensityZero = L::Select(hit, L::Set(0.f), numDensityZero);
+
+            // large steps that ran into a cloud step back
+            t = L::Select(L::And(hit, isSearching), L::Sub(t, dt), t);
+
+            const Mask contributing = L::And(hit, L::Not(isSearching));
+            if(!L::Any(contributing)) {
+                continue;
+            }
+
+            const Float sampleTransmittance = expLanes(contributing, L::Mul(L::Set(-1.f), L::Mul(L::Mul(extinction, density), dt)));
+
+            L::CompressStore(queuedX + numQueued, contributing, samplePos.x);
+            L::CompressStore(queuedY + numQueued, contributing, samplePos.y);
+            L::CompressStore(queuedZ + numQueued, contributing, samplePos.z);
+            L::CompressStore(queuedDensity + numQueued, contributing, density);
+            L::CompressStore(queuedSampleTransmittance + numQueued, contributing, sampleTransmittance);
+            L::CompressStore(queuedTransmittance + numQueued, contributing, transmittance);
+            L::CompressStore(queuedMiePhase + numQueued, contributing, miePhase);
+            L::CompressLaneNumbers(queuedRay + numQueued, contributing);
+            numQueued += std::popcount(L::ToBits(contributing));
+
+            transmittance = L::Select(contributing, L::Mul(transmittance, sampleTransmittance), transmittance);
+
+            if(numQueued >= L::Width) {
+                marchQueuedLights((uint32_t)L::Width);
+            }
+        }
+
+        while(numQueued > 0) {
+            marchQueuedLights(std::min(numQueued, (uint32_t)L::Width));
+        }
+
+        alignas(64) float a[L::Width];
+        L::Store(a, transmittance);
+        for(uint32_t i = 0; i < numRays; i++) {
+            outColors[i] = radiance[i];
+            outTransmittances[i] = a[i];
+        }
+    }
+
+    // ResolvePixel's tone map with fast math, black (and below) stays black
+    template <typename L>
+    typename L::Float ToneMapLanes(typename L::Float c) {
+        const typename L::Float x = L::Sub(L::Set(1.f), FastExpLanes<L>(L::Mul(L::Mul(L::Set(-1.f), c), L::Set(3.f))));
+        const typename L::Float toneMapped = FastExpLanes<L>(L::Mul(FastLogLanes<L>(x), L::Set(1.f / 2.2f)));
+        return L::Select(L::Less(L::Set(0.f), x), toneMapped, L::Set(0.f));
+    }
+
+    // pixels [x0, x1) of row y, L::Width at a time
+    template <typename L>
+    void ShadeRowPackets(const CloudMarchContext& ctx, uint32_t y, uint32_t x0, uint32_t x1, const CloudMarchView& view, AtmosphereLUT& image) {
+        const CloudMarchParameters& params = ctx.params;
+
+        for(uint32_t x = x0; x < x1; x += (uint32_t)L::Width) {
+            const uint32_t numRays = std::min((uint32_t)L::Width, x1 - x);
+
+            PrimaryRay primaries[L::Width];
+            CloudRay rays[L::Width];
+            for(uint32_t i = 0; i < numRays; i++) {
+                primaries[i] = GetPrimaryRay(x + i, y, view, params, ctx.textures);
+                rays[i] = SetupCloudRay(ctx, primaries[i].origin, primaries[i].dir, primaries[i].rayOffset);
+            }
+
+            Vector3f colors[L::Width];
+            float transmittances[L::Width];
+            CloudMarchPacket<L>(ctx, primaries, rays, numRays, colors, transmittances);
+
+            if(!ctx.fastMath) {
+                for(uint32_t i = 0; i < numRays; i++) {
+                    image.At(x + i, y) = ResolvePixel(params, colors[i], transmittances[i]);
+                }
+                continue;
+            }
+
+            alignas(64) float r[L::Width], g[L::Width], b[L::Width];
+            L::Store(r, ToneMapLanes<L>(LoadLanes<L>(numRays, [&](uint32_t i) { return colors[i].x; })));
+            L::Store(g, ToneMapLanes<L>(LoadLanes<L>(numRays, [&](uint32_t i) { return colors[i].y; })));
+            L::Store(b, ToneMapLanes<L>(LoadLanes<L>(numRays, [&](uint32_t i) { return colors[i].z; })));
+            for(uint32_t i = 0; i < numRays; i++) {
+                image.At(x + i, y) = { r[i], g[i], b[i], ResolveAlpha(params, transmittances[i]) };
+            }
+        }
+    }
+#endif
+}
+
+CloudImageComparison CompareCloudImages(const AtmosphereLUT& reference, const AtmosphereLUT& image, float tolerance) {
+    assert(reference.width == image.width && reference.height == image.height && "Images have to be the same size.");
+
+    CloudImageComparison comparison;
+    comparison.numPixels = reference.GetNumTexels();
+
+    double sumSquaredError = 0.0;
+    for(size_t i = 0; i < comparison.numPixels; i++) {
+        const float a[4] = { reference.texels[i].x, reference.texels[i].y, reference.texels[i].z, reference.texels[i].w };
+        const float b[4] = { image.texels[i].x, image.texels[i].y, image.texels[i].z, image.texels[i].w };
+
+        bool overTolerance = false;
+        for(int c = 0; c < 4; c++) {
+            // NaN only matches NaN
+            float error;
+            if(std::isnan(a[c]) || std::isnan(b[c])) {
+                error = std::isnan(a[c]) && std::isnan(b[c]) ? 0.f : std::numeric_limits<float>::infinity();
+            }
+            else {
+                error = std::abs(a[c] - b[c]);
+            }
+
+            comparison.maxAbsError = std::max(comparison.maxAbsError, error);
+            sumSquaredError += (double)error * error;
+            overTolerance |= error > tolerance;
+        }
+
+        if(overTolerance) {
+            comparison.numPixelsOverTolerance++;
+        }
+    }
+
+    if(comparison.numPixels > 0) {
+        comparison.rmse = (float)std::sqrt(sumSquaredError / (comparison.numPixels * 4));
+    }
+
+    return comparison;
+}
+
+CloudRaymarcher::CloudRaymarcher(uint32_t numThreads)
+    : simdLevel_(noise::GetSimdLevel()), occupancyGrid_(nullptr), leapEmptySpace_(false), fastMath_(false),
+      scheduler_(std::make_shared<WorkStealingScheduler>(numThreads)) {
+    scheduler_->Start();
+}
+
+Vector4f CloudRaymarcher::ShadePixel(uint32_t x, uint32_t y, const CloudMarchView& view, const CloudMarchParameters& params,
+                                     const CloudMarchTextures& textures) const {
+    assert((!occupancyGrid_ || occupancyGrid_->IsBuiltFor(params, textures)) && "The occupancy grid was built for other parameters.");
+
+    MarchCounters counters;
+    const CloudMarchContext ctx { params, textures, occupancyGrid_, leapEmptySpace_, fastMath_, GetSkyColor(view, params, textures), counters };
+    return ::ShadePixel(ctx, x, y, view);
+}
+
+float CloudRaymarcher::GetDensity(const Vector3f& pos, const CloudMarchParameters& params, const CloudMarchTextures& textures,
+                                  bool highQuality) const {
+    MarchCounters counters;
+    const CloudMarchContext ctx { params, textures, nullptr, false, false, Vector3f(), counters };
+    return GetCloudDensityByPos(ctx, pos, highQuality);
+}
+
+AtmosphereLUT CloudRaymarcher::Render(const CloudMarchView& view, const CloudMarchParameters& params, const CloudMarchTextures& textures) {
+    assert(textures.modelNoise && textures.detailNoise && textures.weather && textures.skyView && "Missing cloud texture.");
+    assert((textures.blueNoise || !params.useBlueNoise) && "Blue noise is enabled but not bound.");
+    assert((!occupancyGrid_ || occupancyGrid_->IsBuiltFor(params, textures)) && "The occupancy grid was built for other parameters.");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    AtmosphereLUT image(view.screenSize.x, view.screenSize.y);
+
+    const uint32_t numTilesX = (image.width + TileSize - 1) / TileSize;
+    const uint32_t numTilesY = (image.height + TileSize - 1) / TileSize;
+    const uint32_t numTiles = numTilesX * numTilesY;
+
+    // how long a tile takes depends a lot on how much cloud it sees, small tiles keep the threads busy
+    const uint32_t numThreads = std::min<uint32_t>(scheduler_->GetNumThreads(), std::max(numTiles, 1u));
+
+    // packets need gathers, below AVX2 rays are marched one at a time
+    noise::SimdLevel simdLevel = noise::SimdLevel::Scalar;
+#if defined(NINMATH_NOISE_SIMD_AVX512)
+    if(simdLevel_ == noise::SimdLevel::AVX512) {
+        simdLevel = noise::SimdLevel::AVX512;
+    }
+#endif
+#if defined(NINMATH_NOISE_SIMD_AVX2)
+    if(simdLevel_ == noise::SimdLevel::AVX2) {
+        simdLevel = noise::SimdLevel::AVX2;
+    }
+#endif
+
+    std::vector<MarchCounters> threadCounters(numThreads);
+    const Vector3f skyColor = GetSkyColor(view, params, textures);
+
+    auto shadeRow = [&](const CloudMarchContext& ctx, uint32_t y, uint32_t x0, uint32_t x1) {
+        switch(simdLevel) {
+#if defined(NINMATH_NOISE_SIMD_AVX512)
+        case noise::SimdLevel::AVX512:
+            ShadeRowPackets<PacketLanesAVX512>(ctx, y, x0, x1, view, image);
+            return;
+#endif
+#if defined(NINMATH_NOISE_SIMD_AVX2)
+        case noise::SimdLevel::AVX2:
+            ShadeRowPackets<PacketLanesAVX2>(ctx, y, x0, x1, view, image);
+            return;
+#endif
+        default:
+            for(uint32_t x = x0; x < x1; x++) {
+                image.At(x, y) = ::ShadePixel(ctx, x, y, view);
+            }
+            return;
+        }
+    };
+
+    // one context per thread, for its counters
+    std::vector<CloudMarchContext> contexts;
+    contexts.reserve(numThreads);
+    for(uint32_t i = 0; i < numThreads; i++) {
+        contexts.push_back(CloudMarchContext { params, textures, occupancyGrid_, leapEmptySpace_, fastMath_, skyColor, threadCounters[i] });
+    }
+
+    scheduler_->ParallelFor(numTiles, numThreads, [&](uint32_t tile, uint32_t slot) {
+        const uint32_t x0 = (tile % numTilesX) * TileSize;
+        const uint32_t y0 = (tile / numTilesX) * TileSize;
+        const uint32_t x1 = std::min(x0 + TileSize, image.width);
+        const uint32_t y1 = std::min(y0 + TileSize, image.height);
+
+        for(uint32_t y = y0; y < y1; y++) {
+            shadeRow(contexts[slot], y, x0, x1);
+        }
+    });
+
+    lastRenderStats_ = RenderStats {
+        .seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+        .numThreads = numThreads,
+        .simdLevel = simdLevel,
+        .fastMath = fastMath_ && simdLevel != noise::SimdLevel::Scalar,
+        .numTiles = numTiles,
+        .numPixels = image.GetNumTexels()
+    };
+
+    for(const MarchCounters& counters : threadCounters) {
+        lastRenderStats_.numSamples += counters.numSamples;
+        lastRenderStats_.numSkippedSamples += counters.numSkippedSamples;
+        lastRenderStats_.numLeapedSamples += counters.numLeapedSamples;
+        lastRenderStats_.numLightSamples += counters.numLightSamples;
+        lastRenderStats_.numSkippedLightSamples += counters.numSkippedLightSamples;
+    }
+
+    std::cout << "Raymarched " << image.width << "x" << image.height << " clouds in "
+              << lastRenderStats_.seconds * 1000.0 << "ms (" << numThreads << " threads, " << numTiles << " tiles, "
+              << noise::SimdLevelToString(simdLevel) << (lastRenderStats_.fastMath ? ", fast math" : "") << ")" << std::endl;
+
+    if(occupancyGrid_) {
+        const RenderStats& stats = lastRenderStats_;
+        const uint64_t numSaved = stats.numSkippedSamples + stats.numLeapedSamples + stats.numSkippedLightSamples;
+        const uint64_t numTotal = numSaved + stats.numSamples + stats.numLightSamples;
+        std::cout << "Empty space skipping: " << stats.numSkippedSamples << " view samples skipped, " << stats.numLeapedSamples
+                  << " leaped over, " << stats.numSkippedLightSamples << " light samples skipped ("
+                  << (numTotal > 0 ? 100.0 * numSaved / numTotal : 0.0) << "% of the density evaluations saved)" << std::endl;
+    }
+
+    return image;
+}
@@ -0,0 +1,162 @@
+#ifndef CLOUDSCAPES_CLOUD_RAYMARCHER_H_
+#define CLOUDSCAPES_CLOUD_RAYMARCHER_H_
+
+#include <cstdint>
+#include <memory>
+#include "atmosphere_lut_baker.h"
+#include "noise_volume.h"
+#include "ninmath/ninmath.h"
+#include "ninmath/noise_simd.h"
+
+struct CloudOccupancyGrid;
+class WorkStealingScheduler;
+
+// ground radius the cloud shader hardcodes, in km
+constexpr float CloudGroundRadius = 6360.f;
+
+// same layout as CloudParameters in raymarch_clouds_cs.hlsl
+struct CloudMarchParameters {
+    ninmath::Vector3f lightColor;
+    float phaseG;
+
+    float modelNoiseScale;
+    float cloudCoverage;
+    float highFreqScale;
+    float highFreqModScale;
+
+    float highFreqHFScale;
+    float largeDtScale;
+    float extinction;
+    int numSamples;
+
+    ninmath::Vector4f beersScale;
+
+    ninmath::Vector2f weatherRadius;
+    float minWeatherCoverage;
+    int useBlueNoise;
+
+    int fixedDt;
+    ninmath::Vector3f pad0;
+
+    int useAlpha;
+    ninmath::Vector3f windDir;
+
+    float windSpeed;
+    ninmath::Vector3f pad1;
+
+    ninmath::Vector4f lodThresholds;
+
+    float innerShellRadius;
+    float outerShellRadius;
+    ninmath::Vector2f pad2;
+
+    ninmath::Vector3f lightDir; // posToLight
+    float pad3;
+};
+
+// the parts of RenderContext (common/render_common.hlsl) the cloud shader reads
+struct CloudMarchView {
+    ninmath::Matrix4x4f invProjectionMat;
+    ninmath::Matrix4x4f invViewMat;
+    ninmath::Vector2u screenSize;
+    ninmath::Vector3f cameraPos; // in km, above the ground
+};
+
+// Textures bound to the cloud shader. 2D ones use the AtmosphereLUT layout,
+// everything is sampled like the shader's linear wrap sampler.
+struct CloudMarchTextures {
+    const NoiseVolume* modelNoise = nullptr;  // mip 0, GetCloudDensityByPos never picks another one
+    const NoiseVolume* detailNoise = nullptr;
+    const AtmosphereLUT* blueNoise = nullptr;
+    const AtmosphereLUT* weather = nullptr;
+    const AtmosphereLUT* skyView = nullptr;
+};
+
+struct CloudImageComparison {
+    float maxAbsError = 0.f;
+    float rmse = 0.f;
+    size_t numPixelsOverTolerance = 0;
+    size_t numPixels = 0;
+};
+
+// per channel error between two images of the same size
+CloudImageComparison CompareCloudImages(const AtmosphereLUT& reference, const AtmosphereLUT& image, float tolerance);
+
+//
+// CPU port of the cloud pass (raymarch_clouds_cs.hlsl): CloudMarch, GetCloudDensityByPos,
+// CloudLayerDensity and the Beer-powder light march with its 6 cone samples, same step logic,
+// same tone mapping. Kept close to the HLSL so a frame can be compared pixel for pixel
+// against a GPU capture without a device.
+//
+// The shader only updates one pixel out of every 4x4 block per frame and reprojects the rest,
+// this renders every pixel, i.e. the converged image of a static scene.
+// Screen tiles are handed out to the worker threads one at a time (WorkStealingScheduler::ParallelFor). With AVX2/AVX-512 every
+// tile row is marched as packets of 8/16 neighbouring rays (one per lane), which come out
+// bit-identical to ShadePixel; other levels march one ray at a time. Fast math trades that for
+// vector exp/log in the packets and their tone map, a few ulp off per call (pixels move by ~1e-7).
+//
+// With an occupancy grid (cloud_occupancy_grid.h), samples in empty cells aren't evaluated, which
+// doesn't change the image. Leaping also jumps over as many steps as fit into the empty space
+// around the sample, those count against numSamples like the steps they replace. The image then
+// differs a little, since the blue noise jitter of the skipped steps is gone.
+//
+class CloudRaymarcher {
+public:
+    struct RenderStats {
+        double seconds = 0.0;
+        uint32_t numThreads = 0;
+        ninmath::noise::SimdLevel simdLevel = ninmath::noise::SimdLevel::Scalar; // Scalar when rays were marched one at a time
+        bool fastMath = false; // only packets use it
+        uint32_t numTiles = 0;
+        size_t numPixels = 0;
+
+        // view ray samples: density evaluated, known empty from the grid, leaped over
+        uint64_t numSamples = 0;
+        uint64_t numSkippedSamples = 0;
+        uint64_t numLeapedSamples = 0;
+
+        // light march samples: density evaluated, known empty from the grid
+        uint64_t numLightSamples = 0;
+        uint64_t numSkippedLightSamples = 0;
+    };
+
+    static constexpr uint32_t TileSize = 16;
+
+    // numThreads == 0 uses every hardware thread
+    CloudRaymarcher(uint32_t numThreads = 0);
+
+    // screenSize.x by screenSize.y float4 image, row 0 is the top of the screen like the render target
+    AtmosphereLUT Render(const CloudMarchView& view, const CloudMarchParameters& params, const CloudMarchTextures& textures);
+
+    // what the shader returns for a single pixel
+    ninmath::Vector4f ShadePixel(uint32_t x, uint32_t y, const CloudMarchView& view, const CloudMarchParameters& params,
+                                 const CloudMarchTextures& textures) const;
+
+    // GetCloudDensityByPos at pos (in km, from the planet's center), i.e. what a view ray sample
+    // (highQuality) or a far light sample sees there
+    float GetDensity(const ninmath::Vector3f& pos, const CloudMarchParameters& params, const CloudMarchTextures& textures,
+                     bool highQuality = true) const;
+
+    void SetSimdLevel(ninmath::noise::SimdLevel level) { simdLevel_ = level; }
+
+    // off by default, the packets then no longer match ShadePixel bit for bit
+    void SetFastMath(bool fastMath) { fastMath_ = fastMath; }
+
+    // nullptr turns empty-space skipping off, the grid has to outlive the renders using it
+    void SetEmptySpaceSkipping(const CloudOccupancyGrid* occupancyGrid, bool leap = true) {
+        occupancyGrid_ = occupancyGrid;
+        leapEmptySpace_ = leap;
+    }
+
+    const RenderStats& GetLastRenderStats() const { return lastRenderStats_; }
+
+private:
+    ninmath::noise::SimdLevel simdLevel_;
+    const CloudOccupancyGrid* occupancyGrid_;
+    bool leapEmptySpace_;
+    bool fastMath_;
+    std::shared_ptr<WorkStealingScheduler> scheduler_;
+    RenderStats lastRenderStats_;
+};
+
+#endif // CLOUDSCAPES_CLOUD_RAYMARCHER_H_
@@ -0,0 +1,62 @@
+#include "lut_recompute_tracker.h"
+
+#include <cassert>
+
+uint32_t LUTRecomputeTracker::AddLUT(std::string name, std::vector<uint32_t> dependencies) {
+    const uint32_t index = (uint32_t)luts_.size();
+    for(const uint32_t dependency : dependencies) {
+        assert(dependency < index && "Dependencies have to be added first.");
+    }
+
+    LUT lut;
+    lut.name = std::move(name);
+    lut.dependencyVersions.resize(dependencies.size(), 0);
+    lut.dependencies = std::move(dependencies);
+    luts_.push_back(std::move(lut));
+
+    return index;
+}
+
+bool LUTRecomputeTracker::IsOutOfDate(uint32_t index, uint64_t inputsHash) const {
+    const LUT& lut = luts_[index];
+    if(!lut.isValid || lut.inputsHash != inputsHash) {
+        return true;
+    }
+
+    for(size_t i = 0; i < lut.dependencies.size(); i++) {
+        if(luts_[lut.dependencies[i]].version != lut.dependencyVersions[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool LUTRecomputeTracker::Update(uint32_t index, uint64_t inputsHash, const std::function<bool()>& recompute) {
+    if(!IsOutOfDate(index, inputsHash)) {
+        luts_[index].stats.numSkips++;
+        return false;
+    }
+
+    // reading a LUT that was never written, wait for it
+    for(const uint32_t dependency : luts_[index].dependencies) {
+        if(!luts_[dependency].isValid) {
+            return false;
+        }
+    }
+
+    if(!recompute()) {
+        return false;
+    }
+
+    LUT& lut = luts_[index];
+    lut.isValid = true;
+    lut.inputsHash = inputsHash;
+    lut.version++;
+    for(size_t i = 0; i < lut.dependencies.size(); i++) {
+        lut.dependencyVersions[i] = luts_[lut.dependencies[i]].version;
+    }
+    lut.stats.numRecomputes++;
+
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef CLOUDSCAPES_LUT_RECOMPUTE_TRACKER_H_
+#define CLOUDSCAPES_LUT_RECOMPUTE_TRACKER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+//
+// Decides which precomputed LUT passes actually have to run in a frame.
+//
+// Every LUT is keyed by a hash of its own inputs (constants, the state generation of the pipeline
+// writing it, ...). It's recomputed when that hash changed, or when a LUT it reads was recomputed
+// since, so a change ripples down a chain like transmittance -> multiscattering -> skyview.
+// LUTs have to be updated in dependency order every frame.
+//
+// A recompute that couldn't run (e.g. its pipeline is still compiling) isn't recorded, it's
+// simply tried again the next frame. Neither is anything depending on a LUT that was never written.
+//
+class LUTRecomputeTracker {
+public:
+    struct LUTStats {
+        uint64_t numRecomputes = 0;
+        uint64_t numSkips = 0;
+    };
+
+    // dependencies have to be added before the LUTs reading them
+    uint32_t AddLUT(std::string name, std::vector<uint32_t> dependencies = {});
+
+    // Runs recompute if the LUT is out of date. recompute returns whether the work was
+    // actually done (recorded, dispatched, ...). Returns true if it was.
+    bool Update(uint32_t lut, uint64_t inputsHash, const std::function<bool()>& recompute);
+
+    bool IsOutOfDate(uint32_t lut, uint64_t inputsHash) const;
+
+    // forces a recompute on the next Update(), e.g. when the LUT's memory was lost
+    void Invalidate(uint32_t lut) { luts_[lut].isValid = false; }
+
+    const std::string& GetName(uint32_t lut) const { return luts_[lut].name; }
+    const LUTStats& GetStats(uint32_t lut) const { return luts_[lut].stats; }
+    uint32_t GetNumLUTs() const { return (uint32_t)luts_.size(); }
+
+private:
+    struct LUT {
+        std::string name;
+        std::vector<uint32_t> dependencies;
+
+        bool isValid = false;
+        uint64_t inputsHash = 0;
+
+        // bumped on every recompute, dependents remember the versions they were computed from
+        uint64_t version = 0;
+        std::vector<uint64_t> dependencyVersions;
+
+        LUTStats stats;
+    };
+
+    std::vector<LUT> luts_;
+};
+
+#endif // CLOUDSCAPES_LUT_RECOMPUTE_TRACKER_H_
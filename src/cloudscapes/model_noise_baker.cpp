@@ -0,0 +1,88 @@
+#include "model_noise_baker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "multithreading/work_stealing_scheduler.h"
+
+using namespace ninmath::noise;
+
+ModelNoiseBaker::ModelNoiseBaker(const ModelNoiseParameters& params, uint32_t numThreads)
+    : params_(params), simdLevel_(GetSimdLevel()), scheduler_(std::make_shared<WorkStealingScheduler>(numThreads)), cancelFlag_(nullptr) {
+    scheduler_->Start();
+}
+
+NoiseVolume ModelNoiseBaker::Bake(uint32_t resolution) {
+    NoiseVolume volume(resolution, resolution, resolution);
+    Bake(volume, NoiseVolumeType::Model);
+    return volume;
+}
+
+NoiseVolume ModelNoiseBaker::BakeDetail(uint32_t resolution) {
+    NoiseVolume volume(resolution, resolution, resolution);
+    Bake(volume, NoiseVolumeType::Detail);
+    return volume;
+}
+
+bool ModelNoiseBaker::Bake(NoiseVolume& volume, NoiseVolumeType type) {
+    const auto start = std::chrono::steady_clock::now();
+
+    // slices are small enough that handing them out one by one balances well,
+    // and big enough that the atomic never shows up
+    const uint32_t numThreads = std::min<uint32_t>(scheduler_->GetNumThreads(), std::max(volume.depth, 1u));
+
+    std::vector<std::vector<float>> coords(numThreads, std::vector<float>(3 * (size_t)volume.width));
+    std::vector<std::vector<float>> scratch(numThreads, std::vector<float>(ModelNoiseScratchPerElement * (size_t)volume.width));
+
+    scheduler_->ParallelFor(volume.depth, numThreads, [&](uint32_t z, uint32_t slot) {
+        if(!IsCancelled()) {
+            BakeSlice(volume, type, z, coords[slot], scratch[slot]);
+        }
+    });
+
+    if(IsCancelled()) {
+        std::cout << "Cancelled the " << (type == NoiseVolumeType::Model ? "model" : "detail") << " noise bake" << std::endl;
+        return false;
+    }
+
+    lastBakeStats_ = BakeStats {
+        .seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+        .numThreads = numThreads,
+        .simdLevel = simdLevel_,
+        .numTexels = volume.GetNumTexels()
+    };
+
+    std::cout << "Baked " << volume.width << "x" << volume.height << "x" << volume.depth
+              << (type == NoiseVolumeType::Model ? " model" : " detail") << " noise in " << lastBakeStats_.seconds << "s ("
+              << (double)lastBakeStats_.numTexels / lastBakeStats_.seconds / 1e6 << " Mtexels/s, "
+              << numThreads << " threads, " << SimdLevelToString(simdLevel_) << ")" << std::endl;
+    return true;
+}
+
+void ModelNoiseBaker::BakeSlice(NoiseVolume& volume, NoiseVolumeType type, uint32_t z, std::vector<float>& coords, std::vector<float>& scratch) const {
+    const uint32_t width = volume.width;
+    float* xs = coords.data();
+    float* ys = xs + width;
+    float* zs = ys + width;
+
+    // same texel -> noise space mapping as the shader: float3(Cell) * (1/128)
+    const float cz = (float)z * params_.coordScale;
+    for(uint32_t x = 0; x < width; x++) {
+        xs[x] = (float)x * params_.coordScale;
+        zs[x] = cz;
+    }
+
+    for(uint32_t y = 0; y < volume.height; y++) {
+        const float cy = (float)y * params_.coordScale;
+        for(uint32_t x = 0; x < width; x++) {
+            ys[x] = cy;
+        }
+
+        if(type == NoiseVolumeType::Model) {
+            ModelNoiseN(xs, ys, zs, &volume.At(0, y, z), width, params_, scratch.data(), simdLevel_);
+        }
+        else {
+            DetailNoiseN(xs, ys, zs, &volume.At(0, y, z), width, params_, scratch.data(), simdLevel_);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef CLOUDSCAPES_MODEL_NOISE_BAKER_H_
+#define CLOUDSCAPES_MODEL_NOISE_BAKER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "noise_volume.h"
+#include "ninmath/noise.h"
+#include "ninmath/noise_simd.h"
+
+class WorkStealingScheduler;
+
+//
+// Bakes the cloud model noise (compute_model_noise_cs.hlsl) and detail
+// noise (compute_detail_noise_cs.hlsl) on the CPU.
+// Depth slices are handed out to the worker threads one at a time (WorkStealingScheduler::ParallelFor), every
+// slice is evaluated row by row with the batch noise kernels.
+// Doesn't touch D3D, so it can run on machines without a GPU.
+//
+// A bake can be cancelled through SetCancelFlag(...): the workers check the
+// flag before every slice, so a cancelled bake returns after at most one slice
+// per thread and leaves the rest of the volume unfilled.
+//
+class ModelNoiseBaker {
+public:
+    struct BakeStats {
+        double seconds = 0.0;
+        uint32_t numThreads = 0;
+        ninmath::noise::SimdLevel simdLevel = ninmath::noise::SimdLevel::Scalar;
+        size_t numTexels = 0;
+    };
+
+    // numThreads == 0 uses every hardware thread
+    ModelNoiseBaker(const ninmath::noise::ModelNoiseParameters& params = {}, uint32_t numThreads = 0);
+
+    // cubic volume with the same layout the compute shader writes
+    NoiseVolume Bake(uint32_t resolution);
+
+    // fills an already sized volume, returns false if the bake got cancelled
+    bool Bake(NoiseVolume& volume, NoiseVolumeType type = NoiseVolumeType::Model);
+
+    NoiseVolume BakeDetail(uint32_t resolution);
+
+    void SetSimdLevel(ninmath::noise::SimdLevel level) { simdLevel_ = level; }
+
+    // the flag has to outlive every bake, nullptr disables cancellation
+    void SetCancelFlag(const std::atomic_bool* cancelFlag) { cancelFlag_ = cancelFlag; }
+    bool IsCancelled() const { return cancelFlag_ && cancelFlag_->load(std::memory_order_relaxed); }
+
+    const ninmath::noise::ModelNoiseParameters& GetParameters() const { return params_; }
+    const BakeStats& GetLastBakeStats() const { return lastBakeStats_; }
+
+private:
+    void BakeSlice(NoiseVolume& volume, NoiseVolumeType type, uint32_t z, std::vector<float>& coords, std::vector<float>& scratch) const;
+
+    ninmath::noise::ModelNoiseParameters params_;
+    ninmath::noise::SimdLevel simdLevel_;
+    std::shared_ptr<WorkStealingScheduler> scheduler_;
+    const std::atomic_bool* cancelFlag_;
+    BakeStats lastBakeStats_;
+};
+
+#endif // CLOUDSCAPES_MODEL_NOISE_BAKER_H_
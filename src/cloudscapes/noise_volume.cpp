@@ -0,0 +1,112 @@
+#include "noise_volume.h"
+
+#include <algorithm>
+#include <cmath>
+
+using ninmath::Vector3f;
+using ninmath::Vector4f;
+
+namespace {
+    // index on the source axis the shader centers the 2x2x2 footprint on, and the
+    // direction (+1/-1) of the neighbour it pairs it with
+    void ResolveSourceIndex(uint32_t dstCell, uint32_t dstSize, uint32_t srcSize, uint32_t& outIndex, int& outDelta) {
+        if(srcSize < 4) {
+            // too small for the shader's [1, size - 2] remap, plain 2x box filter
+            outIndex = std::min(dstCell * 2, srcSize - 1);
+            outDelta = outIndex + 1 < srcSize ? 1 : 0;
+            return;
+        }
+
+        const float p = (float)dstCell * (1.f / (float)dstSize);
+        const uint32_t startInd = 1;
+        const uint32_t endInd = srcSize - 2;
+
+        outIndex = (uint32_t)((float)startInd + p * (float)(endInd - startInd));
+        outDelta = (float)outIndex < (float)dstSize / 2.f ? 1 : -1;
+    }
+}
+
+Vector4f NoiseVolume::Sample(const Vector3f& uvw) const {
+    // texel centers are at (i + 0.5) / size; NaN coordinates end up at texel 0
+    const float x = std::isnan(uvw.x) ? 0.f : uvw.x * width - 0.5f;
+    const float y = std::isnan(uvw.y) ? 0.f : uvw.y * height - 0.5f;
+    const float z = std::isnan(uvw.z) ? 0.f : uvw.z * depth - 0.5f;
+
+    const float x0f = std::floor(x);
+    const float y0f = std::floor(y);
+    const float z0f = std::floor(z);
+    const float fx = x - x0f;
+    const float fy = y - y0f;
+    const float fz = z - z0f;
+
+    auto wrap = [](float v, uint32_t size) {
+        const float wrapped = v - (float)size * std::floor(v / (float)size);
+        return std::min((uint32_t)wrapped, size - 1);
+    };
+    const uint32_t x0 = wrap(x0f, width);
+    const uint32_t x1 = wrap(x0f + 1, width);
+    const uint32_t y0 = wrap(y0f, height);
+    const uint32_t y1 = wrap(y0f + 1, height);
+    const uint32_t z0 = wrap(z0f, depth);
+    const uint32_t z1 = wrap(z0f + 1, depth);
+
+    auto lerp4 = [](const Vector4f& a, const Vector4f& b, float t) {
+        return Vector4f(ninmath::Lerp(a.x, b.x, t), ninmath::Lerp(a.y, b.y, t), ninmath::Lerp(a.z, b.z, t), ninmath::Lerp(a.w, b.w, t));
+    };
+
+    const Vector4f front = lerp4(lerp4(At(x0, y0, z0), At(x1, y0, z0), fx), lerp4(At(x0, y1, z0), At(x1, y1, z0), fx), fy);
+    const Vector4f back = lerp4(lerp4(At(x0, y0, z1), At(x1, y0, z1), fx), lerp4(At(x0, y1, z1), At(x1, y1, z1), fx), fy);
+    return lerp4(front, back, fz);
+}
+
+NoiseVolume DownsampleNoiseVolume(const NoiseVolume& src) {
+    NoiseVolume dst(std::max(src.width / 2, 1u), std::max(src.height / 2, 1u), std::max(src.depth / 2, 1u));
+
+    for(uint32_t z = 0; z < dst.depth; z++) {
+        uint32_t sz;
+        int dz;
+        ResolveSourceIndex(z, dst.depth, src.depth, sz, dz);
+
+        for(uint32_t y = 0; y < dst.height; y++) {
+            uint32_t sy;
+            int dy;
+            ResolveSourceIndex(y, dst.height, src.height, sy, dy);
+
+            for(uint32_t x = 0; x < dst.width; x++) {
+                uint32_t sx;
+                int dx;
+                ResolveSourceIndex(x, dst.width, src.width, sx, dx);
+
+                // same summation order as the shader's cells[0..7]
+                const uint32_t xs[2] = { sx, sx + dx };
+                const uint32_t ys[2] = { sy, sy + dy };
+                const uint32_t zs[2] = { sz, sz + dz };
+
+                Vector4f sum;
+                for(int i = 0; i < 8; i++) {
+                    const Vector4f& v = src.At(xs[(i >> 2) & 1], ys[i & 1], zs[(i >> 1) & 1]);
+                    sum.x += v.x;
+                    sum.y += v.y;
+                    sum.z += v.z;
+                    sum.w += v.w;
+                }
+
+                dst.At(x, y, z) = Vector4f(sum.x / 8.f, sum.y / 8.f, sum.z / 8.f, sum.w / 8.f);
+            }
+        }
+    }
+
+    return dst;
+}
+
+std::vector<NoiseVolume> GenerateNoiseVolumeMipChain(NoiseVolume mip0, uint32_t numMips) {
+    std::vector<NoiseVolume> mips;
+    mips.reserve(numMips);
+    mips.push_back(std::move(mip0));
+
+    for(uint32_t i = 1; i < numMips; i++) {
+        mips.push_back(DownsampleNoiseVolume(mips.back()));
+    }
+
+    return mips;
+}
@@ -0,0 +1,54 @@
+#ifndef CLOUDSCAPES_NOISE_VOLUME_H_
+#define CLOUDSCAPES_NOISE_VOLUME_H_
+
+#include <cstdint>
+#include <vector>
+#include "ninmath/ninmath.h"
+
+// which of the cloud noise volumes a buffer holds
+enum class NoiseVolumeType : uint32_t {
+    Model,  // compute_model_noise_cs.hlsl
+    Detail, // compute_detail_noise_cs.hlsl
+
+    NumNoiseVolumeTypes
+};
+
+//
+// CPU side float4 3D buffer, laid out like a Texture3D subresource:
+// x is the fastest moving index, then rows (y), then depth slices (z).
+//
+struct NoiseVolume {
+    NoiseVolume() = default;
+
+    NoiseVolume(uint32_t width, uint32_t height, uint32_t depth)
+        : width(width), height(height), depth(depth),
+          texels((size_t)width * height * depth) {}
+
+    size_t GetNumTexels() const { return texels.size(); }
+    size_t GetRowPitch() const { return (size_t)width * sizeof(ninmath::Vector4f); }
+    size_t GetSlicePitch() const { return GetRowPitch() * height; }
+
+    size_t GetIndex(uint32_t x, uint32_t y, uint32_t z) const {
+        return ((size_t)z * height + y) * width + x;
+    }
+
+    ninmath::Vector4f& At(uint32_t x, uint32_t y, uint32_t z) { return texels[GetIndex(x, y, z)]; }
+    const ninmath::Vector4f& At(uint32_t x, uint32_t y, uint32_t z) const { return texels[GetIndex(x, y, z)]; }
+
+    // trilinear with wrapped addressing, what the cloud shaders' linear wrap sampler does on this mip
+    ninmath::Vector4f Sample(const ninmath::Vector3f& uvw) const;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t depth = 0;
+    std::vector<ninmath::Vector4f> texels;
+};
+
+// Next mip level, same filter as texture_3d_mip_maps_cs.hlsl: every destination texel
+// averages 8 source texels around its position, picked towards the volume's center.
+NoiseVolume DownsampleNoiseVolume(const NoiseVolume& src);
+
+// mip 0 followed by numMips - 1 downsampled levels
+std::vector<NoiseVolume> GenerateNoiseVolumeMipChain(NoiseVolume mip0, uint32_t numMips);
+
+#endif // CLOUDSCAPES_NOISE_VOLUME_H_
@@ -0,0 +1,240 @@
+#include "noise_volume_cache.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "serialization.h"
+#include "ninmath/hash.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using ninmath::noise::ModelNoiseParameters;
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::filesystem::path& path) {
+    Close();
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_ = file;
+    mapping_ = mapping;
+    data_ = data;
+    size_ = (uint64_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::Close() {
+    if(data_) {
+        UnmapViewOfFile(data_);
+    }
+    if(mapping_) {
+        CloseHandle(mapping_);
+    }
+    if(file_) {
+        CloseHandle(file_);
+    }
+
+    file_ = nullptr;
+    mapping_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+}
+#else
+bool MappedFile::Open(const std::filesystem::path& path) {
+    Close();
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    close(fd);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+
+    data_ = data;
+    size_ = (uint64_t)st.st_size;
+    return true;
+}
+
+void MappedFile::Close() {
+    if(data_) {
+        munmap(data_, (size_t)size_);
+    }
+
+    data_ = nullptr;
+    size_ = 0;
+}
+#endif
+
+uint64_t ComputeNoiseVolumeKey(NoiseVolumeType type, const ModelNoiseParameters& params, uint32_t resolution, uint32_t numMips, NoiseVolumeFormat format) {
+    ninmath::hash::Hasher hasher;
+    hasher.Add(NoiseVolumeFileVersion)
+          .Add(type)
+          .Add(format)
+          .Add(resolution)
+          .Add(numMips)
+          .Add(params.coordScale)
+          .Add(params.cellCount)
+          .Add(params.perlinSeed)
+          .Add(params.perlinWorleyFreqMults)
+          .Add(params.perlinWorleyWeights)
+          .Add(params.worleyFBMWeights)
+          .Add(params.worleyFBM2Weights);
+    return hasher.Get();
+}
+
+NoiseVolumeCache::NoiseVolumeCache(std::filesystem::path directory)
+    : directory_(std::move(directory)) {}
+
+std::filesystem::path NoiseVolumeCache::GetFilePath(uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".noisevol";
+    return directory_ / name.str();
+}
+
+std::shared_ptr<MappedNoiseVolume> NoiseVolumeCache::Load(uint64_t key) const {
+    std::shared_ptr<MappedNoiseVolume> volume = std::make_shared<MappedNoiseVolume>();
+    if(!volume->file_.Open(GetFilePath(key))) {
+        return nullptr;
+    }
+
+    const uint64_t fileSize = volume->file_.GetSize();
+    if(fileSize < sizeof(NoiseVolumeFileHeader)) {
+        return nullptr;
+    }
+
+    const NoiseVolumeFileHeader* header = reinterpret_cast<const NoiseVolumeFileHeader*>(volume->file_.GetData());
+    if(header->magic != NoiseVolumeFileMagic ||
+       header->version != NoiseVolumeFileVersion ||
+       header->key != key ||
+       header->format >= NoiseVolumeFormat::NumNoiseVolumeFormats ||
+       header->numMips == 0 ||
+       header->numMips > NoiseVolumeFileMaxMips) {
+        std::cout << "Ignoring stale noise volume cache entry " << GetFilePath(key).string() << std::endl;
+        return nullptr;
+    }
+
+    for(uint32_t i = 0; i < header->numMips; i++) {
+        const NoiseVolumeMipInfo& mip = header->mips[i];
+        const uint64_t expectedSize = GetNoiseVolumeSize(header->format, mip.width, mip.height, mip.depth);
+        if(mip.size != expectedSize || mip.offset > fileSize || mip.size > fileSize - mip.offset) {
+            std::cout << "Ignoring corrupt noise volume cache entry " << GetFilePath(key).string() << std::endl;
+            return nullptr;
+        }
+    }
+
+    volume->header_ = header;
+    return volume;
+}
+
+bool NoiseVolumeCache::Store(uint64_t key, NoiseVolumeType type, const std::vector<NoiseVolume>& mips) const {
+    std::vector<EncodedNoiseVolume> encodedMips;
+    encodedMips.reserve(mips.size());
+    for(const NoiseVolume& mip : mips) {
+        encodedMips.push_back(EncodeNoiseVolume(mip, NoiseVolumeFormat::RGBA32F));
+    }
+    return Store(key, type, encodedMips);
+}
+
+bool NoiseVolumeCache::Store(uint64_t key, NoiseVolumeType type, const std::vector<EncodedNoiseVolume>& mips) const {
+    if(mips.empty() || mips.size() > NoiseVolumeFileMaxMips) {
+        return false;
+    }
+
+    // every mip has to share the file's format
+    for(const EncodedNoiseVolume& mip : mips) {
+        if(mip.format != mips[0].format) {
+            return false;
+        }
+    }
+
+    NoiseVolumeFileHeader header = {};
+    header.magic = NoiseVolumeFileMagic;
+    header.version = NoiseVolumeFileVersion;
+    header.key = key;
+    header.type = type;
+    header.format = mips[0].format;
+    header.numMips = (uint32_t)mips.size();
+
+    const uint64_t A = NoiseVolumeFileDataAlignment;
+    uint64_t offset = sizeof(NoiseVolumeFileHeader);
+    for(uint32_t i = 0; i < header.numMips; i++) {
+        offset = (offset + (A - 1)) / A * A;
+
+        NoiseVolumeMipInfo& info = header.mips[i];
+        info.width = mips[i].width;
+        info.height = mips[i].height;
+        info.depth = mips[i].depth;
+        info.offset = offset;
+        info.size = mips[i].data.size();
+
+        offset += info.size;
+    }
+
+    const std::filesystem::path path = GetFilePath(key);
+    const bool written = serialization::WriteFileAtomically(path, [&](std::ostream& out) {
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        uint64_t writtenSize = sizeof(header);
+        const char zeros[NoiseVolumeFileDataAlignment] = {};
+        for(uint32_t i = 0; i < header.numMips; i++) {
+            out.write(zeros, (std::streamsize)(header.mips[i].offset - writtenSize));
+            out.write(reinterpret_cast<const char*>(mips[i].data.data()), (std::streamsize)header.mips[i].size);
+            writtenSize = header.mips[i].offset + header.mips[i].size;
+        }
+    });
+    if(!written) {
+        return false;
+    }
+
+    std::cout << "Stored noise volume cache entry " << path.string() << " (" << offset / 1024 << " KiB)" << std::endl;
+    return true;
+}
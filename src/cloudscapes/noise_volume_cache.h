@@ -0,0 +1,116 @@
+#ifndef CLOUDSCAPES_NOISE_VOLUME_CACHE_H_
+#define CLOUDSCAPES_NOISE_VOLUME_CACHE_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+#include "noise_volume.h"
+#include "noise_volume_format.h"
+#include "ninmath/noise.h"
+
+//
+// Read only memory mapping of a whole file. Pages are only faulted in once
+// they're touched, so opening a big cache file is close to free.
+//
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    bool IsOpen() const { return data_ != nullptr; }
+    const uint8_t* GetData() const { return static_cast<const uint8_t*>(data_); }
+    uint64_t GetSize() const { return size_; }
+
+private:
+    // native handles are kept opaque so this header doesn't pull in windows.h
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+    void* data_ = nullptr;
+    uint64_t size_ = 0;
+};
+
+//
+// On-disk layout (little endian):
+//   NoiseVolumeFileHeader
+//   mip data, every mip starting on a NoiseVolumeFileDataAlignment boundary,
+//   tightly packed like EncodedNoiseVolume (no row/slice padding)
+//
+inline constexpr uint32_t NoiseVolumeFileMagic = 0x564e5343; // "CSNV"
+inline constexpr uint32_t NoiseVolumeFileVersion = 2;
+inline constexpr uint32_t NoiseVolumeFileMaxMips = 16;
+inline constexpr uint64_t NoiseVolumeFileDataAlignment = 4096;
+
+struct NoiseVolumeMipInfo {
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    uint32_t pad0;
+    uint64_t offset; // from the start of the file
+    uint64_t size;   // in bytes
+};
+
+struct NoiseVolumeFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    NoiseVolumeType type;
+    NoiseVolumeFormat format;
+    uint32_t numMips;
+    uint32_t pad0;
+    NoiseVolumeMipInfo mips[NoiseVolumeFileMaxMips];
+};
+
+// Everything that changes the generated texels goes into the key, a cache file
+// built with different parameters is never picked up.
+uint64_t ComputeNoiseVolumeKey(NoiseVolumeType type,
+                               const ninmath::noise::ModelNoiseParameters& params,
+                               uint32_t resolution,
+                               uint32_t numMips,
+                               NoiseVolumeFormat format = NoiseVolumeFormat::RGBA32F);
+
+//
+// A validated cache file, mip data points straight into the mapping.
+//
+class MappedNoiseVolume {
+public:
+    uint32_t GetNumMips() const { return header_->numMips; }
+    NoiseVolumeType GetType() const { return header_->type; }
+    NoiseVolumeFormat GetFormat() const { return header_->format; }
+    const NoiseVolumeMipInfo& GetMipInfo(uint32_t mip) const { return header_->mips[mip]; }
+    const void* GetMipData(uint32_t mip) const { return file_.GetData() + header_->mips[mip].offset; }
+
+private:
+    friend class NoiseVolumeCache;
+
+    MappedFile file_;
+    const NoiseVolumeFileHeader* header_ = nullptr;
+};
+
+//
+// Directory of baked noise volumes, one file per key.
+//
+class NoiseVolumeCache {
+public:
+    NoiseVolumeCache(std::filesystem::path directory);
+
+    // nullptr on a miss, or if the file is stale/corrupt
+    std::shared_ptr<MappedNoiseVolume> Load(uint64_t key) const;
+
+    // writes to a temporary file first, so a crash never leaves a half written entry behind
+    bool Store(uint64_t key, NoiseVolumeType type, const std::vector<EncodedNoiseVolume>& mips) const;
+    bool Store(uint64_t key, NoiseVolumeType type, const std::vector<NoiseVolume>& mips) const;
+
+    std::filesystem::path GetFilePath(uint64_t key) const;
+
+private:
+    std::filesystem::path directory_;
+};
+
+#endif // CLOUDSCAPES_NOISE_VOLUME_CACHE_H_
@@ -0,0 +1,394 @@
+#include "noise_volume_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+using ninmath::Vector4f;
+
+namespace {
+    const uint32_t BC4BlockSize = 4;
+    const uint32_t BC4BlockBytes = 8;
+
+    float GetChannel(const Vector4f& v, uint32_t c) {
+        return (&v.x)[c];
+    }
+
+    float& GetChannel(Vector4f& v, uint32_t c) {
+        return (&v.x)[c];
+    }
+
+    uint8_t FloatToUnorm8(float value) {
+        return (uint8_t)std::lround(std::clamp(value, 0.f, 1.f) * 255.f);
+    }
+
+    // BC4_UNORM palette, both the 8 and the 6 interpolated values modes
+    void GetBC4Palette(uint8_t red0, uint8_t red1, float outPalette[8]) {
+        const float r0 = (float)red0 / 255.f;
+        const float r1 = (float)red1 / 255.f;
+        outPalette[0] = r0;
+        outPalette[1] = r1;
+
+        if(red0 > red1) {
+            for(uint32_t i = 2; i < 8; i++) {
+                outPalette[i] = ((float)(8 - i) * r0 + (float)(i - 1) * r1) / 7.f;
+            }
+        }
+        else {
+            for(uint32_t i = 2; i < 6; i++) {
+                outPalette[i] = ((float)(6 - i) * r0 + (float)(i - 1) * r1) / 5.f;
+            }
+            outPalette[6] = 0.f;
+            outPalette[7] = 1.f;
+        }
+    }
+
+    // 4x4 block of values in [0, 1] -> 8 bytes
+    void EncodeBC4Block(const float values[16], uint8_t* outBlock) {
+        float minVal = values[0];
+        float maxVal = values[0];
+        for(uint32_t i = 1; i < 16; i++) {
+            minVal = std::min(minVal, values[i]);
+            maxVal = std::max(maxVal, values[i]);
+        }
+
+        const uint8_t red0 = FloatToUnorm8(maxVal);
+        const uint8_t red1 = FloatToUnorm8(minVal);
+
+        float palette[8];
+        GetBC4Palette(red0, red1, palette);
+
+        uint64_t indices = 0;
+        for(uint32_t i = 0; i < 16; i++) {
+            uint32_t best = 0;
+            float bestError = std::abs(values[i] - palette[0]);
+            for(uint32_t p = 1; p < 8; p++) {
+                const float error = std::abs(values[i] - palette[p]);
+                if(error < bestError) {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+
+        outBlock[0] = red0;
+        outBlock[1] = red1;
+        for(uint32_t i = 0; i < 6; i++) {
+            outBlock[2 + i] = (uint8_t)(indices >> (8 * i));
+        }
+    }
+
+    void DecodeBC4Block(const uint8_t* block, float outValues[16]) {
+        float palette[8];
+        GetBC4Palette(block[0], block[1], palette);
+
+        uint64_t indices = 0;
+        for(uint32_t i = 0; i < 6; i++) {
+            indices |= (uint64_t)block[2 + i] << (8 * i);
+        }
+
+        for(uint32_t i = 0; i < 16; i++) {
+            outValues[i] = palette[(indices >> (3 * i)) & 7];
+        }
+    }
+
+    void EncodeBC4Planes(const NoiseVolume& volume, uint8_t* dst) {
+        const uint32_t blocksX = (volume.width + BC4BlockSize - 1) / BC4BlockSize;
+        const uint32_t blocksY = (volume.height + BC4BlockSize - 1) / BC4BlockSize;
+        const uint64_t planeSize = GetNoiseVolumePlaneSize(NoiseVolumeFormat::BC4Planes, volume.width, volume.height, volume.depth);
+
+        for(uint32_t c = 0; c < 4; c++) {
+            uint8_t* block = dst + c * planeSize;
+            for(uint32_t z = 0; z < volume.depth; z++) {
+                for(uint32_t by = 0; by < blocksY; by++) {
+                    for(uint32_t bx = 0; bx < blocksX; bx++) {
+                        // mips smaller than a block repeat their edge texels
+                        float values[16];
+                        for(uint32_t i = 0; i < 16; i++) {
+                            const uint32_t x = std::min(bx * BC4BlockSize + (i & 3), volume.width - 1);
+                            const uint32_t y = std::min(by * BC4BlockSize + (i >> 2), volume.height - 1);
+                            values[i] = GetChannel(volume.At(x, y, z), c);
+                        }
+
+                        EncodeBC4Block(values, block);
+                        block += BC4BlockBytes;
+                    }
+                }
+            }
+        }
+    }
+
+    void DecodeBC4Planes(NoiseVolume& volume, const uint8_t* src) {
+        const uint32_t blocksX = (volume.width + BC4BlockSize - 1) / BC4BlockSize;
+        const uint32_t blocksY = (volume.height + BC4BlockSize - 1) / BC4BlockSize;
+        const uint64_t planeSize = GetNoiseVolumePlaneSize(NoiseVolumeFormat::BC4Planes, volume.width, volume.height, volume.depth);
+
+        for(uint32_t c = 0; c < 4; c++) {
+            const uint8_t* block = src + c * planeSize;
+            for(uint32_t z = 0; z < volume.depth; z++) {
+                for(uint32_t by = 0; by < blocksY; by++) {
+                    for(uint32_t bx = 0; bx < blocksX; bx++) {
+                        float values[16];
+                        DecodeBC4Block(block, values);
+                        block += BC4BlockBytes;
+
+                        for(uint32_t i = 0; i < 16; i++) {
+                            const uint32_t x = bx * BC4BlockSize + (i & 3);
+                            const uint32_t y = by * BC4BlockSize + (i >> 2);
+                            if(x < volume.width && y < volume.height) {
+                                GetChannel(volume.At(x, y, z), c) = values[i];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t absBits = bits & 0x7fffffff;
+
+    // inf/nan
+    if(absBits >= 0x7f800000) {
+        return (uint16_t)(sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0));
+    }
+
+    // too large even before rounding
+    if(absBits >= 0x47800000) {
+        return (uint16_t)(sign | 0x7c00);
+    }
+
+    // half denormals (and zero)
+    if(absBits < 0x38800000) {
+        if(absBits < 0x33000000) {
+            return (uint16_t)sign;
+        }
+
+        const uint32_t exponent = absBits >> 23;
+        const uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+        const uint32_t shift = 126 - exponent;
+
+        uint32_t half = mantissa >> shift;
+        const uint32_t rem = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if(rem > halfway || (rem == halfway && (half & 1))) {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    // rebias the exponent (127 -> 15), a rounding carry into the exponent is still correct
+    uint32_t half = (absBits - 0x38000000) >> 13;
+    const uint32_t rem = absBits & 0x1fff;
+    if(rem > 0x1000 || (rem == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return (uint16_t)(sign | half);
+}
+
+float HalfToFloat(uint16_t half) {
+    const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+
+    uint32_t bits;
+    if(exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if(exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if(mantissa != 0) {
+        // denormal, normalize it
+        uint32_t e = 113;
+        while(!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            e--;
+        }
+        bits = sign | (e << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    else {
+        bits = sign;
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+const char* NoiseVolumeFormatToString(NoiseVolumeFormat format) {
+    switch(format) {
+    case NoiseVolumeFormat::RGBA32F:
+        return "RGBA32F";
+    case NoiseVolumeFormat::RGBA16F:
+        return "RGBA16F";
+    case NoiseVolumeFormat::RGBA8:
+        return "RGBA8";
+    case NoiseVolumeFormat::BC4Planes:
+        return "BC4Planes";
+    default:
+        return "Unknown";
+    }
+}
+
+uint32_t GetNoiseVolumeFormatNumPlanes(NoiseVolumeFormat format) {
+    return format == NoiseVolumeFormat::BC4Planes ? 4 : 1;
+}
+
+uint64_t GetNoiseVolumeRowPitch(NoiseVolumeFormat format, uint32_t width) {
+    switch(format) {
+    case NoiseVolumeFormat::RGBA32F:
+        return (uint64_t)width * 16;
+    case NoiseVolumeFormat::RGBA16F:
+        return (uint64_t)width * 8;
+    case NoiseVolumeFormat::RGBA8:
+        return (uint64_t)width * 4;
+    case NoiseVolumeFormat::BC4Planes:
+        return (uint64_t)((width + BC4BlockSize - 1) / BC4BlockSize) * BC4BlockBytes;
+    default:
+        return 0;
+    }
+}
+
+uint32_t GetNoiseVolumeNumRows(NoiseVolumeFormat format, uint32_t height) {
+    if(format == NoiseVolumeFormat::BC4Planes) {
+        return (height + BC4BlockSize - 1) / BC4BlockSize;
+    }
+    return height;
+}
+
+uint64_t GetNoiseVolumePlaneSize(NoiseVolumeFormat format, uint32_t width, uint32_t height, uint32_t depth) {
+    return GetNoiseVolumeRowPitch(format, width) * GetNoiseVolumeNumRows(format, height) * depth;
+}
+
+uint64_t GetNoiseVolumeSize(NoiseVolumeFormat format, uint32_t width, uint32_t height, uint32_t depth) {
+    return GetNoiseVolumePlaneSize(format, width, height, depth) * GetNoiseVolumeFormatNumPlanes(format);
+}
+
+EncodedNoiseVolume EncodeNoiseVolume(const NoiseVolume& volume, NoiseVolumeFormat format) {
+    EncodedNoiseVolume encoded;
+    encoded.format = format;
+    encoded.width = volume.width;
+    encoded.height = volume.height;
+    encoded.depth = volume.depth;
+    encoded.data.resize(GetNoiseVolumeSize(format, volume.width, volume.height, volume.depth));
+
+    const size_t numTexels = volume.GetNumTexels();
+
+    switch(format) {
+    case NoiseVolumeFormat::RGBA32F:
+        memcpy(encoded.data.data(), volume.texels.data(), encoded.data.size());
+        break;
+    case NoiseVolumeFormat::RGBA16F: {
+        uint16_t* dst = reinterpret_cast<uint16_t*>(encoded.data.data());
+        for(size_t i = 0; i < numTexels; i++) {
+            for(uint32_t c = 0; c < 4; c++) {
+                dst[4 * i + c] = FloatToHalf(GetChannel(volume.texels[i], c));
+            }
+        }
+        break;
+    }
+    case NoiseVolumeFormat::RGBA8: {
+        uint8_t* dst = encoded.data.data();
+        for(size_t i = 0; i < numTexels; i++) {
+            for(uint32_t c = 0; c < 4; c++) {
+                dst[4 * i + c] = FloatToUnorm8(GetChannel(volume.texels[i], c));
+            }
+        }
+        break;
+    }
+    case NoiseVolumeFormat::BC4Planes:
+        EncodeBC4Planes(volume, encoded.data.data());
+        break;
+    default:
+        break;
+    }
+
+    return encoded;
+}
+
+NoiseVolume DecodeNoiseVolume(NoiseVolumeFormat format, uint32_t width, uint32_t height, uint32_t depth, const void* data) {
+    NoiseVolume volume(width, height, depth);
+    const size_t numTexels = volume.GetNumTexels();
+
+    switch(format) {
+    case NoiseVolumeFormat::RGBA32F:
+        memcpy(volume.texels.data(), data, numTexels * sizeof(Vector4f));
+        break;
+    case NoiseVolumeFormat::RGBA16F: {
+        const uint16_t* src = static_cast<const uint16_t*>(data);
+        for(size_t i = 0; i < numTexels; i++) {
+            for(uint32_t c = 0; c < 4; c++) {
+                GetChannel(volume.texels[i], c) = HalfToFloat(src[4 * i + c]);
+            }
+        }
+        break;
+    }
+    case NoiseVolumeFormat::RGBA8: {
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        for(size_t i = 0; i < numTexels; i++) {
+            for(uint32_t c = 0; c < 4; c++) {
+                GetChannel(volume.texels[i], c) = (float)src[4 * i + c] / 255.f;
+            }
+        }
+        break;
+    }
+    case NoiseVolumeFormat::BC4Planes:
+        DecodeBC4Planes(volume, static_cast<const uint8_t*>(data));
+        break;
+    default:
+        break;
+    }
+
+    return volume;
+}
+
+NoiseVolume DecodeNoiseVolume(const EncodedNoiseVolume& encoded) {
+    return DecodeNoiseVolume(encoded.format, encoded.width, encoded.height, encoded.depth, encoded.data.data());
+}
+
+NoiseVolumeQualityReport MeasureNoiseVolumeQuality(const NoiseVolume& reference, const EncodedNoiseVolume& encoded) {
+    const NoiseVolume decoded = DecodeNoiseVolume(encoded);
+    const size_t numTexels = reference.GetNumTexels();
+
+    NoiseVolumeQualityReport report = {};
+    report.format = encoded.format;
+
+    double sumSquared[4] = {};
+    for(size_t i = 0; i < numTexels; i++) {
+        for(uint32_t c = 0; c < 4; c++) {
+            const float error = std::abs(GetChannel(decoded.texels[i], c) - GetChannel(reference.texels[i], c));
+            report.maxError[c] = std::max(report.maxError[c], error);
+            sumSquared[c] += (double)error * error;
+        }
+    }
+
+    double sumSquaredAll = 0.0;
+    for(uint32_t c = 0; c < 4; c++) {
+        report.rmsError[c] = numTexels > 0 ? (float)std::sqrt(sumSquared[c] / (double)numTexels) : 0.f;
+        report.maxErrorAll = std::max(report.maxErrorAll, report.maxError[c]);
+        sumSquaredAll += sumSquared[c];
+    }
+    report.rmsErrorAll = numTexels > 0 ? (float)std::sqrt(sumSquaredAll / (4.0 * (double)numTexels)) : 0.f;
+
+    report.sizeInBytes = encoded.data.size();
+    report.compressionRatio = report.sizeInBytes > 0 ? (float)((double)(numTexels * sizeof(Vector4f)) / (double)report.sizeInBytes) : 0.f;
+
+    return report;
+}
+
+void PrintNoiseVolumeQualityReport(const NoiseVolumeQualityReport& report) {
+    std::cout << std::left << std::setw(8) << NoiseVolumeFormatToString(report.format) << std::right
+              << " size " << report.sizeInBytes / 1024 << " KiB (" << report.compressionRatio << "x smaller)"
+              << ", max error " << report.maxErrorAll << ", rms error " << report.rmsErrorAll
+              << " [r " << report.rmsError[0] << ", g " << report.rmsError[1]
+              << ", b " << report.rmsError[2] << ", a " << report.rmsError[3] << "]" << std::endl;
+}
@@ -0,0 +1,71 @@
+#ifndef CLOUDSCAPES_NOISE_VOLUME_FORMAT_H_
+#define CLOUDSCAPES_NOISE_VOLUME_FORMAT_H_
+
+#include <cstdint>
+#include <vector>
+#include "noise_volume.h"
+
+// GPU friendly texel layouts a float noise volume can be stored in
+enum class NoiseVolumeFormat : uint32_t {
+    RGBA32F,   // DXGI_FORMAT_R32G32B32A32_FLOAT, the reference
+    RGBA16F,   // DXGI_FORMAT_R16G16B16A16_FLOAT
+    RGBA8,     // DXGI_FORMAT_R8G8B8A8_UNORM
+    BC4Planes, // one DXGI_FORMAT_BC4_UNORM volume per channel, planes stored r, g, b, a
+
+    NumNoiseVolumeFormats
+};
+
+// float -> half, round to nearest even like the GPU's float to R16F conversion
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
+
+const char* NoiseVolumeFormatToString(NoiseVolumeFormat format);
+
+uint32_t GetNoiseVolumeFormatNumPlanes(NoiseVolumeFormat format);
+
+// Layout of a single plane, matching what GetCopyableFootprints reports for the
+// equivalent DXGI format minus the pitch alignment: block compressed formats
+// have one row per 4 texel rows.
+uint64_t GetNoiseVolumeRowPitch(NoiseVolumeFormat format, uint32_t width);
+uint32_t GetNoiseVolumeNumRows(NoiseVolumeFormat format, uint32_t height);
+uint64_t GetNoiseVolumePlaneSize(NoiseVolumeFormat format, uint32_t width, uint32_t height, uint32_t depth);
+uint64_t GetNoiseVolumeSize(NoiseVolumeFormat format, uint32_t width, uint32_t height, uint32_t depth);
+
+//
+// Tightly packed noise volume in one of the NoiseVolumeFormats
+//
+struct EncodedNoiseVolume {
+    NoiseVolumeFormat format = NoiseVolumeFormat::RGBA32F;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t depth = 0;
+    std::vector<uint8_t> data;
+
+    uint64_t GetRowPitch() const { return GetNoiseVolumeRowPitch(format, width); }
+    uint32_t GetNumRows() const { return GetNoiseVolumeNumRows(format, height); }
+    uint64_t GetSlicePitch() const { return GetRowPitch() * GetNumRows(); }
+    uint64_t GetPlaneSize() const { return GetNoiseVolumePlaneSize(format, width, height, depth); }
+};
+
+EncodedNoiseVolume EncodeNoiseVolume(const NoiseVolume& volume, NoiseVolumeFormat format);
+
+// decodes the way the GPU samples it, used to measure the encoding error
+NoiseVolume DecodeNoiseVolume(NoiseVolumeFormat format, uint32_t width, uint32_t height, uint32_t depth, const void* data);
+NoiseVolume DecodeNoiseVolume(const EncodedNoiseVolume& encoded);
+
+struct NoiseVolumeQualityReport {
+    NoiseVolumeFormat format;
+    float maxError[4];
+    float rmsError[4];
+    float maxErrorAll;
+    float rmsErrorAll;
+    uint64_t sizeInBytes;
+    float compressionRatio; // compared to RGBA32F
+};
+
+// per channel max/RMS absolute error of the encoded volume against the float reference
+NoiseVolumeQualityReport MeasureNoiseVolumeQuality(const NoiseVolume& reference, const EncodedNoiseVolume& encoded);
+
+void PrintNoiseVolumeQualityReport(const NoiseVolumeQualityReport& report);
+
+#endif // CLOUDSCAPES_NOISE_VOLUME_FORMAT_H_
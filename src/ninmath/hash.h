@@ -0,0 +1,70 @@
+#ifndef NINMATH_HASH_H_
+#define NINMATH_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace ninmath {
+namespace hash {
+
+    // 64 bit FNV-1a, stable across runs/platforms so it can key on-disk caches
+    inline constexpr uint64_t Fnv1a64OffsetBasis = 0xcbf29ce484222325ULL;
+    inline constexpr uint64_t Fnv1a64Prime = 0x100000001b3ULL;
+
+    inline uint64_t Fnv1a64(const void* data, size_t size, uint64_t hash = Fnv1a64OffsetBasis) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for(size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= Fnv1a64Prime;
+        }
+        return hash;
+    }
+
+    inline uint64_t Fnv1a64(std::string_view str, uint64_t hash = Fnv1a64OffsetBasis) {
+        return Fnv1a64(str.data(), str.size(), hash);
+    }
+
+    //
+    // Incremental hasher, feed it values field by field (not whole structs,
+    // padding bytes would end up in the hash).
+    //
+    class Hasher {
+    public:
+        template <typename T>
+        requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+        Hasher& Add(const T& value) {
+            hash_ = Fnv1a64(&value, sizeof(T), hash_);
+            return *this;
+        }
+
+        template <typename T, size_t N>
+        Hasher& Add(const T (&values)[N]) {
+            for(const T& v : values) {
+                Add(v);
+            }
+            return *this;
+        }
+
+        Hasher& Add(std::string_view str) {
+            // length first, so ("ab","c") and ("a","bc") differ
+            Add((uint64_t)str.size());
+            hash_ = Fnv1a64(str, hash_);
+            return *this;
+        }
+
+        Hasher& AddBytes(const void* data, size_t size) {
+            Add((uint64_t)size);
+            hash_ = Fnv1a64(data, size, hash_);
+            return *this;
+        }
+
+        uint64_t Get() const { return hash_; }
+
+    private:
+        uint64_t hash_ = Fnv1a64OffsetBasis;
+    };
+}
+} // namespace ninmath
+#endif // NINMATH_HASH_H_
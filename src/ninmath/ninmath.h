@@ -1,6 +1,7 @@
 #pragma once
 #define NOMINMAX
 #include <cmath>
+#include <cstdint>
 #include <numbers>
 
 namespace ninmath {
@@ -656,9 +657,9 @@ inline float Lerp(float val1, float val2, float alpha) {
 
 inline Vector3f Mod(Vector3f v, float m) {
     return {
-        std::fmodf(v.x, m),
-        std::fmodf(v.y, m),
-        std::fmodf(v.z, m)
+        std::fmod(v.x, m),
+        std::fmod(v.y, m),
+        std::fmod(v.z, m)
     };
 }
 
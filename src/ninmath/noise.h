@@ -2,6 +2,7 @@
 #define NINMATH_NOISE_H_
 #define NOMINMAX
 #include <algorithm>
+#include <cfloat>
 #include "ninmath.h"
 
 namespace ninmath {
@@ -13,21 +14,23 @@ namespace noise {
         const uint32_t m = 0x5bd1e995U;
         uint32_t hash = seed;
 
-        uint32_t k = (uint32_t) x.x;
+        // going through int32_t keeps negative coordinates well defined
+        // (a direct float -> uint32_t cast is UB for them and differs per ISA)
+        uint32_t k = (uint32_t)(int32_t) x.x;
         k *= m;
         k ^= k >> 24;
         k *= m;
         hash *= m;
         hash ^= k;
         
-        k = (uint32_t) x.y;
+        k = (uint32_t)(int32_t) x.y;
         k *= m;
         k ^= k >> 24;
         k *= m;
         hash *= m;
         hash ^= k;
         
-        k = (uint32_t) x.z;
+        k = (uint32_t)(int32_t) x.z;
         k *= m;
         k ^= k >> 24;
         k *= m;
@@ -80,12 +83,13 @@ namespace noise {
         }
     }
     
-    inline float Perlin(Vector3f p) {
+    // seed the gpu noise shaders use
+    inline constexpr uint32_t DefaultPerlinSeed = 0x578437adU;
+
+    inline float Perlin(Vector3f p, uint32_t seed = DefaultPerlinSeed) {
         const Vector3f int_part = Floor(p);
         const Vector3f fract_part = Fract(p);
             
-        uint32_t seed = 0x578437adU;
-            
         // generate cube grid points
         const Vector3f g0 = int_part; // bl
         const Vector3f g1 = int_part + Vector3f(1.f, 0.f, 0.f); // br
@@ -173,7 +177,7 @@ namespace noise {
         return min_dist;
     }
     
-    inline float PerlinFBM(Vector3f p) {
+    inline float PerlinFBM(Vector3f p, uint32_t seed = DefaultPerlinSeed) {
         float gain = 0.5f;
         float lacunarity = 2.f;
         int octaves = 3;
@@ -185,7 +189,7 @@ namespace noise {
 
         float val = 0.f;
         for(int i = 0; i < octaves; i++) {
-            val += amplitude * Perlin(p * freq);
+            val += amplitude * Perlin(p * freq, seed);
             freq *= lacunarity;
             
             ampSum += amplitude;
@@ -193,6 +197,83 @@ namespace noise {
         }
         return std::clamp((val / ampSum) * 0.5f + 0.5f, 0.0f, 1.0f);
     }
+
+    inline float Remap(float val, float original_min, float original_max, float new_min, float new_max) {
+        float p = (val - original_min) / (original_max - original_min);
+        return new_min + p * (new_max - new_min);
+    }
+
+    // inputs of compute_model_noise_cs.hlsl, the defaults match the shader
+    struct ModelNoiseParameters {
+        // texel index -> noise space, the shader maps 128 texels to [0,1]
+        float coordScale = 1.f / 128.f;
+        float cellCount = 4.f;
+        uint32_t perlinSeed = DefaultPerlinSeed;
+
+        // worley fbm that gets remapped by the perlin fbm (R channel)
+        float perlinWorleyFreqMults[3] = { 2.f, 8.f, 14.f };
+        float perlinWorleyWeights[3] = { 0.625f, 0.25f, 0.125f };
+
+        // worley fbms in GBA, built from the octaves cellCount * {1, 2, 4, 8, 16}
+        float worleyFBMWeights[3] = { 0.625f, 0.25f, 0.125f };
+        float worleyFBM2Weights[2] = { 0.75f, 0.25f };
+    };
+
+    // worley octaves the GBA channels are built from (as multiples of the cell count)
+    inline constexpr float ModelNoiseWorleyOctaves[5] = { 1.f, 2.f, 4.f, 8.f, 16.f };
+
+    // the three worley fbms of the GBA channels, built from the 5 worley octaves
+    inline void CombineWorleyFBMs(const float worley[5], const ModelNoiseParameters& params, float out[3]) {
+        const float* w = params.worleyFBMWeights;
+        out[0] = worley[1] * w[0] + worley[2] * w[1] + worley[3] * w[2];
+        out[1] = worley[2] * w[0] + worley[3] * w[1] + worley[4] * w[2];
+        out[2] = worley[3] * params.worleyFBM2Weights[0] + worley[4] * params.worleyFBM2Weights[1];
+    }
+
+    // combines the individual noise values the same way the shader does
+    inline Vector4f CombineModelNoise(float perlinFBM,
+                                      const float perlinWorley[3],
+                                      const float worley[5],
+                                      const ModelNoiseParameters& params) {
+        const float* pw = params.perlinWorleyWeights;
+        const float worley_fbm = perlinWorley[0] * pw[0] + perlinWorley[1] * pw[1] + perlinWorley[2] * pw[2];
+        const float perlin_worley = Remap(perlinFBM, 0.0f, 1.0f, worley_fbm, 1.f);
+
+        float worley_fbms[3];
+        CombineWorleyFBMs(worley, params, worley_fbms);
+
+        return Vector4f(perlin_worley, worley_fbms[0], worley_fbms[1], worley_fbms[2]);
+    }
+
+    // CPU version of compute_model_noise_cs.hlsl: Perlin-Worley in R, worley fbms in GBA
+    inline Vector4f ModelNoise(Vector3f coord, const ModelNoiseParameters& params = {}) {
+        const float perlin_fbm = PerlinFBM(coord, params.perlinSeed);
+
+        float perlinWorley[3];
+        for(int i = 0; i < 3; i++) {
+            perlinWorley[i] = 1.f - Worley(coord, params.cellCount * params.perlinWorleyFreqMults[i]);
+        }
+
+        float worley[5];
+        for(int i = 0; i < 5; i++) {
+            worley[i] = 1.f - Worley(coord, params.cellCount * ModelNoiseWorleyOctaves[i]);
+        }
+
+        return CombineModelNoise(perlin_fbm, perlinWorley, worley, params);
+    }
+
+    // CPU version of compute_detail_noise_cs.hlsl: the GBA worley fbms of the model noise, in RGB
+    inline Vector4f DetailNoise(Vector3f coord, const ModelNoiseParameters& params = {}) {
+        float worley[5];
+        for(int i = 0; i < 5; i++) {
+            worley[i] = 1.f - Worley(coord, params.cellCount * ModelNoiseWorleyOctaves[i]);
+        }
+
+        float worley_fbms[3];
+        CombineWorleyFBMs(worley, params, worley_fbms);
+
+        return Vector4f(worley_fbms[0], worley_fbms[1], worley_fbms[2], 0.0f);
+    }
 }
 } // namespace ninmath
 #endif // NINMATH_NOISE_H_
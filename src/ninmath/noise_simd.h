@@ -0,0 +1,667 @@
+#ifndef NINMATH_NOISE_SIMD_H_
+#define NINMATH_NOISE_SIMD_H_
+#define NOMINMAX
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include "noise.h"
+
+//
+// Batch (SoA) versions of the scalar noise functions in noise.h.
+//
+// Every lane performs exactly the same sequence of IEEE operations as the
+// scalar function it mirrors, so the results are bit-identical as long as the
+// compiler doesn't contract a*b+c into FMAs (MSVC's default /fp:precise doesn't,
+// gcc/clang need -ffp-contract=off).
+//
+// MSVC lets us use any intrinsic regardless of /arch, so all paths are compiled
+// in and picked at runtime. Other compilers only get the paths enabled by -m flags.
+//
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#include <intrin.h>
+#define NINMATH_NOISE_SIMD_SSE41 1
+#define NINMATH_NOISE_SIMD_AVX2 1
+#define NINMATH_NOISE_SIMD_AVX512 1
+#else
+#if defined(__SSE4_1__)
+#define NINMATH_NOISE_SIMD_SSE41 1
+#endif
+#if defined(__AVX2__)
+#define NINMATH_NOISE_SIMD_AVX2 1
+#endif
+#if defined(__AVX512F__)
+#define NINMATH_NOISE_SIMD_AVX512 1
+#endif
+#endif
+
+#if defined(NINMATH_NOISE_SIMD_SSE41) || defined(NINMATH_NOISE_SIMD_AVX2) || defined(NINMATH_NOISE_SIMD_AVX512)
+#include <immintrin.h>
+#endif
+
+namespace ninmath {
+namespace noise {
+
+    enum class SimdLevel {
+        Scalar,
+        SSE41,
+        AVX2,
+        AVX512,
+
+        NumSimdLevels
+    };
+
+    inline const char* SimdLevelToString(SimdLevel level) {
+        switch(level) {
+        case SimdLevel::Scalar:
+            return "Scalar";
+        case SimdLevel::SSE41:
+            return "SSE4.1";
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::AVX512:
+            return "AVX-512";
+        default:
+            return "Unknown";
+        }
+    }
+
+    // highest level that is both compiled in and supported by the cpu/os
+    inline SimdLevel DetectSimdLevel() {
+        bool hasSSE41 = false;
+        bool hasAVX2 = false;
+        bool hasAVX512 = false;
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+        int info[4] = {};
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        hasSSE41 = (info[2] & (1 << 19)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+
+        // the os has to save the ymm/zmm registers on context switches as well
+        const uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+        const bool osYMM = (xcr0 & 0x6) == 0x6;
+        const bool osZMM = (xcr0 & 0xe6) == 0xe6;
+
+        if(maxLeaf >= 7) {
+            __cpuidex(info, 7, 0);
+            hasAVX2 = osYMM && (info[1] & (1 << 5)) != 0;
+            hasAVX512 = osZMM && (info[1] & (1 << 16)) != 0;
+        }
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        hasSSE41 = __builtin_cpu_supports("sse4.1");
+        hasAVX2 = __builtin_cpu_supports("avx2");
+        hasAVX512 = __builtin_cpu_supports("avx512f");
+#endif
+
+#if defined(NINMATH_NOISE_SIMD_AVX512)
+        if(hasAVX512) {
+            return SimdLevel::AVX512;
+        }
+#endif
+#if defined(NINMATH_NOISE_SIMD_AVX2)
+        if(hasAVX2) {
+            return SimdLevel::AVX2;
+        }
+#endif
+#if defined(NINMATH_NOISE_SIMD_SSE41)
+        if(hasSSE41) {
+            return SimdLevel::SSE41;
+        }
+#endif
+        (void)hasSSE41; (void)hasAVX2; (void)hasAVX512;
+        return SimdLevel::Scalar;
+    }
+
+    inline SimdLevel GetSimdLevel() {
+        static const SimdLevel level = DetectSimdLevel();
+        return level;
+    }
+
+namespace simd_detail {
+
+    // GradientDirection(...) as lookup tables, indexed by hash & 15
+    alignas(16) inline constexpr int8_t GradientX[16] = { 1, -1,  1, -1,  1, -1,  1, -1,  0,  0,  0,  0,  1, -1,  0,  0 };
+    alignas(16) inline constexpr int8_t GradientY[16] = { 1,  1, -1, -1,  0,  0,  0,  0,  1, -1,  1, -1,  1,  1, -1, -1 };
+    alignas(16) inline constexpr int8_t GradientZ[16] = { 0,  0,  0,  0,  1,  1, -1, -1,  1,  1, -1, -1,  0,  0,  1, -1 };
+
+    //
+    // Lane types. Each one exposes the same small set of operations so the
+    // kernels below can be written once.
+    //
+
+#if defined(NINMATH_NOISE_SIMD_SSE41)
+    struct LanesSSE41 {
+        typedef __m128 Float;
+        typedef __m128i Int;
+        typedef __m128 Mask;
+        static constexpr size_t Width = 4;
+
+        static Float Load(const float* p) { return _mm_loadu_ps(p); }
+        static void Store(float* p, Float v) { _mm_storeu_ps(p, v); }
+        static Float Set(float s) { return _mm_set1_ps(s); }
+
+        static Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static Float Floor(Float a) { return _mm_floor_ps(a); }
+        static Float Trunc(Float a) { return _mm_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+
+        // a < b ? a : b and a > b ? a : b, matching the scalar comparisons
+        static Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+
+        static Mask Less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+        static Mask GreaterEqual(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+        static Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+        static Mask Or(Mask a, Mask b) { return _mm_or_ps(a, b); }
+        static Float Select(Mask m, Float a, Float b) { return _mm_blendv_ps(b, a, m); }
+
+        static Float Abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+        static Float CopySign(Float mag, Float sign) {
+            const __m128 signMask = _mm_set1_ps(-0.f);
+            return _mm_or_ps(_mm_andnot_ps(signMask, mag), _mm_and_ps(signMask, sign));
+        }
+
+        static Int ToInt(Float a) { return _mm_cvttps_epi32(a); }
+        static Int SetInt(uint32_t s) { return _mm_set1_epi32((int)s); }
+        static Int MulInt(Int a, Int b) { return _mm_mullo_epi32(a, b); }
+        static Int XorInt(Int a, Int b) { return _mm_xor_si128(a, b); }
+        template <int N>
+        static Int ShiftRightInt(Int a) { return _mm_srli_epi32(a, N); }
+
+        static Float Gradient(Int hash, const int8_t (&table)[16]) {
+            // byte 0 of every lane picks the table entry, the other bytes are zeroed (0x80)
+            const __m128i lut = _mm_load_si128(reinterpret_cast<const __m128i*>(table));
+            const __m128i index = _mm_or_si128(_mm_and_si128(hash, _mm_set1_epi32(15)), _mm_set1_epi32((int)0x80808000U));
+            const __m128i bytes = _mm_shuffle_epi8(lut, index);
+            return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(bytes, 24), 24));
+        }
+    };
+#endif
+
+#if defined(NINMATH_NOISE_SIMD_AVX2)
+    struct LanesAVX2 {
+        typedef __m256 Float;
+        typedef __m256i Int;
+        typedef __m256 Mask;
+        static constexpr size_t Width = 8;
+
+        static Float Load(const float* p) { return _mm256_loadu_ps(p); }
+        static void Store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+        static Float Set(float s) { return _mm256_set1_ps(s); }
+
+        static Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        static Float Floor(Float a) { return _mm256_floor_ps(a); }
+        static Float Trunc(Float a) { return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+
+        static Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        static Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+
+        static Mask Less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static Mask GreaterEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+        static Mask Or(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+        static Float Select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+
+        static Float Abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+        static Float CopySign(Float mag, Float sign) {
+            const __m256 signMask = _mm256_set1_ps(-0.f);
+            return _mm256_or_ps(_mm256_andnot_ps(signMask, mag), _mm256_and_ps(signMask, sign));
+        }
+
+        static Int ToInt(Float a) { return _mm256_cvttps_epi32(a); }
+        static Int SetInt(uint32_t s) { return _mm256_set1_epi32((int)s); }
+        static Int MulInt(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+        static Int XorInt(Int a, Int b) { return _mm256_xor_si256(a, b); }
+        template <int N>
+        static Int ShiftRightInt(Int a) { return _mm256_srli_epi32(a, N); }
+
+        static Float Gradient(Int hash, const int8_t (&table)[16]) {
+            // vpshufb works within 128 bit halves, so the table is duplicated into both
+            const __m256i lut = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table)));
+            const __m256i index = _mm256_or_si256(_mm256_and_si256(hash, _mm256_set1_epi32(15)), _mm256_set1_epi32((int)0x80808000U));
+            const __m256i bytes = _mm256_shuffle_epi8(lut, index);
+            return _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(bytes, 24), 24));
+        }
+    };
+#endif
+
+#if defined(NINMATH_NOISE_SIMD_AVX512)
+    struct LanesAVX512 {
+        typedef __m512 Float;
+        typedef __m512i Int;
+        typedef __mmask16 Mask;
+        static constexpr size_t Width = 16;
+
+        static Float Load(const float* p) { return _mm512_loadu_ps(p); }
+        static void Store(float* p, Float v) { _mm512_storeu_ps(p, v); }
+        static Float Set(float s) { return _mm512_set1_ps(s); }
+
+        static Float Add(Float a, Float b) { return _mm512_add_ps(a, b); }
+        static Float Sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+        static Float Mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+        static Float Div(Float a, Float b) { return _mm512_div_ps(a, b); }
+        static Float Floor(Float a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+        static Float Trunc(Float a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+
+        static Float Min(Float a, Float b) { return _mm512_min_ps(a, b); }
+        static Float Max(Float a, Float b) { return _mm512_max_ps(a, b); }
+
+        static Mask Less(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static Mask GreaterEqual(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+        static Mask And(Mask a, Mask b) { return (Mask)(a & b); }
+        static Mask Or(Mask a, Mask b) { return (Mask)(a | b); }
+        static Float Select(Mask m, Float a, Float b) { return _mm512_mask_blend_ps(m, b, a); }
+
+        // AVX-512F has no float logic ops, those came with DQ
+        static Float Abs(Float a) {
+            return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff)));
+        }
+        static Float CopySign(Float mag, Float sign) {
+            const __m512i signMask = _mm512_set1_epi32((int)0x80000000U);
+            return _mm512_castsi512_ps(_mm512_or_si512(_mm512_andnot_si512(signMask, _mm512_castps_si512(mag)),
+                                                       _mm512_and_si512(signMask, _mm512_castps_si512(sign))));
+        }
+
+        static Int ToInt(Float a) { return _mm512_cvttps_epi32(a); }
+        static Int SetInt(uint32_t s) { return _mm512_set1_epi32((int)s); }
+        static Int MulInt(Int a, Int b) { return _mm512_mullo_epi32(a, b); }
+        static Int XorInt(Int a, Int b) { return _mm512_xor_si512(a, b); }
+        template <int N>
+        static Int ShiftRightInt(Int a) { return _mm512_srli_epi32(a, N); }
+
+        static Float Gradient(Int hash, const int8_t (&table)[16]) {
+            // 16 entries fit a single zmm register, vpermps only looks at the low 4 bits of the index
+            const __m512 lut = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(table))));
+            return _mm512_permutexvar_ps(hash, lut);
+        }
+    };
+#endif
+
+    //
+    // Kernels, mirroring noise.h operation by operation
+    //
+
+    template <typename L>
+    inline typename L::Int MurmurHash3D(typename L::Float x, typename L::Float y, typename L::Float z, uint32_t seed) {
+        typedef typename L::Int Int;
+        const Int m = L::SetInt(0x5bd1e995U);
+        Int hash = L::SetInt(seed);
+
+        // cvttps matches the scalar (uint32_t)(int32_t) cast for anything in [-2^31, 2^31)
+        const Int coords[3] = { L::ToInt(x), L::ToInt(y), L::ToInt(z) };
+        for(const Int& c : coords) {
+            Int k = L::MulInt(c, m);
+            k = L::XorInt(k, L::template ShiftRightInt<24>(k));
+            k = L::MulInt(k, m);
+            hash = L::MulInt(hash, m);
+            hash = L::XorInt(hash, k);
+        }
+
+        hash = L::XorInt(hash, L::template ShiftRightInt<13>(hash));
+        hash = L::MulInt(hash, m);
+        hash = L::XorInt(hash, L::template ShiftRightInt<15>(hash));
+
+        return hash;
+    }
+
+    template <typename L>
+    inline typename L::Float GradientDot(typename L::Float gx, typename L::Float gy, typename L::Float gz,
+                                         typename L::Float px, typename L::Float py, typename L::Float pz,
+                                         uint32_t seed) {
+        const typename L::Int hash = MurmurHash3D<L>(gx, gy, gz, seed);
+
+        // GradientDirection(hash).Dot(p - g)
+        const typename L::Float dx = L::Sub(px, gx);
+        const typename L::Float dy = L::Sub(py, gy);
+        const typename L::Float dz = L::Sub(pz, gz);
+
+        return L::Add(L::Add(L::Mul(L::Gradient(hash, GradientX), dx),
+                             L::Mul(L::Gradient(hash, GradientY), dy)),
+                      L::Mul(L::Gradient(hash, GradientZ), dz));
+    }
+
+    template <typename L>
+    inline typename L::Float Lerp(typename L::Float a, typename L::Float b, typename L::Float t) {
+        return L::Add(a, L::Mul(L::Sub(b, a), t));
+    }
+
+    template <typename L>
+    inline typename L::Float Perlin(typename L::Float px, typename L::Float py, typename L::Float pz, uint32_t seed) {
+        typedef typename L::Float Float;
+
+        const Float ix = L::Floor(px);
+        const Float iy = L::Floor(py);
+        const Float iz = L::Floor(pz);
+
+        // the scalar version adds 0 or 1 to every component, so do we
+        const Float zero = L::Set(0.f);
+        const Float one = L::Set(1.f);
+        const Float ix0 = L::Add(ix, zero), ix1 = L::Add(ix, one);
+        const Float iy0 = L::Add(iy, zero), iy1 = L::Add(iy, one);
+        const Float iz0 = L::Add(iz, zero), iz1 = L::Add(iz, one);
+
+        const Float d0 = GradientDot<L>(ix,  iy,  iz,  px, py, pz, seed);
+        const Float d1 = GradientDot<L>(ix1, iy0, iz0, px, py, pz, seed);
+        const Float d2 = GradientDot<L>(ix0, iy1, iz0, px, py, pz, seed);
+        const Float d3 = GradientDot<L>(ix1, iy1, iz0, px, py, pz, seed);
+        const Float d4 = GradientDot<L>(ix0, iy0, iz1, px, py, pz, seed);
+        const Float d5 = GradientDot<L>(ix1, iy0, iz1, px, py, pz, seed);
+        const Float d6 = GradientDot<L>(ix0, iy1, iz1, px, py, pz, seed);
+        const Float d7 = GradientDot<L>(ix1, iy1, iz1, px, py, pz, seed);
+
+        // t * t * t * (t * (t * 6 - 15) + 10)
+        auto smooth = [&](Float t) {
+            const Float inner = L::Add(L::Mul(t, L::Sub(L::Mul(t, L::Set(6.f)), L::Set(15.f))), L::Set(10.f));
+            return L::Mul(L::Mul(L::Mul(t, t), t), inner);
+        };
+        const Float ux = smooth(L::Sub(px, ix));
+        const Float uy = smooth(L::Sub(py, iy));
+        const Float uz = smooth(L::Sub(pz, iz));
+
+        const Float M0 = Lerp<L>(d0, d1, ux);
+        const Float M1 = Lerp<L>(d2, d3, ux);
+        const Float M2 = Lerp<L>(d4, d5, ux);
+        const Float M4 = Lerp<L>(d6, d7, ux);
+
+        const Float M5 = Lerp<L>(M0, M1, uy);
+        const Float M6 = Lerp<L>(M2, M4, uy);
+
+        return Lerp<L>(M5, M6, uz);
+    }
+
+    template <typename L>
+    inline typename L::Float Fract(typename L::Float v) {
+        return L::Sub(v, L::Floor(v));
+    }
+
+    // std::fmod for integral x and m (|x| < 2^24), where x - trunc(x/m)*m is exact
+    // apart from the quotient rounding across an integer, which the fix-ups handle
+    template <typename L>
+    inline typename L::Float ModIntegral(typename L::Float x, typename L::Float m) {
+        typedef typename L::Float Float;
+        const Float zero = L::Set(0.f);
+        const Float absM = L::Abs(m);
+
+        Float r = L::Sub(x, L::Mul(L::Trunc(L::Div(x, m)), m));
+        r = L::Select(L::GreaterEqual(L::Abs(r), absM), L::Sub(r, L::CopySign(absM, r)), r);
+
+        const typename L::Mask wrongSign = L::Or(L::And(L::Less(r, zero), L::Less(zero, x)),
+                                                 L::And(L::Less(zero, r), L::Less(x, zero)));
+        r = L::Select(wrongSign, L::Add(r, L::CopySign(absM, x)), r);
+
+        // fmod keeps the sign of x, even for zero results
+        return L::CopySign(r, x);
+    }
+
+    template <typename L>
+    inline void Hash33(typename L::Float px, typename L::Float py, typename L::Float pz,
+                       typename L::Float& outX, typename L::Float& outY, typename L::Float& outZ) {
+        typedef typename L::Float Float;
+
+        Float Px = Fract<L>(L::Mul(px, L::Set(0.1031f)));
+        Float Py = Fract<L>(L::Mul(py, L::Set(0.11369f)));
+        Float Pz = Fract<L>(L::Mul(pz, L::Set(0.13787f)));
+
+        const Float c = L::Set(19.19f);
+        const Float dot = L::Add(L::Add(L::Mul(Px, L::Add(py, c)),
+                                        L::Mul(Py, L::Add(px, c))),
+                                 L::Mul(Pz, L::Add(pz, c)));
+        Px = L::Add(Px, dot);
+        Py = L::Add(Py, dot);
+        Pz = L::Add(Pz, dot);
+
+        const Float two = L::Set(2.f);
+        const Float minusOne = L::Set(-1.f);
+        outX = L::Add(L::Mul(Fract<L>(L::Mul(L::Add(Px, Py), Pz)), two), minusOne);
+        outY = L::Add(L::Mul(Fract<L>(L::Mul(L::Add(Px, Pz), Py)), two), minusOne);
+        outZ = L::Add(L::Mul(Fract<L>(L::Mul(L::Add(Py, Pz), Px)), two), minusOne);
+    }
+
+    template <typename L>
+    inline typename L::Float Worley(typename L::Float px, typename L::Float py, typename L::Float pz, float scale) {
+        typedef typename L::Float Float;
+        const Float s = L::Set(scale);
+        const Float half = L::Set(0.5f);
+
+        const Float sx = L::Mul(px, s);
+        const Float sy = L::Mul(py, s);
+        const Float sz = L::Mul(pz, s);
+
+        const Float gx = L::Floor(sx);
+        const Float gy = L::Floor(sy);
+        const Float gz = L::Floor(sz);
+
+        const Float fx = L::Sub(sx, gx);
+        const Float fy = L::Sub(sy, gy);
+        const Float fz = L::Sub(sz, gz);
+
+        Float minDist = L::Set(FLT_MAX);
+
+        for(int x = -1; x <= 1; x++) {
+            const Float ox = L::Set((float)x);
+            const Float cx = ModIntegral<L>(L::Add(gx, ox), s);
+
+            for(int y = -1; y <= 1; y++) {
+                const Float oy = L::Set((float)y);
+                const Float cy = ModIntegral<L>(L::Add(gy, oy), s);
+
+                for(int z = -1; z <= 1; z++) {
+                    const Float oz = L::Set((float)z);
+                    const Float cz = ModIntegral<L>(L::Add(gz, oz), s);
+
+                    Float hx, hy, hz;
+                    Hash33<L>(cx, cy, cz, hx, hy, hz);
+
+                    // r = offset + rId - fract_part
+                    const Float rx = L::Sub(L::Add(ox, L::Add(L::Mul(hx, half), half)), fx);
+                    const Float ry = L::Sub(L::Add(oy, L::Add(L::Mul(hy, half), half)), fy);
+                    const Float rz = L::Sub(L::Add(oz, L::Add(L::Mul(hz, half), half)), fz);
+
+                    const Float d = L::Add(L::Add(L::Mul(rx, rx), L::Mul(ry, ry)), L::Mul(rz, rz));
+                    minDist = L::Min(d, minDist);
+                }
+            }
+        }
+
+        return minDist;
+    }
+
+    template <typename L>
+    inline typename L::Float PerlinFBM(typename L::Float px, typename L::Float py, typename L::Float pz, uint32_t seed) {
+        typedef typename L::Float Float;
+
+        const float lacunarity = 2.f;
+        const int octaves = 3;
+
+        float amplitude = 0.5;
+        float freq = 8.f;
+        float ampSum = 0.f;
+
+        Float val = L::Set(0.f);
+        for(int i = 0; i < octaves; i++) {
+            const Float f = L::Set(freq);
+            val = L::Add(val, L::Mul(L::Set(amplitude), Perlin<L>(L::Mul(px, f), L::Mul(py, f), L::Mul(pz, f), seed)));
+            freq *= lacunarity;
+
+            ampSum += amplitude;
+            amplitude *= amplitude;
+        }
+
+        const Float v = L::Add(L::Mul(L::Div(val, L::Set(ampSum)), L::Set(0.5f)), L::Set(0.5f));
+        return L::Min(L::Set(1.f), L::Max(L::Set(0.f), v));
+    }
+
+    // runs the kernel over full batches, returns how many elements were processed
+    template <typename L, typename KernelFunc>
+    inline size_t RunBatches(const float* x, const float* y, const float* z, float* out, size_t count, KernelFunc kernel) {
+        const size_t batched = count - (count % L::Width);
+        for(size_t i = 0; i < batched; i += L::Width) {
+            L::Store(out + i, kernel(L::Load(x + i), L::Load(y + i), L::Load(z + i)));
+        }
+        return batched;
+    }
+
+    template <typename KernelFunc>
+    inline size_t Dispatch(SimdLevel level, const float* x, const float* y, const float* z, float* out, size_t count, KernelFunc kernel) {
+        if(level > GetSimdLevel()) {
+            level = GetSimdLevel();
+        }
+
+        switch(level) {
+#if defined(NINMATH_NOISE_SIMD_AVX512)
+        case SimdLevel::AVX512:
+            return RunBatches<LanesAVX512>(x, y, z, out, count,
+                [&](__m512 px, __m512 py, __m512 pz) { return kernel.template operator()<LanesAVX512>(px, py, pz); });
+#endif
+#if defined(NINMATH_NOISE_SIMD_AVX2)
+        case SimdLevel::AVX2:
+            return RunBatches<LanesAVX2>(x, y, z, out, count,
+                [&](__m256 px, __m256 py, __m256 pz) { return kernel.template operator()<LanesAVX2>(px, py, pz); });
+#endif
+#if defined(NINMATH_NOISE_SIMD_SSE41)
+        case SimdLevel::SSE41:
+            return RunBatches<LanesSSE41>(x, y, z, out, count,
+                [&](__m128 px, __m128 py, __m128 pz) { return kernel.template operator()<LanesSSE41>(px, py, pz); });
+#endif
+        default:
+            return 0;
+        }
+    }
+
+} // namespace simd_detail
+
+    //
+    // Batch entry points. Positions are passed as SoA arrays, any count is fine -
+    // whatever doesn't fill a full batch goes through the scalar functions.
+    // Requesting a level above GetSimdLevel() runs the best available one instead.
+    //
+
+    inline void PerlinN(const float* x, const float* y, const float* z, float* out, size_t count,
+                        uint32_t seed = DefaultPerlinSeed, SimdLevel level = GetSimdLevel()) {
+        const size_t done = simd_detail::Dispatch(level, x, y, z, out, count,
+            [seed]<typename L>(typename L::Float px, typename L::Float py, typename L::Float pz) {
+                return simd_detail::Perlin<L>(px, py, pz, seed);
+            });
+
+        for(size_t i = done; i < count; i++) {
+            out[i] = Perlin(Vector3f(x[i], y[i], z[i]), seed);
+        }
+    }
+
+    inline void WorleyN(const float* x, const float* y, const float* z, float scale, float* out, size_t count,
+                        SimdLevel level = GetSimdLevel()) {
+        // the vectorized Mod(...) is only exact for integral scales, which is what
+        // the noise generators use anyway
+        if(scale != std::floor(scale) || std::fabs(scale) >= 16777216.f) {
+            level = SimdLevel::Scalar;
+        }
+
+        const size_t done = simd_detail::Dispatch(level, x, y, z, out, count,
+            [scale]<typename L>(typename L::Float px, typename L::Float py, typename L::Float pz) {
+                return simd_detail::Worley<L>(px, py, pz, scale);
+            });
+
+        for(size_t i = done; i < count; i++) {
+            out[i] = Worley(Vector3f(x[i], y[i], z[i]), scale);
+        }
+    }
+
+    inline void PerlinFBMN(const float* x, const float* y, const float* z, float* out, size_t count,
+                           uint32_t seed = DefaultPerlinSeed, SimdLevel level = GetSimdLevel()) {
+        const size_t done = simd_detail::Dispatch(level, x, y, z, out, count,
+            [seed]<typename L>(typename L::Float px, typename L::Float py, typename L::Float pz) {
+                return simd_detail::PerlinFBM<L>(px, py, pz, seed);
+            });
+
+        for(size_t i = done; i < count; i++) {
+            out[i] = PerlinFBM(Vector3f(x[i], y[i], z[i]), seed);
+        }
+    }
+
+    // floats of scratch memory ModelNoiseN(...) needs per element
+    inline constexpr size_t ModelNoiseScratchPerElement = 9;
+
+    // Batch ModelNoise(...), scratch needs room for ModelNoiseScratchPerElement * count floats.
+    // Worley octaves that show up in both the R and GBA channels are only evaluated once.
+    inline void ModelNoiseN(const float* x, const float* y, const float* z, Vector4f* out, size_t count,
+                            const ModelNoiseParameters& params, float* scratch,
+                            SimdLevel level = GetSimdLevel()) {
+        // unique worley scales, the 3 perlin-worley octaves first, then the 5 GBA octaves
+        float scales[8];
+        int scaleSlot[8];
+        int numScales = 0;
+        for(int i = 0; i < 8; i++) {
+            const float scale = params.cellCount * (i < 3 ? params.perlinWorleyFreqMults[i] : ModelNoiseWorleyOctaves[i - 3]);
+            scaleSlot[i] = -1;
+            for(int j = 0; j < numScales; j++) {
+                if(scales[j] == scale) {
+                    scaleSlot[i] = j;
+                }
+            }
+            if(scaleSlot[i] < 0) {
+                scaleSlot[i] = numScales;
+                scales[numScales++] = scale;
+            }
+        }
+
+        float* perlinFBM = scratch;
+        float* octaves = scratch + count;
+
+        PerlinFBMN(x, y, z, perlinFBM, count, params.perlinSeed, level);
+
+        for(int j = 0; j < numScales; j++) {
+            float* octave = octaves + (size_t)j * count;
+            WorleyN(x, y, z, scales[j], octave, count, level);
+            for(size_t i = 0; i < count; i++) {
+                octave[i] = 1.f - octave[i];
+            }
+        }
+
+        for(size_t i = 0; i < count; i++) {
+            float perlinWorley[3];
+            float worley[5];
+            for(int o = 0; o < 3; o++) {
+                perlinWorley[o] = octaves[(size_t)scaleSlot[o] * count + i];
+            }
+            for(int o = 0; o < 5; o++) {
+                worley[o] = octaves[(size_t)scaleSlot[o + 3] * count + i];
+            }
+            out[i] = CombineModelNoise(perlinFBM[i], perlinWorley, worley, params);
+        }
+    }
+
+    // Batch DetailNoise(...), same scratch requirements as ModelNoiseN(...)
+    inline void DetailNoiseN(const float* x, const float* y, const float* z, Vector4f* out, size_t count,
+                             const ModelNoiseParameters& params, float* scratch,
+                             SimdLevel level = GetSimdLevel()) {
+        for(int o = 0; o < 5; o++) {
+            float* octave = scratch + (size_t)o * count;
+            WorleyN(x, y, z, params.cellCount * ModelNoiseWorleyOctaves[o], octave, count, level);
+            for(size_t i = 0; i < count; i++) {
+                octave[i] = 1.f - octave[i];
+            }
+        }
+
+        for(size_t i = 0; i < count; i++) {
+            float worley[5];
+            for(int o = 0; o < 5; o++) {
+                worley[o] = scratch[(size_t)o * count + i];
+            }
+
+            float worley_fbms[3];
+            CombineWorleyFBMs(worley, params, worley_fbms);
+            out[i] = Vector4f(worley_fbms[0], worley_fbms[1], worley_fbms[2], 0.0f);
+        }
+    }
+}
+} // namespace ninmath
+#endif // NINMATH_NOISE_SIMD_H_
@@ -0,0 +1,63 @@
+﻿#include "command_list_pool.h"
+
+#include <cassert>
+
+CommandListPool::CommandListPool(winrt::com_ptr<ID3D12Device2> device, uint32_t numBuffers)
+    : device_(device), numBuffers_(numBuffers), backBufferIndex_(0), numInUse_(0) {
+
+    WINRT_ASSERT(device_ && numBuffers_ > 0);
+}
+
+void CommandListPool::BeginFrame(uint32_t backBufferIndex) {
+    assert(backBufferIndex < numBuffers_);
+    backBufferIndex_ = backBufferIndex;
+    numInUse_ = 0;
+}
+
+CommandListPool::Entry* CommandListPool::Acquire(HRESULT& hr) {
+    if(numInUse_ == entries_.size()) {
+        std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+
+        entry->allocators.resize(numBuffers_);
+        for(uint32_t i = 0; i < numBuffers_; i++) {
+            hr = device_->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+                                                 __uuidof(ID3D12CommandAllocator),
+                                                 entry->allocators[i].put_void());
+            CHECK_HR_NULL(hr);
+        }
+
+        // created open, closed again so Acquire can treat it like every other list
+        hr = device_->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, entry->allocators[0].get(), nullptr,
+                                        __uuidof(ID3D12GraphicsCommandList), entry->cmdList.put_void());
+        CHECK_HR_NULL(hr);
+
+        hr = entry->cmdList->Close();
+        CHECK_HR_NULL(hr);
+
+        entries_.push_back(std::move(entry));
+    }
+
+    Entry* entry = entries_[numInUse_].get();
+
+    // the allocator was last used numBuffers_ frames ago, which the GPU is done with
+    hr = entry->allocators[backBufferIndex_]->Reset();
+    CHECK_HR_NULL(hr);
+
+    hr = entry->cmdList->Reset(entry->allocators[backBufferIndex_].get(), nullptr);
+    CHECK_HR_NULL(hr);
+
+    assert(!entry->batcher.HasPendingBarriers() && !entry->batcher.HasOpenSplitTransitions());
+    entry->recordsJob = false;
+
+    numInUse_++;
+    return entry;
+}
+
+CommandListPool::Entry* CommandListPool::Find(const ID3D12GraphicsCommandList* cmdList) {
+    for(uint32_t i = 0; i < numInUse_; i++) {
+        if(entries_[i]->cmdList.get() == cmdList) {
+            return entries_[i].get();
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,53 @@
+﻿#ifndef RENDERER_COMMAND_LIST_POOL_H_
+#define RENDERER_COMMAND_LIST_POOL_H_
+
+#include <memory>
+#include <vector>
+
+#include "renderer_types.h"
+#include "resource_barrier_batcher.h"
+
+//
+// Direct command lists beyond the renderer's main one, for recording on worker threads.
+//
+// Every list has an allocator per back buffer. Lists are handed out for the current frame
+// only and all come back with the next BeginFrame, which has to be called once the GPU is
+// done with the frame that last used that back buffer (Renderer::StartCommandList).
+// The pool grows to the most lists a frame asked for.
+//
+// Acquire and Find aren't thread safe: acquire every list up front, then hand them out.
+//
+class CommandListPool {
+public:
+    struct Entry {
+        winrt::com_ptr<ID3D12GraphicsCommandList> cmdList;
+        std::vector<winrt::com_ptr<ID3D12CommandAllocator>> allocators; // by back buffer
+        ResourceBarrierBatcher batcher;
+
+        // recorded by a parallel job, which doesn't track resource states (see Renderer::RecordParallel)
+        bool recordsJob = false;
+    };
+
+    CommandListPool(winrt::com_ptr<ID3D12Device2> device, uint32_t numBuffers);
+
+    void BeginFrame(uint32_t backBufferIndex);
+
+    // reset and open, nullptr if creating or resetting the list failed
+    Entry* Acquire(HRESULT& hr);
+
+    // the entry of a list acquired this frame, nullptr for any other list
+    Entry* Find(const ID3D12GraphicsCommandList* cmdList);
+
+    uint32_t GetNumLists() const { return (uint32_t)entries_.size(); }
+    uint32_t GetNumListsInUse() const { return numInUse_; }
+
+private:
+    winrt::com_ptr<ID3D12Device2> device_;
+    uint32_t numBuffers_;
+    uint32_t backBufferIndex_;
+
+    std::vector<std::unique_ptr<Entry>> entries_;
+    uint32_t numInUse_; // the first numInUse_ entries
+};
+
+#endif // RENDERER_COMMAND_LIST_POOL_H_
@@ -0,0 +1,402 @@
+﻿#include "frame_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    struct StateName {
+        FrameGraphStates state;
+        const char* name;
+    };
+
+    const StateName stateNames[] = {
+        {frame_graph_states::VertexAndConstantBuffer, "VertexAndConstantBuffer"},
+        {frame_graph_states::IndexBuffer, "IndexBuffer"},
+        {frame_graph_states::RenderTarget, "RenderTarget"},
+        {frame_graph_states::UnorderedAccess, "UnorderedAccess"},
+        {frame_graph_states::DepthWrite, "DepthWrite"},
+        {frame_graph_states::DepthRead, "DepthRead"},
+        {frame_graph_states::PixelShaderResource, "PixelShaderResource"},
+        {frame_graph_states::NonPixelShaderResource, "NonPixelShaderResource"},
+        {frame_graph_states::IndirectArgument, "IndirectArgument"},
+        {frame_graph_states::CopyDest, "CopyDest"},
+        {frame_graph_states::CopySource, "CopySource"},
+    };
+
+    const char* SplitSuffix(FrameGraphBarrier::Split split) {
+        switch(split) {
+            case FrameGraphBarrier::Split::Begin: return " (begin)";
+            case FrameGraphBarrier::Split::End: return " (end)";
+            default: return "";
+        }
+    }
+
+    // accesses that need the resource to themselves, like writes
+    bool IsExclusive(FrameGraphStates state, bool write) {
+        return write || !frame_graph_states::IsReadOnly(state);
+    }
+}
+
+bool frame_graph_states::IsReadOnly(FrameGraphStates states) {
+    return states != 0 && (states & ~ReadOnly) == 0;
+}
+
+std::string frame_graph_states::ToString(FrameGraphStates states) {
+    if(states == Common) {
+        return "Common";
+    }
+
+    std::string str;
+    for(const StateName& stateName : stateNames) {
+        if((states & stateName.state) != 0) {
+            if(!str.empty()) {
+                str += "|";
+            }
+            str += stateName.name;
+            states &= ~stateName.state;
+        }
+    }
+
+    if(states != 0) {
+        if(!str.empty()) {
+            str += "|";
+        }
+        std::ostringstream rest;
+        rest << "0x" << std::hex << states;
+        str += rest.str();
+    }
+    return str;
+}
+
+uint32_t FrameGraph::ImportResource(std::string name, FrameGraphStates currentState, bool isOutput) {
+    assert(!compiled_ && "Resources have to be imported before compiling.");
+
+    Resource res;
+    res.name = std::move(name);
+    res.initialState = currentState;
+    res.finalState = currentState;
+    res.isOutput = isOutput;
+    resources_.push_back(std::move(res));
+    return (uint32_t)resources_.size() - 1;
+}
+
+uint32_t FrameGraph::AddPass(std::string name, std::function<void(FrameGraphCommandList&)> execute, bool hasSideEffects) {
+    assert(!compiled_ && "Passes have to be added before compiling.");
+
+    Pass pass;
+    pass.name = std::move(name);
+    pass.execute = std::move(execute);
+    pass.hasSideEffects = hasSideEffects;
+    passes_.push_back(std::move(pass));
+    return (uint32_t)passes_.size() - 1;
+}
+
+void FrameGraph::Read(uint32_t pass, uint32_t resource, FrameGraphStates state) {
+    AddAccess(pass, resource, state, false);
+}
+
+void FrameGraph::Write(uint32_t pass, uint32_t resource, FrameGraphStates state) {
+    assert(!frame_graph_states::IsReadOnly(state) && "Can't write in a read-only state.");
+    AddAccess(pass, resource, state, true);
+}
+
+void FrameGraph::AddAccess(uint32_t pass, uint32_t resource, FrameGraphStates state, bool write) {
+    assert(!compiled_);
+    assert(pass < passes_.size() && resource < resources_.size());
+
+    std::vector<Access>& accesses = passes_[pass].accesses;
+    assert(std::none_of(accesses.begin(), accesses.end(), [&](const Access& access) { return access.resource == resource; }) &&
+           "A pass can only access a resource once.");
+
+    accesses.push_back({resource, state, write});
+}
+
+void FrameGraph::Compile() {
+    assert(!compiled_ && "Already compiled.");
+
+    CullPasses();
+    SortPasses();
+    BuildBarriers();
+
+    compiled_ = true;
+}
+
+void FrameGraph::CullPasses() {
+    // back to front: a pass is needed if it writes something a later needed pass reads (or an output)
+    std::vector<bool> needed(resources_.size());
+    for(uint32_t i = 0; i < resources_.size(); i++) {
+        needed[i] = resources_[i].isOutput;
+    }
+
+    for(uint32_t i = (uint32_t)passes_.size(); i-- > 0;) {
+        Pass& pass = passes_[i];
+
+        bool live = pass.hasSideEffects;
+        for(const Access& access : pass.accesses) {
+            live = live || (access.write && needed[access.resource]);
+        }
+
+        pass.culled = !live;
+        if(!live) {
+            continue;
+        }
+
+        for(const Access& access : pass.accesses) {
+            if(!access.write) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void FrameGraph::SortPasses() {
+    std::vector<uint32_t> lastExclusive(resources_.size(), InvalidIndex);
+    std::vector<std::vector<uint32_t>> readersSinceExclusive(resources_.size());
+
+    uint32_t numLevels = 0;
+
+    for(uint32_t i = 0; i < passes_.size(); i++) {
+        Pass& pass = passes_[i];
+        if(pass.culled) {
+            continue;
+        }
+
+        uint32_t level = 0;
+        auto dependOn = [&](uint32_t other) {
+            level = std::max(level, passes_[other].level + 1);
+        };
+
+        for(const Access& access : pass.accesses) {
+            if(lastExclusive[access.resource] != InvalidIndex) {
+                dependOn(lastExclusive[access.resource]);
+            }
+
+            if(IsExclusive(access.state, access.write)) {
+                for(uint32_t reader : readersSinceExclusive[access.resource]) {
+                    dependOn(reader);
+                }
+                lastExclusive[access.resource] = i;
+                readersSinceExclusive[access.resource].clear();
+            }
+            else {
+                readersSinceExclusive[access.resource].push_back(i);
+            }
+        }
+
+        pass.level = level;
+        numLevels = std::max(numLevels, level + 1);
+        order_.push_back(i);
+    }
+
+    // dependencies always point to passes declared earlier, so this is a valid order
+    std::stable_sort(order_.begin(), order_.end(), [&](uint32_t a, uint32_t b) {
+        return passes_[a].level < passes_[b].level;
+    });
+
+    stats_.numPasses = (uint32_t)passes_.size();
+    stats_.numCulledPasses = (uint32_t)(passes_.size() - order_.size());
+    stats_.numLevels = numLevels;
+}
+
+void FrameGraph::BuildBarriers() {
+    struct ResourceAccess {
+        uint32_t level;
+        Access access;
+    };
+
+    std::vector<std::vector<ResourceAccess>> accessesByResource(resources_.size());
+    for(uint32_t passIndex : order_) {
+        for(const Access& access : passes_[passIndex].accesses) {
+            accessesByResource[access.resource].push_back({passes_[passIndex].level, access});
+        }
+    }
+
+    std::vector<std::vector<FrameGraphBarrier>> levelBarriers(stats_.numLevels);
+
+    for(uint32_t r = 0; r < resources_.size(); r++) {
+        const std::vector<ResourceAccess>& accesses = accessesByResource[r];
+
+        FrameGraphStates state = resources_[r].initialState;
+        bool hasPrevious = false;
+        bool previousWrote = false;
+        uint32_t previousLevel = 0;
+
+        size_t i = 0;
+        while(i < accesses.size()) {
+            const uint32_t level = accesses[i].level;
+
+            size_t levelEnd = i;
+            while(levelEnd < accesses.size() && accesses[levelEnd].level == level) {
+                levelEnd++;
+            }
+
+            const Access& first = accesses[i].access;
+            const bool exclusive = IsExclusive(first.state, first.write);
+            assert((!exclusive || levelEnd - i == 1) && "Exclusive accesses can't share a level.");
+
+            FrameGraphStates levelStates = 0;
+            for(size_t j = i; j < levelEnd; j++) {
+                levelStates |= accesses[j].access.state;
+            }
+
+            FrameGraphStates required = levelStates;
+            if(!exclusive) {
+                // every read-only state until the next exclusive access, so later reads need no barrier
+                size_t next = levelEnd;
+                while(next < accesses.size() && !IsExclusive(accesses[next].access.state, accesses[next].access.write)) {
+                    required |= accesses[next].access.state;
+                    next++;
+                }
+            }
+
+            const bool alreadyReadable = !exclusive && frame_graph_states::IsReadOnly(state) && (state & levelStates) == levelStates;
+
+            if(alreadyReadable) {
+                // an earlier transition already included this state
+            }
+            else if(state != required) {
+                // nothing uses the resource in the levels in between
+                const uint32_t beginLevel = hasPrevious ? previousLevel + 1 : 0;
+                if(beginLevel < level) {
+                    levelBarriers[beginLevel].push_back({FrameGraphBarrier::Type::Transition, r, state, required, FrameGraphBarrier::Split::Begin});
+                    levelBarriers[level].push_back({FrameGraphBarrier::Type::Transition, r, state, required, FrameGraphBarrier::Split::End});
+                }
+                else {
+                    levelBarriers[level].push_back({FrameGraphBarrier::Type::Transition, r, state, required});
+                }
+                state = required;
+            }
+            else if(state == frame_graph_states::UnorderedAccess && hasPrevious && (previousWrote || first.write)) {
+                levelBarriers[level].push_back({FrameGraphBarrier::Type::UAV, r, state, state});
+            }
+
+            hasPrevious = true;
+            previousWrote = first.write;
+            previousLevel = level;
+            i = levelEnd;
+        }
+
+        resources_[r].finalState = state;
+    }
+
+    // the first pass of every level issues the level's batch
+    uint32_t prevLevel = InvalidIndex;
+    for(uint32_t passIndex : order_) {
+        Pass& pass = passes_[passIndex];
+        if(pass.level == prevLevel) {
+            continue;
+        }
+        prevLevel = pass.level;
+
+        pass.barriers = std::move(levelBarriers[pass.level]);
+        if(pass.barriers.empty()) {
+            continue;
+        }
+
+        stats_.numBarrierBatches++;
+        for(const FrameGraphBarrier& barrier : pass.barriers) {
+            if(barrier.type == FrameGraphBarrier::Type::UAV) {
+                stats_.numUAVBarriers++;
+            }
+            else if(barrier.split == FrameGraphBarrier::Split::None) {
+                stats_.numTransitions++;
+            }
+            else if(barrier.split == FrameGraphBarrier::Split::Begin) {
+                stats_.numTransitions++;
+                stats_.numSplitTransitions++;
+            }
+        }
+    }
+}
+
+void FrameGraph::Execute(FrameGraphCommandList& cmdList) const {
+    assert(compiled_ && "Compile the graph first.");
+
+    for(uint32_t passIndex : order_) {
+        ExecutePass(passIndex, cmdList);
+    }
+}
+
+void FrameGraph::ExecutePass(uint32_t passIndex, FrameGraphCommandList& cmdList) const {
+    assert(compiled_ && "Compile the graph first.");
+
+    const Pass& pass = passes_[passIndex];
+    assert(!pass.culled);
+
+    if(!pass.barriers.empty()) {
+        cmdList.ResourceBarriers(pass.barriers);
+    }
+
+    cmdList.BeginPass(pass.name);
+    if(pass.execute) {
+        pass.execute(cmdList);
+    }
+    cmdList.EndPass();
+}
+
+FrameGraphStates FrameGraph::GetFinalState(uint32_t resource) const {
+    assert(compiled_);
+    return resources_[resource].finalState;
+}
+
+bool FrameGraph::IsCulled(uint32_t pass) const {
+    assert(compiled_);
+    return passes_[pass].culled;
+}
+
+void FrameGraph::PrintPlan() const {
+    std::cout << "Frame graph (" << stats_.numPasses << " passes, " << stats_.numCulledPasses << " culled, "
+              << stats_.numLevels << " levels):" << std::endl;
+
+    for(uint32_t passIndex : order_) {
+        const Pass& pass = passes_[passIndex];
+        for(const FrameGraphBarrier& barrier : pass.barriers) {
+            std::cout << "    barrier " << resources_[barrier.resource].name << ": ";
+            if(barrier.type == FrameGraphBarrier::Type::Transition) {
+                std::cout << frame_graph_states::ToString(barrier.before) << " -> "
+                          << frame_graph_states::ToString(barrier.after) << SplitSuffix(barrier.split) << std::endl;
+            }
+            else {
+                std::cout << "UAV" << std::endl;
+            }
+        }
+        std::cout << "  [" << pass.level << "] " << pass.name << std::endl;
+    }
+
+    for(const Pass& pass : passes_) {
+        if(pass.culled) {
+            std::cout << "  culled " << pass.name << std::endl;
+        }
+    }
+
+    std::cout << "  " << stats_.numTransitions << " transitions (" << stats_.numSplitTransitions << " split) and " << stats_.numUAVBarriers << " UAV barriers in "
+              << stats_.numBarrierBatches << " batches" << std::endl;
+}
+
+void RecordingFrameGraphCommandList::ResourceBarriers(const std::vector<FrameGraphBarrier>& barriers) {
+    batches_.push_back(barriers);
+
+    events_.push_back("barriers");
+    for(const FrameGraphBarrier& barrier : barriers) {
+        if(barrier.type == FrameGraphBarrier::Type::Transition) {
+            events_.push_back("  " + graph_.GetResourceName(barrier.resource) + ": " +
+                              frame_graph_states::ToString(barrier.before) + " -> " +
+                              frame_graph_states::ToString(barrier.after) + SplitSuffix(barrier.split));
+        }
+        else {
+            events_.push_back("  " + graph_.GetResourceName(barrier.resource) + ": UAV");
+        }
+    }
+}
+
+void RecordingFrameGraphCommandList::BeginPass(const std::string& name) {
+    events_.push_back("pass " + name);
+}
+
+void RecordingFrameGraphCommandList::PrintEvents() const {
+    for(const std::string& event : events_) {
+        std::cout << event << std::endl;
+    }
+}
@@ -0,0 +1,220 @@
+﻿#ifndef RENDERER_FRAME_GRAPH_H_
+#define RENDERER_FRAME_GRAPH_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Same bits as D3D12_RESOURCE_STATES (frame_graph_d3d12.cpp checks), so the graph
+// itself doesn't need the D3D12 headers. States can be or'd like the D3D12 ones.
+typedef uint32_t FrameGraphStates;
+
+namespace frame_graph_states {
+    constexpr FrameGraphStates Common = 0x0;
+    constexpr FrameGraphStates VertexAndConstantBuffer = 0x1;
+    constexpr FrameGraphStates IndexBuffer = 0x2;
+    constexpr FrameGraphStates RenderTarget = 0x4;
+    constexpr FrameGraphStates UnorderedAccess = 0x8;
+    constexpr FrameGraphStates DepthWrite = 0x10;
+    constexpr FrameGraphStates DepthRead = 0x20;
+    constexpr FrameGraphStates NonPixelShaderResource = 0x40;
+    constexpr FrameGraphStates PixelShaderResource = 0x80;
+    constexpr FrameGraphStates IndirectArgument = 0x200;
+    constexpr FrameGraphStates CopyDest = 0x400;
+    constexpr FrameGraphStates CopySource = 0x800;
+    constexpr FrameGraphStates Present = 0x0;
+
+    constexpr FrameGraphStates AllShaderResource = NonPixelShaderResource | PixelShaderResource;
+
+    // states that can be combined with each other, everything else has to be the only bit set
+    constexpr FrameGraphStates ReadOnly = VertexAndConstantBuffer | IndexBuffer | DepthRead |
+                                          AllShaderResource | IndirectArgument | CopySource;
+
+    bool IsReadOnly(FrameGraphStates states);
+
+    // "PixelShaderResource|NonPixelShaderResource"
+    std::string ToString(FrameGraphStates states);
+}
+
+struct FrameGraphBarrier {
+    enum class Type {
+        Transition,
+        UAV // UAV accesses before and after have to be ordered, before == after
+    };
+
+    // halves of a split transition (D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY/END_ONLY), same before and after
+    enum class Split {
+        None,
+        Begin,
+        End
+    };
+
+    Type type;
+    uint32_t resource;
+    FrameGraphStates before;
+    FrameGraphStates after;
+    Split split = Split::None;
+};
+
+//
+// What the graph records into. The D3D12 one is in frame_graph_d3d12.h,
+// RecordingFrameGraphCommandList below only logs, for checking a schedule without a device.
+//
+class FrameGraphCommandList {
+public:
+    virtual ~FrameGraphCommandList() {}
+
+    // one ResourceBarrier call, never empty
+    virtual void ResourceBarriers(const std::vector<FrameGraphBarrier>& barriers) = 0;
+    virtual void BeginPass(const std::string&) {}
+    virtual void EndPass() {}
+};
+
+//
+// Per frame pass graph that derives the resource barriers between passes.
+//
+//   FrameGraph graph;
+//   uint32_t target = graph.ImportResource("main_rt", currentState, true);
+//   uint32_t sky = graph.AddPass("Sky Render", [&](FrameGraphCommandList& cmdList) { ... });
+//   graph.Write(sky, target, frame_graph_states::RenderTarget);
+//   graph.Compile();
+//   graph.Execute(cmdList);
+//
+// Passes are declared in an order that's valid to run in, with the state every resource
+// has to be in for them. Compile():
+// - culls passes that don't contribute to an output resource or a pass with side effects.
+//   Writes count as partial, so earlier writers of a resource that's needed stay too.
+// - sorts the rest by dependency level (read after write, write after read, write after write),
+//   declaration order within a level, so independent passes end up next to each other.
+// - derives the barriers, all the barriers of a level go out in one batch before its first pass.
+//   A resource that's read in several read-only states until its next write is transitioned
+//   once into their union. Back to back UAV accesses get a UAV barrier if either one writes.
+// - splits transitions of resources that sit unused for at least one level: the begin goes out
+//   with the batch after the last use, the end with the batch before the next one.
+//
+// Accesses in a state that isn't read-only (a UAV that's only read) are ordered like writes,
+// since passes of the same level share one state per resource.
+//
+// Passes only depend on the barriers before them, so they can be recorded in any order or
+// concurrently with ExecutePass, as long as the recorded commands run in GetPassOrder() order.
+//
+class FrameGraph {
+public:
+    static constexpr uint32_t InvalidIndex = ~0u;
+
+    struct Access {
+        uint32_t resource;
+        FrameGraphStates state;
+        bool write;
+    };
+
+    struct Stats {
+        uint32_t numPasses = 0;
+        uint32_t numCulledPasses = 0;
+        uint32_t numLevels = 0;
+        uint32_t numBarrierBatches = 0; // ResourceBarriers calls
+        uint32_t numTransitions = 0;
+        uint32_t numSplitTransitions = 0; // also in numTransitions
+        uint32_t numUAVBarriers = 0;
+    };
+
+    // currentState is the state the resource is in when the graph starts executing,
+    // passes writing an output resource are never culled
+    uint32_t ImportResource(std::string name, FrameGraphStates currentState, bool isOutput = false);
+    // execute gets the command list the pass is recorded into
+    uint32_t AddPass(std::string name, std::function<void(FrameGraphCommandList&)> execute, bool hasSideEffects = false);
+
+    // a pass accesses every resource at most once
+    void Read(uint32_t pass, uint32_t resource, FrameGraphStates state);
+    void Write(uint32_t pass, uint32_t resource, FrameGraphStates state);
+
+    void Compile();
+
+    // runs the passes in compiled order, with their barriers
+    void Execute(FrameGraphCommandList& cmdList) const;
+
+    // one pass of GetPassOrder() with the barriers before it, can be called from any thread
+    void ExecutePass(uint32_t pass, FrameGraphCommandList& cmdList) const;
+
+    // the state each resource is left in after Execute
+    FrameGraphStates GetFinalState(uint32_t resource) const;
+
+    bool IsCulled(uint32_t pass) const;
+
+    // compiled order: passes that run, in order
+    const std::vector<uint32_t>& GetPassOrder() const { return order_; }
+    const Stats& GetStats() const { return stats_; }
+
+    // levels, passes and their barriers
+    void PrintPlan() const;
+
+    uint32_t GetNumResources() const { return (uint32_t)resources_.size(); }
+    const std::string& GetResourceName(uint32_t resource) const { return resources_[resource].name; }
+    const std::string& GetPassName(uint32_t pass) const { return passes_[pass].name; }
+    // in the order they were declared
+    const std::vector<Access>& GetPassAccesses(uint32_t pass) const { return passes_[pass].accesses; }
+
+private:
+    struct Resource {
+        std::string name;
+        FrameGraphStates initialState;
+        FrameGraphStates finalState;
+        bool isOutput;
+    };
+
+    struct Pass {
+        std::string name;
+        std::function<void(FrameGraphCommandList&)> execute;
+        bool hasSideEffects;
+        std::vector<Access> accesses;
+
+        // filled by Compile
+        bool culled = false;
+        uint32_t level = 0;
+        std::vector<FrameGraphBarrier> barriers; // issued right before this pass
+    };
+
+    void AddAccess(uint32_t pass, uint32_t resource, FrameGraphStates state, bool write);
+
+    void CullPasses();
+    void SortPasses();
+    void BuildBarriers();
+
+    std::vector<Resource> resources_;
+    std::vector<Pass> passes_;
+    std::vector<uint32_t> order_;
+    Stats stats_;
+    bool compiled_ = false;
+};
+
+//
+// Logs what the graph records, one line per barrier and pass:
+//
+//   barriers
+//     RT0: PixelShaderResource|NonPixelShaderResource -> RenderTarget
+//   pass Clouds Render
+//
+// Pass callbacks still run, so they can log into the same list with AddEvent.
+//
+class RecordingFrameGraphCommandList : public FrameGraphCommandList {
+public:
+    RecordingFrameGraphCommandList(const FrameGraph& graph) : graph_(graph) {}
+
+    void ResourceBarriers(const std::vector<FrameGraphBarrier>& barriers) override;
+    void BeginPass(const std::string& name) override;
+
+    void AddEvent(std::string event) { events_.push_back(std::move(event)); }
+
+    const std::vector<std::string>& GetEvents() const { return events_; }
+    const std::vector<std::vector<FrameGraphBarrier>>& GetBarrierBatches() const { return batches_; }
+
+    void PrintEvents() const;
+
+private:
+    const FrameGraph& graph_;
+    std::vector<std::string> events_;
+    std::vector<std::vector<FrameGraphBarrier>> batches_;
+};
+
+#endif // RENDERER_FRAME_GRAPH_H_
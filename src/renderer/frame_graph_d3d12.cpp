@@ -0,0 +1,84 @@
+﻿#include "frame_graph_d3d12.h"
+
+#include "renderer.h"
+
+static_assert(frame_graph_states::Common == D3D12_RESOURCE_STATE_COMMON);
+static_assert(frame_graph_states::VertexAndConstantBuffer == D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+static_assert(frame_graph_states::IndexBuffer == D3D12_RESOURCE_STATE_INDEX_BUFFER);
+static_assert(frame_graph_states::RenderTarget == D3D12_RESOURCE_STATE_RENDER_TARGET);
+static_assert(frame_graph_states::UnorderedAccess == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+static_assert(frame_graph_states::DepthWrite == D3D12_RESOURCE_STATE_DEPTH_WRITE);
+static_assert(frame_graph_states::DepthRead == D3D12_RESOURCE_STATE_DEPTH_READ);
+static_assert(frame_graph_states::NonPixelShaderResource == D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+static_assert(frame_graph_states::PixelShaderResource == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+static_assert(frame_graph_states::IndirectArgument == D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+static_assert(frame_graph_states::CopyDest == D3D12_RESOURCE_STATE_COPY_DEST);
+static_assert(frame_graph_states::CopySource == D3D12_RESOURCE_STATE_COPY_SOURCE);
+static_assert(frame_graph_states::Present == D3D12_RESOURCE_STATE_PRESENT);
+
+uint32_t D3D12FrameGraphCommandList::ImportResource(FrameGraph& graph, std::string name, std::shared_ptr<Resource> res, bool isOutput) {
+    WINRT_ASSERT(res);
+
+    const uint32_t index = graph.ImportResource(std::move(name), (FrameGraphStates)res->GetResourceState(), isOutput);
+    if(resources_.size() <= index) {
+        resources_.resize(index + 1);
+    }
+    resources_[index] = std::move(res);
+    return index;
+}
+
+void D3D12FrameGraphCommandList::ResourceBarriers(const std::vector<FrameGraphBarrier>& barriers) {
+    for(const FrameGraphBarrier& barrier : barriers) {
+        WINRT_ASSERT(barrier.resource < resources_.size() && resources_[barrier.resource]);
+        const std::shared_ptr<Resource>& res = resources_[barrier.resource];
+
+        if(barrier.type == FrameGraphBarrier::Type::UAV) {
+            batcher_.UAV(res->GetNativeResource().get());
+        }
+        else if(!tracksResourceStates_) {
+            if(barrier.split != FrameGraphBarrier::Split::Begin) {
+                batcher_.Transition(res->GetNativeResource().get(), (D3D12_RESOURCE_STATES)barrier.before, (D3D12_RESOURCE_STATES)barrier.after);
+            }
+        }
+        else if(barrier.split == FrameGraphBarrier::Split::End) {
+            WINRT_ASSERT(res->GetResourceState() == (D3D12_RESOURCE_STATES)barrier.after);
+            res->EndSplitStateChange(batcher_);
+        }
+        else {
+            // something outside the graph changed the state after it was imported
+            WINRT_ASSERT(res->GetResourceState() == (D3D12_RESOURCE_STATES)barrier.before);
+
+            if(barrier.split == FrameGraphBarrier::Split::Begin) {
+                res->BeginSplitStateChange((D3D12_RESOURCE_STATES)barrier.after, batcher_);
+            }
+            else {
+                res->ChangeState((D3D12_RESOURCE_STATES)barrier.after, batcher_);
+            }
+        }
+    }
+}
+
+void D3D12FrameGraphCommandList::BeginPass(const std::string& name) {
+    batcher_.Flush(cmdList_.get());
+}
+
+winrt::com_ptr<ID3D12GraphicsCommandList> D3D12FrameGraphCommandList::RecordParallel(Renderer& renderer, const FrameGraph& graph, HRESULT& hr) {
+    WINRT_ASSERT(tracksResourceStates_);
+
+    // where the graph leaves everything, the jobs record the transitions in between
+    for(uint32_t i = 0; i < resources_.size(); i++) {
+        if(resources_[i]) {
+            resources_[i]->SetResourceState((D3D12_RESOURCE_STATES)graph.GetFinalState(i));
+        }
+    }
+
+    std::vector<Renderer::RecordJob> jobs;
+    for(uint32_t pass : graph.GetPassOrder()) {
+        jobs.push_back([this, &renderer, &graph, pass](winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) {
+            D3D12FrameGraphCommandList jobCmdList(cmdList, renderer.GetBarrierBatcher(cmdList), resources_);
+            graph.ExecutePass(pass, jobCmdList);
+        });
+    }
+
+    return renderer.RecordParallel(cmdList_, std::move(jobs), hr);
+}
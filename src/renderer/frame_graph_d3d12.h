@@ -0,0 +1,57 @@
+﻿#ifndef RENDERER_FRAME_GRAPH_D3D12_H_
+#define RENDERER_FRAME_GRAPH_D3D12_H_
+
+#include <memory>
+#include <vector>
+
+#include "frame_graph.h"
+#include "resources.h"
+
+class Renderer;
+
+//
+// Records a FrameGraph into a D3D12 command list. Barriers go into the renderer's
+// ResourceBarrierBatcher, which is flushed when a pass begins, so every batch turns into
+// one ResourceBarrier call together with whatever else was pending. Transitions go through
+// Resource::ChangeState, so the resources' tracked state stays in sync with what the graph
+// did and code outside the graph keeps working.
+//
+// RecordParallel records every pass into a command list of its own instead (Renderer::RecordParallel).
+// The graph's state changes are applied to the tracked states up front, so the jobs never touch
+// them. Split transitions can't span lists there, their end becomes a plain transition.
+//
+class D3D12FrameGraphCommandList : public FrameGraphCommandList {
+public:
+    D3D12FrameGraphCommandList(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, ResourceBarrierBatcher& batcher)
+        : cmdList_(cmdList), batcher_(batcher), tracksResourceStates_(true) {}
+
+    // imports res with its current state
+    uint32_t ImportResource(FrameGraph& graph, std::string name, std::shared_ptr<Resource> res, bool isOutput = false);
+
+    void ResourceBarriers(const std::vector<FrameGraphBarrier>& barriers) override;
+    void BeginPass(const std::string& name) override;
+
+    // instead of graph.Execute(*this), same contract as Renderer::RecordParallel:
+    // the list this was made with is closed, keep recording into the returned one
+    winrt::com_ptr<ID3D12GraphicsCommandList> RecordParallel(Renderer& renderer, const FrameGraph& graph, HRESULT& hr);
+
+    winrt::com_ptr<ID3D12GraphicsCommandList> GetNativeCommandList() const { return cmdList_; }
+
+    // for pass callbacks, the native list behind the one they get
+    static winrt::com_ptr<ID3D12GraphicsCommandList> GetNativeCommandList(FrameGraphCommandList& cmdList) {
+        return static_cast<D3D12FrameGraphCommandList&>(cmdList).cmdList_;
+    }
+
+private:
+    // a parallel job's list
+    D3D12FrameGraphCommandList(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, ResourceBarrierBatcher& batcher,
+                               const std::vector<std::shared_ptr<Resource>>& resources)
+        : cmdList_(cmdList), batcher_(batcher), tracksResourceStates_(false), resources_(resources) {}
+
+    winrt::com_ptr<ID3D12GraphicsCommandList> cmdList_;
+    ResourceBarrierBatcher& batcher_;
+    bool tracksResourceStates_;
+    std::vector<std::shared_ptr<Resource>> resources_; // by graph resource index
+};
+
+#endif // RENDERER_FRAME_GRAPH_D3D12_H_
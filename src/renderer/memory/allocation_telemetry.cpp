@@ -0,0 +1,219 @@
+﻿#include "allocation_telemetry.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+
+namespace {
+    std::string EscapeJson(const std::string& str) {
+        std::ostringstream out;
+        for(const char c : str) {
+            switch(c) {
+                case '"': out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\r': out << "\\r"; break;
+                case '\t': out << "\\t"; break;
+                default:
+                    if((unsigned char)c < 0x20) {
+                        out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+                    }
+                    else {
+                        out << c;
+                    }
+            }
+        }
+        return out.str();
+    }
+
+    // minimal writer, just enough for the snapshot: keeps track of commas and indentation
+    class JsonWriter {
+    public:
+        JsonWriter() {
+            out_ << std::fixed << std::setprecision(4);
+        }
+
+        void BeginObject(const char* key = nullptr) { Begin(key, '{'); }
+        void EndObject() { End('}'); }
+        void BeginArray(const char* key) { Begin(key, '['); }
+        void EndArray() { End(']'); }
+
+        template<typename T>
+        void Value(const char* key, const T& value) {
+            Key(key);
+            out_ << value;
+        }
+
+        void Value(const char* key, const std::string& value) {
+            Key(key);
+            out_ << '"' << EscapeJson(value) << '"';
+        }
+
+        std::string GetString() const { return out_.str() + "\n"; }
+
+    private:
+        void Key(const char* key) {
+            if(!isFirst_) {
+                out_ << ',';
+            }
+            isFirst_ = false;
+
+            if(depth_ > 0) {
+                out_ << '\n' << std::string(depth_ * 2, ' ');
+            }
+            if(key) {
+                out_ << '"' << key << "\": ";
+            }
+        }
+
+        void Begin(const char* key, char bracket) {
+            Key(key);
+            out_ << bracket;
+            depth_++;
+            isFirst_ = true;
+        }
+
+        void End(char bracket) {
+            depth_--;
+            if(!isFirst_) {
+                out_ << '\n' << std::string(depth_ * 2, ' ');
+            }
+            out_ << bracket;
+            isFirst_ = false;
+        }
+
+        std::ostringstream out_;
+        uint32_t depth_ = 0;
+        bool isFirst_ = true;
+    };
+}
+
+uint64_t MemoryAllocatorTelemetry::GetResourceReservedBytes() const {
+    return std::accumulate(resources.begin(), resources.end(), uint64_t(0),
+                           [](uint64_t sum, const ResourceMemoryTelemetry& res) { return sum + res.reservedBytes; });
+}
+
+uint64_t MemoryAllocatorTelemetry::GetResourceUsedBytes() const {
+    return std::accumulate(resources.begin(), resources.end(), uint64_t(0),
+                           [](uint64_t sum, const ResourceMemoryTelemetry& res) { return sum + res.usedBytes; });
+}
+
+std::string AllocationTelemetrySnapshot::ToJson() const {
+    JsonWriter json;
+    json.BeginObject();
+    json.Value("fenceValue", fenceValue);
+
+    json.BeginArray("memoryAllocators");
+    for(const MemoryAllocatorTelemetry& allocator : memoryAllocators) {
+        json.BeginObject();
+        json.Value("name", allocator.name);
+        json.Value("reservedBytes", allocator.reservedBytes);
+        json.Value("resourceReservedBytes", allocator.GetResourceReservedBytes());
+        json.Value("resourceUsedBytes", allocator.GetResourceUsedBytes());
+        json.Value("alignmentWasteBytes", allocator.GetAlignmentWaste());
+
+        json.BeginObject("heap");
+        json.Value("size", allocator.heapSize);
+        json.Value("freeBytes", allocator.heapFreeBytes);
+        json.Value("largestFreeBlock", allocator.heapLargestFreeBlock);
+        json.Value("numFreeBlocks", allocator.heapNumFreeBlocks);
+        json.Value("fragmentation", allocator.heapFragmentation);
+        json.EndObject();
+
+        json.BeginArray("resources");
+        for(const ResourceMemoryTelemetry& res : allocator.resources) {
+            json.BeginObject();
+            json.Value("id", res.id);
+            json.Value("kind", res.kind);
+            json.Value("reservedBytes", res.reservedBytes);
+            json.Value("usedBytes", res.usedBytes);
+            json.Value("alignmentWasteBytes", res.GetAlignmentWaste());
+            json.EndObject();
+        }
+        json.EndArray();
+
+        json.BeginArray("ringBuffers");
+        for(const RingBufferTelemetry& ring : allocator.ringBuffers) {
+            json.BeginObject();
+            json.Value("name", ring.name);
+            json.Value("size", ring.size);
+            json.Value("usedBytes", ring.usedBytes);
+            json.EndObject();
+        }
+        json.EndArray();
+
+        json.EndObject();
+    }
+    json.EndArray();
+
+    json.BeginArray("descriptorHeaps");
+    for(const DescriptorHeapTelemetry& heap : descriptorHeaps) {
+        json.BeginObject();
+        json.Value("name", heap.name);
+        json.Value("numDescriptors", heap.numDescriptors);
+        json.Value("numAllocations", heap.numAllocations);
+        json.Value("numAllocatedDescriptors", heap.numAllocatedDescriptors);
+        json.Value("numCachedDescriptors", heap.numCachedDescriptors);
+        json.Value("numFreeDescriptors", heap.numFreeDescriptors);
+        json.Value("largestFreeRange", heap.largestFreeRange);
+        json.Value("numFreeRanges", heap.numFreeRanges);
+        json.Value("numPendingFrees", heap.numPendingFrees);
+        json.Value("occupancy", heap.GetOccupancy());
+        json.EndObject();
+    }
+    json.EndArray();
+
+    json.EndObject();
+    return json.GetString();
+}
+
+bool AllocationTelemetrySnapshot::WriteJson(const std::filesystem::path& path) const {
+    std::error_code ec;
+    if(path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+
+    std::ofstream out(path, std::ios::trunc);
+    if(!out) {
+        return false;
+    }
+
+    out << ToJson();
+    return out.good();
+}
+
+uint64_t GetResourcePayloadSize(ID3D12Device* device, const D3D12_RESOURCE_DESC& desc) {
+    if(desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) {
+        return desc.Width;
+    }
+
+    const uint32_t numMips = desc.MipLevels > 0 ? desc.MipLevels : 1;
+    const uint32_t numSlices = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+    const uint32_t numSubresources = numMips * numSlices;
+
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(numSubresources);
+    std::vector<UINT> numRows(numSubresources);
+    std::vector<UINT64> rowSizes(numSubresources);
+    device->GetCopyableFootprints(&desc, 0, numSubresources, 0, footprints.data(), numRows.data(), rowSizes.data(), nullptr);
+
+    // the footprints' row pitch is padded for copies, only the rows themselves count
+    uint64_t size = 0;
+    for(uint32_t i = 0; i < numSubresources; i++) {
+        size += rowSizes[i] * numRows[i] * footprints[i].Footprint.Depth;
+    }
+
+    return size;
+}
+
+ResourceMemoryTelemetry GetCommittedResourceTelemetry(ID3D12Device* device, std::string id, const D3D12_RESOURCE_DESC& desc) {
+    const D3D12_RESOURCE_ALLOCATION_INFO allocInfo = device->GetResourceAllocationInfo(0, 1, &desc);
+
+    ResourceMemoryTelemetry telemetry;
+    telemetry.id = std::move(id);
+    telemetry.kind = "committed";
+    telemetry.reservedBytes = allocInfo.SizeInBytes;
+    telemetry.usedBytes = std::min(GetResourcePayloadSize(device, desc), allocInfo.SizeInBytes);
+    return telemetry;
+}
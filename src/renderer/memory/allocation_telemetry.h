@@ -0,0 +1,88 @@
+﻿#ifndef RENDERER_MEMORY_ALLOCATION_TELEMETRY_H_
+#define RENDERER_MEMORY_ALLOCATION_TELEMETRY_H_
+
+#include <d3d12.h>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+//
+// Snapshot of where GPU memory and descriptors went, gathered on demand (see
+// Renderer::GetAllocationTelemetry()). Nothing here is tracked per frame, every allocator
+// fills in its part from the bookkeeping it has anyway.
+//
+// Sizes per resource:
+//   reservedBytes - what the resource takes out of its heap (placement size, incl. alignment)
+//   usedBytes     - what its data actually needs (buffer width, or the rows of every subresource)
+// the difference is what's lost to placement alignment and the driver's texture layout.
+//
+
+struct ResourceMemoryTelemetry {
+    std::string id;
+    std::string kind; // "placed" or "committed"
+    uint64_t reservedBytes = 0;
+    uint64_t usedBytes = 0;
+
+    uint64_t GetAlignmentWaste() const { return reservedBytes - usedBytes; }
+};
+
+struct RingBufferTelemetry {
+    std::string name;
+    uint64_t size = 0;
+    uint64_t usedBytes = 0; // frames in flight included
+};
+
+struct MemoryAllocatorTelemetry {
+    std::string name;
+
+    // held from the device: heaps and committed resources
+    uint64_t reservedBytes = 0;
+
+    // placed heap, 0 if there's none yet (before Commit())
+    uint64_t heapSize = 0;
+    uint64_t heapFreeBytes = 0;
+    uint64_t heapLargestFreeBlock = 0;
+    uint32_t heapNumFreeBlocks = 0;
+    double heapFragmentation = 0.0;
+
+    std::vector<ResourceMemoryTelemetry> resources;
+    std::vector<RingBufferTelemetry> ringBuffers;
+
+    uint64_t GetResourceReservedBytes() const;
+    uint64_t GetResourceUsedBytes() const;
+    uint64_t GetAlignmentWaste() const { return GetResourceReservedBytes() - GetResourceUsedBytes(); }
+};
+
+struct DescriptorHeapTelemetry {
+    std::string name;
+    uint32_t numDescriptors = 0;
+
+    uint32_t numAllocations = 0;
+    uint32_t numAllocatedDescriptors = 0; // in live allocations
+    uint32_t numCachedDescriptors = 0;    // sitting unused in per-thread pages
+    uint32_t numFreeDescriptors = 0;      // pending frees not included
+    uint32_t largestFreeRange = 0;
+    uint32_t numFreeRanges = 0;
+    uint32_t numPendingFrees = 0;         // ranges waiting for their fence
+
+    double GetOccupancy() const { return numDescriptors > 0 ? (double)numAllocatedDescriptors / numDescriptors : 0.0; }
+};
+
+struct AllocationTelemetrySnapshot {
+    uint64_t fenceValue = 0; // last fence value signaled on the main queue when this was taken
+
+    std::vector<MemoryAllocatorTelemetry> memoryAllocators;
+    std::vector<DescriptorHeapTelemetry> descriptorHeaps;
+
+    std::string ToJson() const;
+    bool WriteJson(const std::filesystem::path& path) const;
+};
+
+// how many bytes of a resource with this desc carry data, without any padding
+uint64_t GetResourcePayloadSize(ID3D12Device* device, const D3D12_RESOURCE_DESC& desc);
+
+// a committed resource: reserved is what the device needs for it, so includes its alignment
+ResourceMemoryTelemetry GetCommittedResourceTelemetry(ID3D12Device* device, std::string id, const D3D12_RESOURCE_DESC& desc);
+
+#endif // RENDERER_MEMORY_ALLOCATION_TELEMETRY_H_
@@ -0,0 +1,249 @@
+﻿#include "directx/d3dx12.h"
+#include "chunked_uploader.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "multithreading/work_stealing_scheduler.h"
+
+namespace {
+    // upper bound for one copy command, keeps a single chunk from hogging the staging ring
+    const uint64_t ChunkSize = 1024 * 1024;
+
+    const uint64_t BufferChunkAlignment = 256;
+}
+
+ChunkedUploader::ChunkedUploader(winrt::com_ptr<ID3D12Device> device, uint64_t stagingSize, uint64_t frameBudget)
+    : device_(device), staging_(device, stagingSize, L"Upload Staging Ring"), frameBudget_(frameBudget), copyFenceValue_(0) {
+    WINRT_ASSERT(ChunkSize <= stagingSize);
+
+    HRESULT hr = device_->CreateFence(0, D3D12_FENCE_FLAG_NONE, __uuidof(ID3D12Fence), copyFence_.put_void());
+    winrt::check_hresult(hr);
+}
+
+ChunkedUploader::~ChunkedUploader() {
+    // the copy queue may still read from the staging ring
+    if(copyFence_->GetCompletedValue() < copyFenceValue_) {
+        HANDLE fenceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        WINRT_ASSERT(fenceEvent);
+
+        copyFence_->SetEventOnCompletion(copyFenceValue_, fenceEvent);
+        WaitForSingleObject(fenceEvent, INFINITE); // block
+        CloseHandle(fenceEvent);
+    }
+}
+
+void ChunkedUploader::Enqueue(std::shared_ptr<Resource> res) {
+    WINRT_ASSERT(res->HasNativeResource() && res->IsUploadNeeded());
+
+    std::packaged_task<void()> prepare([res]() {
+        res->PrepareUpload();
+    });
+
+    PendingUpload upload;
+    upload.res = res;
+    upload.prepared = prepare.get_future().share();
+    pending_.push_back(std::move(upload));
+
+    if(std::shared_ptr<WorkStealingScheduler> scheduler = scheduler_.lock()) {
+        scheduler->AddTask(std::move(prepare));
+    }
+    else {
+        prepare();
+    }
+}
+
+void ChunkedUploader::Update(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, winrt::com_ptr<ID3D12CommandQueue> cmdQueue) {
+    UploadBatch batch;
+    uint64_t budget = frameBudget_;
+    uint64_t numChunks = 0;
+    bool isStalled = false;
+
+    for(auto it = pending_.begin(); it != pending_.end() && !isStalled;) {
+        PendingUpload& upload = *it;
+
+        // still being prepared, the ones behind it may be done already
+        if(upload.prepared.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+
+        if(!upload.isStarted) {
+            StartUpload(upload);
+        }
+
+        while(upload.subresource < upload.data.size()) {
+            if(!StageChunk(upload, cmdList.get(), budget)) {
+                isStalled = true;
+                break;
+            }
+            numChunks++;
+        }
+
+        if(isStalled) {
+            break;
+        }
+
+        // everything is in the staging ring, the source isn't needed anymore
+        upload.res->FinishUpload();
+        batch.finished.push_back(upload.res);
+        it = pending_.erase(it);
+    }
+
+    cmdList->Close();
+
+    if(numChunks == 0) {
+        return;
+    }
+
+    ID3D12CommandList* const cmdLists[] = {
+        cmdList.get()
+    };
+    cmdQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+
+    copyFenceValue_++;
+    cmdQueue->Signal(copyFence_.get(), copyFenceValue_);
+    staging_.FinishFrame(copyFenceValue_);
+
+    batch.fenceValue = copyFenceValue_;
+    batches_.push_back(std::move(batch));
+}
+
+void ChunkedUploader::ReleaseCompletedBatches() {
+    const uint64_t completedFenceValue = copyFence_->GetCompletedValue();
+
+    while(!batches_.empty() && batches_.front().fenceValue <= completedFenceValue) {
+        for(std::shared_ptr<Resource>& res : batches_.front().finished) {
+            res->SetIsReady(true);
+        }
+        batches_.pop_front();
+    }
+
+    staging_.ReleaseCompletedFrames(completedFenceValue);
+}
+
+void ChunkedUploader::StartUpload(PendingUpload& upload) {
+    // rethrows whatever PrepareUpload() threw on the worker
+    upload.prepared.get();
+
+    upload.data = upload.res->GetUploadData();
+    WINRT_ASSERT(!upload.data.empty());
+
+    const D3D12_RESOURCE_DESC desc = upload.res->GetNativeResource()->GetDesc();
+    if(desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER) {
+        const uint32_t numSubresources = (uint32_t) upload.data.size();
+        upload.footprints.resize(numSubresources);
+        upload.numRows.resize(numSubresources);
+        upload.rowSizes.resize(numSubresources);
+
+        device_->GetCopyableFootprints(&desc, 0, numSubresources, 0,
+                                       upload.footprints.data(), upload.numRows.data(), upload.rowSizes.data(), nullptr);
+    }
+
+    upload.isStarted = true;
+}
+
+bool ChunkedUploader::StageChunk(PendingUpload& upload, ID3D12GraphicsCommandList* cmdList, uint64_t& budget) {
+    if(budget == 0) {
+        return false;
+    }
+
+    if(upload.footprints.empty()) {
+        return StageBufferChunk(upload, cmdList, budget);
+    }
+
+    return StageTextureChunk(upload, cmdList, budget);
+}
+
+bool ChunkedUploader::StageBufferChunk(PendingUpload& upload, ID3D12GraphicsCommandList* cmdList, uint64_t& budget) {
+    const UploadSubresourceData& src = upload.data[upload.subresource];
+    const uint64_t size = src.slicePitch;
+
+    const uint64_t numBytes = std::min({size - upload.position, ChunkSize, budget});
+    const UploadAllocation staged = staging_.Allocate(numBytes, BufferChunkAlignment);
+    if(!staged.IsValid()) {
+        return false;
+    }
+
+    memcpy(staged.cpuAddress, static_cast<const uint8_t*>(src.data) + upload.position, numBytes);
+
+    ID3D12Resource* dst = upload.res->GetNativeResource().get();
+    cmdList->CopyBufferRegion(dst, upload.position, staging_.GetResource(), staged.offset, numBytes);
+
+    upload.position += numBytes;
+    budget -= numBytes;
+
+    if(upload.position == size) {
+        upload.subresource++;
+        upload.position = 0;
+    }
+
+    return true;
+}
+
+bool ChunkedUploader::StageTextureChunk(PendingUpload& upload, ID3D12GraphicsCommandList* cmdList, uint64_t& budget) {
+    const uint32_t subresource = upload.subresource;
+    const UploadSubresourceData& src = upload.data[subresource];
+    const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = upload.footprints[subresource];
+
+    const uint32_t rowsPerSlice = upload.numRows[subresource];
+    const uint32_t numSlices = footprint.Footprint.Depth;
+    const uint64_t rowPitch = footprint.Footprint.RowPitch;
+    const uint64_t slicePitch = rowPitch * rowsPerSlice;
+
+    const uint32_t slice = (uint32_t) (upload.position / rowsPerSlice);
+    const uint32_t firstRow = (uint32_t) (upload.position % rowsPerSlice);
+
+    // whole slices if they fit, otherwise rows of one slice; at least one row, even over budget
+    const uint64_t limit = std::min(ChunkSize, budget);
+    uint32_t chunkRows;
+    uint32_t chunkSlices;
+    if(firstRow == 0 && slicePitch <= limit) {
+        chunkRows = rowsPerSlice;
+        chunkSlices = (uint32_t) std::min<uint64_t>(numSlices - slice, limit / slicePitch);
+    }
+    else {
+        chunkRows = (uint32_t) std::min<uint64_t>(rowsPerSlice - firstRow, std::max<uint64_t>(1, limit / rowPitch));
+        chunkSlices = 1;
+    }
+
+    const uint64_t numBytes = rowPitch * chunkRows * chunkSlices;
+    const UploadAllocation staged = staging_.Allocate(numBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    if(!staged.IsValid()) {
+        return false;
+    }
+
+    // source rows are tightly packed (or use the source's pitches), staged rows are D3D12_TEXTURE_DATA_PITCH_ALIGNMENT aligned
+    uint8_t* dst = static_cast<uint8_t*>(staged.cpuAddress);
+    for(uint32_t z = 0; z < chunkSlices; z++) {
+        const uint8_t* srcSlice = static_cast<const uint8_t*>(src.data) + (slice + z) * src.slicePitch;
+        for(uint32_t y = 0; y < chunkRows; y++) {
+            memcpy(dst + z * slicePitch + y * rowPitch,
+                   srcSlice + (firstRow + y) * src.rowPitch,
+                   upload.rowSizes[subresource]);
+        }
+    }
+
+    // a row is a row of blocks for block compressed formats
+    const uint32_t texelsPerRow = footprint.Footprint.Height / rowsPerSlice;
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT chunkFootprint = footprint;
+    chunkFootprint.Offset = staged.offset;
+    chunkFootprint.Footprint.Height = chunkRows * texelsPerRow;
+    chunkFootprint.Footprint.Depth = chunkSlices;
+
+    ID3D12Resource* dstRes = upload.res->GetNativeResource().get();
+    CD3DX12_TEXTURE_COPY_LOCATION dstLoc = CD3DX12_TEXTURE_COPY_LOCATION(dstRes, subresource);
+    CD3DX12_TEXTURE_COPY_LOCATION srcLoc = CD3DX12_TEXTURE_COPY_LOCATION(staging_.GetResource(), chunkFootprint);
+    cmdList->CopyTextureRegion(&dstLoc, 0, firstRow * texelsPerRow, slice, &srcLoc, NULL);
+
+    upload.position += (uint64_t) chunkRows * chunkSlices;
+    budget -= std::min(budget, numBytes);
+
+    if(upload.position == (uint64_t) rowsPerSlice * numSlices) {
+        upload.subresource++;
+        upload.position = 0;
+    }
+
+    return true;
+}
@@ -0,0 +1,91 @@
+﻿#ifndef RENDERER_MEMORY_CHUNKED_UPLOADER_H_
+#define RENDERER_MEMORY_CHUNKED_UPLOADER_H_
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "resources.h"
+#include "upload_ring_buffer.h"
+
+class WorkStealingScheduler;
+
+//
+// Staged uploads of static resources (images, static buffers, baked volumes):
+//   1. Resource::PrepareUpload() (e.g. image decoding) runs on the task scheduler,
+//   2. prepared data is copied into a bounded staging ring in chunks of whole rows (bytes for
+//      buffers), with one copy command recorded per chunk,
+//   3. a resource is ready once the copy fence of the batch holding its last chunk completed.
+//
+// Every Update() stages at most frameBudget bytes, a large texture is spread over a few frames
+// instead of stalling one. Uploads that don't fit the staging ring wait for earlier batches.
+//
+class ChunkedUploader {
+public:
+    ChunkedUploader(winrt::com_ptr<ID3D12Device> device, uint64_t stagingSize, uint64_t frameBudget);
+    ~ChunkedUploader();
+
+    ChunkedUploader(const ChunkedUploader&) = delete;
+    ChunkedUploader& operator=(const ChunkedUploader&) = delete;
+
+    // without a scheduler, uploads are prepared on the calling thread
+    void SetTaskScheduler(std::shared_ptr<WorkStealingScheduler> scheduler) { scheduler_ = scheduler; }
+
+    // res has to have its native resource
+    void Enqueue(std::shared_ptr<Resource> res);
+
+    // records this frame's chunks into cmdList, closes it and submits it to cmdQueue
+    void Update(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, winrt::com_ptr<ID3D12CommandQueue> cmdQueue);
+
+    // marks the resources of completed batches ready, and gives their staging memory back
+    void ReleaseCompletedBatches();
+
+    // uploads that still have to be recorded
+    bool HasWork() const { return !pending_.empty(); }
+
+    const UploadRingBuffer& GetStagingRing() const { return staging_; }
+
+private:
+    struct PendingUpload {
+        std::shared_ptr<Resource> res;
+        std::shared_future<void> prepared;
+
+        // set up once prepared
+        bool isStarted = false;
+        std::vector<UploadSubresourceData> data;
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints; // empty for buffers
+        std::vector<UINT> numRows;
+        std::vector<UINT64> rowSizes;
+
+        // progress: rows over all slices of the current subresource, bytes for buffers
+        uint32_t subresource = 0;
+        uint64_t position = 0;
+    };
+
+    struct UploadBatch {
+        uint64_t fenceValue;
+        std::vector<std::shared_ptr<Resource>> finished;
+    };
+
+    void StartUpload(PendingUpload& upload);
+
+    // false if the budget or the staging ring is used up
+    bool StageChunk(PendingUpload& upload, ID3D12GraphicsCommandList* cmdList, uint64_t& budget);
+    bool StageBufferChunk(PendingUpload& upload, ID3D12GraphicsCommandList* cmdList, uint64_t& budget);
+    bool StageTextureChunk(PendingUpload& upload, ID3D12GraphicsCommandList* cmdList, uint64_t& budget);
+
+    winrt::com_ptr<ID3D12Device> device_;
+    std::weak_ptr<WorkStealingScheduler> scheduler_;
+
+    UploadRingBuffer staging_;
+    uint64_t frameBudget_;
+
+    winrt::com_ptr<ID3D12Fence> copyFence_;
+    uint64_t copyFenceValue_;
+
+    std::deque<PendingUpload> pending_;
+    std::deque<UploadBatch> batches_;
+};
+
+#endif // RENDERER_MEMORY_CHUNKED_UPLOADER_H_
@@ -3,11 +3,13 @@
 #include <cstdint>
 #include <d3d12.h>
 #include <mutex>
+#include "allocation_telemetry.h"
 #include "renderer_types.h"
 #include <directx/d3dx12_root_signature.h>
 
 class DescriptorAllocator;
 class StaticDescriptorAllocator;
+class PagedDescriptorAllocator;
 
 class DescriptorHeapAllocation {
 public:
@@ -23,11 +25,13 @@ public:
 private:
     friend DescriptorAllocator;
     friend StaticDescriptorAllocator;
+    friend PagedDescriptorAllocator;
     
     
     uint32_t offset_; // offset from heap start, in descriptors
     uint32_t size_;
     uint32_t incrementSize_;
+    uint32_t cacheIndex_ = 0; // PagedDescriptorAllocator's thread cache that owns it
 
     CD3DX12_CPU_DESCRIPTOR_HANDLE cpuHandle_;
     std::optional<CD3DX12_GPU_DESCRIPTOR_HANDLE> gpuHandle_; // parent heap may not be gpu visible
@@ -42,6 +46,16 @@ public:
         {}
 
     virtual std::weak_ptr<DescriptorHeapAllocation> Allocate(uint32_t numDescriptors) = 0;
+
+    // The allocation expires right away, its descriptors are reused once the GPU signaled fenceValue.
+    // Allocators that never give descriptors back ignore this.
+    virtual void Free(std::weak_ptr<DescriptorHeapAllocation> allocation, uint64_t fenceValue) {}
+
+    // frame boundary on the main queue, frees up to completedFenceValue are reclaimed
+    virtual void BeginFrame(uint64_t completedFenceValue) {}
+
+    // occupancy of the heap, outTelemetry.name is left to the caller
+    virtual void GetTelemetry(DescriptorHeapTelemetry& outTelemetry) const = 0;
     
     D3D12_CPU_DESCRIPTOR_HANDLE GetCPUHeapBase() const;
     D3D12_GPU_DESCRIPTOR_HANDLE GetGPUHeapBase() const;
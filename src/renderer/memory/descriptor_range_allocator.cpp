@@ -0,0 +1,100 @@
+﻿#include "descriptor_range_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+DescriptorRangeAllocator::DescriptorRangeAllocator(uint32_t numDescriptors)
+    : size_(numDescriptors), numFree_(0) {
+    if(numDescriptors > 0) {
+        AddFreeRange(0, numDescriptors);
+    }
+}
+
+uint32_t DescriptorRangeAllocator::Allocate(uint32_t numDescriptors) {
+    if(numDescriptors == 0) {
+        return InvalidOffset;
+    }
+
+    const SizeMap::iterator bestFit = freeBySize_.lower_bound(numDescriptors);
+    if(bestFit == freeBySize_.end()) {
+        return InvalidOffset;
+    }
+
+    const uint32_t offset = bestFit->second;
+    const uint32_t rangeSize = bestFit->first;
+    RemoveFreeRange(freeByOffset_.find(offset));
+
+    // the rest of the range stays free
+    if(rangeSize > numDescriptors) {
+        AddFreeRange(offset + numDescriptors, rangeSize - numDescriptors);
+    }
+
+    return offset;
+}
+
+void DescriptorRangeAllocator::Free(uint32_t offset, uint32_t numDescriptors) {
+    assert(numDescriptors > 0 && offset + numDescriptors <= size_);
+
+    uint32_t start = offset;
+    uint32_t end = offset + numDescriptors;
+
+    // merge with the free range right after
+    OffsetMap::iterator next = freeByOffset_.lower_bound(offset);
+    assert((next == freeByOffset_.end() || next->first >= end) && "Freeing a range that's (partly) free already.");
+    if(next != freeByOffset_.end() && next->first == end) {
+        end += next->second;
+        next = std::next(next);
+        RemoveFreeRange(std::prev(next));
+    }
+
+    // and the one right before
+    if(next != freeByOffset_.begin()) {
+        const OffsetMap::iterator prev = std::prev(next);
+        assert(prev->first + prev->second <= start && "Freeing a range that's (partly) free already.");
+        if(prev->first + prev->second == start) {
+            start = prev->first;
+            RemoveFreeRange(prev);
+        }
+    }
+
+    AddFreeRange(start, end - start);
+}
+
+void DescriptorRangeAllocator::FreeDeferred(uint32_t offset, uint32_t numDescriptors, uint64_t fenceValue) {
+    pendingFrees_.push_back({ offset, numDescriptors, fenceValue });
+}
+
+void DescriptorRangeAllocator::ReleaseCompleted(uint64_t completedFenceValue) {
+    // not necessarily in fence order, a range nothing was recorded with can be freed with fence 0
+    std::erase_if(pendingFrees_, [this, completedFenceValue](const PendingFree& pending) {
+        if(pending.fenceValue > completedFenceValue) {
+            return false;
+        }
+
+        Free(pending.offset, pending.numDescriptors);
+        return true;
+    });
+}
+
+uint32_t DescriptorRangeAllocator::GetLargestFreeRange() const {
+    return freeBySize_.empty() ? 0 : freeBySize_.rbegin()->first;
+}
+
+void DescriptorRangeAllocator::AddFreeRange(uint32_t offset, uint32_t numDescriptors) {
+    freeByOffset_.insert({ offset, numDescriptors });
+    freeBySize_.insert({ numDescriptors, offset });
+    numFree_ += numDescriptors;
+}
+
+void DescriptorRangeAllocator::RemoveFreeRange(OffsetMap::iterator it) {
+    // several ranges can have the same size, find the one at this offset
+    auto [first, last] = freeBySize_.equal_range(it->second);
+    const SizeMap::iterator sizeIt = std::find_if(first, last, [&it](const auto& entry) {
+        return entry.second == it->first;
+    });
+    assert(sizeIt != last);
+
+    numFree_ -= it->second;
+    freeBySize_.erase(sizeIt);
+    freeByOffset_.erase(it);
+}
@@ -0,0 +1,59 @@
+﻿#ifndef RENDERER_MEMORY_DESCRIPTOR_RANGE_ALLOCATOR_H_
+#define RENDERER_MEMORY_DESCRIPTOR_RANGE_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+//
+// Free list over a heap of `numDescriptors` descriptors.
+// Allocations take the smallest free range that fits (best fit), freed ranges are merged
+// with their free neighbours right away. Descriptors can't be overwritten while a frame in
+// flight still reads them, FreeDeferred() holds a range back until its fence completed.
+//
+// Only deals with offsets, see PagedDescriptorAllocator for the D3D12 side. Not thread safe.
+//
+class DescriptorRangeAllocator {
+public:
+    static constexpr uint32_t InvalidOffset = ~0u;
+
+    DescriptorRangeAllocator(uint32_t numDescriptors);
+
+    // InvalidOffset if no free range is large enough
+    uint32_t Allocate(uint32_t numDescriptors);
+    void Free(uint32_t offset, uint32_t numDescriptors);
+
+    void FreeDeferred(uint32_t offset, uint32_t numDescriptors, uint64_t fenceValue);
+    void ReleaseCompleted(uint64_t completedFenceValue);
+
+    uint32_t GetSize() const { return size_; }
+    uint32_t GetNumFreeDescriptors() const { return numFree_; }
+    uint32_t GetLargestFreeRange() const;
+    size_t GetNumFreeRanges() const { return freeByOffset_.size(); }
+    size_t GetNumPendingFrees() const { return pendingFrees_.size(); }
+
+private:
+    struct PendingFree {
+        uint32_t offset;
+        uint32_t numDescriptors;
+        uint64_t fenceValue;
+    };
+
+    using OffsetMap = std::map<uint32_t, uint32_t>;
+    using SizeMap = std::multimap<uint32_t, uint32_t>;
+
+    void AddFreeRange(uint32_t offset, uint32_t numDescriptors);
+    void RemoveFreeRange(OffsetMap::iterator it);
+
+    uint32_t size_;
+    uint32_t numFree_;
+
+    // the same free ranges twice: offset -> size for merging, size -> offset for best fit
+    OffsetMap freeByOffset_;
+    SizeMap freeBySize_;
+
+    std::vector<PendingFree> pendingFrees_;
+};
+
+#endif // RENDERER_MEMORY_DESCRIPTOR_RANGE_ALLOCATOR_H_
@@ -3,3 +3,15 @@
 bool MemoryAllocator::DoesResourceExist(std::string id) const {
     return resourceMap_.contains(id);
 }
+
+void MemoryAllocator::DestroyResource(const std::string& id) {
+    const auto it = resourceMap_.find(id);
+    WINRT_ASSERT(it != resourceMap_.end());
+    if(it == resourceMap_.end()) {
+        return;
+    }
+
+    std::shared_ptr<Resource> resource = std::move(it->second);
+    resourceMap_.erase(it);
+    OnResourceDestroyed(std::move(resource));
+}
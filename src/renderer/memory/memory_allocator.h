@@ -5,8 +5,11 @@
 #include <map>
 #include <string>
 #include <memory>
+#include "allocation_telemetry.h"
 #include "resources.h"
 
+class WorkStealingScheduler;
+
 class MemoryAllocator {
 public:
 
@@ -27,11 +30,24 @@ public:
 
     virtual void OnResourceCreated(std::shared_ptr<Resource> newResource) = 0;
 
+    // the allocator lets go of the resource, its memory is reclaimed once the GPU finished the current frame
+    void DestroyResource(const std::string& id);
+
 
     virtual void Update(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList,
                         winrt::com_ptr<ID3D12CommandQueue> cmdQueue) = 0;
 
     virtual bool HasWork() = 0;
+
+    // frame boundaries on the main queue, for memory that's recycled once the GPU is done with a frame
+    virtual void BeginFrame(uint64_t completedFenceValue) {}
+    virtual void EndFrame(uint64_t fenceValue) {}
+
+    // for work that can be spread over worker threads (e.g. decoding images to upload)
+    virtual void SetTaskScheduler(std::shared_ptr<WorkStealingScheduler> scheduler) {}
+
+    // fills in what's known about the memory held by this allocator, outTelemetry.name is left to the caller
+    virtual void GetTelemetry(MemoryAllocatorTelemetry& outTelemetry) const {}
     
     virtual ~MemoryAllocator() = default;
 
@@ -41,6 +57,7 @@ public:
     
 protected:
     virtual void CommitImplementation() = 0;
+    virtual void OnResourceDestroyed(std::shared_ptr<Resource> resource) {}
     
     std::map<std::string, std::shared_ptr<Resource>> resourceMap_;
     
@@ -0,0 +1,322 @@
+﻿#include "offset_allocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <limits>
+
+namespace {
+    const uint32_t InvalidNode = OffsetAllocation::InvalidNode;
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+OffsetAllocator::OffsetAllocator(uint64_t size, uint64_t granularity)
+    : size_(size), granularity_(granularity), granularityShift_(std::countr_zero(granularity)) {
+    assert(std::has_single_bit(granularity) && "Granularity has to be a power of two.");
+    Reset();
+}
+
+void OffsetAllocator::Reset() {
+    nodes_.clear();
+    unusedNodes_.clear();
+
+    firstLevelBitmap_ = 0;
+    secondLevelBitmaps_.fill(0);
+    freeHeads_.fill(InvalidNode);
+
+    usedUnits_ = 0;
+    numAllocations_ = 0;
+    numFreeBlocks_ = 0;
+
+    // a tail smaller than the granularity can never be handed out
+    const uint64_t totalUnits = size_ >> granularityShift_;
+    if(totalUnits == 0) {
+        return;
+    }
+
+    const uint32_t node = CreateNode();
+    nodes_[node] = Block {
+        .offset = 0,
+        .size = totalUnits,
+        .prevPhysical = InvalidNode,
+        .nextPhysical = InvalidNode,
+        .prevFree = InvalidNode,
+        .nextFree = InvalidNode,
+        .isFree = false
+    };
+    InsertFreeBlock(node);
+}
+
+OffsetAllocation OffsetAllocator::Allocate(uint64_t size, uint64_t alignment) {
+    assert(std::has_single_bit(alignment) && "Alignment has to be a power of two.");
+
+    if(size == 0 || size > size_) {
+        return OffsetAllocation();
+    }
+
+    const uint64_t units = AlignUp(size, granularity_) >> granularityShift_;
+    const uint64_t alignUnits = alignment > granularity_ ? alignment >> granularityShift_ : 1;
+
+    auto fits = [&](uint32_t candidate)->bool {
+        if(candidate == InvalidNode) {
+            return false;
+        }
+        const Block& block = nodes_[candidate];
+        return AlignUp(block.offset, alignUnits) + units <= block.offset + block.size;
+    };
+
+    BinIndex index;
+    uint32_t node = GetSearchBinIndex(units, index) ? FindFreeBlock(index) : InvalidNode;
+
+    // the first candidate may already be aligned, otherwise look for room for the worst case head
+    if(!fits(node) && alignUnits > 1) {
+        node = GetSearchBinIndex(units + alignUnits - 1, index) ? FindFreeBlock(index) : InvalidNode;
+    }
+
+    // The searches skip the bin the size falls into, its blocks aren't all large enough.
+    // Its first block still might be, e.g. for the last placement into an exactly sized heap.
+    if(!fits(node)) {
+        index = GetBinIndex(units);
+        node = freeHeads_[index.firstLevel * SecondLevelCount + index.secondLevel];
+    }
+
+    if(!fits(node)) {
+        return OffsetAllocation();
+    }
+
+    RemoveFreeBlock(node);
+
+    const uint64_t head = AlignUp(nodes_[node].offset, alignUnits) - nodes_[node].offset;
+    if(head > 0) {
+        const uint32_t rest = SplitBlock(node, head);
+        InsertFreeBlock(node);
+        node = rest;
+    }
+
+    const uint32_t tail = SplitBlock(node, units);
+    if(tail != InvalidNode) {
+        InsertFreeBlock(tail);
+    }
+
+    usedUnits_ += units;
+    numAllocations_++;
+
+    OffsetAllocation allocation;
+    allocation.offset = nodes_[node].offset << granularityShift_;
+    allocation.size = units << granularityShift_;
+    allocation.node = node;
+    return allocation;
+}
+
+void OffsetAllocator::Free(const OffsetAllocation& allocation) {
+    if(!allocation.IsValid()) {
+        return;
+    }
+
+    uint32_t node = allocation.node;
+    assert(node < nodes_.size() && !nodes_[node].isFree && "Allocation was already freed.");
+    assert((nodes_[node].offset << granularityShift_) == allocation.offset && "Allocation is from another allocator.");
+
+    usedUnits_ -= nodes_[node].size;
+    numAllocations_--;
+
+    // free blocks never border each other, so there's at most one merge per side
+    const uint32_t prev = nodes_[node].prevPhysical;
+    if(prev != InvalidNode && nodes_[prev].isFree) {
+        RemoveFreeBlock(prev);
+        node = MergeBlocks(prev, node);
+    }
+
+    const uint32_t next = nodes_[node].nextPhysical;
+    if(next != InvalidNode && nodes_[next].isFree) {
+        RemoveFreeBlock(next);
+        node = MergeBlocks(node, next);
+    }
+
+    InsertFreeBlock(node);
+}
+
+OffsetAllocatorStats OffsetAllocator::GetStats() const {
+    const uint64_t totalUnits = size_ >> granularityShift_;
+
+    OffsetAllocatorStats stats;
+    stats.totalSize = totalUnits << granularityShift_;
+    stats.usedSize = usedUnits_ << granularityShift_;
+    stats.freeSize = (totalUnits - usedUnits_) << granularityShift_;
+    stats.largestFreeBlock = 0;
+    stats.numAllocations = numAllocations_;
+    stats.numFreeBlocks = numFreeBlocks_;
+
+    if(firstLevelBitmap_ != 0) {
+        const uint32_t fl = 63 - std::countl_zero(firstLevelBitmap_);
+        const uint32_t sl = 31 - std::countl_zero(secondLevelBitmaps_[fl]);
+
+        uint64_t largest = 0;
+        for(uint32_t node = freeHeads_[fl * SecondLevelCount + sl]; node != InvalidNode; node = nodes_[node].nextFree) {
+            largest = std::max(largest, nodes_[node].size);
+        }
+        stats.largestFreeBlock = largest << granularityShift_;
+    }
+
+    return stats;
+}
+
+OffsetAllocator::BinIndex OffsetAllocator::GetBinIndex(uint64_t units) {
+    assert(units > 0);
+
+    const uint32_t fl = std::bit_width(units) - 1;
+    uint32_t sl;
+    if(fl < SecondLevelBits) {
+        // below SecondLevelCount units every size has a bin of its own
+        sl = (uint32_t)(units << (SecondLevelBits - fl)) - SecondLevelCount;
+    }
+    else {
+        sl = (uint32_t)(units >> (fl - SecondLevelBits)) - SecondLevelCount;
+    }
+
+    return BinIndex { fl, sl };
+}
+
+bool OffsetAllocator::GetSearchBinIndex(uint64_t units, BinIndex& outIndex) {
+    // round up to the next bin boundary, every block in that bin (or later ones) fits
+    const uint32_t fl = std::bit_width(units) - 1;
+    if(fl >= SecondLevelBits) {
+        const uint64_t roundUp = (1ull << (fl - SecondLevelBits)) - 1;
+        if(units > std::numeric_limits<uint64_t>::max() - roundUp) {
+            return false;
+        }
+        units += roundUp;
+    }
+
+    outIndex = GetBinIndex(units);
+    return true;
+}
+
+uint32_t OffsetAllocator::FindFreeBlock(BinIndex index) const {
+    uint32_t fl = index.firstLevel;
+    uint32_t slBitmap = secondLevelBitmaps_[fl] & (~0u << index.secondLevel);
+
+    if(slBitmap == 0) {
+        const uint64_t flBitmap = fl + 1 < FirstLevelCount ? firstLevelBitmap_ & (~0ull << (fl + 1)) : 0;
+        if(flBitmap == 0) {
+            return InvalidNode;
+        }
+
+        fl = std::countr_zero(flBitmap);
+        slBitmap = secondLevelBitmaps_[fl];
+    }
+
+    const uint32_t sl = std::countr_zero(slBitmap);
+    return freeHeads_[fl * SecondLevelCount + sl];
+}
+
+void OffsetAllocator::InsertFreeBlock(uint32_t node) {
+    const BinIndex index = GetBinIndex(nodes_[node].size);
+    uint32_t& head = freeHeads_[index.firstLevel * SecondLevelCount + index.secondLevel];
+
+    Block& block = nodes_[node];
+    block.isFree = true;
+    block.prevFree = InvalidNode;
+    block.nextFree = head;
+    if(head != InvalidNode) {
+        nodes_[head].prevFree = node;
+    }
+    head = node;
+
+    firstLevelBitmap_ |= 1ull << index.firstLevel;
+    secondLevelBitmaps_[index.firstLevel] |= 1u << index.secondLevel;
+    numFreeBlocks_++;
+}
+
+void OffsetAllocator::RemoveFreeBlock(uint32_t node) {
+    Block& block = nodes_[node];
+    assert(block.isFree);
+
+    if(block.prevFree != InvalidNode) {
+        nodes_[block.prevFree].nextFree = block.nextFree;
+    }
+    if(block.nextFree != InvalidNode) {
+        nodes_[block.nextFree].prevFree = block.prevFree;
+    }
+
+    const BinIndex index = GetBinIndex(block.size);
+    uint32_t& head = freeHeads_[index.firstLevel * SecondLevelCount + index.secondLevel];
+    if(head == node) {
+        head = block.nextFree;
+
+        if(head == InvalidNode) {
+            secondLevelBitmaps_[index.firstLevel] &= ~(1u << index.secondLevel);
+            if(secondLevelBitmaps_[index.firstLevel] == 0) {
+                firstLevelBitmap_ &= ~(1ull << index.firstLevel);
+            }
+        }
+    }
+
+    block.isFree = false;
+    block.prevFree = InvalidNode;
+    block.nextFree = InvalidNode;
+    numFreeBlocks_--;
+}
+
+uint32_t OffsetAllocator::SplitBlock(uint32_t node, uint64_t units) {
+    assert(nodes_[node].size >= units);
+    if(nodes_[node].size == units) {
+        return InvalidNode;
+    }
+
+    // may grow nodes_, no references across this
+    const uint32_t rest = CreateNode();
+
+    Block& block = nodes_[node];
+    nodes_[rest] = Block {
+        .offset = block.offset + units,
+        .size = block.size - units,
+        .prevPhysical = node,
+        .nextPhysical = block.nextPhysical,
+        .prevFree = InvalidNode,
+        .nextFree = InvalidNode,
+        .isFree = false
+    };
+
+    if(block.nextPhysical != InvalidNode) {
+        nodes_[block.nextPhysical].prevPhysical = rest;
+    }
+    block.nextPhysical = rest;
+    block.size = units;
+
+    return rest;
+}
+
+uint32_t OffsetAllocator::MergeBlocks(uint32_t first, uint32_t second) {
+    Block& block = nodes_[first];
+    const Block& absorbed = nodes_[second];
+    assert(block.nextPhysical == second && block.offset + block.size == absorbed.offset);
+
+    block.size += absorbed.size;
+    block.nextPhysical = absorbed.nextPhysical;
+    if(block.nextPhysical != InvalidNode) {
+        nodes_[block.nextPhysical].prevPhysical = first;
+    }
+
+    ReleaseNode(second);
+    return first;
+}
+
+uint32_t OffsetAllocator::CreateNode() {
+    if(!unusedNodes_.empty()) {
+        const uint32_t node = unusedNodes_.back();
+        unusedNodes_.pop_back();
+        return node;
+    }
+
+    nodes_.push_back(Block());
+    return (uint32_t)nodes_.size() - 1;
+}
+
+void OffsetAllocator::ReleaseNode(uint32_t node) {
+    nodes_[node].isFree = false;
+    unusedNodes_.push_back(node);
+}
@@ -0,0 +1,125 @@
+﻿#ifndef RENDERER_MEMORY_OFFSET_ALLOCATOR_H_
+#define RENDERER_MEMORY_OFFSET_ALLOCATOR_H_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT and D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT,
+// repeated here so the allocator doesn't depend on d3d12.h
+inline constexpr uint64_t PlacementAlignment64K = 64ull * 1024;
+inline constexpr uint64_t PlacementAlignment4M = 4ull * 1024 * 1024;
+
+struct OffsetAllocation {
+    static constexpr uint32_t InvalidNode = ~0u;
+
+    uint64_t offset = 0;
+    uint64_t size = 0; // rounded up to the allocator's granularity
+    uint32_t node = InvalidNode;
+
+    bool IsValid() const { return node != InvalidNode; }
+};
+
+struct OffsetAllocatorStats {
+    uint64_t totalSize;
+    uint64_t usedSize;
+    uint64_t freeSize;
+    uint64_t largestFreeBlock;
+    uint32_t numAllocations;
+    uint32_t numFreeBlocks;
+
+    // 0 when all free space is one block, close to 1 when it's scattered in small pieces
+    double GetFragmentation() const {
+        return freeSize > 0 ? 1.0 - (double)largestFreeBlock / (double)freeSize : 0.0;
+    }
+};
+
+//
+// Two level segregated fit (TLSF, Masmano et al. 2004) allocator for ranges of an
+// abstract address space, e.g. placements in an ID3D12Heap. It never touches the
+// memory it manages, so it works the same for any backend and without a device.
+//
+// Free blocks are binned by size: the first level is the power of two, the second
+// splits that range into SecondLevelCount linear steps. A bitmap per level finds the
+// smallest non-empty bin that's guaranteed to fit in O(1); freeing merges with the
+// physical neighbours in O(1).
+//
+// Everything is measured in units of the granularity (a power of two, 64 KiB by default,
+// which is also the smallest placement alignment). Larger alignments like 4 MiB for MSAA
+// textures are handled by looking for size + alignment - granularity and handing the
+// unaligned head back as a free block.
+//
+// Not thread safe.
+//
+class OffsetAllocator {
+public:
+    OffsetAllocator(uint64_t size, uint64_t granularity = PlacementAlignment64K);
+
+    OffsetAllocator(const OffsetAllocator&) = delete;
+    OffsetAllocator& operator=(const OffsetAllocator&) = delete;
+
+    // invalid allocation if there's no free range large enough; alignment has to be a power of two
+    OffsetAllocation Allocate(uint64_t size, uint64_t alignment = PlacementAlignment64K);
+    void Free(const OffsetAllocation& allocation);
+
+    // frees everything at once
+    void Reset();
+
+    uint64_t GetSize() const { return size_; }
+    uint64_t GetGranularity() const { return granularity_; }
+
+    // walks the largest non-empty bin for largestFreeBlock, the rest is kept up to date
+    OffsetAllocatorStats GetStats() const;
+
+private:
+    static constexpr uint32_t SecondLevelBits = 4;
+    static constexpr uint32_t SecondLevelCount = 1u << SecondLevelBits;
+    static constexpr uint32_t FirstLevelCount = 64;
+
+    struct Block {
+        uint64_t offset; // in units
+        uint64_t size;   // in units
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool isFree;
+    };
+
+    struct BinIndex {
+        uint32_t firstLevel;
+        uint32_t secondLevel;
+    };
+
+    static BinIndex GetBinIndex(uint64_t units);
+    // bin from which on every block is at least this large, false if there's none
+    static bool GetSearchBinIndex(uint64_t units, BinIndex& outIndex);
+
+    uint32_t FindFreeBlock(BinIndex index) const;
+    void InsertFreeBlock(uint32_t node);
+    void RemoveFreeBlock(uint32_t node);
+
+    // shrinks the block to `units`, returns the node of the remainder (not in a free list yet)
+    uint32_t SplitBlock(uint32_t node, uint64_t units);
+    uint32_t MergeBlocks(uint32_t first, uint32_t second);
+
+    uint32_t CreateNode();
+    void ReleaseNode(uint32_t node);
+
+    uint64_t size_;
+    uint64_t granularity_;
+    uint32_t granularityShift_;
+
+    std::vector<Block> nodes_;
+    std::vector<uint32_t> unusedNodes_;
+
+    uint64_t firstLevelBitmap_;
+    std::array<uint32_t, FirstLevelCount> secondLevelBitmaps_;
+    std::array<uint32_t, FirstLevelCount * SecondLevelCount> freeHeads_;
+
+    uint64_t usedUnits_;
+    uint32_t numAllocations_;
+    uint32_t numFreeBlocks_;
+};
+
+#endif // RENDERER_MEMORY_OFFSET_ALLOCATOR_H_
@@ -0,0 +1,189 @@
+﻿#include "directx/d3dx12.h"
+#include "paged_descriptor_allocator.h"
+
+#include <atomic>
+
+namespace {
+    // allocations up to this size are served from the calling thread's page
+    const uint32_t MaxCachedAllocationSize = 4;
+    const uint32_t PageSize = 16;
+
+    std::atomic<uint32_t> nextThreadCacheIndex = 0;
+
+    // threads are spread over the caches round robin, in the order they first allocate
+    uint32_t GetThreadCacheIndex(uint32_t numCaches) {
+        thread_local const uint32_t index = nextThreadCacheIndex.fetch_add(1);
+        return index % numCaches;
+    }
+}
+
+PagedDescriptorAllocator::PagedDescriptorAllocator(winrt::com_ptr<ID3D12Device> device,
+                                                   D3D12_DESCRIPTOR_HEAP_TYPE type,
+                                                   uint32_t numDescriptors,
+                                                   bool shaderVisible)
+    : DescriptorAllocator(device, type, shaderVisible), ranges_(numDescriptors) {
+
+    D3D12_DESCRIPTOR_HEAP_DESC desc;
+    desc.Type = type_;
+    desc.Flags = isShaderVisible_? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    desc.NumDescriptors = numDescriptors;
+    desc.NodeMask = 0;
+
+    device_->CreateDescriptorHeap(&desc, __uuidof(ID3D12DescriptorHeap), descriptorHeap_.put_void());
+    incrementSize_ = device_->GetDescriptorHandleIncrementSize(type_);
+}
+
+std::weak_ptr<DescriptorHeapAllocation> PagedDescriptorAllocator::Allocate(uint32_t numDescriptors) {
+    WINRT_ASSERT(numDescriptors > 0);
+
+    const uint32_t cacheIndex = GetThreadCacheIndex(NumThreadCaches);
+    ThreadCache& cache = threadCaches_[cacheIndex];
+
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+
+        uint32_t offset = DescriptorRangeAllocator::InvalidOffset;
+        if(numDescriptors <= MaxCachedAllocationSize) {
+            offset = AllocateFromCache(cache, numDescriptors);
+        }
+
+        if(offset == DescriptorRangeAllocator::InvalidOffset) {
+            offset = AllocateFromHeap(numDescriptors);
+        }
+
+        if(offset != DescriptorRangeAllocator::InvalidOffset) {
+            std::shared_ptr<DescriptorHeapAllocation> allocation = CreateAllocation(offset, numDescriptors, cacheIndex);
+            cache.allocations.insert({allocation.get(), allocation});
+            return allocation;
+        }
+    }
+
+    // the space might be sitting in other threads' pages
+    TrimThreadCaches();
+
+    const uint32_t offset = AllocateFromHeap(numDescriptors);
+    if(offset == DescriptorRangeAllocator::InvalidOffset) {
+        WINRT_ASSERT("Ran out of descriptor space!" && false);
+        return std::weak_ptr<DescriptorHeapAllocation>();
+    }
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    std::shared_ptr<DescriptorHeapAllocation> allocation = CreateAllocation(offset, numDescriptors, cacheIndex);
+    cache.allocations.insert({allocation.get(), allocation});
+    return allocation;
+}
+
+void PagedDescriptorAllocator::Free(std::weak_ptr<DescriptorHeapAllocation> allocation, uint64_t fenceValue) {
+    const std::shared_ptr<DescriptorHeapAllocation> freed = allocation.lock();
+    if(!freed) {
+        return;
+    }
+
+    WINRT_ASSERT(freed->cacheIndex_ < NumThreadCaches);
+    ThreadCache& cache = threadCaches_[freed->cacheIndex_];
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        const size_t numErased = cache.allocations.erase(freed.get());
+        WINRT_ASSERT(numErased == 1 && "Allocation wasn't made by this allocator.");
+    }
+
+    std::lock_guard<std::mutex> lock(rangeMutex_);
+    ranges_.FreeDeferred(freed->offset_, freed->size_, fenceValue);
+}
+
+void PagedDescriptorAllocator::BeginFrame(uint64_t completedFenceValue) {
+    std::lock_guard<std::mutex> lock(rangeMutex_);
+    ranges_.ReleaseCompleted(completedFenceValue);
+}
+
+void PagedDescriptorAllocator::GetTelemetry(DescriptorHeapTelemetry& outTelemetry) const {
+    outTelemetry.numAllocations = 0;
+    outTelemetry.numAllocatedDescriptors = 0;
+    outTelemetry.numCachedDescriptors = 0;
+
+    // caches one at a time, other threads may keep allocating in between,
+    // so the numbers only add up exactly when nothing else is going on
+    for(const ThreadCache& cache : threadCaches_) {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+
+        outTelemetry.numAllocations += (uint32_t)cache.allocations.size();
+        outTelemetry.numCachedDescriptors += cache.pageEnd - cache.pageOffset;
+        for(const auto& [ptr, allocation] : cache.allocations) {
+            outTelemetry.numAllocatedDescriptors += allocation->size_;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(rangeMutex_);
+    outTelemetry.numDescriptors = ranges_.GetSize();
+    outTelemetry.numFreeDescriptors = ranges_.GetNumFreeDescriptors();
+    outTelemetry.largestFreeRange = ranges_.GetLargestFreeRange();
+    outTelemetry.numFreeRanges = (uint32_t)ranges_.GetNumFreeRanges();
+    outTelemetry.numPendingFrees = (uint32_t)ranges_.GetNumPendingFrees();
+}
+
+uint32_t PagedDescriptorAllocator::AllocateFromCache(ThreadCache& cache, uint32_t numDescriptors) {
+    if(cache.pageEnd - cache.pageOffset < numDescriptors) {
+        std::lock_guard<std::mutex> lock(rangeMutex_);
+
+        // the rest of the page is too small, hand it back and start a new one
+        if(cache.pageEnd > cache.pageOffset) {
+            ranges_.Free(cache.pageOffset, cache.pageEnd - cache.pageOffset);
+        }
+        cache.pageOffset = 0;
+        cache.pageEnd = 0;
+
+        const uint32_t page = ranges_.Allocate(PageSize);
+        if(page == DescriptorRangeAllocator::InvalidOffset) {
+            return DescriptorRangeAllocator::InvalidOffset;
+        }
+
+        cache.pageOffset = page;
+        cache.pageEnd = page + PageSize;
+    }
+
+    const uint32_t offset = cache.pageOffset;
+    cache.pageOffset += numDescriptors;
+    return offset;
+}
+
+uint32_t PagedDescriptorAllocator::AllocateFromHeap(uint32_t numDescriptors) {
+    std::lock_guard<std::mutex> lock(rangeMutex_);
+    return ranges_.Allocate(numDescriptors);
+}
+
+void PagedDescriptorAllocator::TrimThreadCaches() {
+    for(ThreadCache& cache : threadCaches_) {
+        std::lock_guard<std::mutex> cacheLock(cache.mutex);
+        if(cache.pageEnd == cache.pageOffset) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(rangeMutex_);
+        ranges_.Free(cache.pageOffset, cache.pageEnd - cache.pageOffset);
+        cache.pageOffset = 0;
+        cache.pageEnd = 0;
+    }
+}
+
+std::shared_ptr<DescriptorHeapAllocation> PagedDescriptorAllocator::CreateAllocation(uint32_t offset,
+                                                                                    uint32_t numDescriptors,
+                                                                                    uint32_t cacheIndex) const {
+    std::shared_ptr<DescriptorHeapAllocation> allocation = std::make_shared<DescriptorHeapAllocation>();
+
+    allocation->offset_ = offset;
+    allocation->size_ = numDescriptors;
+    allocation->incrementSize_ = incrementSize_;
+    allocation->cacheIndex_ = cacheIndex;
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE cpuHandle;
+    cpuHandle.InitOffsetted(GetCPUHeapBase(), offset, incrementSize_);
+    allocation->cpuHandle_ = cpuHandle;
+
+    if(isShaderVisible_) {
+        CD3DX12_GPU_DESCRIPTOR_HANDLE gpuHandle;
+        gpuHandle.InitOffsetted(GetGPUHeapBase(), offset, incrementSize_);
+        allocation->gpuHandle_ = gpuHandle;
+    }
+
+    return allocation;
+}
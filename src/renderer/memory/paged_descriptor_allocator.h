@@ -0,0 +1,58 @@
+﻿#ifndef RENDERER_MEMORY_PAGED_DESCRIPTOR_ALLOCATOR_H_
+#define RENDERER_MEMORY_PAGED_DESCRIPTOR_ALLOCATOR_H_
+
+#include <array>
+#include <unordered_map>
+
+#include "descriptor_allocator.h"
+#include "descriptor_range_allocator.h"
+
+//
+// Descriptor allocator that gets its descriptors back.
+//
+// Ranges are managed by a DescriptorRangeAllocator, freed ranges are merged and reused once the
+// frame they were freed in completed (see BeginFrame()).
+// Small allocations, the bulk of what pipeline assembly asks for, are carved out of pages
+// that are cached per thread, so assembly threads mostly don't touch the shared free list.
+// When the heap runs dry, the unused rest of every cached page goes back before giving up.
+//
+class PagedDescriptorAllocator : public DescriptorAllocator {
+public:
+    PagedDescriptorAllocator(winrt::com_ptr<ID3D12Device> device,
+                             D3D12_DESCRIPTOR_HEAP_TYPE type,
+                             uint32_t numDescriptors,
+                             bool shaderVisible);
+
+    std::weak_ptr<DescriptorHeapAllocation> Allocate(uint32_t numDescriptors) override;
+    void Free(std::weak_ptr<DescriptorHeapAllocation> allocation, uint64_t fenceValue) override;
+    void BeginFrame(uint64_t completedFenceValue) override;
+    void GetTelemetry(DescriptorHeapTelemetry& outTelemetry) const override;
+
+private:
+    static const uint32_t NumThreadCaches = 8;
+
+    struct alignas(64) ThreadCache {
+        mutable std::mutex mutex;
+        // unused part of the cached page
+        uint32_t pageOffset = 0;
+        uint32_t pageEnd = 0;
+        // owns the allocations made through this cache
+        std::unordered_map<const DescriptorHeapAllocation*, std::shared_ptr<DescriptorHeapAllocation>> allocations;
+    };
+
+    uint32_t AllocateFromCache(ThreadCache& cache, uint32_t numDescriptors);
+    uint32_t AllocateFromHeap(uint32_t numDescriptors);
+    void TrimThreadCaches();
+
+    std::shared_ptr<DescriptorHeapAllocation> CreateAllocation(uint32_t offset, uint32_t numDescriptors, uint32_t cacheIndex) const;
+
+    std::array<ThreadCache, NumThreadCaches> threadCaches_;
+
+    // lock order: a ThreadCache's mutex before rangeMutex_
+    mutable std::mutex rangeMutex_;
+    DescriptorRangeAllocator ranges_;
+
+    uint32_t incrementSize_;
+};
+
+#endif // RENDERER_MEMORY_PAGED_DESCRIPTOR_ALLOCATOR_H_
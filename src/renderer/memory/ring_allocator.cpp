@@ -0,0 +1,42 @@
+﻿#include "ring_allocator.h"
+
+#include <cassert>
+
+RingAllocator::RingAllocator(uint64_t size)
+    : size_(size), head_(0), tail_(0), frameIndex_(0) {
+}
+
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment) {
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && size_ % alignment == 0);
+
+    if(size == 0 || size > size_) {
+        return InvalidOffset;
+    }
+
+    uint64_t start = (head_ + alignment - 1) & ~(alignment - 1);
+
+    // allocations never wrap around, the rest of the ring is skipped instead
+    const uint64_t offset = start % size_;
+    if(offset + size > size_) {
+        start += size_ - offset;
+    }
+
+    if(start + size - tail_ > size_) {
+        return InvalidOffset;
+    }
+
+    head_ = start + size;
+    return start % size_;
+}
+
+void RingAllocator::FinishFrame(uint64_t fenceValue) {
+    frames_.push_back({ fenceValue, head_ });
+    frameIndex_++;
+}
+
+void RingAllocator::ReleaseCompletedFrames(uint64_t completedFenceValue) {
+    while(!frames_.empty() && frames_.front().fenceValue <= completedFenceValue) {
+        tail_ = frames_.front().end;
+        frames_.pop_front();
+    }
+}
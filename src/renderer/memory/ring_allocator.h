@@ -0,0 +1,51 @@
+﻿#ifndef RENDERER_MEMORY_RING_ALLOCATOR_H_
+#define RENDERER_MEMORY_RING_ALLOCATOR_H_
+
+#include <cstdint>
+#include <deque>
+
+//
+// Linear allocator over a ring of `size` bytes, reclaimed a whole frame at a time.
+// Allocations are handed out back to back; FinishFrame() closes the current frame with
+// the fence value the GPU signals once it's done with it, and ReleaseCompletedFrames()
+// gives the memory of every completed frame back.
+//
+// Only deals with offsets, see UploadRingBuffer for the D3D12 side. Not thread safe.
+//
+class RingAllocator {
+public:
+    static constexpr uint64_t InvalidOffset = ~0ull;
+
+    RingAllocator(uint64_t size);
+
+    // InvalidOffset if the frames in flight still hold too much of the ring.
+    // alignment has to be a power of two that divides the ring size
+    uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+    // everything allocated since the last call belongs to the frame that signals fenceValue
+    void FinishFrame(uint64_t fenceValue);
+    void ReleaseCompletedFrames(uint64_t completedFenceValue);
+
+    uint64_t GetSize() const { return size_; }
+    uint64_t GetUsedSize() const { return head_ - tail_; }
+
+    // counts FinishFrame() calls
+    uint64_t GetFrameIndex() const { return frameIndex_; }
+
+private:
+    struct FrameMarker {
+        uint64_t fenceValue;
+        uint64_t end; // head_ when the frame was finished
+    };
+
+    uint64_t size_;
+
+    // positions keep counting up, the ring offset is position % size_
+    uint64_t head_;
+    uint64_t tail_;
+
+    uint64_t frameIndex_;
+    std::deque<FrameMarker> frames_;
+};
+
+#endif // RENDERER_MEMORY_RING_ALLOCATOR_H_
@@ -56,3 +56,15 @@ std::weak_ptr<DescriptorHeapAllocation> StaticDescriptorAllocator::Allocate(uint
     allocations_.push_back(std::move(allocation));
     return allocations_.back();
 }
+
+void StaticDescriptorAllocator::GetTelemetry(DescriptorHeapTelemetry& outTelemetry) const {
+    std::lock_guard<std::mutex> lock(allocMutex_);
+
+    // only ever grows, everything after curIndex_ is one free range
+    outTelemetry.numDescriptors = size_;
+    outTelemetry.numAllocations = (uint32_t)allocations_.size();
+    outTelemetry.numAllocatedDescriptors = curIndex_;
+    outTelemetry.numFreeDescriptors = size_ - curIndex_;
+    outTelemetry.largestFreeRange = size_ - curIndex_;
+    outTelemetry.numFreeRanges = curIndex_ < size_ ? 1 : 0;
+}
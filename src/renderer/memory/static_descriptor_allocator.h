@@ -11,10 +11,11 @@ public:
                                 bool shaderVisible);
                                 
     std::weak_ptr<DescriptorHeapAllocation> Allocate(uint32_t numDescriptors) override;
+    void GetTelemetry(DescriptorHeapTelemetry& outTelemetry) const override;
 private:
     std::vector<std::shared_ptr<DescriptorHeapAllocation>> allocations_;
 
-    std::mutex allocMutex_;
+    mutable std::mutex allocMutex_;
     uint32_t size_;
     uint32_t curIndex_;
     uint32_t incrementSize_;
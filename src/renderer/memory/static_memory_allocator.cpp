@@ -1,14 +1,42 @@
 ﻿#include "directx/d3dx12.h"
 #include "static_memory_allocator.h"
 
+#include <algorithm>
 #include <iostream>
 
+namespace {
+    // a few frames worth of constant buffers
+    const uint64_t UploadRingSize = 4 * 1024 * 1024;
+
+    // static uploads are staged through a ring this big, with at most UploadFrameBudget per frame
+    const uint64_t UploadStagingSize = 32 * 1024 * 1024;
+    const uint64_t UploadFrameBudget = 8 * 1024 * 1024;
+
+    // room for resources created after Commit(), as a fraction of what was committed
+    const uint64_t HeapHeadroomDivisor = 4;
+    const uint64_t MinHeapHeadroom = 16 * 1024 * 1024;
+
+    // heaps added once the committed one is full
+    const uint64_t GrowthHeapSize = 64 * 1024 * 1024;
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
 StaticMemoryAllocator::StaticMemoryAllocator(winrt::com_ptr<ID3D12Device> device)
-    : device_(device), heapSize_(0) {
+    : device_(device) {
+    uploadRing_ = std::make_shared<UploadRingBuffer>(device_, UploadRingSize);
+    uploader_ = std::make_unique<ChunkedUploader>(device_, UploadStagingSize, UploadFrameBudget);
+}
 
+void StaticMemoryAllocator::SetTaskScheduler(std::shared_ptr<WorkStealingScheduler> scheduler) {
+    uploader_->SetTaskScheduler(scheduler);
 }
 
 void StaticMemoryAllocator::CommitImplementation() {
+    WINRT_ASSERT(heaps_.empty() && "The static memory allocator can only be committed once.");
+
     // go through all resources and see how big our D3D12_HEAP_TYPE_DEFAULT should be
     std::vector<D3D12_RESOURCE_DESC> resourceDescs;
     
@@ -23,98 +51,102 @@ void StaticMemoryAllocator::CommitImplementation() {
 
     D3D12_RESOURCE_ALLOCATION_INFO allocInfo = device_->GetResourceAllocationInfo(0, resourceDescs.size(), resourceDescs.data());
 
-    const uint64_t heapSize = allocInfo.SizeInBytes;
-    const uint64_t globalAlignment = allocInfo.Alignment;
+    // if we have MSAA textures in this heap, we must use the other one (4MB)
+    const uint64_t globalAlignment = std::max<uint64_t>(allocInfo.Alignment, PlacementAlignment64K);
+    const uint64_t headroom = std::max(allocInfo.SizeInBytes / HeapHeadroomDivisor, MinHeapHeadroom);
+    AddHeap(AlignUp(allocInfo.SizeInBytes + headroom, globalAlignment), globalAlignment);
 
-    {
-        CD3DX12_HEAP_DESC desc = CD3DX12_HEAP_DESC(heapSize,
-                                                    D3D12_HEAP_TYPE_DEFAULT,
-                                                    globalAlignment, // if we have MSAA textures in this heap, we must use the other one (4MB)
-                                                    D3D12_HEAP_FLAG_NONE);
-        
-        device_->CreateHeap(&desc, __uuidof(ID3D12Heap), heap_.put_void());
+    for(auto [id, res] : resourceMap_) {
+        if(res->IsDynamic()) {
+            continue;
+        }
+
+        const bool placed = PlaceResource(res);
+        WINRT_ASSERT(placed);
     }
+}
+
+bool StaticMemoryAllocator::PlaceResource(std::shared_ptr<Resource> res) {
+    D3D12_RESOURCE_DESC resDesc = res->CreateResourceDesc();
 
-    // The D3D12_HEAP_TYPE_UPLOAD will be the same size, but once
-    // everything is uploaded, we will free this memory
-    {
-        CD3DX12_HEAP_DESC desc = CD3DX12_HEAP_DESC(heapSize,
-                                                    D3D12_HEAP_TYPE_UPLOAD,
-                                                    globalAlignment, // if we have MSAA textures in this heap, we must use the other one (4MB)
-                                                    D3D12_HEAP_FLAG_NONE);
-                                                    
-        device_->CreateHeap(&desc, __uuidof(ID3D12Heap), uploadHeap_.put_void());
+    D3D12_CLEAR_VALUE clearVal;
+    D3D12_CLEAR_VALUE* ptrClearVal = NULL;
+    if(res->GetOptimizedClearValue(clearVal)) {
+        ptrClearVal = &clearVal;
     }
+    
+    // 64KB, or 4MB for MSAA textures
+    D3D12_RESOURCE_ALLOCATION_INFO resAllocInfo = device_->GetResourceAllocationInfo(0, 1, &resDesc);
 
-    uint64_t defaultOffset = 0;
-    uint64_t uploadOffset = 0;
+    const uint64_t alignment = std::max<uint64_t>(resAllocInfo.Alignment, PlacementAlignment64K);
 
-    for(auto [id, res] : resourceMap_) {
-        if(res->IsDynamic()) {
-            continue;
+    Placement placement = { 0, OffsetAllocation() };
+    for(uint32_t i = 0; i < heaps_.size() && !placement.allocation.IsValid(); i++) {
+        // MSAA resources need a heap that's 4MB aligned
+        if(heaps_[i].alignment >= alignment) {
+            placement = { i, heaps_[i].allocator->Allocate(resAllocInfo.SizeInBytes, alignment) };
         }
-        
-        D3D12_RESOURCE_DESC resDesc = res->CreateResourceDesc();
+    }
 
-        D3D12_CLEAR_VALUE clearVal;
-        D3D12_CLEAR_VALUE* ptrClearVal = NULL;
-        if(res->GetOptimizedClearValue(clearVal)) {
-            ptrClearVal = &clearVal;
-        }
-        
-        // update heap offset
-        D3D12_RESOURCE_ALLOCATION_INFO resAllocInfo = device_->GetResourceAllocationInfo(0, 1, &resDesc);
-        
-        assert(defaultOffset % resAllocInfo.Alignment == 0);
-        assert(defaultOffset + resAllocInfo.SizeInBytes <= heapSize);
-
-        winrt::com_ptr<ID3D12Resource> newRes;
-        device_->CreatePlacedResource(heap_.get(),
-                                      defaultOffset,
-                                      &resDesc,
-                                      res->GetResourceState(),
-                                      ptrClearVal,
-                                      __uuidof(ID3D12Resource),
-                                      newRes.put_void());
-        
-        res->SetNativeResource(newRes);
+    if(!placement.allocation.IsValid()) {
+        AddHeap(std::max(GrowthHeapSize, AlignUp(resAllocInfo.SizeInBytes, alignment)), alignment);
+        placement = { (uint32_t)heaps_.size() - 1, heaps_.back().allocator->Allocate(resAllocInfo.SizeInBytes, alignment) };
+    }
 
-        // https://stackoverflow.com/questions/2403631/how-do-i-find-the-next-multiple-of-10-of-any-integer
-        // (n+9) - ((n+9)%10) - Mark Dickinson
-        defaultOffset += resAllocInfo.SizeInBytes;
-        
-        const uint64_t A = allocInfo.Alignment;
-        defaultOffset = (defaultOffset + (A - 1)) - ((defaultOffset + (A - 1)) % A);
-
-        if(res->IsUploadNeeded()) {
-            CD3DX12_RESOURCE_DESC uploadResDesc = CD3DX12_RESOURCE_DESC::Buffer(resAllocInfo);
-            
-            winrt::com_ptr<ID3D12Resource> uploadRes;
-            device_->CreatePlacedResource(uploadHeap_.get(),
-                                      uploadOffset,
-                                      &uploadResDesc,
-                                      res->GetResourceState(),
-                                      ptrClearVal,
-                                      __uuidof(ID3D12Resource),
-                                      uploadRes.put_void());
-
-            res->SetUploadResource(uploadRes);
-
-            uploadOffset += resAllocInfo.SizeInBytes;
-            uploadOffset = (uploadOffset + (A - 1)) - ((uploadOffset + (A - 1)) % A);
-
-            uploadQueue_.push(res);
-        }
-        else {
-            // no upload needed, can be use right away
-            res->SetIsReady(true);
-        }
+    if(!placement.allocation.IsValid()) {
+        std::cout << "Out of heap space for a " << resAllocInfo.SizeInBytes << " byte resource" << std::endl;
+        return false;
+    }
+
+    winrt::com_ptr<ID3D12Resource> newRes;
+    device_->CreatePlacedResource(heaps_[placement.heapIndex].heap.get(),
+                                  placement.allocation.offset,
+                                  &resDesc,
+                                  res->GetResourceState(),
+                                  ptrClearVal,
+                                  __uuidof(ID3D12Resource),
+                                  newRes.put_void());
+    
+    res->SetNativeResource(newRes);
+    placements_[res.get()] = placement;
+
+    if(res->IsUploadNeeded()) {
+        uploader_->Enqueue(res);
+    }
+    else {
+        // no upload needed, can be use right away
+        res->SetIsReady(true);
+    }
+
+    return true;
+}
+
+void StaticMemoryAllocator::AddHeap(uint64_t size, uint64_t alignment) {
+    Heap heap;
+    heap.alignment = alignment;
+    heap.allocator = std::make_unique<OffsetAllocator>(size);
+
+    CD3DX12_HEAP_DESC desc = CD3DX12_HEAP_DESC(size, D3D12_HEAP_TYPE_DEFAULT, alignment, D3D12_HEAP_FLAG_NONE);
+    HRESULT hr = device_->CreateHeap(&desc, __uuidof(ID3D12Heap), heap.heap.put_void());
+    WINRT_ASSERT(SUCCEEDED(hr));
+
+    if(!heaps_.empty()) {
+        std::cout << "Adding a " << size / (1024 * 1024) << " MiB default heap (" << heaps_.size() + 1 << " heaps)" << std::endl;
     }
+    heaps_.push_back(std::move(heap));
 }
 
 void StaticMemoryAllocator::OnResourceCreated(std::shared_ptr<Resource> newResource) {
     //
-    if(newResource->IsDynamic()) {
+    const std::shared_ptr<DynamicBufferBase> ringBuffer = std::dynamic_pointer_cast<DynamicBufferBase>(newResource);
+    if(ringBuffer && ringBuffer->UsesUploadRing()) {
+        // no native resource, every update goes into the ring
+        ringBuffer->uploadRing_ = uploadRing_;
+        ringBuffers_.push_back(ringBuffer);
+        ringBuffer->UpdateGPUData();
+        ringBuffer->SetIsReady(true);
+    }
+    else if(newResource->IsDynamic()) {
         // we give the resource the function to call, so if it wants to reinitialize its data, then it can
         newResource->initializeDynamicResourceFunc_ = std::bind(&StaticMemoryAllocator::InitializeDynamicResource, this, newResource);
         InitializeDynamicResource(newResource);
@@ -122,6 +154,25 @@ void StaticMemoryAllocator::OnResourceCreated(std::shared_ptr<Resource> newResou
         newResource->HandleDynamicUpload();
         newResource->SetIsReady(true);
     }
+    else if(!heaps_.empty()) {
+        // created after Commit(), goes into the space that's left (or a new heap)
+        const bool placed = PlaceResource(newResource);
+        WINRT_ASSERT(placed);
+    }
+}
+
+void StaticMemoryAllocator::OnResourceDestroyed(std::shared_ptr<Resource> resource) {
+    std::erase_if(ringBuffers_, [&resource](const std::shared_ptr<DynamicBufferBase>& ringBuffer) { return ringBuffer == resource; });
+
+    const auto it = placements_.find(resource.get());
+    if(it == placements_.end()) {
+        // committed and ring resources give their memory back when the last reference goes
+        return;
+    }
+
+    // command lists recorded this frame may still reference it, the fence is known at EndFrame()
+    releasesThisFrame_.push_back({ std::move(resource), it->second, 0 });
+    placements_.erase(it);
 }
 
 void StaticMemoryAllocator::InitializeDynamicResource(std::shared_ptr<Resource> res) {
@@ -142,69 +193,93 @@ void StaticMemoryAllocator::InitializeDynamicResource(std::shared_ptr<Resource>
     res->res_->Map(0, &readRange, &res->dynamicResMappedPtr_);
 }
 
-void StaticMemoryAllocator::Update(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, winrt::com_ptr<ID3D12CommandQueue> cmdQueue) {
-    
-    //
-    std::vector<std::shared_ptr<Resource>> resUploading;
-    
-    const uint32_t maxWorkNum = uploadQueue_.size();
-    for(int i = 0; i < maxWorkNum; i++) {
-        if(uploadQueue_.empty()) {
-            break;
+void StaticMemoryAllocator::BeginFrame(uint64_t completedFenceValue) {
+    uploadRing_->ReleaseCompletedFrames(completedFenceValue);
+
+    // binding a ring buffer only reads its allocation, which lets worker threads record with it
+    for(const std::shared_ptr<DynamicBufferBase>& ringBuffer : ringBuffers_) {
+        if(!ringBuffer->IsUploadedThisFrame()) {
+            ringBuffer->UploadToRing();
         }
-        
-        // - create in upload heap
-        // - Map 
-        // - memcpy (ideally in another thread and just check if done per Update())
-        //          - for larger uploads (but playing with maxWorkNum can also affect performance)
-        // - let Resource handle copying, and give the ptr in the UPLOAD_HEAP
-        // -
-        std::shared_ptr<Resource> res = uploadQueue_.front();
-        res->HandleUpload(cmdList);
-        
-        uploadQueue_.pop();
-        resUploading.push_back(res);
     }
-    
-    cmdList->Close();
-    ID3D12CommandList* const cmdLists[] = {
-        cmdList.get()
-    };
-    cmdQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
-
-    // TODO: profile cost of creating one-off fences vs maintaining a pool of fences...
-    winrt::com_ptr<ID3D12Fence> waitFence;
-    device_->CreateFence(0, D3D12_FENCE_FLAG_NONE, __uuidof(ID3D12Fence), waitFence.put_void());
-    cmdQueue->Signal(waitFence.get(), 1);
-
-    // TODO: thread pool
-    std::thread t(&StaticMemoryAllocator::WaitForUploadComplete, this, waitFence, resUploading);
-    t.detach();
+
+    // a placement that's still being uploaded to can't be handed out again either
+    std::erase_if(pendingReleases_, [this, completedFenceValue](PendingRelease& pending) {
+        if(pending.fenceValue > completedFenceValue || !pending.resource->IsReady()) {
+            return false;
+        }
+
+        pending.resource->SetNativeResource(nullptr);
+        heaps_[pending.placement.heapIndex].allocator->Free(pending.placement.allocation);
+        return true;
+    });
+
+    // uploads are on the copy queue, which has a fence of its own
+    uploader_->ReleaseCompletedBatches();
 }
 
-bool StaticMemoryAllocator::HasWork() {
-    return uploadQueue_.size() > 0;
+void StaticMemoryAllocator::EndFrame(uint64_t fenceValue) {
+    uploadRing_->FinishFrame(fenceValue);
+
+    for(PendingRelease& release : releasesThisFrame_) {
+        release.fenceValue = fenceValue;
+        pendingReleases_.push_back(std::move(release));
+    }
+    releasesThisFrame_.clear();
+}
+
+void StaticMemoryAllocator::Update(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, winrt::com_ptr<ID3D12CommandQueue> cmdQueue) {
+    uploader_->Update(cmdList, cmdQueue);
 }
 
-void StaticMemoryAllocator::WaitForUploadComplete(winrt::com_ptr<ID3D12Fence> fence, std::vector<std::shared_ptr<Resource>> resUploading) {
-	HANDLE fe = CreateEvent(NULL, FALSE, FALSE, NULL);
-	assert(fe);
+bool StaticMemoryAllocator::HasWork() {
+    return uploader_->HasWork();
+}
 
-    std::cout << "starting upload fence" << std::endl;
-	
-	if(fence->GetCompletedValue() < 1) {
-		fence->SetEventOnCompletion(1, fe);
-		WaitForSingleObject(fe, INFINITE); // block
-	}
-	
-	std::cout << "upload fence complete!" << std::endl;
+void StaticMemoryAllocator::GetTelemetry(MemoryAllocatorTelemetry& outTelemetry) const {
+    // all heaps together, the largest free block is the largest of any heap
+    for(const Heap& heap : heaps_) {
+        const OffsetAllocatorStats stats = heap.allocator->GetStats();
+        outTelemetry.heapSize += stats.totalSize;
+        outTelemetry.heapFreeBytes += stats.freeSize;
+        outTelemetry.heapLargestFreeBlock = std::max(outTelemetry.heapLargestFreeBlock, stats.largestFreeBlock);
+        outTelemetry.heapNumFreeBlocks += stats.numFreeBlocks;
+    }
+    outTelemetry.heapFragmentation = outTelemetry.heapFreeBytes > 0 ?
+        1.0 - (double)outTelemetry.heapLargestFreeBlock / (double)outTelemetry.heapFreeBytes : 0.0;
+    outTelemetry.reservedBytes = outTelemetry.heapSize;
 
-    for(std::shared_ptr<Resource>& res : resUploading) {
-        res->SetIsReady(true);
+    for(const auto& [id, res] : resourceMap_) {
+        const auto placement = placements_.find(res.get());
+        if(placement != placements_.end()) {
+            ResourceMemoryTelemetry resTelemetry;
+            resTelemetry.id = id;
+            resTelemetry.kind = "placed";
+            resTelemetry.reservedBytes = placement->second.allocation.size;
+            resTelemetry.usedBytes = std::min(GetResourcePayloadSize(device_.get(), res->CreateResourceDesc()), placement->second.allocation.size);
+            outTelemetry.resources.push_back(std::move(resTelemetry));
+        }
+        else if(res->IsDynamic() && res->HasNativeResource()) {
+            // dynamic resources in their own upload heap resource, ring users have no memory of their own
+            outTelemetry.resources.push_back(GetCommittedResourceTelemetry(device_.get(), id, res->CreateResourceDesc()));
+            outTelemetry.reservedBytes += outTelemetry.resources.back().reservedBytes;
+        }
     }
+
+    const UploadRingBuffer& staging = uploader_->GetStagingRing();
+    outTelemetry.ringBuffers.push_back({ "Upload Ring Buffer", uploadRing_->GetSize(), uploadRing_->GetUsedSize() });
+    outTelemetry.ringBuffers.push_back({ "Upload Staging Ring", staging.GetSize(), staging.GetUsedSize() });
+    outTelemetry.reservedBytes += uploadRing_->GetSize() + staging.GetSize();
 }
 
 StaticMemoryAllocator::~StaticMemoryAllocator() {
     std::cout << "Destroying memory allocator..." << std::endl;
+
+    for(const Heap& heap : heaps_) {
+        const OffsetAllocatorStats stats = heap.allocator->GetStats();
+        std::cout << "Default heap: " << stats.usedSize << "/" << stats.totalSize << " bytes in "
+                  << stats.numAllocations << " placements, " << stats.numFreeBlocks << " free blocks, "
+                  << "fragmentation " << stats.GetFragmentation() << std::endl;
+    }
     
 }
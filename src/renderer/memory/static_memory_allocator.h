@@ -1,30 +1,26 @@
 ﻿#ifndef RENDERER_MEMORY_STATIC_MEMORY_ALLOCATOR_H_
 #define RENDERER_MEMORY_STATIC_MEMORY_ALLOCATOR_H_
 
-#include <queue>
-
+#include "chunked_uploader.h"
 #include "memory_allocator.h"
+#include "offset_allocator.h"
+#include "upload_ring_buffer.h"
 #include "renderer_types.h"
 
-
-struct UploadTask {
-    std::string fileName;
-    std::string texID;
-private:
-
-    //friend StaticDescriptorAllocator;
-    void* srcImage;
-};
-
 //
 // A (very) simple memory allocator that will
-// store all resources in a default heap of fixed size
+// store all resources in default heaps
 //
 // For transferring data (e.g. images -> textures, uploading (static) vertex buffers),
-// an upload queue is used, and one can refer to Resource::IsReady() for use. 
+// a ChunkedUploader is used, and one can refer to Resource::IsReady() for use. 
 //
-// Once StaticMemoryAllocator::Commit() is called, no further changes in the memory layout can be made.
-// Great for applications where memory is static and the size is known before hand.
+// Heap placement goes through an OffsetAllocator per heap. Commit() sizes the first heap for
+// everything created so far plus some headroom; static resources created afterwards go into
+// whatever space is left, and into additional heaps once that runs out.
+// Destroyed resources keep their placement until the GPU finished the frame they were destroyed in.
+// Dynamic constant buffers are sub-allocated from an UploadRingBuffer every frame, BeginFrame() moves
+// the ones that aren't updated into the new frame's slice before anything is recorded.
+// Great for applications where memory is mostly static and the size is known before hand.
 //
 class StaticMemoryAllocator : public MemoryAllocator {
 public:
@@ -33,24 +29,54 @@ public:
     
     void Update(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, winrt::com_ptr<ID3D12CommandQueue> cmdQueue);
     bool HasWork() override;
+    void SetTaskScheduler(std::shared_ptr<WorkStealingScheduler> scheduler) override;
+
+    void BeginFrame(uint64_t completedFenceValue) override;
+    void EndFrame(uint64_t fenceValue) override;
+
+    void GetTelemetry(MemoryAllocatorTelemetry& outTelemetry) const override;
     
 
 protected:
     void CommitImplementation() override;
     void OnResourceCreated(std::shared_ptr<Resource> newResource) override;
+    void OnResourceDestroyed(std::shared_ptr<Resource> resource) override;
     void InitializeDynamicResource(std::shared_ptr<Resource> res); 
     
 private:
-    void WaitForUploadComplete(winrt::com_ptr<ID3D12Fence> fence, std::vector<std::shared_ptr<Resource>> resUploading);
+    struct Heap {
+        winrt::com_ptr<ID3D12Heap> heap;
+        std::unique_ptr<OffsetAllocator> allocator;
+        uint64_t alignment;
+    };
+
+    struct Placement {
+        uint32_t heapIndex;
+        OffsetAllocation allocation;
+    };
+
+    // a destroyed resource, kept alive (and placed) until the GPU is done with it
+    struct PendingRelease {
+        std::shared_ptr<Resource> resource;
+        Placement placement;
+        uint64_t fenceValue;
+    };
+
+    bool PlaceResource(std::shared_ptr<Resource> res);
+    void AddHeap(uint64_t size, uint64_t alignment);
 
-    std::queue<std::shared_ptr<Resource>> uploadQueue_;
-    uint32_t heapSize_;
     winrt::com_ptr<ID3D12Device> device_;
-    winrt::com_ptr<ID3D12Heap> heap_;
-    winrt::com_ptr<ID3D12Heap> uploadHeap_;
-    
-    // std::vector<std::thread> uploadFenceThreads_;
-    // std::vector<std::atomic_bool> uploadFenceThreadDone_;
+
+    std::vector<Heap> heaps_;
+    std::map<const Resource*, Placement> placements_;
+
+    // destroyed during the current frame, they get the frame's fence value in EndFrame()
+    std::vector<PendingRelease> releasesThisFrame_;
+    std::vector<PendingRelease> pendingReleases_;
+
+    std::shared_ptr<UploadRingBuffer> uploadRing_;
+    std::vector<std::shared_ptr<DynamicBufferBase>> ringBuffers_; // every resource using uploadRing_
+    std::unique_ptr<ChunkedUploader> uploader_;
 };
 
 #endif // RENDERER_MEMORY_STATIC_MEMORY_ALLOCATOR_H_
@@ -0,0 +1,218 @@
+﻿#include "transient_resource_planner.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <numeric>
+
+#include "frame_graph.h"
+
+namespace {
+    uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    bool LifetimesIntersect(const TransientResourcePlacement& a, const TransientResourcePlacement& b) {
+        return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+    }
+
+    bool RangesIntersect(const TransientResourcePlacement& a, const TransientResourcePlacement& b) {
+        return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+    }
+}
+
+uint32_t TransientResourcePlanner::AddResource(std::string name, uint64_t size, uint64_t alignment, bool persistent) {
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "Alignment has to be a power of two.");
+
+    Resource res;
+    res.name = std::move(name);
+    res.size = size;
+    res.alignment = alignment;
+    res.persistent = persistent;
+    resources_.push_back(std::move(res));
+    return (uint32_t)resources_.size() - 1;
+}
+
+uint32_t TransientResourcePlanner::AddPass(std::string name) {
+    passes_.push_back(std::move(name));
+    return (uint32_t)passes_.size() - 1;
+}
+
+void TransientResourcePlanner::Read(uint32_t pass, uint32_t resource) {
+    Access(pass, resource, false);
+}
+
+void TransientResourcePlanner::Write(uint32_t pass, uint32_t resource) {
+    Access(pass, resource, true);
+}
+
+std::vector<uint32_t> TransientResourcePlanner::AddFrameGraph(const FrameGraph& graph, const std::vector<TransientResourceDesc>& resources) {
+    assert(resources.size() == graph.GetNumResources());
+
+    std::vector<uint32_t> indices(resources.size(), InvalidIndex);
+    for(uint32_t r = 0; r < resources.size(); r++) {
+        if(resources[r].alignment > 0) {
+            indices[r] = AddResource(graph.GetResourceName(r), resources[r].size, resources[r].alignment, resources[r].persistent);
+        }
+    }
+
+    for(uint32_t graphPass : graph.GetPassOrder()) {
+        const uint32_t pass = AddPass(graph.GetPassName(graphPass));
+        for(const FrameGraph::Access& access : graph.GetPassAccesses(graphPass)) {
+            if(indices[access.resource] != InvalidIndex) {
+                Access(pass, indices[access.resource], access.write);
+            }
+        }
+    }
+    return indices;
+}
+
+void TransientResourcePlanner::Access(uint32_t pass, uint32_t resource, bool write) {
+    assert(pass < passes_.size() && resource < resources_.size());
+    Resource& res = resources_[resource];
+
+    if(res.firstPass == InvalidIndex || pass < res.firstPass) {
+        res.firstPass = pass;
+        res.readFirst = !write;
+    }
+    else if(pass == res.firstPass && !write) {
+        // read-modify-write in the first pass needs the old contents too
+        res.readFirst = true;
+    }
+
+    if(res.lastPass == InvalidIndex || pass > res.lastPass) {
+        res.lastPass = pass;
+    }
+}
+
+bool TransientResourcePlanner::IsAliasable(const Resource& res) const {
+    return !res.persistent && !res.readFirst && res.firstPass != InvalidIndex;
+}
+
+TransientAliasingPlan TransientResourcePlanner::Plan() const {
+    const uint32_t lastFramePass = passes_.empty() ? 0 : (uint32_t)passes_.size() - 1;
+
+    TransientAliasingPlan plan;
+    plan.heapSize = 0;
+    plan.unaliasedSize = 0;
+
+    for(const Resource& res : resources_) {
+        const bool aliasable = IsAliasable(res);
+        plan.placements.push_back(TransientResourcePlacement {
+            .offset = 0,
+            .size = res.size,
+            .firstPass = aliasable ? res.firstPass : 0,
+            .lastPass = aliasable ? res.lastPass : lastFramePass,
+            .aliasable = aliasable
+        });
+
+        plan.unaliasedSize = AlignUp(plan.unaliasedSize, res.alignment) + res.size;
+    }
+
+    // whole frame resources first (they can't share anything), then the big ones while there's room
+    std::vector<uint32_t> order(resources_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)->bool {
+        const TransientResourcePlacement& pa = plan.placements[a];
+        const TransientResourcePlacement& pb = plan.placements[b];
+        if(pa.aliasable != pb.aliasable) {
+            return !pa.aliasable;
+        }
+        if(pa.size != pb.size) {
+            return pa.size > pb.size;
+        }
+        return pa.firstPass < pb.firstPass;
+    });
+
+    // first fit below everything that's alive at the same time
+    std::vector<uint32_t> placed;
+    for(uint32_t index : order) {
+        TransientResourcePlacement& placement = plan.placements[index];
+        const uint64_t alignment = resources_[index].alignment;
+
+        std::vector<uint32_t> conflicts;
+        for(uint32_t other : placed) {
+            if(LifetimesIntersect(placement, plan.placements[other])) {
+                conflicts.push_back(other);
+            }
+        }
+        std::sort(conflicts.begin(), conflicts.end(), [&](uint32_t a, uint32_t b)->bool {
+            return plan.placements[a].offset < plan.placements[b].offset;
+        });
+
+        uint64_t offset = 0;
+        for(uint32_t other : conflicts) {
+            const TransientResourcePlacement& occupied = plan.placements[other];
+            if(AlignUp(offset, alignment) + placement.size <= occupied.offset) {
+                break;
+            }
+            offset = std::max(offset, occupied.offset + occupied.size);
+        }
+
+        placement.offset = AlignUp(offset, alignment);
+        plan.heapSize = std::max(plan.heapSize, placement.offset + placement.size);
+        placed.push_back(index);
+    }
+
+    // Whoever shares memory with a resource used it before its first pass, in this frame or
+    // (for the earliest user of a range) the previous one. With more than one of them the
+    // barrier can't name a single resource.
+    for(uint32_t index = 0; index < plan.placements.size(); index++) {
+        const TransientResourcePlacement& placement = plan.placements[index];
+        if(!placement.aliasable || placement.size == 0) {
+            continue;
+        }
+
+        uint32_t numSharing = 0;
+        uint32_t sharing = InvalidIndex;
+        for(uint32_t other = 0; other < plan.placements.size(); other++) {
+            if(other != index && plan.placements[other].size > 0 && RangesIntersect(placement, plan.placements[other])) {
+                numSharing++;
+                sharing = other;
+            }
+        }
+
+        if(numSharing > 0) {
+            plan.barriers.push_back(TransientAliasingBarrier {
+                .pass = placement.firstPass,
+                .resourceBefore = numSharing == 1 ? sharing : InvalidIndex,
+                .resourceAfter = index
+            });
+        }
+    }
+
+    std::stable_sort(plan.barriers.begin(), plan.barriers.end(), [](const TransientAliasingBarrier& a, const TransientAliasingBarrier& b)->bool {
+        return a.pass < b.pass;
+    });
+
+    return plan;
+}
+
+void TransientResourcePlanner::PrintPlan(const TransientAliasingPlan& plan) const {
+    std::cout << "Transient resource plan (" << passes_.size() << " passes):" << std::endl;
+
+    for(uint32_t i = 0; i < resources_.size(); i++) {
+        const TransientResourcePlacement& placement = plan.placements[i];
+        std::cout << "  " << resources_[i].name << ": " << placement.size << " bytes at " << placement.offset;
+        if(placement.aliasable) {
+            std::cout << ", passes " << placement.firstPass << "-" << placement.lastPass << std::endl;
+        }
+        else {
+            std::cout << ", whole frame" << std::endl;
+        }
+    }
+
+    for(const TransientAliasingBarrier& barrier : plan.barriers) {
+        std::cout << "  aliasing barrier before '" << passes_[barrier.pass] << "': "
+                  << (barrier.resourceBefore == InvalidIndex ? std::string("(any)") : resources_[barrier.resourceBefore].name)
+                  << " -> " << resources_[barrier.resourceAfter].name << std::endl;
+    }
+
+    const uint64_t saved = plan.unaliasedSize - std::min(plan.unaliasedSize, plan.heapSize);
+    if(saved == 0) {
+        std::cout << "  no two resources can share memory, aliasing saves nothing (" << plan.heapSize << " bytes)" << std::endl;
+        return;
+    }
+    std::cout << "  peak memory " << plan.heapSize << " bytes instead of " << plan.unaliasedSize
+              << " (" << saved << " bytes, " << 100.0 * (double)saved / (double)plan.unaliasedSize << "% saved)" << std::endl;
+}
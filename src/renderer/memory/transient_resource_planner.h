@@ -0,0 +1,99 @@
+﻿#ifndef RENDERER_MEMORY_TRANSIENT_RESOURCE_PLANNER_H_
+#define RENDERER_MEMORY_TRANSIENT_RESOURCE_PLANNER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class FrameGraph;
+
+struct TransientResourcePlacement {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t firstPass;
+    uint32_t lastPass;
+    // false for resources that have to keep their contents for the whole frame
+    bool aliasable;
+};
+
+// D3D12_RESOURCE_ALIASING_BARRIER, issued right before `pass`
+struct TransientAliasingBarrier {
+    uint32_t pass;
+    uint32_t resourceBefore; // TransientResourcePlanner::InvalidIndex means "any" (a NULL pResourceBefore)
+    uint32_t resourceAfter;
+};
+
+// what a FrameGraph resource takes in the heap, from GetResourceAllocationInfo
+struct TransientResourceDesc {
+    uint64_t size = 0;
+    uint64_t alignment = 0; // 0 for resources that aren't placed in the heap (the swap chain)
+    bool persistent = false;
+};
+
+struct TransientAliasingPlan {
+    std::vector<TransientResourcePlacement> placements; // by resource index
+    std::vector<TransientAliasingBarrier> barriers;     // by pass
+    uint64_t heapSize;      // with aliasing
+    uint64_t unaliasedSize; // every resource in a range of its own
+};
+
+//
+// Lifetime analysis over one frame's pass sequence, for placing resources in a shared heap.
+//
+// Passes are declared in execution order, each with the resources it reads and writes.
+// A resource lives from its first to its last use. Resources whose lifetimes don't
+// intersect get overlapping heap ranges, and every resource that takes over memory
+// from another one gets an aliasing barrier before its first pass.
+//
+// A resource is only aliasable if it's written before it's read within the frame, and
+// its first pass has to overwrite it completely (full write, clear or discard). Anything
+// that's read first (history buffers, data uploaded once) lives for the whole frame, as
+// do resources marked persistent.
+//
+class TransientResourcePlanner {
+public:
+    static constexpr uint32_t InvalidIndex = ~0u;
+
+    // alignment has to be a power of two
+    uint32_t AddResource(std::string name, uint64_t size, uint64_t alignment, bool persistent = false);
+    uint32_t AddPass(std::string name);
+
+    void Read(uint32_t pass, uint32_t resource);
+    void Write(uint32_t pass, uint32_t resource);
+
+    // Adds the passes of a compiled graph that weren't culled, in the order they run, with their accesses.
+    // resources has a desc per graph resource. The first write of an aliasable resource has to cover all of it.
+    // Returns the planner index of every graph resource, InvalidIndex for the ones that aren't in the heap.
+    std::vector<uint32_t> AddFrameGraph(const FrameGraph& graph, const std::vector<TransientResourceDesc>& resources);
+
+    TransientAliasingPlan Plan() const;
+
+    // per resource placement and the barriers, and how much memory aliasing saves
+    void PrintPlan(const TransientAliasingPlan& plan) const;
+
+    uint32_t GetNumResources() const { return (uint32_t)resources_.size(); }
+    uint32_t GetNumPasses() const { return (uint32_t)passes_.size(); }
+    const std::string& GetResourceName(uint32_t resource) const { return resources_[resource].name; }
+    const std::string& GetPassName(uint32_t pass) const { return passes_[pass]; }
+
+private:
+    struct Resource {
+        std::string name;
+        uint64_t size;
+        uint64_t alignment;
+        bool persistent;
+
+        uint32_t firstPass = InvalidIndex;
+        uint32_t lastPass = InvalidIndex;
+        bool readFirst = false;
+    };
+
+    void Access(uint32_t pass, uint32_t resource, bool write);
+
+    bool IsAliasable(const Resource& res) const;
+
+    std::vector<Resource> resources_;
+    std::vector<std::string> passes_;
+};
+
+#endif // RENDERER_MEMORY_TRANSIENT_RESOURCE_PLANNER_H_
@@ -0,0 +1,42 @@
+﻿#include "directx/d3dx12.h"
+#include "upload_ring_buffer.h"
+
+UploadRingBuffer::UploadRingBuffer(winrt::com_ptr<ID3D12Device> device, uint64_t size, const wchar_t* name)
+    : ring_(size), mappedData_(nullptr), gpuAddress_(0) {
+    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+    HRESULT hr = device->CreateCommittedResource(&heapProps,
+                                                 D3D12_HEAP_FLAG_NONE,
+                                                 &resDesc,
+                                                 D3D12_RESOURCE_STATE_GENERIC_READ,
+                                                 nullptr,
+                                                 __uuidof(ID3D12Resource),
+                                                 buffer_.put_void());
+    winrt::check_hresult(hr);
+    buffer_->SetName(name);
+
+    // upload heaps can stay mapped for their whole lifetime
+    D3D12_RANGE readRange = {0, 0};
+    hr = buffer_->Map(0, &readRange, reinterpret_cast<void**>(&mappedData_));
+    winrt::check_hresult(hr);
+
+    gpuAddress_ = buffer_->GetGPUVirtualAddress();
+}
+
+UploadRingBuffer::~UploadRingBuffer() {
+    buffer_->Unmap(0, nullptr);
+}
+
+UploadAllocation UploadRingBuffer::Allocate(uint64_t size, uint64_t alignment) {
+    const uint64_t offset = ring_.Allocate(size, alignment);
+    if(offset == RingAllocator::InvalidOffset) {
+        return UploadAllocation();
+    }
+
+    UploadAllocation allocation;
+    allocation.cpuAddress = mappedData_ + offset;
+    allocation.gpuAddress = gpuAddress_ + offset;
+    allocation.offset = offset;
+    return allocation;
+}
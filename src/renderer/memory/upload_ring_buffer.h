@@ -0,0 +1,49 @@
+﻿#ifndef RENDERER_MEMORY_UPLOAD_RING_BUFFER_H_
+#define RENDERER_MEMORY_UPLOAD_RING_BUFFER_H_
+
+#include <d3d12.h>
+#include <cstdint>
+#include <winrt/windows.foundation.h>
+
+#include "ring_allocator.h"
+
+struct UploadAllocation {
+    void* cpuAddress = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+    uint64_t offset = 0; // in GetResource(), for copies
+
+    bool IsValid() const { return cpuAddress != nullptr; }
+};
+
+//
+// One persistently mapped upload heap buffer that per-frame data (constant buffers, staged
+// uploads) is sub-allocated from. A frame's allocations are only reused once the GPU signaled the
+// frame's fence, so the CPU never writes into memory a frame in flight still reads.
+//
+class UploadRingBuffer {
+public:
+    UploadRingBuffer(winrt::com_ptr<ID3D12Device> device, uint64_t size, const wchar_t* name = L"Upload Ring Buffer");
+    ~UploadRingBuffer();
+
+    UploadRingBuffer(const UploadRingBuffer&) = delete;
+    UploadRingBuffer& operator=(const UploadRingBuffer&) = delete;
+
+    // invalid allocation if the ring is full, until frames in flight are released
+    UploadAllocation Allocate(uint64_t size, uint64_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+    void FinishFrame(uint64_t fenceValue) { ring_.FinishFrame(fenceValue); }
+    void ReleaseCompletedFrames(uint64_t completedFenceValue) { ring_.ReleaseCompletedFrames(completedFenceValue); }
+
+    uint64_t GetFrameIndex() const { return ring_.GetFrameIndex(); }
+    uint64_t GetUsedSize() const { return ring_.GetUsedSize(); }
+    uint64_t GetSize() const { return ring_.GetSize(); }
+    ID3D12Resource* GetResource() const { return buffer_.get(); }
+
+private:
+    RingAllocator ring_;
+    winrt::com_ptr<ID3D12Resource> buffer_;
+    uint8_t* mappedData_;
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress_;
+};
+
+#endif // RENDERER_MEMORY_UPLOAD_RING_BUFFER_H_
@@ -0,0 +1,148 @@
+﻿#ifndef RENDERER_MULTITHREADING_CHASE_LEV_DEQUE_H_
+#define RENDERER_MULTITHREADING_CHASE_LEV_DEQUE_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+//
+// Lock-free work-stealing deque (Chase & Lev 2005, with the C11 memory orderings from
+// Le, Pop, Cohen & Zappa Nardelli 2013).
+// The owning thread pushes/pops at the bottom (LIFO, cache friendly), any other
+// thread steals from the top (FIFO). T has to be trivially copyable, in practice a pointer.
+//
+template <typename T>
+class ChaseLevDeque {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    ChaseLevDeque(int64_t capacity = 256);
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    // owner thread only
+    void Push(T item);
+    bool Pop(T& outItem);
+
+    // any thread, can fail spuriously when racing with another thief or the owner
+    bool Steal(T& outItem);
+
+    // snapshot, only a hint while other threads are working on the deque
+    bool IsEmpty() const {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Array {
+        Array(int64_t capacity)
+            : capacity(capacity), mask(capacity - 1), items(new std::atomic<T>[capacity]) {
+            assert((capacity & mask) == 0 && "Capacity has to be a power of two.");
+        }
+
+        T Get(int64_t i) const { return items[i & mask].load(std::memory_order_relaxed); }
+        void Put(int64_t i, T item) { items[i & mask].store(item, std::memory_order_relaxed); }
+
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> items;
+    };
+
+    Array* Grow(Array* array, int64_t top, int64_t bottom);
+
+    // top and bottom on their own cache lines, thieves hammer top_ while the owner works on bottom_
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    alignas(64) std::atomic<Array*> array_;
+
+    // Arrays replaced by Grow(). A thief may still be reading one, so they're
+    // only freed with the deque. Growth doubles, so this is bounded by the final size.
+    std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+template <typename T>
+ChaseLevDeque<T>::ChaseLevDeque(int64_t capacity)
+    : top_(0), bottom_(0) {
+    arrays_.push_back(std::make_unique<Array>(capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+}
+
+template <typename T>
+typename ChaseLevDeque<T>::Array* ChaseLevDeque<T>::Grow(Array* array, int64_t top, int64_t bottom) {
+    arrays_.push_back(std::make_unique<Array>(array->capacity * 2));
+    Array* newArray = arrays_.back().get();
+
+    for(int64_t i = top; i < bottom; i++) {
+        newArray->Put(i, array->Get(i));
+    }
+
+    return newArray;
+}
+
+template <typename T>
+void ChaseLevDeque<T>::Push(T item) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    Array* array = array_.load(std::memory_order_relaxed);
+
+    if(bottom - top > array->capacity - 1) {
+        array = Grow(array, top, bottom);
+        array_.store(array, std::memory_order_release);
+    }
+
+    array->Put(bottom, item);
+    // The paper uses a release fence + relaxed store here. Release stores to bottom_ (also in
+    // Pop()) give thieves the same guarantee and are something ThreadSanitizer understands.
+    bottom_.store(bottom + 1, std::memory_order_release);
+}
+
+template <typename T>
+bool ChaseLevDeque<T>::Pop(T& outItem) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* array = array_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+
+    if(top > bottom) {
+        // empty
+        bottom_.store(bottom + 1, std::memory_order_release);
+        return false;
+    }
+
+    outItem = array->Get(bottom);
+    if(top == bottom) {
+        // last item, race the thieves for it
+        const bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom_.store(bottom + 1, std::memory_order_release);
+        return won;
+    }
+
+    return true;
+}
+
+template <typename T>
+bool ChaseLevDeque<T>::Steal(T& outItem) {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+
+    if(top >= bottom) {
+        return false;
+    }
+
+    // acquire instead of consume, which every compiler promotes to acquire anyway
+    Array* array = array_.load(std::memory_order_acquire);
+    const T item = array->Get(top);
+    if(!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return false;
+    }
+
+    outItem = item;
+    return true;
+}
+
+#endif // RENDERER_MULTITHREADING_CHASE_LEV_DEQUE_H_
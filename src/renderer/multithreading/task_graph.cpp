@@ -0,0 +1,71 @@
+﻿#include "task_graph.h"
+
+#include <cassert>
+
+GraphTask::GraphTask(WorkStealingScheduler* scheduler, std::unique_ptr<Callable> callable)
+    : scheduler_(scheduler), callable_(std::move(callable)), numPending_(1), submitted_(false), finished_(false) {
+}
+
+bool GraphTask::IsFinished() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_;
+}
+
+TaskGraph::TaskGraph(std::shared_ptr<WorkStealingScheduler> scheduler)
+    : scheduler_(std::move(scheduler)) {
+    assert(scheduler_);
+}
+
+void TaskGraph::AddDependency(const GraphTaskHandle& predecessor, const GraphTaskHandle& successor) {
+    assert(predecessor && successor && predecessor != successor);
+    {
+        std::lock_guard<std::mutex> lock(successor->mutex_);
+        assert(!successor->submitted_ && "Dependencies have to be added before the task is submitted.");
+    }
+
+    std::lock_guard<std::mutex> lock(predecessor->mutex_);
+    if(predecessor->finished_) {
+        return;
+    }
+
+    // counted before it's registered, so the predecessor finishing right after
+    // the unlock can't release the successor early
+    successor->numPending_.fetch_add(1);
+    predecessor->successors_.push_back(successor);
+}
+
+void TaskGraph::Submit(const GraphTaskHandle& task) {
+    {
+        std::lock_guard<std::mutex> lock(task->mutex_);
+        assert(!task->submitted_ && "Task submitted twice.");
+        task->submitted_ = true;
+    }
+
+    Release(task);
+}
+
+void TaskGraph::Release(const GraphTaskHandle& task) {
+    if(task->numPending_.fetch_sub(1) != 1) {
+        return;
+    }
+
+    task->scheduler_->Submit([task]() {
+        Run(task);
+    });
+}
+
+void TaskGraph::Run(const GraphTaskHandle& task) {
+    task->callable_->Run();
+    task->callable_.reset();
+
+    std::vector<GraphTaskHandle> successors;
+    {
+        std::lock_guard<std::mutex> lock(task->mutex_);
+        task->finished_ = true;
+        successors.swap(task->successors_);
+    }
+
+    for(const GraphTaskHandle& successor : successors) {
+        Release(successor);
+    }
+}
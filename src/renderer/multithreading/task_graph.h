@@ -0,0 +1,98 @@
+﻿#ifndef RENDERER_MULTITHREADING_TASK_GRAPH_H_
+#define RENDERER_MULTITHREADING_TASK_GRAPH_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "work_stealing_scheduler.h"
+
+class TaskGraph;
+
+//
+// Node of a TaskGraph. Only becomes runnable once it's been submitted and every
+// predecessor has finished, so a task never has to block on another one.
+//
+class GraphTask {
+public:
+    ~GraphTask() = default;
+
+    GraphTask(const GraphTask&) = delete;
+    GraphTask& operator=(const GraphTask&) = delete;
+
+    bool IsFinished() const;
+
+private:
+    friend TaskGraph;
+
+    struct Callable {
+        virtual ~Callable() = default;
+        virtual void Run() = 0;
+    };
+
+    template <typename Func>
+    struct CallableImpl : Callable {
+        CallableImpl(Func&& f) : func(std::move(f)) {}
+        CallableImpl(const Func& f) : func(f) {}
+        void Run() override { func(); }
+
+        Func func;
+    };
+
+    GraphTask(WorkStealingScheduler* scheduler, std::unique_ptr<Callable> callable);
+
+    WorkStealingScheduler* scheduler_;
+    std::unique_ptr<Callable> callable_;
+
+    // unfinished predecessors, +1 until the task is submitted
+    std::atomic<uint32_t> numPending_;
+
+    mutable std::mutex mutex_;
+    bool submitted_;                                    // guarded by mutex_
+    bool finished_;                                     // guarded by mutex_
+    std::vector<std::shared_ptr<GraphTask>> successors_; // guarded by mutex_
+};
+
+typedef std::shared_ptr<GraphTask> GraphTaskHandle;
+
+//
+// Dependency tracking on top of WorkStealingScheduler.
+//
+//   GraphTaskHandle compile = graph.CreateTask(...);
+//   GraphTaskHandle assemble = graph.CreateTask(...);
+//   TaskGraph::AddDependency(compile, assemble);
+//   graph.Submit(compile);
+//   graph.Submit(assemble); // runs on a worker once compile is done
+//
+// The last predecessor to finish pushes the successor onto its own worker's deque,
+// so no thread ever waits on a task. Tasks are expected not to throw, wrap them in a
+// std::packaged_task if they can. The scheduler has to outlive every task created here.
+//
+class TaskGraph {
+public:
+    TaskGraph(std::shared_ptr<WorkStealingScheduler> scheduler);
+
+    template <typename Func>
+    GraphTaskHandle CreateTask(Func&& func) {
+        std::unique_ptr<GraphTask::Callable> callable = std::make_unique<GraphTask::CallableImpl<std::decay_t<Func>>>(std::forward<Func>(func));
+        return GraphTaskHandle(new GraphTask(scheduler_.get(), std::move(callable)));
+    }
+
+    // successor runs after predecessor finished. Has to be called before successor is
+    // submitted, a predecessor that already finished is no dependency at all.
+    static void AddDependency(const GraphTaskHandle& predecessor, const GraphTaskHandle& successor);
+
+    void Submit(const GraphTaskHandle& task);
+
+    const std::shared_ptr<WorkStealingScheduler>& GetScheduler() const { return scheduler_; }
+
+private:
+    static void Release(const GraphTaskHandle& task);
+    static void Run(const GraphTaskHandle& task);
+
+    std::shared_ptr<WorkStealingScheduler> scheduler_;
+};
+
+#endif // RENDERER_MULTITHREADING_TASK_GRAPH_H_
@@ -1,13 +1,15 @@
 ﻿#ifndef RENDERER_MULTITHREADING_THREAD_POOL_H_
 #define RENDERER_MULTITHREADING_THREAD_POOL_H_
 
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
 #include <functional>
 #include <future>
 #include <mutex>
 #include <queue>
 #include <vector>
 #include <thread>
-#include <winrt/base.h>
 #include <iostream>
 
 //
@@ -63,7 +65,7 @@ ThreadPool<T>::~ThreadPool() {
 
 template <typename T>
 void ThreadPool<T>::Start() {
-    WINRT_ASSERT(!started && "Trying to start the thread pool again.");
+    assert(!started && "Trying to start the thread pool again.");
     started = true;
 
     for(int i = 0; i < numThreads_; i++) {
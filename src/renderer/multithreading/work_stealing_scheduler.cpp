@@ -0,0 +1,274 @@
+﻿#include "work_stealing_scheduler.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    // how often an idle worker looks for work again (yielding in between) before it parks
+    const uint32_t NumSearchRounds = 64;
+
+    // cap on how many tasks a worker moves from the injection queue to its own deque at once
+    const size_t MaxInjectedBatch = 32;
+
+    thread_local const WorkStealingScheduler* currentScheduler = nullptr;
+    thread_local uint32_t currentWorkerIndex = 0;
+
+    uint32_t XorShift(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+}
+
+WorkStealingScheduler::WorkStealingScheduler(uint16_t numThreads)
+    : numInjected_(0), numSearching_(0), numSleeping_(0), wakeTokens_(0), shouldTerminate_(false), started_(false) {
+    if(numThreads == 0) {
+        numThreads_ = std::max(1u, std::thread::hardware_concurrency());
+    }
+    else {
+        numThreads_ = numThreads;
+    }
+
+    for(uint32_t i = 0; i < numThreads_; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+        workers_.back()->rngState = 0x9e3779b9u * (i + 1);
+    }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+    Stop();
+    DrainTasks();
+}
+
+void WorkStealingScheduler::Start() {
+    assert(!started_ && "Trying to start the scheduler again.");
+    started_ = true;
+
+    for(uint32_t i = 0; i < numThreads_; i++) {
+        threads_.push_back(std::thread(&WorkStealingScheduler::ThreadDoWork, this, i));
+    }
+}
+
+void WorkStealingScheduler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        if(shouldTerminate_) {
+            return;
+        }
+
+        shouldTerminate_ = true;
+    }
+    sleepCondVar_.notify_all();
+
+    for(std::thread& t : threads_) {
+        t.join();
+    }
+
+    threads_.clear();
+}
+
+int WorkStealingScheduler::GetCurrentWorkerIndex() const {
+    return currentScheduler == this ? (int)currentWorkerIndex : -1;
+}
+
+void WorkStealingScheduler::Push(Task* task) {
+    const int workerIndex = GetCurrentWorkerIndex();
+    if(workerIndex >= 0) {
+        workers_[workerIndex]->deque.Push(task);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(injectionMutex_);
+        injectionQueue_.push_back(task);
+        numInjected_.fetch_add(1);
+    }
+
+    NotifyWork();
+}
+
+void WorkStealingScheduler::NotifyWork() {
+    // pairs with the fence in HasWork(): either a parking worker sees the new task,
+    // or we see it parked
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // a searching worker will pick the task up, waking another one would only add contention
+    if(numSearching_.load() == 0 && numSleeping_.load() > 0) {
+        WakeOne();
+    }
+}
+
+void WorkStealingScheduler::WakeOne() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        wakeTokens_ = std::min<uint32_t>(wakeTokens_ + 1, numThreads_);
+    }
+    sleepCondVar_.notify_one();
+}
+
+void WorkStealingScheduler::ThreadDoWork(uint32_t workerIndex) {
+    currentScheduler = this;
+    currentWorkerIndex = workerIndex;
+
+    bool searching = false;
+
+    while(!shouldTerminate_) {
+        Task* task = FindTask(workerIndex);
+
+        if(!task) {
+            if(!searching) {
+                searching = true;
+                numSearching_.fetch_add(1);
+            }
+
+            for(uint32_t i = 0; i < NumSearchRounds && !task && !shouldTerminate_; i++) {
+                std::this_thread::yield();
+                task = FindTask(workerIndex);
+            }
+        }
+
+        if(task) {
+            if(searching) {
+                searching = false;
+                // the last searcher hands the search over to a parked worker if there's more to do
+                if(numSearching_.fetch_sub(1) == 1 && HasWork()) {
+                    NotifyWork();
+                }
+            }
+
+            task->Run();
+            delete task;
+            continue;
+        }
+
+        if(shouldTerminate_) {
+            break;
+        }
+
+        // park
+        numSleeping_.fetch_add(1);
+        searching = false;
+        numSearching_.fetch_sub(1);
+
+        // a task pushed while we were giving up either shows up here, or its NotifyWork() sees us sleeping
+        if(HasWork()) {
+            numSleeping_.fetch_sub(1);
+            continue;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            sleepCondVar_.wait(lock, [this]()->bool {
+                return wakeTokens_ > 0 || shouldTerminate_;
+            });
+
+            if(wakeTokens_ > 0) {
+                wakeTokens_--;
+            }
+        }
+
+        numSleeping_.fetch_sub(1);
+
+        // woken workers start out searching
+        searching = true;
+        numSearching_.fetch_add(1);
+    }
+
+    if(searching) {
+        numSearching_.fetch_sub(1);
+    }
+
+    currentScheduler = nullptr;
+    std::cout << "Worker thread terminating..." << std::endl;
+}
+
+WorkStealingScheduler::Task* WorkStealingScheduler::FindTask(uint32_t workerIndex) {
+    Task* task;
+    if(workers_[workerIndex]->deque.Pop(task)) {
+        return task;
+    }
+
+    task = PopInjected(workerIndex);
+    if(task) {
+        return task;
+    }
+
+    return Steal(workerIndex);
+}
+
+WorkStealingScheduler::Task* WorkStealingScheduler::PopInjected(uint32_t workerIndex) {
+    if(numInjected_.load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(injectionMutex_);
+    if(injectionQueue_.empty()) {
+        return nullptr;
+    }
+
+    Task* task = injectionQueue_.front();
+    injectionQueue_.pop_front();
+
+    // take a fair share along, so the other workers don't all queue up on this lock
+    const size_t batch = std::min(injectionQueue_.size() / numThreads_, MaxInjectedBatch);
+    ChaseLevDeque<Task*>& deque = workers_[workerIndex]->deque;
+    for(size_t i = 0; i < batch; i++) {
+        deque.Push(injectionQueue_.front());
+        injectionQueue_.pop_front();
+    }
+
+    numInjected_.fetch_sub(1 + batch);
+    return task;
+}
+
+WorkStealingScheduler::Task* WorkStealingScheduler::Steal(uint32_t workerIndex) {
+    if(numThreads_ < 2) {
+        return nullptr;
+    }
+
+    const uint32_t start = XorShift(workers_[workerIndex]->rngState) % numThreads_;
+    for(uint32_t i = 0; i < numThreads_; i++) {
+        const uint32_t victim = (start + i) % numThreads_;
+        if(victim == workerIndex) {
+            continue;
+        }
+
+        Task* task;
+        if(workers_[victim]->deque.Steal(task)) {
+            return task;
+        }
+    }
+
+    return nullptr;
+}
+
+bool WorkStealingScheduler::HasWork() const {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(numInjected_.load(std::memory_order_relaxed) > 0) {
+        return true;
+    }
+
+    for(const std::unique_ptr<Worker>& worker : workers_) {
+        if(!worker->deque.IsEmpty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingScheduler::DrainTasks() {
+    // only called once every worker has been joined
+    for(const std::unique_ptr<Worker>& worker : workers_) {
+        Task* task;
+        while(worker->deque.Steal(task)) {
+            delete task;
+        }
+    }
+
+    for(Task* task : injectionQueue_) {
+        delete task;
+    }
+    injectionQueue_.clear();
+    numInjected_ = 0;
+}
@@ -0,0 +1,160 @@
+﻿#ifndef RENDERER_MULTITHREADING_WORK_STEALING_SCHEDULER_H_
+#define RENDERER_MULTITHREADING_WORK_STEALING_SCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "chase_lev_deque.h"
+
+//
+// Work-stealing replacement for ThreadPool<T>.
+//
+// Every worker owns a ChaseLevDeque: tasks submitted from a worker go to its own
+// deque, tasks submitted from any other thread go to one global injection queue.
+// An idle worker looks at its deque, then the injection queue, then steals from
+// the other workers, starting at a random victim.
+//
+// Waking: a worker that runs out of work spins (searching) for a bit before it parks.
+// A submit only wakes a parked worker if nobody is searching, and only ever one.
+// A woken worker that finds work while being the last searcher wakes the next one,
+// so a burst of tasks ramps the workers up one at a time instead of all at once.
+//
+class WorkStealingScheduler {
+public:
+    WorkStealingScheduler(uint16_t numThreads = 0);
+    ~WorkStealingScheduler();
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    void Start();
+
+    // tasks that haven't started yet are dropped (their futures see a broken promise)
+    void Stop();
+
+    // same entry point as ThreadPool<T>
+    template <typename T>
+    void AddTask(std::packaged_task<T()>&& job) {
+        Submit(std::move(job));
+    }
+
+    // any void() callable, move-only ones included
+    template <typename Func>
+    void Submit(Func&& func) {
+        Push(new TaskImpl<std::decay_t<Func>>(std::forward<Func>(func)));
+    }
+
+    // Calls func(index, slot) for every index in [0, count) on up to numSlots threads, the calling one
+    // included, and returns once every call returned. Indices are handed out one at a time, so uneven
+    // items balance out. slot < min(numSlots, count) tells the threads apart, for per thread scratch.
+    // The caller only waits for items that are already running, so this can be called from a worker.
+    template <typename Func>
+    void ParallelFor(uint32_t count, uint32_t numSlots, const Func& func);
+
+    uint16_t GetNumThreads() const { return numThreads_; }
+
+    // index of the calling worker thread of this scheduler, -1 for any other thread
+    int GetCurrentWorkerIndex() const;
+
+private:
+    struct Task {
+        virtual ~Task() = default;
+        virtual void Run() = 0;
+    };
+
+    template <typename Func>
+    struct TaskImpl : Task {
+        TaskImpl(Func&& f) : func(std::move(f)) {}
+        TaskImpl(const Func& f) : func(f) {}
+        void Run() override { func(); }
+
+        Func func;
+    };
+
+    struct alignas(64) Worker {
+        ChaseLevDeque<Task*> deque;
+        uint32_t rngState = 0;
+    };
+
+    void Push(Task* task);
+    void NotifyWork();
+    void WakeOne();
+
+    void ThreadDoWork(uint32_t workerIndex);
+    Task* FindTask(uint32_t workerIndex);
+    Task* PopInjected(uint32_t workerIndex);
+    Task* Steal(uint32_t workerIndex);
+    bool HasWork() const;
+    void DrainTasks();
+
+    uint16_t numThreads_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex injectionMutex_;
+    std::deque<Task*> injectionQueue_;
+    std::atomic<size_t> numInjected_;
+
+    // parking
+    alignas(64) std::atomic<uint32_t> numSearching_;
+    alignas(64) std::atomic<uint32_t> numSleeping_;
+    std::mutex sleepMutex_;
+    std::condition_variable sleepCondVar_;
+    uint32_t wakeTokens_; // guarded by sleepMutex_
+
+    std::atomic_bool shouldTerminate_;
+    bool started_;
+};
+
+template <typename Func>
+void WorkStealingScheduler::ParallelFor(uint32_t count, uint32_t numSlots, const Func& func) {
+    numSlots = std::min(numSlots, count);
+    if(numSlots == 0) {
+        return;
+    }
+
+    struct State {
+        std::atomic<uint32_t> nextIndex = 0;
+        std::atomic<uint32_t> numDone = 0;
+    };
+
+    // A helper that only starts after the last index was claimed never calls func, it may be gone by then.
+    // The counters live until the last helper is done with them.
+    std::shared_ptr<State> state = std::make_shared<State>();
+    auto run = [&func, count](State& state, uint32_t slot) {
+        while(true) {
+            const uint32_t index = state.nextIndex.fetch_add(1);
+            if(index >= count) {
+                return;
+            }
+
+            func(index, slot);
+            if(state.numDone.fetch_add(1) + 1 == count) {
+                state.numDone.notify_all();
+            }
+        }
+    };
+
+    for(uint32_t slot = 1; slot < numSlots; slot++) {
+        Submit([state, run, slot]() {
+            run(*state, slot);
+        });
+    }
+    run(*state, 0);
+
+    uint32_t numDone = state->numDone.load();
+    while(numDone < count) {
+        state->numDone.wait(numDone);
+        numDone = state->numDone.load();
+    }
+}
+
+#endif // RENDERER_MULTITHREADING_WORK_STEALING_SCHEDULER_H_
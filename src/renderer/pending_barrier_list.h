@@ -0,0 +1,189 @@
+﻿#ifndef RENDERER_PENDING_BARRIER_LIST_H_
+#define RENDERER_PENDING_BARRIER_LIST_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// The API independent part of ResourceBarrierBatcher (resource_barrier_batcher.h): the barriers
+// waiting for the next flush, with transitions merged, UAV barriers dropped and split transitions
+// paired up as described there. Resource identifies a resource (ID3D12Resource*), States are its
+// state bits (D3D12_RESOURCE_STATES), so the merging can be checked without a device.
+//
+template<typename Resource, typename States>
+class PendingBarrierList {
+public:
+    struct Barrier {
+        enum class Type {
+            Transition,
+            UAV // before and after are unused
+        };
+
+        // halves of a split transition (D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY/END_ONLY), same before and after
+        enum class Split {
+            None,
+            Begin,
+            End
+        };
+
+        Type type;
+        Resource res;
+        States before;
+        States after;
+        Split split;
+    };
+
+    struct Stats {
+        uint64_t numRequested = 0; // transitions and UAV barriers asked for, split ones count once
+        uint64_t numIssued = 0;    // barriers that made it into a ResourceBarrier call
+        uint64_t numCollapsed = 0; // transitions merged into or cancelled by another one
+        uint64_t numSplit = 0;     // split transitions that stayed split
+        uint64_t numFlushes = 0;   // ResourceBarrier calls
+    };
+
+    void Transition(Resource res, States before, States after) {
+        assert(FindOpenSplit(res) == openSplits_.size() && "Resource is in the middle of a split transition.");
+
+        if(before == after) {
+            return;
+        }
+
+        stats_.numRequested++;
+
+        const size_t index = FindPendingTransition(res, Barrier::Split::None);
+        if(index == pending_.size()) {
+            pending_.push_back({ Barrier::Type::Transition, res, before, after, Barrier::Split::None });
+            return;
+        }
+
+        // nothing used the resource in the pending end state yet, go straight to the new one
+        Barrier& pending = pending_[index];
+        assert(pending.after == before);
+
+        if(pending.before == after) {
+            pending_.erase(pending_.begin() + index);
+            stats_.numCollapsed += 2;
+        }
+        else {
+            pending.after = after;
+            stats_.numCollapsed++;
+        }
+    }
+
+    void UAV(Resource res) {
+        stats_.numRequested++;
+
+        const bool alreadyPending = std::any_of(pending_.begin(), pending_.end(), [&](const Barrier& barrier) {
+            return barrier.type == Barrier::Type::UAV && barrier.res == res;
+        });
+
+        if(!alreadyPending) {
+            pending_.push_back({ Barrier::Type::UAV, res, States(), States(), Barrier::Split::None });
+        }
+    }
+
+    void BeginSplitTransition(Resource res, States before, States after) {
+        assert(FindOpenSplit(res) == openSplits_.size() && "Resource is already in a split transition.");
+        assert(FindPendingTransition(res, Barrier::Split::None) == pending_.size() &&
+               "Flush before splitting the transition of a resource that has one pending.");
+
+        if(before == after) {
+            return;
+        }
+
+        stats_.numRequested++;
+        pending_.push_back({ Barrier::Type::Transition, res, before, after, Barrier::Split::Begin });
+        openSplits_.push_back({ res, before, after, false });
+    }
+
+    void EndSplitTransition(Resource res) {
+        const size_t splitIndex = FindOpenSplit(res);
+        if(splitIndex == openSplits_.size()) {
+            // the begin was a no-op
+            return;
+        }
+
+        const SplitTransition split = openSplits_[splitIndex];
+        openSplits_.erase(openSplits_.begin() + splitIndex);
+
+        if(!split.begun) {
+            // no flush in between, nothing could overlap with the transition
+            const size_t index = FindPendingTransition(res, Barrier::Split::Begin);
+            assert(index < pending_.size());
+            pending_[index].split = Barrier::Split::None;
+            return;
+        }
+
+        pending_.push_back({ Barrier::Type::Transition, res, split.before, split.after, Barrier::Split::End });
+        stats_.numSplit++;
+    }
+
+    // Takes everything pending, returns what goes into one ResourceBarrier call, can be empty.
+    // Valid until the next Flush.
+    const std::vector<Barrier>& Flush() {
+        issued_.clear();
+        for(const Barrier& barrier : pending_) {
+            if(barrier.type == Barrier::Type::UAV && FindPendingTransition(barrier.res, Barrier::Split::None) < pending_.size()) {
+                continue;
+            }
+            issued_.push_back(barrier);
+        }
+
+        if(!pending_.empty()) {
+            for(SplitTransition& split : openSplits_) {
+                split.begun = true;
+            }
+            pending_.clear();
+        }
+
+        if(!issued_.empty()) {
+            stats_.numIssued += issued_.size();
+            stats_.numFlushes++;
+        }
+        return issued_;
+    }
+
+    bool HasPendingBarriers() const { return !pending_.empty(); }
+    bool HasOpenSplitTransitions() const { return !openSplits_.empty(); }
+
+    const Stats& GetStats() const { return stats_; }
+    void ResetStats() { stats_ = Stats(); }
+
+private:
+    struct SplitTransition {
+        Resource res;
+        States before;
+        States after;
+        bool begun; // BEGIN_ONLY half already flushed
+    };
+
+    // pending_ index of res's transition with this split, pending_.size() if there's none
+    size_t FindPendingTransition(Resource res, typename Barrier::Split split) const {
+        for(size_t i = 0; i < pending_.size(); i++) {
+            const Barrier& barrier = pending_[i];
+            if(barrier.type == Barrier::Type::Transition && barrier.split == split && barrier.res == res) {
+                return i;
+            }
+        }
+        return pending_.size();
+    }
+
+    size_t FindOpenSplit(Resource res) const {
+        for(size_t i = 0; i < openSplits_.size(); i++) {
+            if(openSplits_[i].res == res) {
+                return i;
+            }
+        }
+        return openSplits_.size();
+    }
+
+    std::vector<Barrier> pending_;
+    std::vector<SplitTransition> openSplits_;
+    std::vector<Barrier> issued_; // kept around so flushing doesn't allocate
+    Stats stats_;
+};
+
+#endif // RENDERER_PENDING_BARRIER_LIST_H_
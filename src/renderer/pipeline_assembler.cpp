@@ -4,10 +4,14 @@
 #include "pipeline_assembler.h"
 
 #include <comdef.h>
+#include <dxgi1_4.h>
 
+#include "pipeline_library.h"
 #include "resources.h"
+#include "root_signature_cache.h"
 #include "shader.h"
 #include "memory/descriptor_allocator.h"
+#include "ninmath/hash.h"
 #include <ranges>
 #include <iostream>
 
@@ -26,21 +30,6 @@ struct DescriptorAllocationInfo {
 
 typedef PipelineResourceMap<DescriptorAllocationInfo> RegisterToDescriptorAllocationMap;
 
-struct DescriptorTableDescription {
-    uint32_t paramIndex;
-    std::vector<D3D12_DESCRIPTOR_RANGE> ranges;
-
-    uint32_t GetTotalDescriptors() const {
-        uint32_t sum = 0;
-        for(const auto& r : ranges) {
-            sum += r.NumDescriptors;
-        }
-        return sum;
-    }
-
-    std::weak_ptr<DescriptorHeapAllocation> allocation;
-};
-
 // info for creating D3D12_DESCRIPTOR_RANGE
 struct DescriptorRangeDescription {
     ResourceDescriptorType descriptorType;
@@ -50,6 +39,21 @@ struct DescriptorRangeDescription {
 };
 
 namespace {
+
+    const char* PipelineLibraryFilePath = "cache/pipeline_library.bin";
+
+    class D3D12PipelineLibraryDevice : public PipelineLibraryDevice {
+    public:
+        D3D12PipelineLibraryDevice(ID3D12Device* device);
+
+        uint64_t GetDriverKey() const override { return driverKey_; }
+
+    private:
+        uint64_t driverKey_;
+    };
+
+    uint64_t HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSigHash);
+    uint64_t HashComputePipelineDesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, uint64_t rootSigHash);
     
     const std::set<D3D12_DESCRIPTOR_RANGE_TYPE> resourceRangeTypes = {
         D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
@@ -61,10 +65,6 @@ namespace {
 
     RootParameterUsageMap GetMergedRootParameterUsageMap(std::vector<std::weak_ptr<Shader>> shaders);
     
-    void ExtractAllRootSignatureDescriptorTablesWithType(const D3D12_ROOT_SIGNATURE_DESC* rootSigDesc,
-                                                         const std::set<D3D12_DESCRIPTOR_RANGE_TYPE>& allowList,
-                                                         std::vector<DescriptorTableDescription>& outDescriptorTables);
-    
     // returns num allocations made
     uint32_t CreateDescriptorAllocationsFromTables(std::shared_ptr<DescriptorAllocator>& descriptorAllocator,
                                                    std::vector<DescriptorTableDescription>& tables,
@@ -100,26 +100,34 @@ namespace {
                                const PipelineResourceMap<RootConstantInfo>& constantMap,
                                const PipelineResourceMap<D3D12_SAMPLER_DESC>& samplerMap,
                                const PipelineResourceMap<D3D12_SAMPLER_DESC>& staticSamplerMap,
-                               winrt::com_ptr<ID3DBlob>& outRSBlob,
-                               winrt::com_ptr<ID3D12RootSignature>& outRS);
+                               winrt::com_ptr<ID3DBlob>& outRSBlob);
 
 } // pipeline_assembler_utils
 
 PipelineAssembler::PipelineAssembler(winrt::com_ptr<ID3D12Device> device,
+                    std::shared_ptr<WorkStealingScheduler> scheduler,
                     const std::weak_ptr<DescriptorAllocator>& resourceDescriptorAllocator,
                     const std::weak_ptr<DescriptorAllocator>& samplerDescriptorAllocator) 
 :
 device_(device), 
 resourceDescriptorAllocator_(resourceDescriptorAllocator),
-samplerDescriptorAllocator_(samplerDescriptorAllocator)
+samplerDescriptorAllocator_(samplerDescriptorAllocator),
+taskGraph_(std::move(scheduler)),
+rootSignatureCache_(std::make_unique<RootSignatureCache>(device)),
+pipelineLibrary_(std::make_unique<PipelineLibrary>(PipelineLibraryFilePath, std::make_shared<D3D12PipelineLibraryDevice>(device.get()))),
+numLibraryHits_(0)
 {
-    threadPool_ = std::make_shared<ThreadPool<PipelineState::State>>();
-    threadPool_->Start();
+    pipelineLibrary_->Load();
 }
 
 PipelineAssembler::~PipelineAssembler() {
     std::cout << "Destroying pipeline assembler..." << std::endl;
-    
+    std::cout << "Root signature cache: " << rootSignatureCache_->GetNumRootSignatures() << " root signatures, "
+              << rootSignatureCache_->GetNumHits() << " reused" << std::endl;
+    std::cout << "Pipeline library: " << pipelineLibrary_->GetNumEntries() << " entries, "
+              << numLibraryHits_.load() << " pipelines created from cached blobs" << std::endl;
+
+    pipelineLibrary_->Save();
 }
 
 void PipelineAssembler::Flush() {
@@ -132,8 +140,19 @@ void PipelineAssembler::Flush() {
         std::packaged_task<PipelineState::State()> task(std::bind(&PipelineAssembler::AssemblePipeline, this, pso, std::ref(statePromise)));
         // pso.lock()->future_ = task.get_future();
 
+        GraphTaskHandle assembleTask = taskGraph_.CreateTask(std::move(task));
+
+        // only becomes runnable once every shader is compiled, instead of a worker waiting on them
+        std::vector<std::weak_ptr<Shader>> shaders;
+        pso.lock()->GetShaders(shaders);
+        for(const auto& s : shaders) {
+            const GraphTaskHandle& compileTask = s.lock()->GetCompileTask();
+            WINRT_ASSERT(compileTask && "Shader was never flushed by the shader compiler.");
+            TaskGraph::AddDependency(compileTask, assembleTask);
+        }
+
         std::cout << "Adding build PSO task: " << pso.lock()->GetID() << std::endl;
-        threadPool_->AddTask(std::move(task));
+        taskGraph_.Submit(assembleTask);
     }
 }
 
@@ -145,10 +164,20 @@ PipelineState::State PipelineAssembler::AssemblePipeline(std::weak_ptr<PipelineS
     std::vector<std::weak_ptr<Shader>> shaders;
     pso->GetShaders(shaders);
 
-    // wait for every shader to finish compiling
+    // the compile tasks are predecessors of this one, every shader is done by now
     for(const auto& s : shaders) {
         std::shared_ptr<Shader> shader = s.lock();
-        std::cout << std::format("Waiting for {}", shader->GetSourceFile()) << std::endl;
+
+        // a compile task that threw never resolves the shader's state
+        if(!shader->IsStateReady()) {
+            PipelineState::State out;
+            out.type = PipelineState::StateType::CompileError;
+            out.msg = std::format("Shader ({}) did not produce a result. Pipeline assembly failed. {}", shader->GetSourceFile(), pso->id_);
+            std::cout << out.msg << std::endl;
+
+            statePromise.set_value(out);
+            return out;
+        }
 
         const Shader::State& shaderState = shader->GetState_Block();
         
@@ -175,20 +204,12 @@ PipelineState::State PipelineAssembler::AssemblePipeline(std::weak_ptr<PipelineS
     const std::shared_ptr<Shader::CompilationData> compileData = rootSigShader.lock()->GetState_Block().compileData;
 
     winrt::com_ptr<ID3DBlob> rsBlob;
-    winrt::com_ptr<ID3D12RootSignature> rootSig;
     LPVOID rootSigPtr;
     SIZE_T rootSigSize;
 
     if(compileData->rootSigBlob) {
         rootSigPtr = compileData->rootSigBlob->GetBufferPointer();
         rootSigSize = compileData->rootSigBlob->GetBufferSize();
-        
-        hr = device_->CreateRootSignature(0,
-            compileData->rootSigBlob->GetBufferPointer(),
-            compileData->rootSigBlob->GetBufferSize(),
-            __uuidof(ID3D12RootSignature),
-            rootSig.put_void());
-        winrt::check_hresult(hr);
     }
     else {
         GenerateRootSignature(device_,
@@ -197,23 +218,16 @@ PipelineState::State PipelineAssembler::AssemblePipeline(std::weak_ptr<PipelineS
                               pso->constantMaps_[0],
                               pso->samplerMaps_[0],
                               pso->staticSamplerMaps_[0],
-                              rsBlob,
-                              rootSig);
+                              rsBlob);
         
         rootSigPtr = rsBlob->GetBufferPointer();
         rootSigSize = rsBlob->GetBufferSize();
     }
 
-    winrt::com_ptr<ID3D12RootSignatureDeserializer> deserializer;
-    hr = D3D12CreateRootSignatureDeserializer(
-            rootSigPtr,
-            rootSigSize,
-            __uuidof(ID3D12RootSignatureDeserializer),
-            deserializer.put_void());
-    
-    winrt::check_hresult(hr);
-    
-    const D3D12_ROOT_SIGNATURE_DESC* rootSigDesc = deserializer->GetRootSignatureDesc();
+    // identical blobs share one root signature, created and parsed only the first time
+    const std::shared_ptr<const CachedRootSignature> cachedRootSig = rootSignatureCache_->GetOrCreate(rootSigPtr, rootSigSize);
+    const winrt::com_ptr<ID3D12RootSignature>& rootSig = cachedRootSig->rootSignature;
+    const D3D12_ROOT_SIGNATURE_DESC* rootSigDesc = cachedRootSig->rootSigDesc;
 
     // get all descriptor tables
     std::shared_ptr<DescriptorAllocator> resDescriptorAllocator = resourceDescriptorAllocator_.lock();
@@ -222,35 +236,41 @@ PipelineState::State PipelineAssembler::AssemblePipeline(std::weak_ptr<PipelineS
     const bool isCompute = pso->type_ == PipelineStateType::Compute;
     std::vector<std::vector<std::shared_ptr<RootParameter>>> rootParametersArr;
     rootParametersArr.resize(pso->GetNumResourceConfigurations());
+
+    std::vector<std::weak_ptr<DescriptorHeapAllocation>> resourceDescriptors;
+    std::vector<std::weak_ptr<DescriptorHeapAllocation>> samplerDescriptors;
     
     for(int curConfigIndex = 0 ; curConfigIndex < pso->GetNumResourceConfigurations(); curConfigIndex++) {
         RegisterToDescriptorAllocationMap allocationMap;
-        std::vector<DescriptorTableDescription> descriptorTables;
-        
+
         //
         // resource descriptor tables
         //
-        ::ExtractAllRootSignatureDescriptorTablesWithType(rootSigDesc,
-                                                          ::resourceRangeTypes,
-                                                          descriptorTables);
-        
+        std::vector<DescriptorTableDescription> descriptorTables = cachedRootSig->resourceTables;
+
         // allocate descriptors for all descriptor tables
         ::CreateDescriptorAllocationsFromTables(resDescriptorAllocator,
                                                 descriptorTables,
                                                 allocationMap);
+
+        for(const DescriptorTableDescription& table : descriptorTables) {
+            resourceDescriptors.push_back(table.allocation);
+        }
         
         //
         // sampler descriptor tables
         //
-        ::ExtractAllRootSignatureDescriptorTablesWithType(rootSigDesc,
-                                                          ::samplerRangeTypes,
-                                                          descriptorTables);
-        
+        descriptorTables.insert(descriptorTables.end(), cachedRootSig->samplerTables.begin(), cachedRootSig->samplerTables.end());
+
 
         // allocate descriptors for all descriptor tables
         ::CreateDescriptorAllocationsFromTables(samplerDescriptorAllocator,
                                                 descriptorTables,
                                                 allocationMap);
+
+        for(size_t i = cachedRootSig->resourceTables.size(); i < descriptorTables.size(); i++) {
+            samplerDescriptors.push_back(descriptorTables[i].allocation);
+        }
         
         // init descriptors, according to linked resources
         bool success = ::InitializeDescriptorAllocations(device_,
@@ -278,7 +298,7 @@ PipelineState::State PipelineAssembler::AssemblePipeline(std::weak_ptr<PipelineS
 
     winrt::com_ptr<ID3D12PipelineState> pipeline;
     if(isCompute) {
-        pipeline = CreateD3DComputePipeline(std::static_pointer_cast<ComputePipelineState>(pso), rootSig.get());
+        pipeline = CreateD3DComputePipeline(std::static_pointer_cast<ComputePipelineState>(pso), *cachedRootSig);
     }
     else {
         std::vector<D3D12_INPUT_ELEMENT_DESC> inputElems = CreateGraphicsInputLayoutDesc(std::static_pointer_cast<GraphicsPipelineState>(pso));
@@ -288,7 +308,7 @@ PipelineState::State PipelineAssembler::AssemblePipeline(std::weak_ptr<PipelineS
         inputLayoutDesc.pInputElementDescs = inputElems.data();
         
         pipeline = CreateD3DGraphicsPipeline(std::static_pointer_cast<GraphicsPipelineState>(pso),
-                                             rootSig.get(),
+                                             *cachedRootSig,
                                              inputLayoutDesc);
 
         InitializeVertexAndIndexBuffers(std::static_pointer_cast<GraphicsPipelineState>(pso));
@@ -306,6 +326,8 @@ PipelineState::State PipelineAssembler::AssemblePipeline(std::weak_ptr<PipelineS
     out.rootParams = std::move(rootParametersArr);
     out.rootSignature = rootSig;
     out.pipelineState = pipeline;
+    out.resourceDescriptors = std::move(resourceDescriptors);
+    out.samplerDescriptors = std::move(samplerDescriptors);
     statePromise.set_value(out);
     
     return out;
@@ -376,7 +398,7 @@ std::vector<D3D12_INPUT_ELEMENT_DESC> PipelineAssembler::CreateGraphicsInputLayo
 }
 
 winrt::com_ptr<ID3D12PipelineState> PipelineAssembler::CreateD3DGraphicsPipeline(std::shared_ptr<GraphicsPipelineState> pso,
-                                                                                 ID3D12RootSignature* rootSig,
+                                                                                 const CachedRootSignature& rootSig,
                                                                                  D3D12_INPUT_LAYOUT_DESC inputLayout) {
     
     auto shaderToBytecode = [](std::weak_ptr<Shader> shader) -> CD3DX12_SHADER_BYTECODE {
@@ -407,7 +429,7 @@ winrt::com_ptr<ID3D12PipelineState> PipelineAssembler::CreateD3DGraphicsPipeline
     const DXGI_SAMPLE_DESC firstSampleDesc = pso->renderTargetMaps_[0].begin()->second.lock()->sampleDesc;
 
     D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
-    desc.pRootSignature = rootSig;
+    desc.pRootSignature = rootSig.rootSignature.get();
     desc.VS = shaderToBytecode(pso->vertexShader_);
     desc.PS = shaderToBytecode(pso->pixelShader_);
     desc.DS = shaderToBytecode(pso->domainShader_);
@@ -457,14 +479,16 @@ winrt::com_ptr<ID3D12PipelineState> PipelineAssembler::CreateD3DGraphicsPipeline
                 };
     desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
 
-    winrt::com_ptr<ID3D12PipelineState> pipeline;
-    device_->CreateGraphicsPipelineState(&desc, __uuidof(ID3D12PipelineState), pipeline.put_void());
-
-    return pipeline;
+    return CreatePipelineWithLibrary(pso->GetID(),
+                                     ::HashGraphicsPipelineDesc(desc, rootSig.blobHash),
+                                     desc.CachedPSO,
+                                     [&](winrt::com_ptr<ID3D12PipelineState>& outPipeline)->HRESULT {
+        return device_->CreateGraphicsPipelineState(&desc, __uuidof(ID3D12PipelineState), outPipeline.put_void());
+    });
 }
 
 winrt::com_ptr<ID3D12PipelineState> PipelineAssembler::CreateD3DComputePipeline(std::shared_ptr<ComputePipelineState> pso,
-                                                                                ID3D12RootSignature* rootSig) {
+                                                                                const CachedRootSignature& rootSig) {
 
     WINRT_ASSERT(!pso->computeShader_.expired());
 
@@ -472,7 +496,7 @@ winrt::com_ptr<ID3D12PipelineState> PipelineAssembler::CreateD3DComputePipeline(
     CD3DX12_SHADER_BYTECODE bytecode(csBlob->GetBufferPointer(), csBlob->GetBufferSize());
     
     D3D12_COMPUTE_PIPELINE_STATE_DESC desc {
-        .pRootSignature = rootSig,
+        .pRootSignature = rootSig.rootSignature.get(),
         .CS = bytecode,
         .NodeMask = 0,
         .CachedPSO = D3D12_CACHED_PIPELINE_STATE {
@@ -482,8 +506,49 @@ winrt::com_ptr<ID3D12PipelineState> PipelineAssembler::CreateD3DComputePipeline(
         .Flags = D3D12_PIPELINE_STATE_FLAG_NONE
     };
 
+    return CreatePipelineWithLibrary(pso->GetID(),
+                                     ::HashComputePipelineDesc(desc, rootSig.blobHash),
+                                     desc.CachedPSO,
+                                     [&](winrt::com_ptr<ID3D12PipelineState>& outPipeline)->HRESULT {
+        return device_->CreateComputePipelineState(&desc, __uuidof(ID3D12PipelineState), outPipeline.put_void());
+    });
+}
+
+winrt::com_ptr<ID3D12PipelineState> PipelineAssembler::CreatePipelineWithLibrary(const std::string& id,
+                                                                                 uint64_t contentHash,
+                                                                                 D3D12_CACHED_PIPELINE_STATE& cachedPSO,
+                                                                                 const std::function<HRESULT(winrt::com_ptr<ID3D12PipelineState>&)>& create) {
     winrt::com_ptr<ID3D12PipelineState> pipeline;
-    device_->CreateComputePipelineState(&desc, __uuidof(ID3D12PipelineState), pipeline.put_void());
+
+    std::shared_ptr<const std::vector<uint8_t>> cachedBlob = pipelineLibrary_->Find(id, contentHash);
+    if(cachedBlob) {
+        cachedPSO.pCachedBlob = cachedBlob->data();
+        cachedPSO.CachedBlobSizeInBytes = cachedBlob->size();
+
+        if(SUCCEEDED(create(pipeline))) {
+            numLibraryHits_.fetch_add(1);
+            return pipeline;
+        }
+
+        // D3D12_ERROR_DRIVER_VERSION_MISMATCH/ADAPTER_NOT_FOUND or a blob the driver doesn't like,
+        // fall back to a full compile and replace the entry
+        std::cout << "Cached blob for " << id << " was rejected, recreating the pipeline" << std::endl;
+        pipelineLibrary_->Remove(id);
+        pipeline = nullptr;
+    }
+
+    cachedPSO.pCachedBlob = NULL;
+    cachedPSO.CachedBlobSizeInBytes = 0;
+
+    if(FAILED(create(pipeline))) {
+        return nullptr;
+    }
+
+    winrt::com_ptr<ID3DBlob> driverBlob;
+    if(SUCCEEDED(pipeline->GetCachedBlob(driverBlob.put()))) {
+        pipelineLibrary_->Store(id, contentHash, driverBlob->GetBufferPointer(), driverBlob->GetBufferSize());
+    }
+
     return pipeline;
 }
 
@@ -499,6 +564,95 @@ bool PipelineAssembler::Enqueue(std::weak_ptr<PipelineState> pso) {
 
 
 namespace {
+    D3D12PipelineLibraryDevice::D3D12PipelineLibraryDevice(ID3D12Device* device) {
+        // The LUID only identifies the adapter until the next reboot, the key is built from
+        // what identifies the hardware and the user mode driver version instead.
+        ninmath::hash::Hasher hasher;
+
+        winrt::com_ptr<IDXGIFactory4> factory;
+        winrt::com_ptr<IDXGIAdapter1> adapter;
+        if(SUCCEEDED(CreateDXGIFactory1(__uuidof(IDXGIFactory4), factory.put_void())) &&
+           SUCCEEDED(factory->EnumAdapterByLuid(device->GetAdapterLuid(), __uuidof(IDXGIAdapter1), adapter.put_void()))) {
+            DXGI_ADAPTER_DESC1 adapterDesc;
+            if(SUCCEEDED(adapter->GetDesc1(&adapterDesc))) {
+                hasher.Add(adapterDesc.VendorId).Add(adapterDesc.DeviceId).Add(adapterDesc.SubSysId).Add(adapterDesc.Revision);
+            }
+
+            LARGE_INTEGER umdVersion;
+            if(SUCCEEDED(adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &umdVersion))) {
+                hasher.Add(umdVersion.QuadPart);
+            }
+        }
+        else {
+            // can't tell the driver apart, cached blobs are then at least not shared between adapters
+            const LUID luid = device->GetAdapterLuid();
+            hasher.Add(luid.LowPart).Add(luid.HighPart);
+        }
+
+        driverKey_ = hasher.Get();
+    }
+
+    void AddShaderBytecode(ninmath::hash::Hasher& hasher, const D3D12_SHADER_BYTECODE& bytecode) {
+        hasher.AddBytes(bytecode.pShaderBytecode, bytecode.pShaderBytecode ? bytecode.BytecodeLength : 0);
+    }
+
+    // field by field, the descs have padding
+    uint64_t HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSigHash) {
+        ninmath::hash::Hasher hasher;
+        hasher.Add(rootSigHash);
+
+        AddShaderBytecode(hasher, desc.VS);
+        AddShaderBytecode(hasher, desc.PS);
+        AddShaderBytecode(hasher, desc.DS);
+        AddShaderBytecode(hasher, desc.HS);
+        AddShaderBytecode(hasher, desc.GS);
+
+        const D3D12_BLEND_DESC& blend = desc.BlendState;
+        hasher.Add(blend.AlphaToCoverageEnable).Add(blend.IndependentBlendEnable);
+        for(const D3D12_RENDER_TARGET_BLEND_DESC& rt : blend.RenderTarget) {
+            hasher.Add(rt.BlendEnable).Add(rt.LogicOpEnable)
+                  .Add(rt.SrcBlend).Add(rt.DestBlend).Add(rt.BlendOp)
+                  .Add(rt.SrcBlendAlpha).Add(rt.DestBlendAlpha).Add(rt.BlendOpAlpha)
+                  .Add(rt.LogicOp).Add(rt.RenderTargetWriteMask);
+        }
+        hasher.Add(desc.SampleMask);
+
+        const D3D12_RASTERIZER_DESC& raster = desc.RasterizerState;
+        hasher.Add(raster.FillMode).Add(raster.CullMode).Add(raster.FrontCounterClockwise)
+              .Add(raster.DepthBias).Add(raster.DepthBiasClamp).Add(raster.SlopeScaledDepthBias)
+              .Add(raster.DepthClipEnable).Add(raster.MultisampleEnable).Add(raster.AntialiasedLineEnable)
+              .Add(raster.ForcedSampleCount).Add(raster.ConservativeRaster);
+
+        const D3D12_DEPTH_STENCIL_DESC& depth = desc.DepthStencilState;
+        hasher.Add(depth.DepthEnable).Add(depth.DepthWriteMask).Add(depth.DepthFunc)
+              .Add(depth.StencilEnable).Add(depth.StencilReadMask).Add(depth.StencilWriteMask);
+        for(const D3D12_DEPTH_STENCILOP_DESC& face : { depth.FrontFace, depth.BackFace }) {
+            hasher.Add(face.StencilFailOp).Add(face.StencilDepthFailOp).Add(face.StencilPassOp).Add(face.StencilFunc);
+        }
+
+        hasher.Add(desc.InputLayout.NumElements);
+        for(uint32_t i = 0; i < desc.InputLayout.NumElements; i++) {
+            const D3D12_INPUT_ELEMENT_DESC& elem = desc.InputLayout.pInputElementDescs[i];
+            hasher.Add(std::string_view(elem.SemanticName)).Add(elem.SemanticIndex).Add(elem.Format)
+                  .Add(elem.InputSlot).Add(elem.AlignedByteOffset).Add(elem.InputSlotClass).Add(elem.InstanceDataStepRate);
+        }
+
+        hasher.Add(desc.IBStripCutValue).Add(desc.PrimitiveTopologyType).Add(desc.NumRenderTargets)
+              .Add(desc.RTVFormats).Add(desc.DSVFormat)
+              .Add(desc.SampleDesc.Count).Add(desc.SampleDesc.Quality)
+              .Add(desc.NodeMask).Add(desc.Flags);
+
+        return hasher.Get();
+    }
+
+    uint64_t HashComputePipelineDesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, uint64_t rootSigHash) {
+        ninmath::hash::Hasher hasher;
+        hasher.Add(rootSigHash);
+        AddShaderBytecode(hasher, desc.CS);
+        hasher.Add(desc.NodeMask).Add(desc.Flags);
+        return hasher.Get();
+    }
+
     RootParameterUsageMap GetMergedRootParameterUsageMap(std::vector<std::weak_ptr<Shader>> shaders) {
         RootParameterUsageMap outMap;
         if(shaders.size() <= 0) {
@@ -529,37 +683,6 @@ namespace {
         return outMap;
     }
 
-    void ExtractAllRootSignatureDescriptorTablesWithType(const D3D12_ROOT_SIGNATURE_DESC* rootSigDesc,
-                                                         const std::set<D3D12_DESCRIPTOR_RANGE_TYPE>& allowList,
-                                                         std::vector<DescriptorTableDescription>& outDescriptorTables) {
-        for(int i = 0; i < rootSigDesc->NumParameters; i++) {
-            const D3D12_ROOT_PARAMETER rootParam = rootSigDesc->pParameters[i];
-
-            if(rootParam.ParameterType != D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE) {
-                continue;
-            }
-
-            
-            DescriptorTableDescription descriptorTable;
-            descriptorTable.paramIndex = i;
-
-            // drInd <==> descriptor range index
-            for(int drInd = 0; drInd < rootParam.DescriptorTable.NumDescriptorRanges; drInd++) {
-                const D3D12_DESCRIPTOR_RANGE drange = rootParam.DescriptorTable.pDescriptorRanges[drInd];
-                if(!allowList.contains(drange.RangeType)) {
-                    continue;
-                }
-
-                descriptorTable.ranges.push_back(drange);
-            }
-
-            if(!descriptorTable.ranges.empty()) {
-                outDescriptorTables.push_back(descriptorTable);
-            }
-        }
-        
-    }
-
     uint32_t CreateDescriptorAllocationsFromTables(std::shared_ptr<DescriptorAllocator>& descriptorAllocator,
                                                    std::vector<DescriptorTableDescription>& tables,
                                                    RegisterToDescriptorAllocationMap& outAllocationMap) {
@@ -646,6 +769,10 @@ namespace {
                     WINRT_ASSERT(!resInfo.res.expired());
                     std::shared_ptr<const Resource> res = resInfo.res.lock();
 
+                    const auto dynamicBuffer = std::dynamic_pointer_cast<const DynamicBufferBase>(res);
+                    WINRT_ASSERT((!dynamicBuffer || !dynamicBuffer->UsesUploadRing()) &&
+                                 "Buffers in the upload ring move every frame, bind them as root descriptors.");
+
                     success = res->CreateDescriptorByResourceType(cpuHandle, shaderReg.type, resInfo.descriptorConfig);
                     WINRT_ASSERT(success);
 
@@ -767,9 +894,11 @@ namespace {
                     const ResourceInfo& resInfo = resMap.at(shaderReg);
                     WINRT_ASSERT(!resInfo.res.expired());
 
+                    // the resource outlives the pipeline, same as the native resource pointer before it
+                    const Resource* res = resInfo.res.lock().get();
                     const auto newParam = std::make_shared<RootDescriptorParameter>(i,
                                                                                     isCompute,
-                                                                                    resInfo.res.lock()->GetNativeResource().get(),
+                                                                                    [res]() { return res->GetGPUVirtualAddress(); },
                                                                                     resType);
                     found = true;
                     outRootParameters.push_back(std::move(newParam));
@@ -874,8 +1003,7 @@ namespace {
                                                               const PipelineResourceMap<RootConstantInfo>& constantMap,
                                                               const PipelineResourceMap<D3D12_SAMPLER_DESC>& samplerMap,
                                                               const PipelineResourceMap<D3D12_SAMPLER_DESC>& staticSamplerMap,
-                                                              winrt::com_ptr<ID3DBlob>& outRSBlob,
-                                                              winrt::com_ptr<ID3D12RootSignature>& outRS) {
+                                                              winrt::com_ptr<ID3DBlob>& outRSBlob) {
         // given the resource usage, create a default root parameter configuration
         // flags can be used to explicitly describe how a resource should be accessed (root parameter, tables, etc.)
 
@@ -1025,17 +1153,7 @@ namespace {
                                                   );
         WINRT_ASSERT(SUCCEEDED(hr));
 
-        winrt::com_ptr<ID3D12RootSignature> rootSig;
-        hr = device->CreateRootSignature(0,
-                                          rsBlob->GetBufferPointer(),
-                                          rsBlob->GetBufferSize(),
-                                          __uuidof(ID3D12RootSignature),
-                                          rootSig.put_void());
-
-        WINRT_ASSERT(SUCCEEDED(hr));
-        
-        // Continue to root signature processing...
-        outRS = rootSig;
+        // the root signature itself is created by the RootSignatureCache
         outRSBlob = rsBlob;
     }
     
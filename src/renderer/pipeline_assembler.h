@@ -1,23 +1,33 @@
 ﻿#ifndef RENDERER_PIPELINE_ASSEMBLER_H_
 #define RENDERER_PIPELINE_ASSEMBLER_H_
 #include <d3d12.h>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <queue>
 
 #include "pipeline_state.h"
 #include "shader_types.h"
-#include "multithreading/thread_pool.h"
+#include "multithreading/task_graph.h"
 
 class DescriptorAllocator;
 class DescriptorHeapAllocation;
+class RootSignatureCache;
+class PipelineLibrary;
+struct CachedRootSignature;
 
 class PipelineAssembler {
 public:
     PipelineAssembler(winrt::com_ptr<ID3D12Device> device,
+                    std::shared_ptr<WorkStealingScheduler> scheduler,
                     const std::weak_ptr<DescriptorAllocator>& resourceDescriptorAllocator,
                     const std::weak_ptr<DescriptorAllocator>& samplerDescriptorAllocator);
     ~PipelineAssembler();
 
     bool Enqueue(std::weak_ptr<PipelineState> pso);
+
+    // Every assembly task depends on the compile tasks of its shaders, so this has to
+    // come after ShaderCompiler::Flush() for the shaders of the queued pipelines.
     void Flush();
 
 private:
@@ -28,11 +38,19 @@ private:
     std::vector<D3D12_INPUT_ELEMENT_DESC> CreateGraphicsInputLayoutDesc(std::shared_ptr<GraphicsPipelineState> pso);
 
     winrt::com_ptr<ID3D12PipelineState> CreateD3DGraphicsPipeline(std::shared_ptr<GraphicsPipelineState> pso,
-                                                                  ID3D12RootSignature* rootSig,
+                                                                  const CachedRootSignature& rootSig,
                                                                   D3D12_INPUT_LAYOUT_DESC inputLayout);
     
     winrt::com_ptr<ID3D12PipelineState> CreateD3DComputePipeline(std::shared_ptr<ComputePipelineState> pso,
-                                                                 ID3D12RootSignature* rootSignature);
+                                                                 const CachedRootSignature& rootSignature);
+
+    // Creates the pipeline from the library's cached blob if there's one for the same inputs,
+    // otherwise from scratch and stores the driver's blob for the next run.
+    // create() is called with cachedPSO filled in (or cleared) and does the actual device call.
+    winrt::com_ptr<ID3D12PipelineState> CreatePipelineWithLibrary(const std::string& id,
+                                                                  uint64_t contentHash,
+                                                                  D3D12_CACHED_PIPELINE_STATE& cachedPSO,
+                                                                  const std::function<HRESULT(winrt::com_ptr<ID3D12PipelineState>&)>& create);
     
     void InitializeVertexAndIndexBuffers(std::shared_ptr<GraphicsPipelineState> pso);
     
@@ -41,7 +59,10 @@ private:
     winrt::com_ptr<ID3D12Device> device_;
     std::weak_ptr<DescriptorAllocator> resourceDescriptorAllocator_; 
     std::weak_ptr<DescriptorAllocator> samplerDescriptorAllocator_; 
-    std::shared_ptr<ThreadPool<PipelineState::State>> threadPool_;
+    TaskGraph taskGraph_;
+    std::unique_ptr<RootSignatureCache> rootSignatureCache_;
+    std::unique_ptr<PipelineLibrary> pipelineLibrary_;
+    std::atomic<uint32_t> numLibraryHits_;
     std::queue<std::weak_ptr<PipelineState>> queue_;
 };
 
@@ -0,0 +1,135 @@
+﻿#include "pipeline_library.h"
+
+#include <cassert>
+#include <iostream>
+
+#include "serialization.h"
+
+using serialization::ByteReader;
+using serialization::ByteWriter;
+
+PipelineLibrary::PipelineLibrary(std::filesystem::path filePath, std::shared_ptr<PipelineLibraryDevice> device)
+    : filePath_(std::move(filePath)), device_(std::move(device)), dirty_(false) {
+}
+
+bool PipelineLibrary::Load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    dirty_ = false;
+
+    std::vector<uint8_t> bytes;
+    if(!serialization::ReadFile(filePath_, bytes)) {
+        return false;
+    }
+
+    ByteReader reader(bytes.data(), bytes.size());
+    PipelineLibraryFileHeader header;
+    if(!reader.Read(header)) {
+        return false;
+    }
+
+    if(header.magic != PipelineLibraryFileMagic || header.version != PipelineLibraryFileVersion) {
+        std::cout << "Ignoring stale pipeline library " << filePath_.string() << std::endl;
+        return false;
+    }
+
+    // blobs of another adapter/driver would be rejected by CreatePipelineState anyway
+    if(header.driverKey != device_->GetDriverKey()) {
+        std::cout << "Pipeline library " << filePath_.string() << " was written for another driver, rebuilding" << std::endl;
+        return false;
+    }
+
+    std::map<std::string, Entry> entries;
+    for(uint32_t i = 0; i < header.numEntries; i++) {
+        uint16_t idLength;
+        uint64_t contentHash;
+        uint64_t blobSize;
+
+        const uint8_t* id = nullptr;
+        const uint8_t* blob = nullptr;
+        if(!reader.Read(idLength) ||
+           (id = reader.ReadBytes(idLength)) == nullptr ||
+           !reader.Read(contentHash) ||
+           !reader.Read(blobSize) ||
+           (blob = reader.ReadBytes(blobSize)) == nullptr) {
+            break;
+        }
+
+        entries[std::string(reinterpret_cast<const char*>(id), idLength)] =
+            Entry { contentHash, std::make_shared<const std::vector<uint8_t>>(blob, blob + blobSize) };
+    }
+
+    if(entries.size() != header.numEntries || !reader.IsAtEnd()) {
+        std::cout << "Ignoring corrupt pipeline library " << filePath_.string() << std::endl;
+        return false;
+    }
+
+    entries_ = std::move(entries);
+    std::cout << "Loaded pipeline library " << filePath_.string() << " (" << entries_.size() << " pipelines)" << std::endl;
+    return true;
+}
+
+bool PipelineLibrary::Save() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!dirty_) {
+        return true;
+    }
+
+    PipelineLibraryFileHeader header = {};
+    header.magic = PipelineLibraryFileMagic;
+    header.version = PipelineLibraryFileVersion;
+    header.driverKey = device_->GetDriverKey();
+    header.numEntries = (uint32_t)entries_.size();
+
+    ByteWriter writer;
+    writer.Write(header);
+    for(const auto& [id, entry] : entries_) {
+        writer.Write((uint16_t)id.size());
+        writer.WriteBytes(id.data(), id.size());
+        writer.Write(entry.contentHash);
+        writer.Write((uint64_t)entry.blob->size());
+        writer.WriteBytes(entry.blob->data(), entry.blob->size());
+    }
+
+    if(!serialization::WriteFileAtomically(filePath_, writer.GetBytes())) {
+        return false;
+    }
+
+    dirty_ = false;
+    std::cout << "Stored pipeline library " << filePath_.string() << " (" << entries_.size() << " pipelines, "
+              << writer.GetBytes().size() / 1024 << " KiB)" << std::endl;
+    return true;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> PipelineLibrary::Find(const std::string& id, uint64_t contentHash) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto it = entries_.find(id);
+    if(it == entries_.end() || it->second.contentHash != contentHash) {
+        return nullptr;
+    }
+    return it->second.blob;
+}
+
+void PipelineLibrary::Store(const std::string& id, uint64_t contentHash, const void* blob, size_t size) {
+    assert(id.size() <= UINT16_MAX);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(blob);
+    std::shared_ptr<const std::vector<uint8_t>> blobCopy = std::make_shared<const std::vector<uint8_t>>(bytes, bytes + size);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[id] = Entry { contentHash, std::move(blobCopy) };
+    dirty_ = true;
+}
+
+void PipelineLibrary::Remove(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(entries_.erase(id) > 0) {
+        dirty_ = true;
+    }
+}
+
+size_t PipelineLibrary::GetNumEntries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
@@ -0,0 +1,80 @@
+﻿#ifndef RENDERER_PIPELINE_LIBRARY_H_
+#define RENDERER_PIPELINE_LIBRARY_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//
+// What the pipeline library needs to know about the device. Driver cached PSO blobs
+// are only valid for the adapter + driver that produced them. Kept apart from D3D12 so
+// the file layer builds (and can be exercised with a mock device) anywhere.
+//
+class PipelineLibraryDevice {
+public:
+    virtual ~PipelineLibraryDevice() = default;
+
+    // changes with the adapter and the driver version
+    virtual uint64_t GetDriverKey() const = 0;
+};
+
+//
+// On-disk layout (little endian):
+//   PipelineLibraryFileHeader
+//   per entry { u16 idLength, char id[], u64 contentHash, u64 blobSize, u8 blob[] }
+//
+inline constexpr uint32_t PipelineLibraryFileMagic = 0x4c505343; // "CSPL"
+inline constexpr uint32_t PipelineLibraryFileVersion = 1;
+
+struct PipelineLibraryFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t driverKey;
+    uint32_t numEntries;
+    uint32_t pad0;
+};
+
+//
+// Driver cached PSO blobs by pipeline ID. Every entry carries a content hash (shaders,
+// root signature and state), a blob is only handed out if the pipeline is still built
+// from exactly the same inputs. One entry per ID, storing a new hash replaces the old one.
+// Safe to use from multiple assembly tasks at once.
+//
+class PipelineLibrary {
+public:
+    PipelineLibrary(std::filesystem::path filePath, std::shared_ptr<PipelineLibraryDevice> device);
+
+    // false if the file is missing, or was written for another driver/format (the library starts out empty then)
+    bool Load();
+
+    // no-op if nothing changed since Load()
+    bool Save();
+
+    // nullptr on a miss or if the pipeline's inputs changed
+    std::shared_ptr<const std::vector<uint8_t>> Find(const std::string& id, uint64_t contentHash) const;
+    void Store(const std::string& id, uint64_t contentHash, const void* blob, size_t size);
+
+    // a blob the driver rejected (e.g. after an update that kept the driver key) isn't used again
+    void Remove(const std::string& id);
+
+    size_t GetNumEntries() const;
+
+private:
+    struct Entry {
+        uint64_t contentHash;
+        std::shared_ptr<const std::vector<uint8_t>> blob;
+    };
+
+    std::filesystem::path filePath_;
+    std::shared_ptr<PipelineLibraryDevice> device_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    bool dirty_;
+};
+
+#endif // RENDERER_PIPELINE_LIBRARY_H_
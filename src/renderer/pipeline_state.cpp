@@ -6,6 +6,29 @@
 #include "resources.h"
 
 
+PipelineState::PipelineState(const PipelineState& other)
+:
+type_(other.type_),
+future_(promise_.get_future()),
+stateGeneration_(other.stateGeneration_),
+id_(other.id_),
+resMaps_(other.resMaps_),
+constantMaps_(other.constantMaps_),
+samplerMaps_(other.samplerMaps_),
+staticSamplerMaps_(other.staticSamplerMaps_),
+depthId_(other.depthId_),
+blendDesc_(other.blendDesc_),
+resConfigInd_(other.resConfigInd_)
+{}
+
+std::shared_future<PipelineState::State> PipelineState::AdoptReloadCopy(const PipelineState& copy) {
+    WINRT_ASSERT(copy.IsStateReady());
+    std::shared_future<PipelineState::State> previous = std::move(future_);
+    future_ = copy.future_;
+    stateGeneration_++;
+    return previous;
+}
+
 void PipelineState::Execute(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) {
     // set root signature
     SetRootSignature(cmdList);
@@ -117,6 +140,45 @@ void GraphicsPipelineState::InitializeVertexAndIndexBufferDescriptors() {
     }
 }
 
+std::shared_ptr<PipelineState> GraphicsPipelineState::CreateReloadCopy(const std::map<std::string, std::shared_ptr<Shader>>& shaders) const {
+    std::shared_ptr<GraphicsPipelineState> copy = std::make_shared<GraphicsPipelineState>(*this);
+    ReplaceShader(copy->vertexShader_, shaders);
+    ReplaceShader(copy->hullShader_, shaders);
+    ReplaceShader(copy->domainShader_, shaders);
+    ReplaceShader(copy->pixelShader_, shaders);
+    ReplaceShader(copy->geometryShader_, shaders);
+    return copy;
+}
+
+std::shared_future<PipelineState::State> GraphicsPipelineState::AdoptReloadCopy(const PipelineState& inCopy) {
+    const GraphicsPipelineState& copy = static_cast<const GraphicsPipelineState&>(inCopy);
+
+    // only what assembly produces, settings made in the meantime (instances, configurations) stay
+    vertexShader_ = copy.vertexShader_;
+    hullShader_ = copy.hullShader_;
+    domainShader_ = copy.domainShader_;
+    pixelShader_ = copy.pixelShader_;
+    geometryShader_ = copy.geometryShader_;
+    vertexBufferDescriptors_ = copy.vertexBufferDescriptors_;
+    indexBufferDescriptor_ = copy.indexBufferDescriptor_;
+    numVertices_ = copy.numVertices_;
+
+    return PipelineState::AdoptReloadCopy(copy);
+}
+
+std::shared_ptr<PipelineState> ComputePipelineState::CreateReloadCopy(const std::map<std::string, std::shared_ptr<Shader>>& shaders) const {
+    std::shared_ptr<ComputePipelineState> copy = std::make_shared<ComputePipelineState>(*this);
+    ReplaceShader(copy->computeShader_, shaders);
+    return copy;
+}
+
+std::shared_future<PipelineState::State> ComputePipelineState::AdoptReloadCopy(const PipelineState& inCopy) {
+    const ComputePipelineState& copy = static_cast<const ComputePipelineState&>(inCopy);
+    computeShader_ = copy.computeShader_;
+
+    return PipelineState::AdoptReloadCopy(copy);
+}
+
 std::weak_ptr<Shader> ComputePipelineState::GetShaderForHLSLRootSignatures() const {
     return computeShader_;
 }
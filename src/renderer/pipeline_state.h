@@ -2,6 +2,7 @@
 #define RENDERER_PIPELINE_STATE_H_
 
 #include <future>
+#include <map>
 #include <optional>
 #include <string>
 #include "shader_types.h"
@@ -9,6 +10,7 @@
 class Renderer;
 class PipelineAssembler;
 class Resource;
+class DescriptorHeapAllocation;
 
 class Shader;
 class VertexShader;
@@ -44,6 +46,10 @@ public:
         
         winrt::com_ptr<ID3D12RootSignature> rootSignature;
         winrt::com_ptr<ID3D12PipelineState> pipelineState;
+
+        // descriptor tables of all resource configurations, freed once the state is replaced
+        std::vector<std::weak_ptr<DescriptorHeapAllocation>> resourceDescriptors;
+        std::vector<std::weak_ptr<DescriptorHeapAllocation>> samplerDescriptors;
     };
 
     
@@ -53,6 +59,7 @@ public:
     :
     type_(type),
     future_(promise_.get_future()),
+    stateGeneration_(0),
     id_(std::move(id)),
     resConfigInd_(0)
     {}
@@ -69,6 +76,9 @@ public:
     bool IsStateReady() const {
         return future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
     }
+
+    // bumped whenever a hot reloaded state is adopted, for anything that caches what the pipeline produced
+    uint32_t GetStateGeneration() const { return stateGeneration_; }
     
     const PipelineState::State& GetState_Block() const {
         return future_.get();
@@ -89,16 +99,31 @@ public:
         resConfigInd_ = ind;
     }
     uint32_t GetNumResourceConfigurations() const { return resMaps_.size(); }
-    
+
+protected:
+    // copies what the pipeline is built from, not its assembled state
+    PipelineState(const PipelineState& other);
+
+    // shader slots pointing at a shader with a replacement in the map (by source file) are swapped
+    template <typename T>
+    static void ReplaceShader(std::weak_ptr<T>& slot, const std::map<std::string, std::shared_ptr<Shader>>& shaders);
+
 private:
     friend PipelineAssembler;
     virtual std::weak_ptr<Shader> GetShaderForHLSLRootSignatures() const = 0;
+
+    // hot reloading: an unassembled copy using the newest shaders, that is assembled in the background
+    // while this one keeps rendering. Once it's ready it's adopted, the previous state is returned
+    // so it can be kept alive until the GPU is done with it.
+    virtual std::shared_ptr<PipelineState> CreateReloadCopy(const std::map<std::string, std::shared_ptr<Shader>>& shaders) const = 0;
+    virtual std::shared_future<PipelineState::State> AdoptReloadCopy(const PipelineState& copy);
     
     PipelineStateType type_;
 
     // invalid if not ready (shaders compiling, pso assembling)
     std::promise<PipelineState::State> promise_;
     std::shared_future<PipelineState::State> future_;
+    uint32_t stateGeneration_;
     
     std::string id_;
 
@@ -144,6 +169,9 @@ public:
 private:
     friend Renderer;
     friend PipelineAssembler;
+    std::shared_ptr<PipelineState> CreateReloadCopy(const std::map<std::string, std::shared_ptr<Shader>>& shaders) const override;
+    std::shared_future<PipelineState::State> AdoptReloadCopy(const PipelineState& copy) override;
+
     std::weak_ptr<VertexShader> vertexShader_;
     std::weak_ptr<HullShader> hullShader_;
     std::weak_ptr<DomainShader> domainShader_;
@@ -186,6 +214,9 @@ public:
 private:
     friend Renderer;
     friend PipelineAssembler;
+    std::shared_ptr<PipelineState> CreateReloadCopy(const std::map<std::string, std::shared_ptr<Shader>>& shaders) const override;
+    std::shared_future<PipelineState::State> AdoptReloadCopy(const PipelineState& copy) override;
+
     std::weak_ptr<Shader> computeShader_;
     
     uint32_t threadCountX_;
@@ -197,4 +228,17 @@ private:
     uint32_t threadGroupCountZ_;
 };
 
+template <typename T>
+void PipelineState::ReplaceShader(std::weak_ptr<T>& slot, const std::map<std::string, std::shared_ptr<Shader>>& shaders) {
+    std::shared_ptr<T> shader = slot.lock();
+    if(!shader) {
+        return;
+    }
+
+    const auto it = shaders.find(shader->GetSourceFile());
+    if(it != shaders.end() && it->second != shader) {
+        slot = std::static_pointer_cast<T>(it->second);
+    }
+}
+
 #endif // RENDERER_PIPELINE_STATE_H_
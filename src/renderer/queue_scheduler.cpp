@@ -0,0 +1,196 @@
+﻿#include "queue_scheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+
+const char* GetGPUQueueName(GPUQueue queue) {
+    switch(queue) {
+        case GPUQueue::Direct: return "Direct";
+        case GPUQueue::Compute: return "Compute";
+        default: return "Unknown";
+    }
+}
+
+uint32_t QueueScheduler::AddResource(std::string name) {
+    resources_.push_back({ std::move(name) });
+    return (uint32_t)resources_.size() - 1;
+}
+
+uint64_t QueueScheduler::Submit(GPUQueue queue, const std::vector<GPUQueueAccess>& accesses, const std::function<void()>& execute,
+                                bool joinOtherQueues) {
+    assert(queue != GPUQueue::Count);
+    const uint32_t queueIndex = (uint32_t)queue;
+
+    // the latest value of every other queue this depends on
+    uint64_t dependencies[NumGPUQueues] = {};
+    for(const GPUQueueAccess& access : accesses) {
+        assert(access.resource < resources_.size());
+        const Resource& res = resources_[access.resource];
+
+        if(res.lastWriteValue != 0 && res.lastWriteQueue != queue) {
+            uint64_t& dependency = dependencies[(uint32_t)res.lastWriteQueue];
+            dependency = std::max(dependency, res.lastWriteValue);
+        }
+
+        if(access.write) {
+            for(uint32_t i = 0; i < NumGPUQueues; i++) {
+                if(i != queueIndex) {
+                    dependencies[i] = std::max(dependencies[i], res.lastReadValues[i]);
+                }
+            }
+        }
+    }
+
+    for(uint32_t i = 0; i < NumGPUQueues; i++) {
+        if(dependencies[i] != 0) {
+            WaitFor(queue, (GPUQueue)i, dependencies[i]);
+        }
+    }
+
+    execute();
+
+    if(joinOtherQueues) {
+        for(uint32_t i = 0; i < NumGPUQueues; i++) {
+            if(i != queueIndex && submittedValues_[i] != 0) {
+                WaitFor(queue, (GPUQueue)i, submittedValues_[i]);
+            }
+        }
+    }
+
+    const uint64_t value = ++submittedValues_[queueIndex];
+    backend_.Signal(queue, value);
+    stats_.numSubmissions++;
+
+    for(const GPUQueueAccess& access : accesses) {
+        Resource& res = resources_[access.resource];
+        if(access.write) {
+            // the reads before were waited for or ran on this queue
+            res.lastWriteQueue = queue;
+            res.lastWriteValue = value;
+            std::fill(std::begin(res.lastReadValues), std::end(res.lastReadValues), 0);
+        }
+        else {
+            res.lastReadValues[queueIndex] = value;
+        }
+    }
+
+    return value;
+}
+
+void QueueScheduler::WaitFor(GPUQueue queue, GPUQueue signalQueue, uint64_t value) {
+    assert(queue != signalQueue && value <= submittedValues_[(uint32_t)signalQueue]);
+
+    uint64_t& waitedValue = waitedValues_[(uint32_t)queue][(uint32_t)signalQueue];
+    if(value <= waitedValue || value <= backend_.GetCompletedValue(signalQueue)) {
+        stats_.numElidedWaits++;
+        return;
+    }
+
+    backend_.Wait(queue, signalQueue, value);
+    waitedValue = value;
+    stats_.numWaits++;
+}
+
+void SimulatedGPUQueues::Execute(GPUQueue queue, std::string name, double duration) {
+    assert(duration >= 0.0);
+    Queue& q = queues_[(uint32_t)queue];
+
+    const double start = std::max(q.freeTime, cpuTime_);
+    q.freeTime = start + duration;
+    work_.push_back({ queue, std::move(name), start, q.freeTime });
+}
+
+void SimulatedGPUQueues::Wait(GPUQueue queue, GPUQueue signalQueue, uint64_t value) {
+    Queue& q = queues_[(uint32_t)queue];
+    q.freeTime = std::max(q.freeTime, GetSignalTime(signalQueue, value));
+}
+
+void SimulatedGPUQueues::Signal(GPUQueue queue, uint64_t value) {
+    Queue& q = queues_[(uint32_t)queue];
+    assert(q.fences.empty() || q.fences.back().value < value);
+
+    q.freeTime = std::max(q.freeTime, cpuTime_);
+    q.fences.push_back({ value, q.freeTime });
+}
+
+uint64_t SimulatedGPUQueues::GetCompletedValue(GPUQueue queue) const {
+    // fence times only go up
+    uint64_t completed = 0;
+    for(const Fence& fence : queues_[(uint32_t)queue].fences) {
+        if(fence.time > cpuTime_) {
+            break;
+        }
+        completed = fence.value;
+    }
+    return completed;
+}
+
+void SimulatedGPUQueues::SetCPUTime(double time) {
+    assert(time >= cpuTime_);
+    cpuTime_ = time;
+}
+
+double SimulatedGPUQueues::GetSignalTime(GPUQueue queue, uint64_t value) const {
+    for(const Fence& fence : queues_[(uint32_t)queue].fences) {
+        if(fence.value >= value) {
+            return fence.time;
+        }
+    }
+
+    // a real queue would wait forever
+    assert(false && "Waiting for a value that was never signaled.");
+    return 0.0;
+}
+
+double SimulatedGPUQueues::GetEndTime() const {
+    double end = 0.0;
+    for(const Work& work : work_) {
+        end = std::max(end, work.end);
+    }
+    return end;
+}
+
+double SimulatedGPUQueues::GetBusyTime(GPUQueue queue) const {
+    double busy = 0.0;
+    for(const Work& work : work_) {
+        if(work.queue == queue) {
+            busy += work.end - work.start;
+        }
+    }
+    return busy;
+}
+
+double SimulatedGPUQueues::GetOverlapTime() const {
+    // +1 at every start, -1 at every end, ends first where they meet
+    std::vector<std::pair<double, int>> events;
+    for(const Work& work : work_) {
+        events.push_back({ work.start, 1 });
+        events.push_back({ work.end, -1 });
+    }
+    std::sort(events.begin(), events.end());
+
+    double overlap = 0.0;
+    int numRunning = 0;
+    for(size_t i = 0; i < events.size(); i++) {
+        if(numRunning > 1) {
+            overlap += events[i].first - events[i - 1].first;
+        }
+        numRunning += events[i].second;
+    }
+    return overlap;
+}
+
+void SimulatedGPUQueues::PrintTimeline() const {
+    std::vector<Work> sorted = work_;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Work& a, const Work& b) { return a.start < b.start; });
+
+    std::cout << std::fixed << std::setprecision(2);
+    for(const Work& work : sorted) {
+        std::cout << "  " << std::left << std::setw(8) << GetGPUQueueName(work.queue) << std::right
+                  << std::setw(7) << work.start << " - " << std::setw(7) << work.end << "  " << work.name << std::endl;
+    }
+
+    std::cout << "  end " << GetEndTime() << ", overlap " << GetOverlapTime() << std::defaultfloat << std::endl;
+}
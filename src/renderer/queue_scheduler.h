@@ -0,0 +1,161 @@
+﻿#ifndef RENDERER_QUEUE_SCHEDULER_H_
+#define RENDERER_QUEUE_SCHEDULER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class GPUQueue : uint32_t {
+    Direct,
+    Compute,
+    Count
+};
+
+constexpr uint32_t NumGPUQueues = (uint32_t)GPUQueue::Count;
+
+const char* GetGPUQueueName(GPUQueue queue);
+
+// a resource a submission reads or writes, see QueueScheduler::AddResource
+struct GPUQueueAccess {
+    uint32_t resource;
+    bool write;
+};
+
+//
+// What the scheduler drives. Every queue has one fence, signaled with increasing values.
+// The D3D12 one is in queue_scheduler_d3d12.h, SimulatedGPUQueues below runs on a timeline.
+//
+class GPUQueueBackend {
+public:
+    virtual ~GPUQueueBackend() {}
+
+    // queue doesn't start anything submitted after this until signalQueue's fence reaches value,
+    // the CPU doesn't block
+    virtual void Wait(GPUQueue queue, GPUQueue signalQueue, uint64_t value) = 0;
+    // queue's fence is set to value once everything submitted to it before is done
+    virtual void Signal(GPUQueue queue, uint64_t value) = 0;
+    virtual uint64_t GetCompletedValue(GPUQueue queue) const = 0;
+};
+
+//
+// Orders work submitted to several queues by the resources it reads and writes.
+//
+//   QueueScheduler scheduler(backend);
+//   uint32_t lut = scheduler.AddResource("SkyView LUT");
+//   scheduler.Submit(GPUQueue::Compute, {{ lut, true }}, [&]() { computeQueue->ExecuteCommandLists(...); });
+//   scheduler.Submit(GPUQueue::Direct, {{ lut, false }}, [&]() { directQueue->ExecuteCommandLists(...); });
+//
+// Work on one queue runs in submission order. Across queues, a submission waits for the last
+// write of everything it accesses (read after write, write after write) and, when it writes,
+// for the reads since (write after read). Only the waits that are needed go out: none for a value
+// the queue already waited for, or one the other queue's fence has reached.
+//
+// Submissions have to be made in an order that's valid to run in, from one thread.
+//
+class QueueScheduler {
+public:
+    struct Stats {
+        uint64_t numSubmissions = 0;
+        uint64_t numWaits = 0;        // GPU waits issued, joins included
+        uint64_t numElidedWaits = 0;  // needed, but covered by an earlier wait or already done
+    };
+
+    QueueScheduler(GPUQueueBackend& backend) : backend_(backend), submittedValues_{}, waitedValues_{} {}
+
+    uint32_t AddResource(std::string name);
+
+    // Waits for whatever accesses depend on, calls execute (which submits the work to queue) and
+    // signals queue's fence. With joinOtherQueues, reaching the returned value also means all the
+    // work submitted to the other queues so far is done, without holding up this submission's work.
+    uint64_t Submit(GPUQueue queue, const std::vector<GPUQueueAccess>& accesses, const std::function<void()>& execute,
+                    bool joinOtherQueues = false);
+
+    // what queue's fence reaches once everything submitted to it so far is done
+    uint64_t GetLastSubmittedValue(GPUQueue queue) const { return submittedValues_[(uint32_t)queue]; }
+
+    const std::string& GetResourceName(uint32_t resource) const { return resources_[resource].name; }
+    const Stats& GetStats() const { return stats_; }
+
+private:
+    struct Resource {
+        std::string name;
+
+        // 0 if never written or read
+        GPUQueue lastWriteQueue = GPUQueue::Direct;
+        uint64_t lastWriteValue = 0;
+        uint64_t lastReadValues[NumGPUQueues] = {}; // last read on each queue since the last write
+    };
+
+    // makes queue wait until signalQueue reaches value, unless that's already covered
+    void WaitFor(GPUQueue queue, GPUQueue signalQueue, uint64_t value);
+
+    GPUQueueBackend& backend_;
+    std::vector<Resource> resources_;
+    uint64_t submittedValues_[NumGPUQueues];
+    uint64_t waitedValues_[NumGPUQueues][NumGPUQueues]; // [queue][signal queue]
+    Stats stats_;
+};
+
+//
+// Queues on a simulated timeline, for checking a schedule without a device.
+// Every queue runs its work in submission order, one item at a time, and can't start anything
+// before the CPU time it was submitted at (SetCPUTime). Waits are the only link between queues.
+// Durations and times are in whatever unit the caller picks.
+//
+//   Compute    0.00 -    2.00  LUTs 0
+//   Direct     2.00 -    6.00  Graphics 0
+//   Compute    2.00 -    4.00  LUTs 1
+//
+class SimulatedGPUQueues : public GPUQueueBackend {
+public:
+    struct Work {
+        GPUQueue queue;
+        std::string name;
+        double start;
+        double end;
+    };
+
+    // adds work to the end of queue, call from QueueScheduler::Submit's execute
+    void Execute(GPUQueue queue, std::string name, double duration);
+
+    void Wait(GPUQueue queue, GPUQueue signalQueue, uint64_t value) override;
+    void Signal(GPUQueue queue, uint64_t value) override;
+    // the largest value signaled by the current CPU time
+    uint64_t GetCompletedValue(GPUQueue queue) const override;
+
+    // when the following submissions are made, never goes back
+    void SetCPUTime(double time);
+    double GetCPUTime() const { return cpuTime_; }
+
+    // when the fence reached value, value has to be signaled already
+    double GetSignalTime(GPUQueue queue, uint64_t value) const;
+
+    const std::vector<Work>& GetWork() const { return work_; }
+
+    // when the last work ends
+    double GetEndTime() const;
+    // time queue spent running work
+    double GetBusyTime(GPUQueue queue) const;
+    // time more than one queue was running work
+    double GetOverlapTime() const;
+
+    void PrintTimeline() const;
+
+private:
+    struct Fence {
+        uint64_t value;
+        double time;
+    };
+
+    struct Queue {
+        double freeTime = 0.0;     // when the queue can start its next work
+        std::vector<Fence> fences; // signaled values, in order
+    };
+
+    Queue queues_[NumGPUQueues];
+    std::vector<Work> work_;
+    double cpuTime_ = 0.0;
+};
+
+#endif // RENDERER_QUEUE_SCHEDULER_H_
@@ -0,0 +1,21 @@
+﻿#include "queue_scheduler_d3d12.h"
+
+D3D12GPUQueues::D3D12GPUQueues(winrt::com_ptr<ID3D12CommandQueue> directQueue, winrt::com_ptr<ID3D12Fence> directFence,
+                               winrt::com_ptr<ID3D12CommandQueue> computeQueue, winrt::com_ptr<ID3D12Fence> computeFence)
+: queues_{ directQueue, computeQueue }, fences_{ directFence, computeFence } {
+    WINRT_ASSERT(directQueue && directFence && computeQueue && computeFence);
+}
+
+void D3D12GPUQueues::Wait(GPUQueue queue, GPUQueue signalQueue, uint64_t value) {
+    HRESULT hr = queues_[(uint32_t)queue]->Wait(fences_[(uint32_t)signalQueue].get(), value);
+    winrt::check_hresult(hr);
+}
+
+void D3D12GPUQueues::Signal(GPUQueue queue, uint64_t value) {
+    HRESULT hr = queues_[(uint32_t)queue]->Signal(fences_[(uint32_t)queue].get(), value);
+    winrt::check_hresult(hr);
+}
+
+uint64_t D3D12GPUQueues::GetCompletedValue(GPUQueue queue) const {
+    return fences_[(uint32_t)queue]->GetCompletedValue();
+}
@@ -0,0 +1,25 @@
+﻿#ifndef RENDERER_QUEUE_SCHEDULER_D3D12_H_
+#define RENDERER_QUEUE_SCHEDULER_D3D12_H_
+
+#include "queue_scheduler.h"
+#include "renderer_types.h"
+
+//
+// QueueScheduler backend on D3D12 queues. Waits are ID3D12CommandQueue::Wait, so they only
+// hold up the GPU. The fences stay the renderer's, it keeps waiting on them for frame pacing.
+//
+class D3D12GPUQueues : public GPUQueueBackend {
+public:
+    D3D12GPUQueues(winrt::com_ptr<ID3D12CommandQueue> directQueue, winrt::com_ptr<ID3D12Fence> directFence,
+                   winrt::com_ptr<ID3D12CommandQueue> computeQueue, winrt::com_ptr<ID3D12Fence> computeFence);
+
+    void Wait(GPUQueue queue, GPUQueue signalQueue, uint64_t value) override;
+    void Signal(GPUQueue queue, uint64_t value) override;
+    uint64_t GetCompletedValue(GPUQueue queue) const override;
+
+private:
+    winrt::com_ptr<ID3D12CommandQueue> queues_[NumGPUQueues];
+    winrt::com_ptr<ID3D12Fence> fences_[NumGPUQueues];
+};
+
+#endif // RENDERER_QUEUE_SCHEDULER_D3D12_H_
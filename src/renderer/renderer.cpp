@@ -3,6 +3,8 @@
 
 #include <d3d12.h>
 #include <dxgi1_6.h>
+#include <algorithm>
+#include <future>
 #include <iostream>
 #include <winrt/windows.foundation.h>
 #include <thread>
@@ -11,7 +13,10 @@
 #include "pipeline_state.h"
 #include "shader.h"
 #include "shader_compiler.h"
+#include "shader_file_watcher.h"
+#include "multithreading/work_stealing_scheduler.h"
 #include "memory/memory_allocator.h"
+#include "memory/paged_descriptor_allocator.h"
 #include "memory/static_descriptor_allocator.h"
 #include "pipeline_builder.h"
 #include "memory/static_memory_allocator.h"
@@ -30,6 +35,11 @@ concept IsIDXGISwapChain1 = IsAnyOf<T, IDXGISwapChain1, IDXGISwapChain2, IDXGISw
 const ResourceID Renderer::SwapChainRenderTargetID = "DefaultSwapChainRenderTarget";
 const ResourceID Renderer::DefaultDepthStencilTargetID = "DefaultDepthStencilTarget";
 
+namespace {
+	// seconds between checking shader files for changes
+	const double ShaderPollInterval = 0.5;
+}
+
 namespace dx12_init {
 	void EnableDebugLayer(HRESULT& hr);
 	
@@ -76,40 +86,44 @@ std::shared_ptr<Renderer> Renderer::CreateRenderer(HWND hwnd, RendererConfig par
 	return renderer;
 }
 
-void Renderer::ExecutePipeline(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::shared_ptr<PipelineState> pso) {
+bool Renderer::ExecutePipeline(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::shared_ptr<PipelineState> pso) {
 	if(!pso->IsStateReady()) {
 		// std::cout << "pso not assembled" << std::endl;
-		return;
+		return false;
 	}
 	
 	if(!pso->IsReadyAndOk()) {
 		// std::cout << "pso not assembled correctly..." << std::endl;
-		return;
+		return false;
 	}
 	
 	// check all dependent resources (vertex buffers, textures, etc.), abort if not ready
 	// check that all render target resource states are OK, otherwise barriers are needed
 	if(!pso->AreAllResourcesReady()) {
 		std::cout << "pso resources not ready..." << std::endl;
-		return;
+		return false;
 	}
 
 	if(pso->type_ == PipelineStateType::Graphics) {
+		WINRT_ASSERT(cmdList != cmdComputeList_ && "Compute lists can't draw.");
 		PrepareGraphicsPipelineRenderTargets(cmdList, std::static_pointer_cast<GraphicsPipelineState>(pso));
 	}
+
+	GetBarrierBatcher(cmdList).Flush(cmdList.get());
 	
 	// execute pipeline...
 	// 1. Set root signature
 	// 2. Graphics => bind vertex buffer(s), index buffer, and draw
 	//    Compute => dispatch
 	pso->Execute(cmdList);
+	return true;
 }
 
-void Renderer::ExecuteGraphicsPipeline(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList,
+bool Renderer::ExecuteGraphicsPipeline(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList,
 	std::shared_ptr<PipelineState> pso, uint32_t numInstances) {
 	
 	std::static_pointer_cast<GraphicsPipelineState>(pso)->SetNumInstances(numInstances);
-	ExecutePipeline(cmdList, pso);
+	return ExecutePipeline(cmdList, pso);
 }
 
 std::shared_ptr<RenderTarget> Renderer::CreateRenderTarget(ResourceID id, DXGI_FORMAT format, bool useAsUAV, D3D12_RESOURCE_STATES state) {
@@ -158,8 +172,83 @@ std::shared_ptr<RenderTarget> Renderer::GetCurrentSwapChainBufferResource() cons
 	return renderTargetMap_.at(Renderer::SwapChainRenderTargetID)->resources[curBackBufferIndex_];
 }
 
+AllocationTelemetrySnapshot Renderer::GetAllocationTelemetry() const {
+	AllocationTelemetrySnapshot snapshot;
+	snapshot.fenceValue = fenceValue_;
+
+	if(memoryAllocator_) {
+		MemoryAllocatorTelemetry telemetry;
+		telemetry.name = "Memory Allocator";
+		memoryAllocator_->GetTelemetry(telemetry);
+		snapshot.memoryAllocators.push_back(std::move(telemetry));
+	}
+
+	// render targets are committed resources made in CreateRenderTarget(), swap chain buffers included
+	{
+		MemoryAllocatorTelemetry telemetry;
+		telemetry.name = "Render Targets";
+
+		for(const auto& [id, rtHandle] : renderTargetMap_) {
+			for(size_t i = 0; i < rtHandle->resources.size(); i++) {
+				const std::shared_ptr<RenderTarget>& rt = rtHandle->resources[i];
+				if(!rt->HasNativeResource()) {
+					continue;
+				}
+
+				const std::string resId = rtHandle->resources.size() > 1 ? id + "[" + std::to_string(i) + "]" : id;
+				telemetry.resources.push_back(GetCommittedResourceTelemetry(device_.get(), resId, rt->GetNativeResource()->GetDesc()));
+				telemetry.reservedBytes += telemetry.resources.back().reservedBytes;
+			}
+		}
+
+		snapshot.memoryAllocators.push_back(std::move(telemetry));
+	}
+
+	const std::pair<const char*, std::shared_ptr<DescriptorAllocator>> descriptorAllocators[] = {
+		{ "CBV_SRV_UAV", resourceDescriptorAllocator_ },
+		{ "Sampler", samplerDescriptorAllocator_ },
+		{ "RTV", renderTargetDescriptorAllocator_ },
+		{ "DSV", depthStencilDescriptorAllocator_ },
+	};
+
+	for(const auto& [name, allocator] : descriptorAllocators) {
+		if(!allocator) {
+			continue;
+		}
+
+		DescriptorHeapTelemetry telemetry;
+		telemetry.name = name;
+		allocator->GetTelemetry(telemetry);
+		snapshot.descriptorHeaps.push_back(std::move(telemetry));
+	}
+
+	return snapshot;
+}
+
+bool Renderer::DumpAllocationTelemetry(const std::filesystem::path& path) const {
+	const AllocationTelemetrySnapshot snapshot = GetAllocationTelemetry();
+	if(!snapshot.WriteJson(path)) {
+		std::cout << "Couldn't write allocation telemetry to " << path.string() << std::endl;
+		return false;
+	}
+
+	for(const MemoryAllocatorTelemetry& allocator : snapshot.memoryAllocators) {
+		std::cout << allocator.name << ": " << allocator.reservedBytes << " bytes reserved, "
+				  << allocator.GetResourceUsedBytes() << " used by " << allocator.resources.size() << " resources, "
+				  << allocator.GetAlignmentWaste() << " lost to alignment" << std::endl;
+	}
+
+	for(const DescriptorHeapTelemetry& heap : snapshot.descriptorHeaps) {
+		std::cout << heap.name << " descriptors: " << heap.numAllocatedDescriptors << "/" << heap.numDescriptors
+				  << " in " << heap.numAllocations << " allocations" << std::endl;
+	}
+
+	std::cout << "Allocation telemetry written to " << path.string() << std::endl;
+	return true;
+}
+
 Renderer::Renderer(HWND hwnd, RendererConfig config, HRESULT& hr)
-: cmdListActive_(false), fenceValue_(0), config_(config) {
+: cmdListActive_(false), cmdComputeListActive_(false), fenceValue_(0), shaderPollTimer_(0.0), config_(config) {
 	numBuffers_ = config_.numBuffers;
 	
 	RECT rect;
@@ -186,6 +275,9 @@ Renderer::Renderer(HWND hwnd, RendererConfig config, HRESULT& hr)
 	cmdQueue_ = dx12_init::CreateCommandQueue(device_, D3D12_COMMAND_LIST_TYPE_DIRECT, hr);
 	CHECK_HR(hr);
 	
+	cmdComputeQueue_ = dx12_init::CreateCommandQueue(device_, D3D12_COMMAND_LIST_TYPE_COMPUTE, hr);
+	CHECK_HR(hr);
+
 	cmdCopyQueue_ = dx12_init::CreateCommandQueue(device_, D3D12_COMMAND_LIST_TYPE_COPY, hr);
 	CHECK_HR(hr);
 
@@ -196,6 +288,7 @@ Renderer::Renderer(HWND hwnd, RendererConfig config, HRESULT& hr)
 
 	// 1 cmd allocator per frame buffer
 	cmdAllocators_.resize(numBuffers_);
+	cmdComputeAllocators_.resize(numBuffers_);
 	cmdCopyAllocators_.resize(numBuffers_);
 	
 	for(int i = 0; i < numBuffers_; i++) {
@@ -203,6 +296,11 @@ Renderer::Renderer(HWND hwnd, RendererConfig config, HRESULT& hr)
 											__uuidof(ID3D12CommandAllocator),
 											cmdAllocators_[i].put_void());
 		CHECK_HR(hr);
+
+		hr = device_->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE,
+											__uuidof(ID3D12CommandAllocator),
+											cmdComputeAllocators_[i].put_void());
+		CHECK_HR(hr);
 											
 		hr = device_->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
 											__uuidof(ID3D12CommandAllocator),
@@ -218,6 +316,12 @@ Renderer::Renderer(HWND hwnd, RendererConfig config, HRESULT& hr)
 	cmdList_->Close();
 	CHECK_HR(hr);
 	
+	hr = device_->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE, cmdComputeAllocators_[0].get(), nullptr, __uuidof(ID3D12GraphicsCommandList), cmdComputeList_.put_void());
+	CHECK_HR(hr);
+
+	cmdComputeList_->Close();
+	CHECK_HR(hr);
+
 	hr = device_->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, cmdCopyAllocators_[0].get(), nullptr, __uuidof(ID3D12GraphicsCommandList), cmdCopyList_.put_void());
 	CHECK_HR(hr);
 	
@@ -228,21 +332,34 @@ Renderer::Renderer(HWND hwnd, RendererConfig config, HRESULT& hr)
 	hr = device_->CreateFence(0, D3D12_FENCE_FLAG_NONE, __uuidof(ID3D12Fence), mainFence_.put_void());
 	CHECK_HR(hr);
 
+	hr = device_->CreateFence(0, D3D12_FENCE_FLAG_NONE, __uuidof(ID3D12Fence), computeFence_.put_void());
+	CHECK_HR(hr);
+
+	gpuQueues_ = std::make_unique<D3D12GPUQueues>(cmdQueue_, mainFence_, cmdComputeQueue_, computeFence_);
+	queueScheduler_ = std::make_unique<QueueScheduler>(*gpuQueues_);
+
 	fenceEvent_ = CreateEvent(NULL, FALSE, FALSE, NULL);
 	assert(fenceEvent_);
 
 	scissorRect_ = CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX);
 	viewport_ = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(clientWidth_), static_cast<float>(clientHeight_));
 
-	shaderCompiler_ = std::make_shared<ShaderCompiler>();
+	taskScheduler_ = std::make_shared<WorkStealingScheduler>();
+	taskScheduler_->Start();
+
+	cmdListPool_ = std::make_unique<CommandListPool>(device_, numBuffers_);
 
-	resourceDescriptorAllocator_ = std::make_shared<StaticDescriptorAllocator>(device_,
+	shaderCompiler_ = std::make_shared<ShaderCompiler>(taskScheduler_);
+	shaderFileWatcher_ = std::make_unique<ShaderFileWatcher>();
+
+	// pipelines are reassembled on hot reload, their descriptor tables are given back
+	resourceDescriptorAllocator_ = std::make_shared<PagedDescriptorAllocator>(device_,
 																		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
 																		500,
 																		true
 																		);
 																		
-	samplerDescriptorAllocator_ = std::make_shared<StaticDescriptorAllocator>(device_,
+	samplerDescriptorAllocator_ = std::make_shared<PagedDescriptorAllocator>(device_,
 																		D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER,
 																		10,
 																		true
@@ -260,7 +377,7 @@ Renderer::Renderer(HWND hwnd, RendererConfig config, HRESULT& hr)
 																		false	
 																		);
 	
-	pipelineAssembler_ = std::make_shared<PipelineAssembler>(device_, resourceDescriptorAllocator_, samplerDescriptorAllocator_);
+	pipelineAssembler_ = std::make_shared<PipelineAssembler>(device_, taskScheduler_, resourceDescriptorAllocator_, samplerDescriptorAllocator_);
 
 	// create render target handles for swap chain buffers
 	std::shared_ptr<RenderTargetHandle> swapChainRtHandle = std::make_shared<RenderTargetHandle>();
@@ -301,8 +418,11 @@ Renderer::~Renderer() {
 		WaitForSingleObject(fenceEvent_, INFINITE); // block
 	}
 
+	// tasks still in flight reference the compiler and the assembler
+	taskScheduler_->Stop();
 	shaderCompiler_.reset();
 	pipelineAssembler_.reset();
+	taskScheduler_.reset();
 	
 	renderTargetMap_.clear();
 	depthStencilTargetMap_.clear();
@@ -483,6 +603,7 @@ bool Renderer::CreateRenderTargetDescriptorAllocation(const RenderTargetGroupID&
 
 void Renderer::OnMemoryAllocatorSet() {
 	WINRT_ASSERT(memoryAllocator_);
+	memoryAllocator_->SetTaskScheduler(taskScheduler_);
 
 	auto allocateDescriptors = [&]() {
 		WINRT_ASSERT(depthStencilDescriptorAllocator_);
@@ -548,23 +669,16 @@ void Renderer::PrepareGraphicsPipelineRenderTargets(winrt::com_ptr<ID3D12Graphic
 
 	const RenderTargetGroupID rtGroupID = pso->GetCurrentRenderTargetGroupID();
 
-	if(rtGroupID != RenderTargetGroupID({SwapChainRenderTargetID}) && !curFrameRenderTargetsReset_.contains(rtGroupID)) {
-		D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle;
-		renderTargetAllocMap_[rtGroupID][0].lock()->GetCPUDescriptorHandle(cpuHandle);
-
-		const FLOAT clearVal[] = {0,0,0,1};
-		cmdList->ClearRenderTargetView(cpuHandle, clearVal, 0, NULL);
-		
-		curFrameRenderTargetsReset_.insert(rtGroupID);
-	}
-	
 	// set render targets (via descriptor)
 	// - the descriptors linked to the current backbuffer index
 	// - the descriptors should've been made when creating the pipeline
 	// barrier if needed
 	const std::vector<ResourceID>& ids = rtGroupID.GetIDs();
 
-	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+	// parallel jobs can run this concurrently, only lookups from here on
+	ResourceBarrierBatcher& batcher = GetBarrierBatcher(cmdList);
+	const CommandListPool::Entry* poolEntry = cmdListPool_->Find(cmdList.get());
+	const bool tracksResourceStates = !poolEntry || !poolEntry->recordsJob;
 
 	bool isRenderingToSwapChain = false;
 	
@@ -572,7 +686,7 @@ void Renderer::PrepareGraphicsPipelineRenderTargets(winrt::com_ptr<ID3D12Graphic
 	// and change its state (if different)
 	for(const auto& id : ids) {
 		WINRT_ASSERT(renderTargetMap_.contains(id));
-		std::shared_ptr<RenderTargetHandle> rtHandle = renderTargetMap_[id];
+		std::shared_ptr<RenderTargetHandle> rtHandle = renderTargetMap_.at(id);
 
 		int index = 0;
 		if(id == Renderer::SwapChainRenderTargetID) {
@@ -582,12 +696,27 @@ void Renderer::PrepareGraphicsPipelineRenderTargets(winrt::com_ptr<ID3D12Graphic
 		
 		std::shared_ptr<RenderTarget> rt = rtHandle->resources[index];
 
-		
-		rt->ChangeState(D3D12_RESOURCE_STATE_RENDER_TARGET, barriers);
+		// in jobs, whoever runs them has put the targets in RENDER_TARGET already
+		if(tracksResourceStates) {
+			rt->ChangeState(D3D12_RESOURCE_STATE_RENDER_TARGET, batcher);
+		}
+	}
+
+	bool clearRenderTargets = false;
+	if(rtGroupID != RenderTargetGroupID({SwapChainRenderTargetID})) {
+		std::lock_guard<std::mutex> lock(renderTargetsResetMutex_);
+		clearRenderTargets = curFrameRenderTargetsReset_.insert(rtGroupID).second;
 	}
 
-	if(barriers.size() > 0) {
-		cmdList->ResourceBarrier(barriers.size(), barriers.data());
+	if(clearRenderTargets) {
+		// the clear needs the targets in RENDER_TARGET already
+		batcher.Flush(cmdList.get());
+
+		D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle;
+		renderTargetAllocMap_.at(rtGroupID)[0].lock()->GetCPUDescriptorHandle(cpuHandle);
+
+		const FLOAT clearVal[] = {0,0,0,1};
+		cmdList->ClearRenderTargetView(cpuHandle, clearVal, 0, NULL);
 	}
 
 	// Output Merger, set render target & depth buffer (if any)
@@ -599,14 +728,14 @@ void Renderer::PrepareGraphicsPipelineRenderTargets(winrt::com_ptr<ID3D12Graphic
 			index = curBackBufferIndex_;
 		}
 
-		std::shared_ptr<DescriptorHeapAllocation> rtAlloc = renderTargetAllocMap_[rtGroupID][index].lock();
+		std::shared_ptr<DescriptorHeapAllocation> rtAlloc = renderTargetAllocMap_.at(rtGroupID)[index].lock();
 		const uint32_t numRenderTargets = rtAlloc->GetAllocationSize();
 		rtAlloc->GetCPUDescriptorHandle(rtDescriptor);
 
 		D3D12_CPU_DESCRIPTOR_HANDLE depthDescriptor;
 		D3D12_CPU_DESCRIPTOR_HANDLE* ptrDepthDescriptor = nullptr;
 		if(depthStencilTargetMap_.contains(pso->depthId_)) {
-			depthBufferAllocMap_[pso->depthId_][curBackBufferIndex_].lock()->GetCPUDescriptorHandle(depthDescriptor);
+			depthBufferAllocMap_.at(pso->depthId_)[curBackBufferIndex_].lock()->GetCPUDescriptorHandle(depthDescriptor);
 			ptrDepthDescriptor = &depthDescriptor;
 		}
 		
@@ -615,6 +744,109 @@ void Renderer::PrepareGraphicsPipelineRenderTargets(winrt::com_ptr<ID3D12Graphic
 }
 
 
+ResourceBarrierBatcher& Renderer::GetBarrierBatcher(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) {
+	if(cmdList == cmdList_) {
+		return barrierBatcher_;
+	}
+	if(cmdList == cmdComputeList_) {
+		return computeBarrierBatcher_;
+	}
+
+	CommandListPool::Entry* entry = cmdListPool_->Find(cmdList.get());
+	WINRT_ASSERT(entry && "Not a command list of this frame.");
+	return entry->batcher;
+}
+
+void Renderer::FlushBarriers(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) {
+	GetBarrierBatcher(cmdList).Flush(cmdList.get());
+}
+
+void Renderer::SetDefaultCommandListState(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) {
+	// there's only 1 resource and sampler heap, bind them now
+	ID3D12DescriptorHeap* heaps[] = {
+		resourceDescriptorAllocator_->GetDescriptorHeap().get(),
+		samplerDescriptorAllocator_->GetDescriptorHeap().get()
+	};
+	cmdList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+	if(cmdList->GetType() == D3D12_COMMAND_LIST_TYPE_COMPUTE) {
+		return;
+	}
+
+	// scissor and viewport represent entire window, will need to
+	// modify this in order to support split-screen
+	cmdList->RSSetScissorRects(1, &scissorRect_);
+	cmdList->RSSetViewports(1, &viewport_);
+}
+
+std::vector<CommandListPool::Entry*> Renderer::RecordJobs(std::vector<RecordJob>& jobs, HRESULT& hr) {
+	WINRT_ASSERT(cmdListActive_);
+	hr = S_OK;
+
+	// the pool isn't thread safe, the workers only get their lists
+	std::vector<CommandListPool::Entry*> entries;
+	for(size_t i = 0; i < jobs.size(); i++) {
+		CommandListPool::Entry* entry = cmdListPool_->Acquire(hr);
+		CHECK_HR_RET(hr, {});
+
+		entry->recordsJob = true;
+		entries.push_back(entry);
+	}
+
+	std::vector<std::future<HRESULT>> recorded;
+	for(size_t i = 0; i < jobs.size(); i++) {
+		std::packaged_task<HRESULT()> task([this, &job = jobs[i], entry = entries[i]]() {
+			SetDefaultCommandListState(entry->cmdList);
+			job(entry->cmdList);
+
+			entry->batcher.Flush(entry->cmdList.get());
+			WINRT_ASSERT(!entry->batcher.HasOpenSplitTransitions());
+			return entry->cmdList->Close();
+		});
+
+		recorded.push_back(task.get_future());
+		taskScheduler_->AddTask(std::move(task));
+	}
+
+	for(std::future<HRESULT>& jobResult : recorded) {
+		const HRESULT jobHr = jobResult.get();
+		if(FAILED(jobHr)) {
+			hr = jobHr;
+		}
+	}
+
+	return entries;
+}
+
+winrt::com_ptr<ID3D12GraphicsCommandList> Renderer::RecordParallel(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList,
+	std::vector<RecordJob> jobs, HRESULT& hr) {
+
+	WINRT_ASSERT(cmdList == activeCmdList_);
+
+	// everything recorded so far runs first
+	ResourceBarrierBatcher& batcher = GetBarrierBatcher(cmdList);
+	WINRT_ASSERT(!batcher.HasOpenSplitTransitions());
+	batcher.Flush(cmdList.get());
+
+	hr = cmdList->Close();
+	CHECK_HR_NULL(hr);
+	frameCmdLists_.push_back(cmdList);
+
+	const std::vector<CommandListPool::Entry*> entries = RecordJobs(jobs, hr);
+	CHECK_HR_NULL(hr);
+
+	for(const CommandListPool::Entry* entry : entries) {
+		frameCmdLists_.push_back(entry->cmdList);
+	}
+
+	CommandListPool::Entry* next = cmdListPool_->Acquire(hr);
+	CHECK_HR_NULL(hr);
+
+	SetDefaultCommandListState(next->cmdList);
+	activeCmdList_ = next->cmdList;
+	return activeCmdList_;
+}
+
 winrt::com_ptr<ID3D12GraphicsCommandList> Renderer::StartCommandList(HRESULT& hr) {
 	// we're still writing to the command list
 	assert(!cmdListActive_);
@@ -628,28 +860,27 @@ winrt::com_ptr<ID3D12GraphicsCommandList> Renderer::StartCommandList(HRESULT& hr
 	cmdList_->Reset(cmdAllocators_[curBackBufferIndex_].get(), nullptr);
 	CHECK_HR_NULL(hr);
 
+	// the frame that used it last waited for the compute work submitted before its end
+	hr = cmdComputeAllocators_[curBackBufferIndex_]->Reset();
+	CHECK_HR_NULL(hr);
+
 	cmdListActive_ = true;
+	activeCmdList_ = cmdList_;
+	frameCmdLists_.clear();
+	cmdListPool_->BeginFrame(curBackBufferIndex_);
 
-	// there's only 1 resource and sampler heap, bind them now
-	ID3D12DescriptorHeap* heaps[] = {
-		resourceDescriptorAllocator_->GetDescriptorHeap().get(),
-		samplerDescriptorAllocator_->GetDescriptorHeap().get()
-	};
-	cmdList_->SetDescriptorHeaps(_countof(heaps), heaps);
+	// recycle per-frame memory and descriptors of the frames the GPU finished
+	const uint64_t completedFenceVal = mainFence_->GetCompletedValue();
+	memoryAllocator_->BeginFrame(completedFenceVal);
+	resourceDescriptorAllocator_->BeginFrame(completedFenceVal);
+	samplerDescriptorAllocator_->BeginFrame(completedFenceVal);
 
-	// scissor and viewport represent entire window, will need to
-	// modify this in order to support split-screen
-	cmdList_->RSSetScissorRects(1, &scissorRect_);
-	cmdList_->RSSetViewports(1, &viewport_);
+	SetDefaultCommandListState(cmdList_);
 
 	// in order for us to clear render targets, they must be in RENDER_TARGET state
-	std::vector<D3D12_RESOURCE_BARRIER> barriers;
 	std::shared_ptr<RenderTarget> curSwapChainBuffer = renderTargetMap_[Renderer::SwapChainRenderTargetID]->resources[curBackBufferIndex_];
-	curSwapChainBuffer->ChangeState(D3D12_RESOURCE_STATE_RENDER_TARGET, barriers);
-
-	if(barriers.size() > 0) {
-		cmdList_->ResourceBarrier(barriers.size(), barriers.data());	
-	}
+	curSwapChainBuffer->ChangeState(D3D12_RESOURCE_STATE_RENDER_TARGET, barrierBatcher_);
+	barrierBatcher_.Flush(cmdList_.get());
 
 	// clear current swap chain buffer and default depth
 	FLOAT clearColor[4] = {0,0,0,1.0f};
@@ -668,36 +899,76 @@ winrt::com_ptr<ID3D12GraphicsCommandList> Renderer::StartCommandList(HRESULT& hr
 	return cmdList_;
 }
 
-void Renderer::FinishCommandList(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, HRESULT& hr) {
-	assert(cmdList == cmdList_);
+winrt::com_ptr<ID3D12GraphicsCommandList> Renderer::StartComputeCommandList(HRESULT& hr) {
+	WINRT_ASSERT(cmdListActive_ && !cmdComputeListActive_);
+
+	// lists can be reset as soon as they're submitted, the allocator only with the frame's
+	hr = cmdComputeList_->Reset(cmdComputeAllocators_[curBackBufferIndex_].get(), nullptr);
+	CHECK_HR_NULL(hr);
+
+	cmdComputeListActive_ = true;
+	SetDefaultCommandListState(cmdComputeList_);
+
+	return cmdComputeList_;
+}
+
+void Renderer::FinishComputeCommandList(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList,
+										const std::vector<GPUQueueAccess>& accesses, HRESULT& hr) {
+	WINRT_ASSERT(cmdList == cmdComputeList_ && cmdComputeListActive_);
+
+	WINRT_ASSERT(!computeBarrierBatcher_.HasOpenSplitTransitions());
+	computeBarrierBatcher_.Flush(cmdList.get());
+
+	hr = cmdList->Close();
+	CHECK_HR(hr);
+
+	queueScheduler_->Submit(GPUQueue::Compute, accesses, [&]() {
+		ID3D12CommandList* cmdLists[] = { cmdList.get() };
+		cmdComputeQueue_->ExecuteCommandLists(1, cmdLists);
+	});
+
+	cmdComputeListActive_ = false;
+}
+
+void Renderer::FinishCommandList(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, HRESULT& hr,
+								 const std::vector<GPUQueueAccess>& accesses) {
+	assert(cmdList == activeCmdList_);
+	WINRT_ASSERT(!cmdComputeListActive_);
 
 	// swap chain render targets to state: PRESENT
-	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+	ResourceBarrierBatcher& batcher = GetBarrierBatcher(cmdList);
 	std::shared_ptr<RenderTarget> curSwapChainBuffer = renderTargetMap_[Renderer::SwapChainRenderTargetID]->resources[curBackBufferIndex_];
-	curSwapChainBuffer->ChangeState(D3D12_RESOURCE_STATE_PRESENT, barriers);
+	curSwapChainBuffer->ChangeState(D3D12_RESOURCE_STATE_PRESENT, batcher);
 
-	if(barriers.size() > 0) {
-		cmdList->ResourceBarrier(barriers.size(), barriers.data());	
-	}
+	// a split transition that never ended would leave its resource unusable
+	WINRT_ASSERT(!batcher.HasOpenSplitTransitions());
+	batcher.Flush(cmdList.get());
 
-	hr = cmdList_->Close();
+	hr = cmdList->Close();
 	CHECK_HR(hr);
 	
+	frameCmdLists_.push_back(cmdList);
 
-	ID3D12CommandList* const cmdLists[] = {
-		cmdList.get()
-	};
+	// the main list and whatever RecordParallel added, in recording order
+	std::vector<ID3D12CommandList*> cmdLists;
+	for(const winrt::com_ptr<ID3D12GraphicsCommandList>& frameCmdList : frameCmdLists_) {
+		cmdLists.push_back(frameCmdList.get());
+	}
 	
-	cmdQueue_->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+	// waits for the compute work the frame reads, the fence value then covers the rest of it too,
+	// so everything below that recycles by fence value is safe for compute work as well
+	const uint64_t nextFenceVal = queueScheduler_->Submit(GPUQueue::Direct, accesses, [&]() {
+		cmdQueue_->ExecuteCommandLists((UINT)cmdLists.size(), cmdLists.data());
 
-	// present whatever's on the current buffer, which was rendered onto (completely) already in a previous frame
-	swapChain_->Present(0, 0);
+		// present whatever's on the current buffer, which was rendered onto (completely) already in a previous frame
+		swapChain_->Present(0, 0);
+	}, true);
 
 	// update fence value for previous buffer
-	const uint64_t nextFenceVal = ++fenceValue_;
+	fenceValue_ = nextFenceVal;
 	mainFenceValues_[curBackBufferIndex_] = nextFenceVal;
-	hr = cmdQueue_->Signal(mainFence_.get(), nextFenceVal);
-	CHECK_HR(hr);
+
+	memoryAllocator_->EndFrame(nextFenceVal);
 
 	const uint32_t nextBackBuffer = swapChain_->GetCurrentBackBufferIndex();
 	const uint64_t waitFenceVal = mainFenceValues_[nextBackBuffer];
@@ -718,6 +989,8 @@ void Renderer::FinishCommandList(winrt::com_ptr<ID3D12GraphicsCommandList> cmdLi
 void Renderer::Tick(double deltaTime) {
 	HRESULT hr;
 	
+	UpdateShaderHotReload(deltaTime);
+
 	screenSizeRCV_.SetValue(ninmath::Vector2f{(float) clientWidth_, (float) clientHeight_});
 	
 	// let memory allocator do work, if there is any
@@ -734,6 +1007,162 @@ void Renderer::Tick(double deltaTime) {
 	}
 }
 
+void Renderer::UpdateShaderHotReload(double deltaTime) {
+	// a replaced pipeline state may still be referenced by frames in flight
+	const uint64_t completedFenceVal = mainFence_->GetCompletedValue();
+	std::erase_if(retiredPipelineStates_, [completedFenceVal](const RetiredPipelineState& retired) {
+		return retired.fenceValue <= completedFenceVal;
+	});
+
+	// adopt reassembled pipelines, the previous state is used until then
+	for(size_t i = 0; i < pipelineReloads_.size();) {
+		PipelineReload& reload = pipelineReloads_[i];
+
+		// the original could still be assembling for the first time
+		if(!reload.copy->IsStateReady() || !reload.pso->IsStateReady()) {
+			i++;
+			continue;
+		}
+
+		// an older reload of the same pipeline goes first, so it can't be adopted over this one later
+		const bool olderPending = std::any_of(pipelineReloads_.begin(), pipelineReloads_.begin() + i, [&](const PipelineReload& other) {
+			return other.pso == reload.pso;
+		});
+		if(olderPending) {
+			i++;
+			continue;
+		}
+
+		// a file changed again while this one was assembling, only the newest reload is adopted
+		const bool superseded = std::any_of(pipelineReloads_.begin() + i + 1, pipelineReloads_.end(), [&](const PipelineReload& other) {
+			return other.pso == reload.pso;
+		});
+
+		if(!superseded && reload.copy->IsReadyAndOk()) {
+			// recorded into the current frame at the latest, which signals fenceValue_ + 1
+			retiredPipelineStates_.push_back({ fenceValue_ + 1, reload.pso->AdoptReloadCopy(*reload.copy) });
+			FreeDescriptors(retiredPipelineStates_.back().state.get(), fenceValue_ + 1);
+			PinPipelineShaders(*reload.pso);
+			std::cout << "Hot reloaded pipeline " << reload.pso->GetID() << std::endl;
+		}
+		else {
+			// never recorded, its descriptors can go right away
+			FreeDescriptors(reload.copy->GetState_Block(), 0);
+
+			if(!superseded) {
+				std::cout << "Reloading pipeline " << reload.pso->GetID() << " failed, keeping the previous one. "
+						  << reload.copy->GetState_Block().msg << std::endl;
+			}
+		}
+
+		pipelineReloads_.erase(pipelineReloads_.begin() + i);
+	}
+
+	shaderPollTimer_ += deltaTime;
+	if(shaderPollTimer_ < ShaderPollInterval) {
+		return;
+	}
+	shaderPollTimer_ = 0.0;
+
+	// (re)register every shader whose compilation finished, with its current include graph
+	for(const auto& [id, shader] : shaderMap_) {
+		if(shader->IsStateReady() && watchedShaders_[id].lock() != shader) {
+			shaderFileWatcher_->Watch(id, shader->GetDependencies());
+			watchedShaders_[id] = shader;
+		}
+	}
+
+	const std::set<std::string> changedShaders = shaderFileWatcher_->Poll();
+	dirtyShaders_.insert(changedShaders.begin(), changedShaders.end());
+
+	if(!dirtyShaders_.empty()) {
+		ReloadShaders(dirtyShaders_);
+	}
+}
+
+void Renderer::PinPipelineShaders(const PipelineState& pso) {
+	std::vector<std::weak_ptr<Shader>> shaders;
+	pso.GetShaders(shaders);
+
+	std::vector<std::shared_ptr<Shader>>& pinned = pipelineShaders_[pso.GetID()];
+	pinned.clear();
+	for(const std::weak_ptr<Shader>& shader : shaders) {
+		pinned.push_back(shader.lock());
+	}
+}
+
+void Renderer::FreeDescriptors(const PipelineState::State& state, uint64_t fenceValue) {
+	for(const std::weak_ptr<DescriptorHeapAllocation>& allocation : state.resourceDescriptors) {
+		resourceDescriptorAllocator_->Free(allocation, fenceValue);
+	}
+
+	for(const std::weak_ptr<DescriptorHeapAllocation>& allocation : state.samplerDescriptors) {
+		samplerDescriptorAllocator_->Free(allocation, fenceValue);
+	}
+}
+
+void Renderer::ReloadShaders(const std::set<std::string>& shaderIds) {
+	std::set<std::string> reloadedIds;
+	std::vector<std::shared_ptr<Shader>> replacedShaders;
+
+	for(const std::string& id : shaderIds) {
+		const auto it = shaderMap_.find(id);
+		if(it == shaderMap_.end()) {
+			continue;
+		}
+
+		// still compiling, it stays dirty and is picked up by a later poll
+		if(!it->second->IsStateReady()) {
+			continue;
+		}
+
+		std::cout << "Shader changed, recompiling " << id << std::endl;
+
+		std::shared_ptr<Shader> reloaded = it->second->CreateReloadCopy();
+		shaderCompiler_->Enqueue(reloaded);
+
+		replacedShaders.push_back(std::move(it->second));
+		it->second = std::move(reloaded);
+		reloadedIds.insert(id);
+	}
+
+	std::erase_if(dirtyShaders_, [&](const std::string& id) {
+		return reloadedIds.contains(id) || !shaderMap_.contains(id);
+	});
+
+	// reassemble only the pipelines using a recompiled shader. Both are flushed at the end of the frame,
+	// the shaders first, so the copies' assembly tasks can depend on the compile tasks.
+	for(const auto& [psoId, pso] : psoMap_) {
+		std::vector<std::weak_ptr<Shader>> shaders;
+		pso->GetShaders(shaders);
+
+		const bool affected = std::any_of(shaders.begin(), shaders.end(), [&](const std::weak_ptr<Shader>& s) {
+			const std::shared_ptr<Shader> shader = s.lock();
+			return shader && reloadedIds.contains(shader->GetSourceFile());
+		});
+
+		if(!affected) {
+			continue;
+		}
+
+		// the pipeline keeps rendering with its current shaders until the reload is adopted, which may never happen
+		PinPipelineShaders(*pso);
+
+		PipelineReload reload;
+		reload.pso = pso;
+		reload.copy = pso->CreateReloadCopy(shaderMap_);
+
+		// the original's shaders are still in the list
+		reload.copy->GetShaders(shaders);
+		for(const std::weak_ptr<Shader>& s : shaders) {
+			reload.shaders.push_back(s.lock());
+		}
+
+		pipelineAssembler_->Enqueue(reload.copy);
+		pipelineReloads_.push_back(std::move(reload));
+	}
+}
+
 GraphicsPipelineBuilder Renderer::BuildGraphicsPipeline(std::string id) {
 	GraphicsPipelineBuilder::BuildFunction buildFunc = std::bind(&Renderer::FinalizeGraphicsPipelineBuild, this, std::placeholders::_1);
 	GraphicsPipelineBuilder builder = GraphicsPipelineBuilder(id, buildFunc);
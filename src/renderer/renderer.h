@@ -5,13 +5,20 @@
 #include <vector>
 #include "renderer_types.h"
 #include <concepts>
+#include <filesystem>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <type_traits>
 #include <string>
 
 #include "root_constant_value.h"
+#include "memory/allocation_telemetry.h"
 #include "shader_types.h"
+#include "pipeline_state.h"
+#include "resource_barrier_batcher.h"
+#include "command_list_pool.h"
+#include "queue_scheduler_d3d12.h"
 #include "ninmath/ninmath.h"
 
 class Resource;
@@ -40,6 +47,8 @@ struct RendererConfig {
 class MemoryAllocator;
 class DescriptorAllocator;
 class ShaderCompiler;
+class ShaderFileWatcher;
+class WorkStealingScheduler;
 class PipelineAssembler;
 
 class GraphicsPipelineBuilder;
@@ -82,12 +91,48 @@ public:
     std::shared_ptr<T> InitializeSamplerDescriptorAllocator(_Types&&... args);
 
     winrt::com_ptr<ID3D12GraphicsCommandList> StartCommandList(HRESULT& hr);
-    void FinishCommandList(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, HRESULT& hr);
+    // accesses are the frame's reads and writes of resources added to GetQueueScheduler(), so it waits for
+    // the compute work they depend on. Its fence value also covers all compute work submitted before.
+    void FinishCommandList(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, HRESULT& hr,
+                           const std::vector<GPUQueueAccess>& accesses = {});
+
+    // Compute-only work (LUTs, noise, ...) for the async compute queue, recorded between StartCommandList
+    // and FinishCommandList. It's submitted on FinishComputeCommandList, ahead of the frame's direct queue
+    // work, so it can run while the GPU is still busy with the previous frame. accesses decide which
+    // direct queue work it waits for and which waits for it (QueueScheduler). Compute lists can't draw.
+    winrt::com_ptr<ID3D12GraphicsCommandList> StartComputeCommandList(HRESULT& hr);
+    void FinishComputeCommandList(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList,
+                                  const std::vector<GPUQueueAccess>& accesses, HRESULT& hr);
+
+    // orders the direct and the compute queue, add the resources both use here
+    QueueScheduler& GetQueueScheduler() { return *queueScheduler_; }
+
+    // barriers of a command list of this frame, ExecutePipeline flushes them before drawing/dispatching,
+    // anything else that records commands using the resources has to call FlushBarriers first
+    ResourceBarrierBatcher& GetBarrierBatcher(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList);
+    void FlushBarriers(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList);
+
+    // records into the command list it gets, on a worker of the task scheduler
+    typedef std::function<void(winrt::com_ptr<ID3D12GraphicsCommandList>)> RecordJob;
+
+    // Records every job into a command list of its own, in parallel, and waits for all of them.
+    // The frame runs cmdList up to this call, then the jobs' lists in job order (so jobs have to be
+    // in dependency order), then the returned list: cmdList is closed, keep recording into the
+    // returned one. FinishCommandList submits them all with one ExecuteCommandLists.
+    //
+    // Jobs don't track resource states, ExecutePipeline doesn't transition render targets in them.
+    // Resources have to be in the right state already or the job records the barriers itself,
+    // FrameGraph's parallel recording does that (frame_graph_d3d12.h). A render target group drawn
+    // by several jobs is cleared by whichever records first, and jobs must not reconfigure a
+    // pipeline another job uses.
+    winrt::com_ptr<ID3D12GraphicsCommandList> RecordParallel(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList,
+                                                             std::vector<RecordJob> jobs, HRESULT& hr);
 
     // was this renderer able to instantiate all needed variables?
     // (able to find a valid adapter, create device, etc.)
 
-    // Checks registered shaders for file changes,
+    // Checks registered shaders (and everything they include) for file changes,
+    // recompiles the changed ones and reassembles the pipelines using them
     //
     void Tick(double deltaTime);
 
@@ -96,8 +141,9 @@ public:
 
     winrt::com_ptr<ID3D12Device> GetDevice() const { return device_; }
 
-    void ExecutePipeline(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::shared_ptr<PipelineState> pso);
-    void ExecuteGraphicsPipeline(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::shared_ptr<PipelineState> pso, uint32_t numInstances);
+    // false if the pipeline wasn't recorded (still assembling, failed to, or its resources aren't ready)
+    bool ExecutePipeline(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::shared_ptr<PipelineState> pso);
+    bool ExecuteGraphicsPipeline(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::shared_ptr<PipelineState> pso, uint32_t numInstances);
 
 
     const RootConstantValue<ninmath::Vector2f>& GetScreenSizeRootConstantValue() const { return screenSizeRCV_; }
@@ -110,6 +156,10 @@ public:
     std::shared_ptr<RenderTarget> CreateRenderTarget(ResourceID id, DXGI_FORMAT format, bool useAsUAV, D3D12_RESOURCE_STATES state);
 
     std::shared_ptr<RenderTarget> GetCurrentSwapChainBufferResource() const;
+
+    // where GPU memory and descriptors went, per allocator and per resource
+    AllocationTelemetrySnapshot GetAllocationTelemetry() const;
+    bool DumpAllocationTelemetry(const std::filesystem::path& path) const;
     
 private:
     Renderer(HWND hwnd, RendererConfig config, HRESULT& hr);
@@ -126,6 +176,17 @@ private:
 
     void PrepareGraphicsPipelineRenderTargets(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList, std::shared_ptr<GraphicsPipelineState> pso);
 
+    // descriptor heaps, scissor and viewport (not on compute lists), every list of a frame starts with them
+    void SetDefaultCommandListState(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList);
+
+    // pooled lists with the jobs recorded and closed, in job order
+    std::vector<CommandListPool::Entry*> RecordJobs(std::vector<RecordJob>& jobs, HRESULT& hr);
+
+    void UpdateShaderHotReload(double deltaTime);
+    void FreeDescriptors(const PipelineState::State& state, uint64_t fenceValue);
+    void ReloadShaders(const std::set<std::string>& shaderIds);
+    void PinPipelineShaders(const PipelineState& pso);
+
 
     uint32_t clientWidth_;
     uint32_t clientHeight_;
@@ -136,6 +197,24 @@ private:
     winrt::com_ptr<ID3D12GraphicsCommandList> cmdList_;
     std::vector<winrt::com_ptr<ID3D12CommandAllocator>> cmdAllocators_;
     bool cmdListActive_;
+    ResourceBarrierBatcher barrierBatcher_;
+
+    // lists recorded by RecordParallel and the ones that continue the frame after it
+    std::unique_ptr<CommandListPool> cmdListPool_;
+    winrt::com_ptr<ID3D12GraphicsCommandList> activeCmdList_;      // the one the application records into
+    std::vector<winrt::com_ptr<ID3D12GraphicsCommandList>> frameCmdLists_; // closed already, in submission order
+    
+    // async compute, its allocators are reset with the direct ones (FinishCommandList joins the queues)
+    winrt::com_ptr<ID3D12CommandQueue> cmdComputeQueue_;
+    winrt::com_ptr<ID3D12GraphicsCommandList> cmdComputeList_;
+    std::vector<winrt::com_ptr<ID3D12CommandAllocator>> cmdComputeAllocators_;
+    bool cmdComputeListActive_;
+    ResourceBarrierBatcher computeBarrierBatcher_;
+    winrt::com_ptr<ID3D12Fence> computeFence_;
+
+    // hands out the fence values of both queues
+    std::unique_ptr<D3D12GPUQueues> gpuQueues_;
+    std::unique_ptr<QueueScheduler> queueScheduler_;
     
     winrt::com_ptr<ID3D12CommandQueue> cmdCopyQueue_;
     winrt::com_ptr<ID3D12GraphicsCommandList> cmdCopyList_;
@@ -158,11 +237,39 @@ private:
     std::shared_ptr<DescriptorAllocator> renderTargetDescriptorAllocator_;
     std::shared_ptr<DescriptorAllocator> depthStencilDescriptorAllocator_;
     
+    // shared by the shader compiler and the pipeline assembler, so pipeline assembly can depend on shader compilation
+    std::shared_ptr<WorkStealingScheduler> taskScheduler_;
     std::shared_ptr<ShaderCompiler> shaderCompiler_;
     std::shared_ptr<PipelineAssembler> pipelineAssembler_;
     
     std::map<std::string, std::shared_ptr<PipelineState>> psoMap_;
     std::map<std::string, std::shared_ptr<Shader>> shaderMap_;
+
+    // shader hot reloading
+    struct PipelineReload {
+        std::shared_ptr<PipelineState> pso;  // keeps rendering until copy is ready and ok
+        std::shared_ptr<PipelineState> copy; // assembled in the background with the recompiled shaders
+
+        // shaders of both, a replaced shader has to outlive any assembly still reading it
+        std::vector<std::shared_ptr<Shader>> shaders;
+    };
+
+    struct RetiredPipelineState {
+        uint64_t fenceValue; // the GPU may use the state until this value is signaled
+        std::shared_future<PipelineState::State> state;
+    };
+
+    std::unique_ptr<ShaderFileWatcher> shaderFileWatcher_;
+    std::map<std::string, std::weak_ptr<Shader>> watchedShaders_;
+    std::set<std::string> dirtyShaders_;
+    std::vector<PipelineReload> pipelineReloads_;
+
+    // What each hot reloaded pipeline's live state was assembled from. The pipeline only holds weak
+    // references and a recompiled shader replaces the previous one in shaderMap_, so without these a
+    // failed reload would leave the pipeline pointing at freed shaders. Replaced once a reload is adopted.
+    std::map<std::string, std::vector<std::shared_ptr<Shader>>> pipelineShaders_;
+    std::vector<RetiredPipelineState> retiredPipelineStates_;
+    double shaderPollTimer_;
     std::unordered_map<ResourceID, std::shared_ptr<RenderTargetHandle>> renderTargetMap_;
     std::unordered_map<ResourceID, std::shared_ptr<DepthStencilTargetHandle>> depthStencilTargetMap_;
 
@@ -175,6 +282,7 @@ private:
                        std::vector<std::weak_ptr<class DescriptorHeapAllocation>>> depthBufferAllocMap_;
 
     std::set<RenderTargetGroupID> curFrameRenderTargetsReset_;
+    std::mutex renderTargetsResetMutex_; // parallel jobs clear render targets too
     
     // TODO: custom non-render target resource (e.g. UAV) where there's 1 allocation per swap chain buffer
 
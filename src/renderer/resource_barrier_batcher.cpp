@@ -0,0 +1,54 @@
+﻿#include "resource_barrier_batcher.h"
+
+#include <cassert>
+
+void ResourceBarrierBatcher::Transition(ID3D12Resource* res, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) {
+    assert(res);
+    pending_.Transition(res, before, after);
+}
+
+void ResourceBarrierBatcher::UAV(ID3D12Resource* res) {
+    assert(res);
+    pending_.UAV(res);
+}
+
+void ResourceBarrierBatcher::BeginSplitTransition(ID3D12Resource* res, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) {
+    assert(res);
+    pending_.BeginSplitTransition(res, before, after);
+}
+
+void ResourceBarrierBatcher::EndSplitTransition(ID3D12Resource* res) {
+    pending_.EndSplitTransition(res);
+}
+
+void ResourceBarrierBatcher::Flush(ID3D12GraphicsCommandList* cmdList) {
+    typedef PendingBarrierList<ID3D12Resource*, D3D12_RESOURCE_STATES>::Barrier Barrier;
+
+    const std::vector<Barrier>& barriers = pending_.Flush();
+    if(barriers.empty()) {
+        return;
+    }
+
+    issued_.clear();
+    for(const Barrier& barrier : barriers) {
+        D3D12_RESOURCE_BARRIER d3dBarrier = {};
+        if(barrier.type == Barrier::Type::UAV) {
+            d3dBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+            d3dBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+            d3dBarrier.UAV.pResource = barrier.res;
+        }
+        else {
+            d3dBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            d3dBarrier.Flags = barrier.split == Barrier::Split::Begin ? D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY :
+                               barrier.split == Barrier::Split::End ? D3D12_RESOURCE_BARRIER_FLAG_END_ONLY :
+                                                                      D3D12_RESOURCE_BARRIER_FLAG_NONE;
+            d3dBarrier.Transition.pResource = barrier.res;
+            d3dBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            d3dBarrier.Transition.StateBefore = barrier.before;
+            d3dBarrier.Transition.StateAfter = barrier.after;
+        }
+        issued_.push_back(d3dBarrier);
+    }
+
+    cmdList->ResourceBarrier((UINT)issued_.size(), issued_.data());
+}
@@ -0,0 +1,49 @@
+﻿#ifndef RENDERER_RESOURCE_BARRIER_BATCHER_H_
+#define RENDERER_RESOURCE_BARRIER_BATCHER_H_
+
+#include <vector>
+
+#include "directx/d3dx12_core.h"
+#include "pending_barrier_list.h"
+
+//
+// Collects the barriers of a command list and issues them in one ResourceBarrier call
+// right before the next command that depends on them (Flush).
+//
+// Until then transitions are merged: a resource that already has one pending only gets its
+// end state updated, and A -> B -> A cancels out. UAV barriers of resources with a pending
+// transition are dropped on flush, the transition orders the accesses already.
+//
+// Split transitions let the GPU work on the transition while independent commands run:
+// BeginSplitTransition goes out with the next flush as BEGIN_ONLY, EndSplitTransition queues
+// the END_ONLY half. The resource can't be used in between. If nothing was flushed since
+// the begin, both halves turn into one plain transition.
+//
+// Resource::ChangeState(newState, ResourceBarrierBatcher&) and friends keep the tracked
+// resource state in sync, those are what callers normally use. The bookkeeping is in
+// PendingBarrierList (pending_barrier_list.h), this only turns its barriers into D3D12 ones.
+//
+class ResourceBarrierBatcher {
+public:
+    typedef PendingBarrierList<ID3D12Resource*, D3D12_RESOURCE_STATES>::Stats Stats;
+
+    void Transition(ID3D12Resource* res, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after);
+    void UAV(ID3D12Resource* res);
+
+    void BeginSplitTransition(ID3D12Resource* res, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after);
+    void EndSplitTransition(ID3D12Resource* res);
+
+    void Flush(ID3D12GraphicsCommandList* cmdList);
+
+    bool HasPendingBarriers() const { return pending_.HasPendingBarriers(); }
+    bool HasOpenSplitTransitions() const { return pending_.HasOpenSplitTransitions(); }
+
+    const Stats& GetStats() const { return pending_.GetStats(); }
+    void ResetStats() { pending_.ResetStats(); }
+
+private:
+    PendingBarrierList<ID3D12Resource*, D3D12_RESOURCE_STATES> pending_;
+    std::vector<D3D12_RESOURCE_BARRIER> issued_; // kept around so flushing doesn't allocate
+};
+
+#endif // RENDERER_RESOURCE_BARRIER_BATCHER_H_
@@ -6,6 +6,14 @@
 #include "windows.h"
 #include "wincodec.h"
 
+namespace {
+    void EnsureCOMInitialized() {
+        // once per thread, S_FALSE if the thread already joined the multithreaded apartment
+        thread_local const HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        WINRT_ASSERT(SUCCEEDED(hr) || hr == RPC_E_CHANGED_MODE);
+    }
+}
+
 winrt::com_ptr<ID3D12Resource> Resource::GetNativeResource() {
     // UpdateNativeResource();
     // resource should not be null when updated
@@ -59,6 +67,20 @@ void Resource::ChangeStateDirect(D3D12_RESOURCE_STATES newState, winrt::com_ptr<
     }
 }
 
+void Resource::ChangeState(D3D12_RESOURCE_STATES newState, ResourceBarrierBatcher& batcher) {
+    batcher.Transition(res_.get(), state_, newState);
+    state_ = newState;
+}
+
+void Resource::BeginSplitStateChange(D3D12_RESOURCE_STATES newState, ResourceBarrierBatcher& batcher) {
+    batcher.BeginSplitTransition(res_.get(), state_, newState);
+    state_ = newState;
+}
+
+void Resource::EndSplitStateChange(ResourceBarrierBatcher& batcher) {
+    batcher.EndSplitTransition(res_.get());
+}
+
 Texture2D::Texture2D(DXGI_FORMAT format, uint32_t width, uint32_t height, bool useAsUAV, D3D12_RESOURCE_STATES initialState)
     : format_(format), width_(width), height_(height), useAsUAV_(useAsUAV), useAsRenderTarget_(false) {
     
@@ -139,9 +161,10 @@ ImageTexture2D::ImageTexture2D(std::string filePath)
     useAsRenderTarget_ = false;
 }
 
-void ImageTexture2D::HandleUpload(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) {
-    winrt::check_pointer(uploadRes_.get());
-    
+void ImageTexture2D::PrepareUpload() {
+    // runs on a worker thread, WIC needs COM there as well
+    EnsureCOMInitialized();
+
     HRESULT hr;
 
     // load image to memory
@@ -158,32 +181,17 @@ void ImageTexture2D::HandleUpload(winrt::com_ptr<ID3D12GraphicsCommandList> cmdL
     WICPixelFormatGUID finalPixelFmt;
     
     // Aside: memcpy_s is the more secure version, and WICPixelFormatGUID == GUID, constants are GUID hence the type difference
-    // memcpy_s(&finalPixelFmt, sizeof(WICPixelFormatGUID), &pixelFormat, sizeof(GUID));
     memcpy_s(&finalPixelFmt, sizeof(WICPixelFormatGUID), &GUID_WICPixelFormat32bppRGBA, sizeof(GUID));
-    // memcpy_s(&finalPixelFmt, sizeof(WICPixelFormatGUID), &GUID_WICPixelFormat128bppRGBAFloat, sizeof(GUID));
 
     // resolve size
     // adding 7 dividing 8 => rounds up for a valid byte count
-    uint32_t rowPitch = (width_ * bpp + 7u) / 8u;
-    uint32_t cbStride = ((bpp * width_ + 31) >> 3) & 0xFFFFFFFC;
-    uint32_t b = GetBitsPerPixel(pixelFormat);
-
-    std::cout << cbStride << " -- " << b << std::endl;
-    
-    uint32_t totalBytes = rowPitch * height_;
+    const uint32_t rowPitch = (width_ * bpp + 7u) / 8u;
+    const uint32_t totalBytes = rowPitch * height_;
 
     // prepare srcData container, receiving the data
     srcData_.resize(totalBytes);
 
-    D3D12_RANGE readRange = {0, 0};
-    hr = uploadRes_->Map(0, &readRange, &uploadSrc_);
-    winrt::check_hresult(hr);
-    
-    D3D12_RESOURCE_DESC uploadDesc = uploadRes_->GetDesc();
-    assert(totalBytes <= uploadDesc.Height * uploadDesc.Width);
-
     // (For now) only support RGBA32
-    // if(memcmp(&pixelFormat, &finalPixelFmt, sizeof(GUID)) != 0) {
     if(!IsEqualGUID(pixelFormat, finalPixelFmt)) {
         // convert
         winrt::com_ptr<IWICImagingFactory> imgFactory = winrt::create_instance<IWICImagingFactory>(CLSID_WICImagingFactory);
@@ -200,32 +208,22 @@ void ImageTexture2D::HandleUpload(winrt::com_ptr<ID3D12GraphicsCommandList> cmdL
         hr = converter->Initialize(frame.get(), finalPixelFmt, WICBitmapDitherTypeErrorDiffusion, NULL, 0, WICBitmapPaletteTypeMedianCut);
         CHECK_HR(hr);
 
-        hr = converter->CopyPixels(NULL, rowPitch, totalBytes, static_cast<unsigned char*>(uploadSrc_));
+        hr = converter->CopyPixels(NULL, rowPitch, totalBytes, srcData_.data());
         CHECK_HR(hr);
     }
     else {
-        hr = frame->CopyPixels(NULL, rowPitch, totalBytes, static_cast<unsigned char*>(uploadSrc_));
+        hr = frame->CopyPixels(NULL, rowPitch, totalBytes, srcData_.data());
         CHECK_HR(hr);
     }
+}
 
-    // issue copy command
-    winrt::com_ptr<ID3D12Device> device;
-    hr = res_->GetDevice(__uuidof(ID3D12Device), device.put_void());
-    CHECK_HR(hr);
-
-    // use the destination's layout, ie interpret our buffer of raw bytes as a resource with
-    // destination's Width, Height, etc. - for an accurate copy
-    D3D12_PLACED_SUBRESOURCE_FOOTPRINT dstPlacedFootprint;
-    D3D12_RESOURCE_DESC resDesc = res_->GetDesc();
-    device->GetCopyableFootprints(&resDesc, 0, 1, 0, &dstPlacedFootprint, NULL, NULL, NULL);
-    
-    CD3DX12_TEXTURE_COPY_LOCATION dstLoc = CD3DX12_TEXTURE_COPY_LOCATION(res_.get(), 0);
-    CD3DX12_TEXTURE_COPY_LOCATION srcLoc = CD3DX12_TEXTURE_COPY_LOCATION(uploadRes_.get(), dstPlacedFootprint);
-    cmdList->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, NULL);
-} 
+std::vector<UploadSubresourceData> ImageTexture2D::GetUploadData() const {
+    const uint64_t rowPitch = srcData_.size() / height_;
+    return { UploadSubresourceData{ .data = srcData_.data(), .rowPitch = rowPitch, .slicePitch = srcData_.size() } };
+}
 
-void ImageTexture2D::SetUploadResource(winrt::com_ptr<ID3D12Resource> res) {
-    uploadRes_ = res;
+void ImageTexture2D::FinishUpload() {
+    srcData_ = std::vector<uint8_t>();
 }
 
 winrt::com_ptr<IWICBitmapFrameDecode> ImageTexture2D::GetWICFrame() const {
@@ -290,10 +288,6 @@ uint32_t ImageTexture2D::GetBitsPerPixel(const GUID& guid) const {
     return bpp;
 }
 
-void ImageTexture2D::FreeSourceData() {
-
-}
-
 RenderTarget::RenderTarget(winrt::com_ptr<ID3D12Resource> res, D3D12_RESOURCE_STATES initState) {
     res_ = res;
     state_ = initState;
@@ -388,19 +382,8 @@ bool Buffer::CreateConstantBufferViewImplementation(D3D12_CPU_DESCRIPTOR_HANDLE
 }
 
 
-void StaticBuffer::HandleUpload(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) {
-    winrt::check_pointer(uploadRes_.get());
-
-    const void* srcData = GetSourceData();
-    const uint64_t srcSizeInBytes = GetSizeInBytes();
-
-    D3D12_RANGE readRange = {0, 0};
-    void* mappedData;
-    uploadRes_->Map(0, &readRange, &mappedData);
-    memcpy(mappedData, GetSourceData(), srcSizeInBytes);
-    uploadRes_->Unmap(0, nullptr);
-
-    cmdList->CopyBufferRegion(res_.get(), 0, uploadRes_.get(), 0, srcSizeInBytes);
+std::vector<UploadSubresourceData> StaticBuffer::GetUploadData() const {
+    return { UploadSubresourceData{ .data = GetSourceData(), .rowPitch = GetSizeInBytes(), .slicePitch = GetSizeInBytes() } };
 }
 
 
@@ -413,7 +396,43 @@ void DynamicBufferBase::HandleDynamicUpload() {
     memcpy(dynamicResMappedPtr_, GetSourceData(), GetSizeInBytes());
 }
 
+D3D12_GPU_VIRTUAL_ADDRESS DynamicBufferBase::GetGPUVirtualAddress() const {
+    if(!uploadRing_) {
+        return Resource::GetGPUVirtualAddress();
+    }
+
+    // recording can run on worker threads, the memory allocator's BeginFrame() carried the data over
+    WINRT_ASSERT(IsUploadedThisFrame() && "Ring buffer bound before the memory allocator's BeginFrame().");
+    return uploadAllocation_.gpuAddress;
+}
+
+bool DynamicBufferBase::IsUploadedThisFrame() const {
+    return uploadFrameIndex_ == uploadRing_->GetFrameIndex() && uploadAllocation_.IsValid();
+}
+
+bool DynamicBufferBase::UploadToRing() {
+    // a full ring isn't retried until the next frame, binding must not touch the ring
+    uploadFrameIndex_ = uploadRing_->GetFrameIndex();
+
+    const UploadAllocation allocation = uploadRing_->Allocate(uploadData_.size());
+    if(!allocation.IsValid()) {
+        std::cout << "Upload ring buffer is full (" << uploadRing_->GetUsedSize() << " bytes in flight), keeping the previous data" << std::endl;
+        return false;
+    }
+
+    memcpy(allocation.cpuAddress, uploadData_.data(), uploadData_.size());
+    uploadAllocation_ = allocation;
+    return true;
+}
+
 void DynamicBufferBase::UpdateGPUData() {
+    if(uploadRing_) {
+        const uint8_t* sourceData = static_cast<const uint8_t*>(GetSourceData());
+        uploadData_.assign(sourceData, sourceData + GetSizeInBytes());
+        UploadToRing();
+        return;
+    }
+
     // call the callback (should have been set when this resource was made)
     //
     // This makes sure we have an up to date native resource, and a valid mapped pointer
@@ -511,3 +530,25 @@ bool Texture3D::CreateUnorderedAccessViewImplementation(D3D12_CPU_DESCRIPTOR_HAN
 
     return true;
 }
+
+StaticTexture3D::StaticTexture3D(DXGI_FORMAT format, uint32_t width, uint32_t height, uint32_t depth, bool useAsUAV,
+    D3D12_RESOURCE_STATES initialState, std::vector<MipData> mips, std::shared_ptr<const void> dataOwner)
+: Texture3D(format, width, height, depth, useAsUAV, (uint32_t) mips.size(), initialState),
+  mips_(std::move(mips)), dataOwner_(std::move(dataOwner)) {
+    
+    WINRT_ASSERT(!mips_.empty());
+}
+
+std::vector<UploadSubresourceData> StaticTexture3D::GetUploadData() const {
+    std::vector<UploadSubresourceData> data;
+    for(const MipData& mip : mips_) {
+        data.push_back({ .data = mip.data, .rowPitch = mip.rowPitch, .slicePitch = mip.slicePitch });
+    }
+    return data;
+}
+
+void StaticTexture3D::FinishUpload() {
+    // everything is staged now, the source (file mapping) can go
+    mips_.clear();
+    dataOwner_.reset();
+}
@@ -7,6 +7,8 @@
 #include "renderer_types.h"
 #include "wincodec.h"
 #include "shader_types.h"
+#include "memory/upload_ring_buffer.h"
+#include "resource_barrier_batcher.h"
 
 class Resource;
 struct DescriptorConfiguration;
@@ -39,6 +41,14 @@ struct DescriptorConfiguration {
     DescriptorConfigType configType; 
 };
 
+// CPU side data of one subresource (or a whole buffer), handed to the memory allocator for uploading.
+// Only the destination's row size is read per row, source rows and slices may be padded.
+struct UploadSubresourceData {
+    const void* data;
+    uint64_t rowPitch;
+    uint64_t slicePitch;
+};
+
 class Resource {
 public:
     virtual ~Resource() {};
@@ -51,6 +61,9 @@ public:
     winrt::com_ptr<ID3D12Resource> GetNativeResource();
     D3D12_RESOURCE_STATES GetResourceState() const { return state_; }
 
+    // where root descriptors point to, not necessarily the native resource (see DynamicBufferBase)
+    virtual D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress() const { return res_->GetGPUVirtualAddress(); }
+
     // needed for a memory allocator to create the native resource
     virtual D3D12_RESOURCE_DESC CreateResourceDesc() const = 0;
 
@@ -75,12 +88,30 @@ public:
 
     virtual bool IsUploadNeeded() const { return false; };
     virtual bool IsDynamic() const { return false; }
-    virtual void HandleUpload(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) { assert(false); };
+
+    // Uploads are staged by the memory allocator. PrepareUpload() runs on a worker thread and gets the
+    // data ready (e.g. decodes an image), GetUploadData() is copied over in chunks, possibly over several
+    // frames, and FinishUpload() is called once all of it is staged so the source can be freed.
+    virtual void PrepareUpload() {}
+    virtual std::vector<UploadSubresourceData> GetUploadData() const { assert(false); return {}; }
+    virtual void FinishUpload() {}
+
     virtual void HandleDynamicUpload() { assert(false); };
     virtual bool GetOptimizedClearValue(D3D12_CLEAR_VALUE& clearVal) const { return false; };
     void ChangeState(D3D12_RESOURCE_STATES newState, std::vector<D3D12_RESOURCE_BARRIER>& barriers);
+    // issues its own ResourceBarrier call right away, the batcher overload below is usually better
     void ChangeStateDirect(D3D12_RESOURCE_STATES newState, winrt::com_ptr<ID3D12GraphicsCommandList> cmdList);
 
+    // queued, the batcher issues it with the next flush (see ResourceBarrierBatcher)
+    void ChangeState(D3D12_RESOURCE_STATES newState, ResourceBarrierBatcher& batcher);
+
+    // the state is newState from the begin on, but the resource can't be used until the end
+    void BeginSplitStateChange(D3D12_RESOURCE_STATES newState, ResourceBarrierBatcher& batcher);
+    void EndSplitStateChange(ResourceBarrierBatcher& batcher);
+
+    // for barriers recorded without ChangeState (FrameGraph's parallel recording)
+    void SetResourceState(D3D12_RESOURCE_STATES state) { state_ = state; }
+
     void SetNativeResource(winrt::com_ptr<ID3D12Resource> res) { res_ = res; }
     void SetIsReady(bool val) { isReady_ = val; }
 
@@ -100,7 +131,6 @@ protected:
     
     friend class MemoryAllocator;
     friend class StaticMemoryAllocator;
-    virtual void SetUploadResource(winrt::com_ptr<ID3D12Resource> res) { assert(false); }
     
     winrt::com_ptr<ID3D12Resource> res_;
     D3D12_RESOURCE_STATES state_;
@@ -141,18 +171,16 @@ class ImageTexture2D : public Texture2D {
 public:
     ImageTexture2D(std::string filePath);
     bool IsUploadNeeded() const override { return true; }
-    virtual void HandleUpload(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList);
-    virtual void SetUploadResource(winrt::com_ptr<ID3D12Resource> res);
+    void PrepareUpload() override;
+    std::vector<UploadSubresourceData> GetUploadData() const override;
+    void FinishUpload() override;
     winrt::com_ptr<IWICBitmapFrameDecode> GetWICFrame() const;
     uint32_t GetBitsPerPixel(REFGUID guid) const;
 
-    void FreeSourceData();
 private:
     
     std::string filePath_;
-    std::vector<uint8_t> srcData_;
-    void* uploadSrc_;
-    winrt::com_ptr<ID3D12Resource> uploadRes_;
+    std::vector<uint8_t> srcData_; // decoded RGBA8 pixels, only around while uploading
 };
 
 class RenderTarget : public Texture2D {
@@ -213,17 +241,24 @@ class StaticBuffer : public Buffer {
 public:
 
     bool IsUploadNeeded() const override { return true; }
-    virtual void HandleUpload(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList);
-    virtual void SetUploadResource(winrt::com_ptr<ID3D12Resource> res) { uploadRes_ = res; }
+    std::vector<UploadSubresourceData> GetUploadData() const override;
     
 protected:
     StaticBuffer() = default;
-    
-private:
-    winrt::com_ptr<ID3D12Resource> uploadRes_;
 };
 
 
+//
+// Buffers the CPU rewrites every now and then.
+//
+// Constant buffers (UsesUploadRing()) don't get a resource of their own: every UpdateGPUData()
+// copies the data into a fresh slice of the memory allocator's UploadRingBuffer, so frames
+// in flight keep reading what they were recorded with. Frames that don't update the buffer
+// get the last data copied into their own slice by the memory allocator's BeginFrame(), on
+// the main thread, so GetGPUVirtualAddress() doesn't write anything and can be called while
+// recording on worker threads. Their address changes from frame to frame, they can only be
+// bound as root descriptors.
+//
 class DynamicBufferBase : public Buffer {
 public:
     DynamicBufferBase(uint32_t resourceSizeInBytes)
@@ -233,13 +268,29 @@ public:
     bool IsUploadNeeded() const override { return false; }
     bool IsDynamic() const override { return true; }
     void HandleDynamicUpload() override;
+    D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress() const override;
     
     void UpdateGPUData();
+
+    virtual bool UsesUploadRing() const { return false; }
     
 protected:
     DynamicBufferBase() = default;
     
     uint32_t resourceSizeInBytes_;
+
+private:
+    friend class StaticMemoryAllocator;
+
+    // false if the ring is full, the GPU keeps reading the previous allocation for the rest of the frame then
+    bool UploadToRing();
+    bool IsUploadedThisFrame() const;
+
+    // set by the memory allocator for buffers that use the upload ring
+    std::shared_ptr<UploadRingBuffer> uploadRing_;
+    std::vector<uint8_t> uploadData_; // copy of the last UpdateGPUData()
+    UploadAllocation uploadAllocation_;
+    uint64_t uploadFrameIndex_ = 0; // the ring frame the last upload was for, whether it fit or not
 };
 
 
@@ -310,6 +361,8 @@ public:
         resourceSizeInBytes_ = sizeof(T);
     }
 
+    bool UsesUploadRing() const override { return true; }
+
 protected:
     const void* GetSourceData() const override {
         return static_cast<const void*>(&source_);
@@ -449,4 +502,32 @@ protected:
     bool useAsUAV_;
     
 };
+
+// Texture3D filled from CPU memory (e.g. a memory mapped noise volume cache).
+// Source data is only read while uploading, dataOwner keeps it alive until then.
+class StaticTexture3D : public Texture3D {
+public:
+    struct MipData {
+        const void* data;
+        uint64_t rowPitch;
+        uint64_t slicePitch;
+    };
+
+    StaticTexture3D(DXGI_FORMAT format,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t depth,
+                    bool useAsUAV,
+                    D3D12_RESOURCE_STATES initialState,
+                    std::vector<MipData> mips,
+                    std::shared_ptr<const void> dataOwner);
+
+    bool IsUploadNeeded() const override { return true; }
+    std::vector<UploadSubresourceData> GetUploadData() const override;
+    void FinishUpload() override;
+
+private:
+    std::vector<MipData> mips_;
+    std::shared_ptr<const void> dataOwner_;
+};
 #endif // RENDERER_RESOURCES_H_
@@ -0,0 +1,119 @@
+﻿#include "root_signature_cache.h"
+
+#include <cstring>
+
+#include "ninmath/hash.h"
+
+RootSignatureCache::RootSignatureCache(winrt::com_ptr<ID3D12Device> device)
+    : device_(std::move(device)), numHits_(0) {
+}
+
+uint32_t RootSignatureCache::GetNumRootSignatures() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    uint32_t num = 0;
+    for(const auto& [key, entries] : entries_) {
+        num += (uint32_t)entries.size();
+    }
+    return num;
+}
+
+std::shared_ptr<const CachedRootSignature> RootSignatureCache::GetOrCreate(const void* blob, size_t size) {
+    const uint64_t key = ninmath::hash::Fnv1a64(blob, size);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_ptr<const CachedRootSignature> entry = Find(key, blob, size);
+        if(entry) {
+            numHits_.fetch_add(1);
+            return entry;
+        }
+    }
+
+    // created without holding the lock, other assembly tasks keep going meanwhile
+    std::shared_ptr<CachedRootSignature> created = Create(blob, size);
+    created->blobHash = key;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // another task could've created the same one in the meantime, everyone uses the first
+    std::shared_ptr<const CachedRootSignature> entry = Find(key, blob, size);
+    if(entry) {
+        numHits_.fetch_add(1);
+        return entry;
+    }
+
+    entries_[key].push_back(created);
+    return created;
+}
+
+std::shared_ptr<const CachedRootSignature> RootSignatureCache::Find(uint64_t key, const void* blob, size_t size) const {
+    const auto it = entries_.find(key);
+    if(it == entries_.end()) {
+        return nullptr;
+    }
+
+    for(const std::shared_ptr<const CachedRootSignature>& entry : it->second) {
+        if(entry->blob.size() == size && memcmp(entry->blob.data(), blob, size) == 0) {
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<CachedRootSignature> RootSignatureCache::Create(const void* blob, size_t size) const {
+    std::shared_ptr<CachedRootSignature> entry = std::make_shared<CachedRootSignature>();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(blob);
+    entry->blob.assign(bytes, bytes + size);
+
+    HRESULT hr = device_->CreateRootSignature(0,
+                                              blob,
+                                              size,
+                                              __uuidof(ID3D12RootSignature),
+                                              entry->rootSignature.put_void());
+    winrt::check_hresult(hr);
+
+    hr = D3D12CreateRootSignatureDeserializer(blob,
+                                              size,
+                                              __uuidof(ID3D12RootSignatureDeserializer),
+                                              entry->deserializer.put_void());
+    winrt::check_hresult(hr);
+
+    entry->rootSigDesc = entry->deserializer->GetRootSignatureDesc();
+
+    ExtractDescriptorTables(entry->rootSigDesc, false, entry->resourceTables);
+    ExtractDescriptorTables(entry->rootSigDesc, true, entry->samplerTables);
+
+    return entry;
+}
+
+void RootSignatureCache::ExtractDescriptorTables(const D3D12_ROOT_SIGNATURE_DESC* rootSigDesc,
+                                                 bool samplerRanges,
+                                                 std::vector<DescriptorTableDescription>& outDescriptorTables) {
+    for(int i = 0; i < rootSigDesc->NumParameters; i++) {
+        const D3D12_ROOT_PARAMETER rootParam = rootSigDesc->pParameters[i];
+
+        if(rootParam.ParameterType != D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE) {
+            continue;
+        }
+
+        DescriptorTableDescription descriptorTable;
+        descriptorTable.paramIndex = i;
+
+        // drInd <==> descriptor range index
+        for(int drInd = 0; drInd < rootParam.DescriptorTable.NumDescriptorRanges; drInd++) {
+            const D3D12_DESCRIPTOR_RANGE drange = rootParam.DescriptorTable.pDescriptorRanges[drInd];
+            if((drange.RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER) != samplerRanges) {
+                continue;
+            }
+
+            descriptorTable.ranges.push_back(drange);
+        }
+
+        if(!descriptorTable.ranges.empty()) {
+            outDescriptorTables.push_back(descriptorTable);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+﻿#ifndef RENDERER_ROOT_SIGNATURE_CACHE_H_
+#define RENDERER_ROOT_SIGNATURE_CACHE_H_
+
+#include <d3d12.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "renderer_types.h"
+
+class DescriptorHeapAllocation;
+
+struct DescriptorTableDescription {
+    uint32_t paramIndex;
+    std::vector<D3D12_DESCRIPTOR_RANGE> ranges;
+
+    uint32_t GetTotalDescriptors() const {
+        uint32_t sum = 0;
+        for(const auto& r : ranges) {
+            sum += r.NumDescriptors;
+        }
+        return sum;
+    }
+
+    std::weak_ptr<DescriptorHeapAllocation> allocation;
+};
+
+//
+// A created root signature plus everything pipeline assembly parses out of it.
+// Immutable once it's in the cache, shared by every pipeline with the same blob.
+//
+struct CachedRootSignature {
+    winrt::com_ptr<ID3D12RootSignature> rootSignature;
+
+    // owns the memory rootSigDesc points to
+    winrt::com_ptr<ID3D12RootSignatureDeserializer> deserializer;
+    const D3D12_ROOT_SIGNATURE_DESC* rootSigDesc;
+
+    // descriptor table layouts without allocations, copy them before allocating
+    std::vector<DescriptorTableDescription> resourceTables; // SRV/CBV/UAV ranges
+    std::vector<DescriptorTableDescription> samplerTables;
+
+    std::vector<uint8_t> blob;
+    uint64_t blobHash;
+};
+
+//
+// Root signatures by the hash of their serialized blob. Different pipelines often end up
+// with identical root signatures (e.g. small compute passes with one UAV/SRV table),
+// those share one ID3D12RootSignature and skip creating and parsing it again.
+// Safe to use from multiple assembly tasks at once.
+//
+class RootSignatureCache {
+public:
+    RootSignatureCache(winrt::com_ptr<ID3D12Device> device);
+
+    std::shared_ptr<const CachedRootSignature> GetOrCreate(const void* blob, size_t size);
+
+    uint32_t GetNumHits() const { return numHits_.load(); }
+    uint32_t GetNumRootSignatures() const;
+
+private:
+    std::shared_ptr<const CachedRootSignature> Find(uint64_t key, const void* blob, size_t size) const;
+    std::shared_ptr<CachedRootSignature> Create(const void* blob, size_t size) const;
+
+    static void ExtractDescriptorTables(const D3D12_ROOT_SIGNATURE_DESC* rootSigDesc,
+                                        bool samplerRanges,
+                                        std::vector<DescriptorTableDescription>& outDescriptorTables);
+
+    winrt::com_ptr<ID3D12Device> device_;
+
+    mutable std::mutex mutex_;
+    // a vector per key, in the unlikely case two blobs collide
+    std::unordered_map<uint64_t, std::vector<std::shared_ptr<const CachedRootSignature>>> entries_;
+    std::atomic<uint32_t> numHits_;
+};
+
+#endif // RENDERER_ROOT_SIGNATURE_CACHE_H_
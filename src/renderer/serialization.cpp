@@ -0,0 +1,68 @@
+﻿#include "serialization.h"
+
+#include <fstream>
+
+namespace serialization {
+
+    bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& outBytes) {
+        outBytes.clear();
+
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if(!in) {
+            return false;
+        }
+
+        const std::streamsize fileSize = in.tellg();
+        if(fileSize < 0) {
+            return false;
+        }
+
+        outBytes.resize((size_t)fileSize);
+        in.seekg(0);
+        if(!in.read(reinterpret_cast<char*>(outBytes.data()), fileSize)) {
+            outBytes.clear();
+            return false;
+        }
+        return true;
+    }
+
+    bool WriteFileAtomically(const std::filesystem::path& path, const std::function<void(std::ostream&)>& write) {
+        std::error_code ec;
+        if(path.has_parent_path()) {
+            std::filesystem::create_directories(path.parent_path(), ec);
+        }
+
+        std::filesystem::path tmpPath = path;
+        tmpPath += ".tmp";
+
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if(!out) {
+                return false;
+            }
+
+            write(out);
+
+            if(!out) {
+                out.close();
+                std::filesystem::remove(tmpPath, ec);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tmpPath, path, ec);
+        if(ec) {
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool WriteFileAtomically(const std::filesystem::path& path, const std::vector<uint8_t>& bytes) {
+        return WriteFileAtomically(path, [&bytes](std::ostream& out) {
+            out.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+        });
+    }
+
+} // namespace serialization
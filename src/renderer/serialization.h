@@ -0,0 +1,86 @@
+﻿#ifndef RENDERER_SERIALIZATION_H_
+#define RENDERER_SERIALIZATION_H_
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+//
+// Helpers shared by the on-disk caches (shader cache, pipeline library, noise volumes).
+// Everything is written in the machine's byte order, which is little endian on every
+// platform the caches are used on.
+//
+namespace serialization {
+
+    class ByteWriter {
+    public:
+        template <typename T>
+        void Write(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            WriteBytes(&value, sizeof(T));
+        }
+
+        void WriteBytes(const void* data, size_t size) {
+            if(size == 0) {
+                return;
+            }
+            const size_t offset = bytes_.size();
+            bytes_.resize(offset + size);
+            memcpy(bytes_.data() + offset, data, size);
+        }
+
+        const std::vector<uint8_t>& GetBytes() const { return bytes_; }
+
+    private:
+        std::vector<uint8_t> bytes_;
+    };
+
+    // every read is bounds checked, a truncated file just fails the load
+    class ByteReader {
+    public:
+        ByteReader(const uint8_t* data, size_t size) : data_(data), size_(size), offset_(0) {}
+
+        template <typename T>
+        bool Read(T& outValue) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            const uint8_t* bytes = ReadBytes(sizeof(T));
+            if(!bytes) {
+                return false;
+            }
+            memcpy(&outValue, bytes, sizeof(T));
+            return true;
+        }
+
+        // nullptr if fewer than size bytes are left
+        const uint8_t* ReadBytes(size_t size) {
+            if(size > size_ - offset_) {
+                return nullptr;
+            }
+            const uint8_t* bytes = data_ + offset_;
+            offset_ += size;
+            return bytes;
+        }
+
+        bool IsAtEnd() const { return offset_ == size_; }
+
+    private:
+        const uint8_t* data_;
+        size_t size_;
+        size_t offset_;
+    };
+
+    // the whole file, false if it's missing or can't be read
+    bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& outBytes);
+
+    // Writes to a temporary file next to path and renames it over path once everything is
+    // written, so a crash never leaves a half written file behind. Creates the missing directories.
+    bool WriteFileAtomically(const std::filesystem::path& path, const std::function<void(std::ostream&)>& write);
+    bool WriteFileAtomically(const std::filesystem::path& path, const std::vector<uint8_t>& bytes);
+
+} // namespace serialization
+
+#endif // RENDERER_SERIALIZATION_H_
@@ -1,14 +1,17 @@
 ﻿#ifndef RENDERER_SHADER_H_
 #define RENDERER_SHADER_H_
 
+#include <filesystem>
 #include <future>
 #include <string>
+#include <vector>
 #include "renderer_types.h"
 #include "shader_types.h"
 #include <set>
 #include <dxcapi.h>
 
 class ShaderCompiler;
+class GraphTask;
 
 
 class Shader {
@@ -51,6 +54,11 @@ public:
     future_(promise_.get_future().share())
     {}
 
+    virtual ~Shader() = default;
+
+    // uncompiled copy (same source, type and macros) for hot reloading
+    virtual std::shared_ptr<Shader> CreateReloadCopy() const = 0;
+
     const std::string& GetSourceFile() const { return sourceFile_; }
 
     bool IsReadyAndOk() const {
@@ -68,6 +76,23 @@ public:
     const Shader::State& GetState_Block() const {
         return future_.get();
     }
+
+    // task that resolves the state, null until the shader has been flushed by the compiler
+    const std::shared_ptr<GraphTask>& GetCompileTask() const { return compileTask_; }
+
+    // the source file and everything it includes (transitively), valid once the state is ready
+    const std::vector<std::filesystem::path>& GetDependencies() const { return dependencies_; }
+
+protected:
+    // copies what the shader is built from, not its compile state
+    Shader(const Shader& other)
+    :
+    sourceFile_(other.sourceFile_),
+    type_(other.type_),
+    future_(promise_.get_future().share()),
+    macros_(other.macros_)
+    {}
+
 private:
     std::string sourceFile_;
     ShaderType type_;
@@ -75,6 +100,8 @@ private:
     friend ShaderCompiler;
     std::promise<Shader::State> promise_;
     std::shared_future<Shader::State> future_;
+    std::shared_ptr<GraphTask> compileTask_;
+    std::vector<std::filesystem::path> dependencies_;
 
 protected:
     std::unordered_map<std::wstring, std::wstring> macros_;
@@ -85,6 +112,8 @@ public:
     VertexShader(std::string sourceFile)
         : Shader(sourceFile, ShaderType::Vertex)
     {}
+
+    std::shared_ptr<Shader> CreateReloadCopy() const override { return std::make_shared<VertexShader>(*this); }
     
 private:
 };
@@ -94,6 +123,8 @@ public:
     PixelShader(std::string sourceFile)
         : Shader(sourceFile, ShaderType::Pixel)
     {}
+
+    std::shared_ptr<Shader> CreateReloadCopy() const override { return std::make_shared<PixelShader>(*this); }
     
 private:
 };
@@ -103,6 +134,8 @@ public:
     HullShader(std::string sourceFile)
         : Shader(sourceFile, ShaderType::Hull)
     {}
+
+    std::shared_ptr<Shader> CreateReloadCopy() const override { return std::make_shared<HullShader>(*this); }
     
 private:
 };
@@ -112,6 +145,8 @@ public:
     DomainShader(std::string sourceFile)
         : Shader(sourceFile, ShaderType::Domain)
     {}
+
+    std::shared_ptr<Shader> CreateReloadCopy() const override { return std::make_shared<DomainShader>(*this); }
     
 private:
 };
@@ -121,6 +156,8 @@ public:
     GeometryShader(std::string sourceFile)
         : Shader(sourceFile, ShaderType::Geometry)
     {}
+
+    std::shared_ptr<Shader> CreateReloadCopy() const override { return std::make_shared<GeometryShader>(*this); }
     
 private:
 };
@@ -134,6 +171,8 @@ public:
         macros_[L"THREAD_COUNT_Y"] = std::to_wstring(threadCountY);
         macros_[L"THREAD_COUNT_Z"] = std::to_wstring(threadCountZ);
     }
+
+    std::shared_ptr<Shader> CreateReloadCopy() const override { return std::make_shared<ComputeShader>(*this); }
     
 private:
 };
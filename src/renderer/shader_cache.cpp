@@ -0,0 +1,152 @@
+﻿#include "shader_cache.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "serialization.h"
+
+using serialization::ByteReader;
+using serialization::ByteWriter;
+
+namespace {
+    winrt::com_ptr<IDxcBlob> CreateBlob(IDxcUtils* utils, const uint8_t* data, size_t size) {
+        winrt::com_ptr<IDxcBlobEncoding> blob;
+        HRESULT hr = utils->CreateBlob(data, (UINT32)size, DXC_CP_ACP, blob.put());
+        winrt::check_hresult(hr);
+        return blob.as<IDxcBlob>();
+    }
+}
+
+ShaderCacheKeyBuilder& ShaderCacheKeyBuilder::AddPreprocessedSource(std::string_view source) {
+    hasher_.Add(source);
+    return *this;
+}
+
+ShaderCacheKeyBuilder& ShaderCacheKeyBuilder::AddArgument(std::wstring_view arg) {
+    hasher_.AddBytes(arg.data(), arg.size() * sizeof(wchar_t));
+    return *this;
+}
+
+ShaderCacheKeyBuilder& ShaderCacheKeyBuilder::AddCompilerVersion(uint32_t major, uint32_t minor) {
+    hasher_.Add(major).Add(minor);
+    return *this;
+}
+
+ShaderCache::ShaderCache(std::filesystem::path directory)
+    : directory_(std::move(directory)) {
+}
+
+std::filesystem::path ShaderCache::GetFilePath(uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".shadercache";
+    return directory_ / name.str();
+}
+
+std::shared_ptr<Shader::CompilationData> ShaderCache::Load(uint64_t key, IDxcUtils* utils) const {
+    std::vector<uint8_t> bytes;
+    if(!serialization::ReadFile(GetFilePath(key), bytes)) {
+        return nullptr;
+    }
+
+    ByteReader reader(bytes.data(), bytes.size());
+
+    ShaderCacheFileHeader header;
+    if(!reader.Read(header) ||
+       header.magic != ShaderCacheFileMagic ||
+       header.version != ShaderCacheFileVersion ||
+       header.key != key ||
+       header.shaderSize == 0) {
+        std::cout << "Ignoring stale shader cache entry " << GetFilePath(key).string() << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<Shader::CompilationData> data = std::make_shared<Shader::CompilationData>();
+
+    const uint8_t* shaderBytes = reader.ReadBytes(header.shaderSize);
+    const uint8_t* rootSigBytes = reader.ReadBytes(header.rootSigSize);
+    bool valid = shaderBytes && rootSigBytes;
+
+    for(uint32_t i = 0; valid && i < header.numRootParamUsages; i++) {
+        uint32_t type;
+        uint16_t space;
+        uint16_t numRegisters;
+        valid = reader.Read(type) && reader.Read(space) && reader.Read(numRegisters) &&
+                type < (uint32_t)ResourceDescriptorType::NumResourceDescriptorTypes;
+
+        std::set<uint16_t>& registers = data->rootParamUsage[shader_utils::CreateRootParamKey((ResourceDescriptorType)type, space)];
+        for(uint16_t r = 0; valid && r < numRegisters; r++) {
+            uint16_t reg;
+            valid = reader.Read(reg);
+            registers.insert(reg);
+        }
+    }
+
+    for(uint32_t i = 0; valid && i < header.numInputLayoutElems; i++) {
+        uint16_t nameLength;
+        VertexInputLayoutElem elem;
+        uint32_t format;
+
+        const uint8_t* name = nullptr;
+        valid = reader.Read(nameLength) &&
+                (name = reader.ReadBytes(nameLength)) != nullptr &&
+                reader.Read(elem.semanticIndex) &&
+                reader.Read(format);
+
+        if(valid) {
+            elem.semanticName.assign(reinterpret_cast<const char*>(name), nameLength);
+            elem.format = (DXGI_FORMAT)format;
+            data->inputLayoutElems.insert(std::move(elem));
+        }
+    }
+
+    if(!valid || !reader.IsAtEnd()) {
+        std::cout << "Ignoring corrupt shader cache entry " << GetFilePath(key).string() << std::endl;
+        return nullptr;
+    }
+
+    data->shaderBlob = CreateBlob(utils, shaderBytes, header.shaderSize);
+    if(header.rootSigSize > 0) {
+        data->rootSigBlob = CreateBlob(utils, rootSigBytes, header.rootSigSize);
+    }
+
+    return data;
+}
+
+bool ShaderCache::Store(uint64_t key, const Shader::CompilationData& data) const {
+    WINRT_ASSERT(data.shaderBlob);
+
+    ShaderCacheFileHeader header = {};
+    header.magic = ShaderCacheFileMagic;
+    header.version = ShaderCacheFileVersion;
+    header.key = key;
+    header.shaderSize = data.shaderBlob->GetBufferSize();
+    header.rootSigSize = data.rootSigBlob ? data.rootSigBlob->GetBufferSize() : 0;
+    header.numRootParamUsages = (uint32_t)data.rootParamUsage.size();
+    header.numInputLayoutElems = (uint32_t)data.inputLayoutElems.size();
+
+    ByteWriter writer;
+    writer.Write(header);
+    writer.WriteBytes(data.shaderBlob->GetBufferPointer(), header.shaderSize);
+    if(data.rootSigBlob) {
+        writer.WriteBytes(data.rootSigBlob->GetBufferPointer(), header.rootSigSize);
+    }
+
+    for(const auto& [usageKey, registers] : data.rootParamUsage) {
+        writer.Write((uint32_t)std::get<0>(usageKey));
+        writer.Write((uint16_t)std::get<1>(usageKey));
+        writer.Write((uint16_t)registers.size());
+        for(uint16_t reg : registers) {
+            writer.Write(reg);
+        }
+    }
+
+    for(const VertexInputLayoutElem& elem : data.inputLayoutElems) {
+        writer.Write((uint16_t)elem.semanticName.size());
+        writer.WriteBytes(elem.semanticName.data(), elem.semanticName.size());
+        writer.Write(elem.semanticIndex);
+        writer.Write((uint32_t)elem.format);
+    }
+
+    return serialization::WriteFileAtomically(GetFilePath(key), writer.GetBytes());
+}
@@ -0,0 +1,71 @@
+﻿#ifndef RENDERER_SHADER_CACHE_H_
+#define RENDERER_SHADER_CACHE_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "shader.h"
+#include "ninmath/hash.h"
+
+//
+// On-disk layout (little endian):
+//   ShaderCacheFileHeader
+//   shader bytecode
+//   root signature blob (if the shader defines one)
+//   root parameter usage: per entry { u32 type, u16 space, u16 numRegisters, u16 registers[] }
+//   input layout: per element { u16 nameLength, char name[], u16 semanticIndex, u32 format }
+//
+inline constexpr uint32_t ShaderCacheFileMagic = 0x43535343; // "CSSC"
+inline constexpr uint32_t ShaderCacheFileVersion = 1;
+
+struct ShaderCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t shaderSize;
+    uint64_t rootSigSize;
+    uint32_t numRootParamUsages;
+    uint32_t numInputLayoutElems;
+};
+
+//
+// Feeds everything that can change the compiler's output. The preprocessed source
+// already contains every transitively included file, the arguments carry the
+// profile, the macros and the flags.
+//
+class ShaderCacheKeyBuilder {
+public:
+    ShaderCacheKeyBuilder& AddPreprocessedSource(std::string_view source);
+    ShaderCacheKeyBuilder& AddArgument(std::wstring_view arg);
+    ShaderCacheKeyBuilder& AddCompilerVersion(uint32_t major, uint32_t minor);
+
+    uint64_t Get() const { return hasher_.Get(); }
+
+private:
+    ninmath::hash::Hasher hasher_;
+};
+
+//
+// Directory of compiled shaders, one file per key. Keys are content hashes,
+// so an entry never goes stale, it just stops being looked up.
+//
+class ShaderCache {
+public:
+    ShaderCache(std::filesystem::path directory);
+
+    // nullptr on a miss or a corrupt entry, the blobs are created through utils
+    std::shared_ptr<Shader::CompilationData> Load(uint64_t key, IDxcUtils* utils) const;
+
+    // writes to a temporary file first, so a crash never leaves a half written entry behind
+    bool Store(uint64_t key, const Shader::CompilationData& data) const;
+
+    std::filesystem::path GetFilePath(uint64_t key) const;
+
+private:
+    std::filesystem::path directory_;
+};
+
+#endif // RENDERER_SHADER_CACHE_H_
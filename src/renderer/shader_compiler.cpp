@@ -1,9 +1,12 @@
 ﻿#include "shader_compiler.h"
 
+#include <chrono>
+#include <iostream>
 #include <set>
 
 #include "shader.h"
-#include "multithreading/thread_pool.h"
+#include "shader_cache.h"
+#include "multithreading/task_graph.h"
 #include "renderer_types.h"
 #include "dxcapi.h"
 #include "d3d12shader.h"
@@ -11,9 +14,61 @@
 #include "shader_types.h"
 #include <filesystem>
 
-ShaderCompiler::ShaderCompiler() {
-    threadPool_ = std::make_shared<ThreadPool<Shader::State>>();
-    threadPool_->Start();
+namespace {
+    // DXC instances aren't free to create and can't be shared between threads,
+    // every worker creates its own set once and keeps it
+    struct DxcContext {
+        winrt::com_ptr<IDxcUtils> utils;
+        winrt::com_ptr<IDxcCompiler3> compiler;
+        uint32_t versionMajor = 0;
+        uint32_t versionMinor = 0;
+    };
+
+    DxcContext& GetThreadDxcContext() {
+        thread_local DxcContext context;
+        if(!context.utils) {
+            HRESULT hr = DxcCreateInstance(CLSID_DxcUtils, __uuidof(IDxcUtils), context.utils.put_void());
+            winrt::check_hresult(hr);
+
+            hr = DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler3), context.compiler.put_void());
+            winrt::check_hresult(hr);
+
+            // part of the cache key, a compiler update invalidates every entry
+            winrt::com_ptr<IDxcVersionInfo> versionInfo = context.compiler.try_as<IDxcVersionInfo>();
+            if(versionInfo) {
+                versionInfo->GetVersion(&context.versionMajor, &context.versionMinor);
+            }
+        }
+        return context;
+    }
+
+    // forwards to the default handler, remembering every file it resolved
+    struct RecordingIncludeHandler : winrt::implements<RecordingIncludeHandler, IDxcIncludeHandler> {
+        RecordingIncludeHandler(winrt::com_ptr<IDxcIncludeHandler> inner) : inner(std::move(inner)) {}
+
+        HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR filename, IDxcBlob** includeSource) override {
+            const HRESULT hr = inner->LoadSource(filename, includeSource);
+            if(SUCCEEDED(hr)) {
+                std::error_code ec;
+                includedFiles.insert(std::filesystem::absolute(filename, ec).lexically_normal());
+            }
+            return hr;
+        }
+
+        winrt::com_ptr<IDxcIncludeHandler> inner;
+        std::set<std::filesystem::path> includedFiles;
+    };
+
+    double MillisecondsSince(int64_t startNs) {
+        const int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        return (nowNs - startNs) / 1.0e6;
+    }
+}
+
+ShaderCompiler::ShaderCompiler(std::shared_ptr<WorkStealingScheduler> scheduler)
+    : taskGraph_(std::move(scheduler)),
+      cache_(std::make_unique<ShaderCache>("cache/shaders")),
+      numPending_(0), numCacheHits_(0), numCompiled_(0), batchStartNs_(0) {
 }
 
 ShaderCompiler::~ShaderCompiler() {
@@ -28,11 +83,20 @@ bool ShaderCompiler::Enqueue(std::weak_ptr<Shader> shader) {
 }
 
 void ShaderCompiler::Flush() {
+    // a new batch starts whenever the previous one is fully done, the batch time
+    // is what startup (cold or warm cache) spends on shaders
+    if(!shaderQueue_.empty() && numPending_.load() == 0) {
+        numCacheHits_ = 0;
+        numCompiled_ = 0;
+        batchStartNs_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     while(shaderQueue_.size() > 0) {
         std::weak_ptr<Shader> shader = std::move(shaderQueue_.front());
         shaderQueue_.pop();
 
-        std::promise<Shader::State>& shaderPromise = shader.lock()->promise_;
+        std::shared_ptr<Shader> s = shader.lock();
+        std::promise<Shader::State>& shaderPromise = s->promise_;
         std::packaged_task<Shader::State()> task = std::packaged_task<Shader::State()>(
                                 std::bind(
                                     &ShaderCompiler::CompileShader,
@@ -40,11 +104,29 @@ void ShaderCompiler::Flush() {
                                     shader, 
                                     std::ref(shaderPromise)));
 
+        // pipelines assembled from this shader hang off this task as successors
+        numPending_.fetch_add(1);
+        s->compileTask_ = taskGraph_.CreateTask([this, task = std::move(task)]() mutable {
+            task();
+            OnShaderDone();
+        });
+
         std::cout << "Flushing shader compiler" << std::endl;
-        threadPool_->AddTask(std::move(task));
+        taskGraph_.Submit(s->compileTask_);
     }
 }
 
+void ShaderCompiler::OnShaderDone() {
+    if(numPending_.fetch_sub(1) != 1) {
+        return;
+    }
+
+    std::cout << std::format("Shader compiler: batch done in {:.1f} ms ({} from cache, {} compiled)",
+                             MillisecondsSince(batchStartNs_.load()),
+                             numCacheHits_.load(),
+                             numCompiled_.load()) << std::endl;
+}
+
 Shader::State ShaderCompiler::CompileShader(std::weak_ptr<Shader> inShader, std::promise<Shader::State>& shaderPromise) {
     std::shared_ptr<Shader> shader = inShader.lock();
     std::cout << "Compiling " << shader->sourceFile_ << std::endl;;
@@ -53,6 +135,10 @@ Shader::State ShaderCompiler::CompileShader(std::weak_ptr<Shader> inShader, std:
 
     const std::wstring parentPath = std::filesystem::path(sourceFile).parent_path().wstring();
 
+    // watched for hot reloading, even if it doesn't exist (yet)
+    std::error_code ec;
+    shader->dependencies_ = { std::filesystem::absolute(sourceFile, ec).lexically_normal() };
+
     // find file
     const DWORD fileAttrs = GetFileAttributes(sourceFile.c_str());
     if(fileAttrs == INVALID_FILE_ATTRIBUTES || (fileAttrs & FILE_ATTRIBUTE_DIRECTORY)) {
@@ -71,13 +157,11 @@ Shader::State ShaderCompiler::CompileShader(std::weak_ptr<Shader> inShader, std:
     
     HRESULT hr;
 
-    winrt::com_ptr<IDxcUtils> utils;
-    hr = DxcCreateInstance(CLSID_DxcUtils, __uuidof(IDxcUtils), utils.put_void());
-    winrt::check_hresult(hr);
+    const auto startTime = std::chrono::steady_clock::now();
 
-    winrt::com_ptr<IDxcCompiler3> compiler;
-    hr = DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler3), compiler.put_void());
-    winrt::check_hresult(hr);
+    DxcContext& dxc = GetThreadDxcContext();
+    IDxcUtils* utils = dxc.utils.get();
+    IDxcCompiler3* compiler = dxc.compiler.get();
 
     std::wstring sourceFileW;
     {
@@ -142,14 +226,74 @@ Shader::State ShaderCompiler::CompileShader(std::weak_ptr<Shader> inShader, std:
         curMacroInd++;
     }
 
-    winrt::com_ptr<IDxcIncludeHandler> includeHandler;
-    utils->CreateDefaultIncludeHandler(includeHandler.put());
+    winrt::com_ptr<IDxcIncludeHandler> defaultIncludeHandler;
+    utils->CreateDefaultIncludeHandler(defaultIncludeHandler.put());
+    winrt::com_ptr<RecordingIncludeHandler> includeHandler = winrt::make_self<RecordingIncludeHandler>(defaultIncludeHandler);
 
     DxcBuffer sourceBuffer;
     sourceBuffer.Ptr = source->GetBufferPointer();
     sourceBuffer.Size = source->GetBufferSize();
     sourceBuffer.Encoding = 0u;
 
+    // preprocess only, the output has every include expanded, so together with the
+    // arguments (profile, macros, flags) it determines the compiled result
+    uint64_t cacheKey = 0;
+    bool cacheKeyValid = false;
+    {
+        std::vector<LPCWSTR> preprocessArgs = compileArgs;
+        preprocessArgs.push_back(L"-P");
+
+        winrt::com_ptr<IDxcResult> preprocessResult;
+        hr = compiler->Compile(
+            &sourceBuffer,
+            preprocessArgs.data(),
+            (UINT32)preprocessArgs.size(),
+            includeHandler.get(),
+            __uuidof(IDxcResult),
+            preprocessResult.put_void()
+        );
+
+        HRESULT status = E_FAIL;
+        if(SUCCEEDED(hr)) {
+            preprocessResult->GetStatus(&status);
+        }
+
+        winrt::com_ptr<IDxcBlobUtf8> preprocessed;
+        if(SUCCEEDED(status)) {
+            preprocessResult->GetOutput(DXC_OUT_HLSL, __uuidof(IDxcBlobUtf8), preprocessed.put_void(), NULL);
+        }
+
+        // every include was resolved by now, so this is the shader's full include graph
+        shader->dependencies_.insert(shader->dependencies_.end(), includeHandler->includedFiles.begin(), includeHandler->includedFiles.end());
+
+        // on a preprocessor error there's no key, the compile below reports the error
+        if(preprocessed) {
+            ShaderCacheKeyBuilder keyBuilder;
+            keyBuilder.AddPreprocessedSource(std::string_view(preprocessed->GetStringPointer(), preprocessed->GetStringLength()));
+            for(LPCWSTR arg : compileArgs) {
+                keyBuilder.AddArgument(arg);
+            }
+            keyBuilder.AddCompilerVersion(dxc.versionMajor, dxc.versionMinor);
+
+            cacheKey = keyBuilder.Get();
+            cacheKeyValid = true;
+        }
+    }
+
+    if(cacheKeyValid) {
+        std::shared_ptr<Shader::CompilationData> cached = cache_->Load(cacheKey, utils);
+        if(cached) {
+            Shader::State out = Shader::State::Ok();
+            out.compileData = std::move(cached);
+            shaderPromise.set_value(out);
+
+            numCacheHits_.fetch_add(1);
+            std::cout << std::format("Shader cache hit: {} ({:.1f} ms)", sourceFile,
+                                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count()) << std::endl;
+            return out;
+        }
+    }
+
     winrt::com_ptr<IDxcResult> result;
     hr = compiler->Compile(
         &sourceBuffer,
@@ -289,11 +433,17 @@ Shader::State ShaderCompiler::CompileShader(std::weak_ptr<Shader> inShader, std:
     compilationData->rootSigBlob = rootSigBlob;
     compilationData->shaderBlob = shaderBlob;
 
+    if(cacheKeyValid && !cache_->Store(cacheKey, *compilationData)) {
+        std::cout << "Failed to store shader cache entry for " << sourceFile << std::endl;
+    }
+
     Shader::State out = Shader::State::Ok();
     out.compileData = compilationData;
     shaderPromise.set_value(out);
 
-    std::cout << "Shader compilation complete: " << sourceFile << std::endl;
+    numCompiled_.fetch_add(1);
+    std::cout << std::format("Shader compilation complete: {} ({:.1f} ms)", sourceFile,
+                             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count()) << std::endl;
     return out;
 }
 
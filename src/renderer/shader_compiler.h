@@ -1,27 +1,40 @@
 ﻿#ifndef RENDERER_SHADER_COMPILER_H_
 #define RENDERER_SHADER_COMPILER_H_
 
+#include <atomic>
 #include <memory>
 #include <queue>
 
 #include "shader.h"
-#include "multithreading/thread_pool.h"
+#include "multithreading/task_graph.h"
 
 
 
+class ShaderCache;
+
 class ShaderCompiler {
 public:
-    ShaderCompiler();
+    ShaderCompiler(std::shared_ptr<WorkStealingScheduler> scheduler);
     ~ShaderCompiler();
     bool Enqueue(std::weak_ptr<Shader> shader);
     void Flush();
 
 private:
     Shader::State CompileShader(std::weak_ptr<Shader> shader, std::promise<Shader::State>& shaderPromise);
+    void OnShaderDone();
     static DXGI_FORMAT ScalarAndMaskToFormat(D3D_REGISTER_COMPONENT_TYPE scalarType, BYTE mask);
     
-    std::shared_ptr<ThreadPool<Shader::State>> threadPool_;
+    TaskGraph taskGraph_;
     std::queue<std::weak_ptr<Shader>> shaderQueue_;
+
+    // bytecode + reflection keyed by a hash of the preprocessed source and the arguments
+    std::unique_ptr<ShaderCache> cache_;
+
+    // per batch (see Flush()), for reporting cold/warm cache startup times
+    std::atomic<uint32_t> numPending_;
+    std::atomic<uint32_t> numCacheHits_;
+    std::atomic<uint32_t> numCompiled_;
+    std::atomic<int64_t> batchStartNs_;
 };
 
 #endif // RENDERER_SHADER_COMPILER_H_
@@ -0,0 +1,63 @@
+﻿#include "shader_file_watcher.h"
+
+void ShaderFileWatcher::Watch(const std::string& shaderId, const std::vector<std::filesystem::path>& files) {
+    Unwatch(shaderId);
+
+    std::vector<std::filesystem::path>& shaderFiles = shaderFiles_[shaderId];
+    for(const std::filesystem::path& file : files) {
+        auto [it, inserted] = files_.try_emplace(file);
+        if(inserted) {
+            it->second.lastWriteTime = GetLastWriteTime(file);
+        }
+
+        if(it->second.shaderIds.insert(shaderId).second) {
+            shaderFiles.push_back(file);
+        }
+    }
+}
+
+void ShaderFileWatcher::Unwatch(const std::string& shaderId) {
+    const auto shaderIt = shaderFiles_.find(shaderId);
+    if(shaderIt == shaderFiles_.end()) {
+        return;
+    }
+
+    for(const std::filesystem::path& file : shaderIt->second) {
+        const auto fileIt = files_.find(file);
+        if(fileIt == files_.end()) {
+            continue;
+        }
+
+        fileIt->second.shaderIds.erase(shaderId);
+        if(fileIt->second.shaderIds.empty()) {
+            files_.erase(fileIt);
+        }
+    }
+
+    shaderFiles_.erase(shaderIt);
+}
+
+std::set<std::string> ShaderFileWatcher::Poll() {
+    std::set<std::string> changedShaders;
+
+    for(auto& [file, watched] : files_) {
+        const std::optional<std::filesystem::file_time_type> writeTime = GetLastWriteTime(file);
+        if(writeTime == watched.lastWriteTime) {
+            continue;
+        }
+
+        watched.lastWriteTime = writeTime;
+        changedShaders.insert(watched.shaderIds.begin(), watched.shaderIds.end());
+    }
+
+    return changedShaders;
+}
+
+std::optional<std::filesystem::file_time_type> ShaderFileWatcher::GetLastWriteTime(const std::filesystem::path& file) {
+    std::error_code ec;
+    const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(file, ec);
+    if(ec) {
+        return std::nullopt;
+    }
+    return writeTime;
+}
@@ -0,0 +1,38 @@
+﻿#ifndef RENDERER_SHADER_FILE_WATCHER_H_
+#define RENDERER_SHADER_FILE_WATCHER_H_
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+//
+// Polls the modification times of the files shaders are built from (the source file
+// and its include graph). One include usually feeds many shaders, every file is only
+// checked once per poll no matter how many shaders depend on it.
+//
+class ShaderFileWatcher {
+public:
+    // Replaces what was watched for the shader before. Files that were already watched
+    // keep their last seen write time, a change made while recompiling isn't lost.
+    void Watch(const std::string& shaderId, const std::vector<std::filesystem::path>& files);
+    void Unwatch(const std::string& shaderId);
+
+    // shaders with a file that was modified, created or deleted since the last poll
+    std::set<std::string> Poll();
+
+private:
+    struct WatchedFile {
+        std::optional<std::filesystem::file_time_type> lastWriteTime; // empty if the file doesn't exist
+        std::set<std::string> shaderIds;
+    };
+
+    static std::optional<std::filesystem::file_time_type> GetLastWriteTime(const std::filesystem::path& file);
+
+    std::map<std::filesystem::path, WatchedFile> files_;
+    std::map<std::string, std::vector<std::filesystem::path>> shaderFiles_;
+};
+
+#endif // RENDERER_SHADER_FILE_WATCHER_H_
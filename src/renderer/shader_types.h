@@ -1,6 +1,7 @@
 ﻿#ifndef RENDERER_SHADER_TYPES_H_
 #define RENDERER_SHADER_TYPES_H_
 
+#include <functional>
 #include <string>
 #include "d3d12.h"
 #include <map>
@@ -195,21 +196,25 @@ private:
     D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle_;
 };
 
+// the address is looked up on every Execute, resources in the upload ring move from frame to frame
 class RootDescriptorParameter : public RootParameter {
 public:
-    RootDescriptorParameter(uint32_t rootParamIndex, bool isCompute, ID3D12Resource* res, ResourceDescriptorType descriptorType)
-        : RootParameter(rootParamIndex, isCompute), res_(res), descriptorType_(descriptorType) {}
+    RootDescriptorParameter(uint32_t rootParamIndex,
+                            bool isCompute,
+                            std::function<D3D12_GPU_VIRTUAL_ADDRESS()> getAddress,
+                            ResourceDescriptorType descriptorType)
+        : RootParameter(rootParamIndex, isCompute), getAddress_(std::move(getAddress)), descriptorType_(descriptorType) {}
     
     void ExecuteGraphics(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) const override {
         switch(descriptorType_) {
         case ResourceDescriptorType::SRV:
-            cmdList->SetGraphicsRootShaderResourceView(rootParamIndex_, res_->GetGPUVirtualAddress());
+            cmdList->SetGraphicsRootShaderResourceView(rootParamIndex_, getAddress_());
             break;
         case ResourceDescriptorType::CBV:
-            cmdList->SetGraphicsRootConstantBufferView(rootParamIndex_, res_->GetGPUVirtualAddress());
+            cmdList->SetGraphicsRootConstantBufferView(rootParamIndex_, getAddress_());
             break;
         case ResourceDescriptorType::UAV:
-            cmdList->SetGraphicsRootUnorderedAccessView(rootParamIndex_, res_->GetGPUVirtualAddress());
+            cmdList->SetGraphicsRootUnorderedAccessView(rootParamIndex_, getAddress_());
             break;
         default:
             return;
@@ -219,13 +224,13 @@ public:
     void ExecuteCompute(winrt::com_ptr<ID3D12GraphicsCommandList> cmdList) const override {
         switch(descriptorType_) {
         case ResourceDescriptorType::SRV:
-            cmdList->SetComputeRootShaderResourceView(rootParamIndex_, res_->GetGPUVirtualAddress());
+            cmdList->SetComputeRootShaderResourceView(rootParamIndex_, getAddress_());
             break;
         case ResourceDescriptorType::CBV:
-            cmdList->SetComputeRootConstantBufferView(rootParamIndex_, res_->GetGPUVirtualAddress());
+            cmdList->SetComputeRootConstantBufferView(rootParamIndex_, getAddress_());
             break;
         case ResourceDescriptorType::UAV:
-            cmdList->SetComputeRootUnorderedAccessView(rootParamIndex_, res_->GetGPUVirtualAddress());
+            cmdList->SetComputeRootUnorderedAccessView(rootParamIndex_, getAddress_());
             break;
         default:
             return;
@@ -233,7 +238,7 @@ public:
     }
     
 private:
-    ID3D12Resource* res_;
+    std::function<D3D12_GPU_VIRTUAL_ADDRESS()> getAddress_;
     ResourceDescriptorType descriptorType_;
 };
 
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "test_common.h"
+#include "cloudscapes/atmosphere_lut_baker.h"
+
+using namespace ninmath;
+
+namespace {
+
+    // what Cloudscaper starts with
+    const AtmosphereContext Atmosphere = { 6360.f, 6460.f };
+
+    SkyBuffer MakeSky() {
+        SkyBuffer sky = {};
+        sky.cameraPos = { 0.f, 0.f, 0.1f };
+        sky.lightDir = Vector3f(0.f, 1.f, 0.9f).Normal();
+        sky.sunIlluminance = { 1.f, 1.f, 1.f };
+        return sky;
+    }
+
+    // largest rgb difference, relative to the largest value in a
+    float GetMaxRelativeDifference(const AtmosphereLUT& a, const AtmosphereLUT& b) {
+        float maxValue = 0.f;
+        float maxDifference = 0.f;
+        for(size_t i = 0; i < a.texels.size(); i++) {
+            const Vector4f& ta = a.texels[i];
+            const Vector4f& tb = b.texels[i];
+            maxValue = std::max({ maxValue, std::abs(ta.x), std::abs(ta.y), std::abs(ta.z) });
+            maxDifference = std::max({ maxDifference, std::abs(ta.x - tb.x), std::abs(ta.y - tb.y), std::abs(ta.z - tb.z) });
+        }
+        return maxDifference / maxValue;
+    }
+
+    bool SameTexels(const AtmosphereLUT& a, const AtmosphereLUT& b) {
+        return a.width == b.width && a.height == b.height &&
+               std::memcmp(a.texels.data(), b.texels.data(), a.texels.size() * sizeof(Vector4f)) == 0;
+    }
+
+    // every rgb channel finite and in [minValue, maxValue], alpha 1
+    bool TexelsInRange(const AtmosphereLUT& lut, float minValue, float maxValue) {
+        for(const Vector4f& texel : lut.texels) {
+            for(float value : { texel.x, texel.y, texel.z }) {
+                if(!std::isfinite(value) || value < minValue || value > maxValue) {
+                    return false;
+                }
+            }
+            if(texel.w != 1.f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // namespace
+
+TEST_CASE(BakesAreDeterministic) {
+    const SkyBuffer sky = MakeSky();
+
+    // rows go to whichever thread asks first, the result can't depend on that
+    AtmosphereLUTBaker singleThreaded(Atmosphere, 1);
+    AtmosphereLUTBaker multiThreaded(Atmosphere, 4);
+    const AtmosphereLUTBaker::AtmosphereLUTs first = singleThreaded.BakeAll(sky);
+    const AtmosphereLUTBaker::AtmosphereLUTs second = multiThreaded.BakeAll(sky);
+    const AtmosphereLUTBaker::AtmosphereLUTs third = multiThreaded.BakeAll(sky);
+
+    for(const AtmosphereLUTBaker::AtmosphereLUTs* luts : { &second, &third }) {
+        CHECK(SameTexels(first.transmittance, luts->transmittance));
+        CHECK(SameTexels(first.multiScattering, luts->multiScattering));
+        CHECK(SameTexels(first.skyView, luts->skyView));
+    }
+}
+
+TEST_CASE(TransmittanceIsInRange) {
+    AtmosphereLUTBaker baker(Atmosphere, 2);
+    const AtmosphereLUT lut = baker.BakeTransmittance();
+    CHECK(lut.width == AtmosphereLUTBaker::TransmittanceWidth && lut.height == AtmosphereLUTBaker::TransmittanceHeight);
+    CHECK(TexelsInRange(lut, 0.f, 1.f));
+
+    // u = 0 looks straight up, u = 1 along the longest path (to the horizon), so light only gets lost along a row.
+    // Above the ground u = 0 itself comes out as 1, mu rounds past 1 there like in the shader.
+    for(uint32_t y = 0; y < lut.height; y++) {
+        for(uint32_t x = 2; x < lut.width; x++) {
+            const Vector4f& shorter = lut.At(x - 1, y);
+            const Vector4f& longer = lut.At(x, y);
+            CHECK(longer.x <= shorter.x && longer.y <= shorter.y && longer.z <= shorter.z);
+        }
+    }
+
+    // straight up from the ground loses some light, blue the most
+    const Vector4f& groundUp = lut.At(0, 0);
+    CHECK(groundUp.x < 1.f && groundUp.z < groundUp.x);
+    CHECK(lut.At(lut.width - 1, 0).z < 0.01f);
+}
+
+TEST_CASE(ScatteringLUTsAreInRange) {
+    AtmosphereLUTBaker baker(Atmosphere, 2);
+    const AtmosphereLUTBaker::AtmosphereLUTs luts = baker.BakeAll(MakeSky());
+
+    // luminance from a unit sun stays well below it, and the sky isn't black
+    CHECK(TexelsInRange(luts.multiScattering, 0.f, 1.f));
+    CHECK(TexelsInRange(luts.skyView, 0.f, 1.f));
+
+    float maxSkyView = 0.f;
+    for(const Vector4f& texel : luts.skyView.texels) {
+        maxSkyView = std::max(maxSkyView, texel.z);
+    }
+    CHECK(maxSkyView > 0.01f);
+}
+
+TEST_CASE(StaleMultiScatteringBarelyMovesTheSky) {
+    // Cloudscaper's LUTLightDirTolerance, the multiscattering LUT can lag the light by this much
+    const float tolerance = 0.005f;
+
+    AtmosphereLUTBaker baker(Atmosphere, 4);
+    // up to the sun just below the horizon, where the LUTs change the fastest
+    for(float angle : { 0.8f, 1.5f, 1.6f }) {
+        SkyBuffer sky = MakeSky();
+        sky.lightDir = Vector3f(0.f, std::sin(angle), std::cos(angle));
+        const AtmosphereLUTBaker::AtmosphereLUTs before = baker.BakeAll(sky);
+
+        sky.lightDir = Vector3f(0.f, std::sin(angle + tolerance), std::cos(angle + tolerance));
+        const AtmosphereLUTBaker::AtmosphereLUTs after = baker.BakeAll(sky);
+        const AtmosphereLUT staleMultiScattering = baker.BakeSkyView(after.transmittance, before.multiScattering, sky);
+
+        // skyview moves with the light, a stale multiscattering LUT under it is orders of magnitude less
+        const float skyViewChange = GetMaxRelativeDifference(before.skyView, after.skyView);
+        const float staleError = GetMaxRelativeDifference(after.skyView, staleMultiScattering);
+        CHECK(staleError < 1e-4f);
+        CHECK(staleError * 100.f < skyViewChange);
+    }
+}
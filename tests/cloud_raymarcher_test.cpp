@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "test_common.h"
+#include "cloud_test_scene.h"
+#include "cloudscapes/cloud_occupancy_grid.h"
+
+using namespace ninmath;
+using namespace ninmath::noise;
+
+namespace {
+
+    // 40 pixels per row leave a partial packet at the end of every tile row at both widths
+    constexpr uint32_t Width = 40;
+    constexpr uint32_t Height = 24;
+
+    // the packet levels the binary and the cpu support
+    std::vector<SimdLevel> GetPacketLevels() {
+        std::vector<SimdLevel> levels;
+        for(SimdLevel level : { SimdLevel::AVX2, SimdLevel::AVX512 }) {
+            if(level <= GetSimdLevel()) {
+                levels.push_back(level);
+            }
+        }
+        return levels;
+    }
+
+    // stats, if given, get the render's stats
+    AtmosphereLUT RenderScene(const CloudTestScene& scene, SimdLevel level, bool fastMath, const CloudOccupancyGrid* occupancyGrid = nullptr,
+                              bool leap = true, CloudRaymarcher::RenderStats* stats = nullptr) {
+        CloudRaymarcher raymarcher(2);
+        raymarcher.SetSimdLevel(level);
+        raymarcher.SetFastMath(fastMath);
+        raymarcher.SetEmptySpaceSkipping(occupancyGrid, leap);
+        const AtmosphereLUT image = raymarcher.Render(scene.view, scene.params, scene.GetTextures());
+        if(raymarcher.GetLastRenderStats().simdLevel != level) {
+            std::cerr << SimdLevelToString(level) << " fell back to " << SimdLevelToString(raymarcher.GetLastRenderStats().simdLevel) << std::endl;
+        }
+        if(stats) {
+            *stats = raymarcher.GetLastRenderStats();
+        }
+        return image;
+    }
+
+    // Clear sky in a checkerboard of 8x8 weather texels, the random coverage alone leaves no empty
+    // cells. The view crosses a clear block before it reaches cloud.
+    void ClearWeather(CloudTestScene& scene) {
+        for(uint32_t y = 0; y < scene.weather.height; y++) {
+            for(uint32_t x = 0; x < scene.weather.width; x++) {
+                if((x / 8 + y / 8) % 2 == 1) {
+                    scene.weather.At(x, y).x = 0.f;
+                }
+            }
+        }
+    }
+
+    bool BitIdentical(const AtmosphereLUT& a, const AtmosphereLUT& b) {
+        return a.texels.size() == b.texels.size() && std::memcmp(a.texels.data(), b.texels.data(), a.texels.size() * sizeof(Vector4f)) == 0;
+    }
+
+} // namespace
+
+TEST_CASE(ScalarRenderMatchesShadePixel) {
+    const CloudTestScene scene = MakeCloudTestScene(Width, Height);
+    const AtmosphereLUT image = RenderScene(scene, SimdLevel::Scalar, false);
+
+    CloudRaymarcher raymarcher(1);
+    for(uint32_t y = 0; y < Height; y += 5) {
+        for(uint32_t x = 0; x < Width; x += 3) {
+            const Vector4f expected = raymarcher.ShadePixel(x, y, scene.view, scene.params, scene.GetTextures());
+            CHECK(std::memcmp(&image.At(x, y), &expected, sizeof(Vector4f)) == 0);
+        }
+    }
+}
+
+TEST_CASE(PacketsMatchScalar) {
+    const CloudTestScene scene = MakeCloudTestScene(Width, Height);
+    const AtmosphereLUT reference = RenderScene(scene, SimdLevel::Scalar, false);
+
+    for(SimdLevel level : GetPacketLevels()) {
+        const AtmosphereLUT image = RenderScene(scene, level, false);
+        if(!BitIdentical(reference, image)) {
+            std::cerr << SimdLevelToString(level) << ": max error " << CompareCloudImages(reference, image, 0.f).maxAbsError << std::endl;
+        }
+        CHECK(BitIdentical(reference, image));
+    }
+}
+
+TEST_CASE(FastMathStaysCloseToScalar) {
+    const CloudTestScene scene = MakeCloudTestScene(Width, Height);
+    const AtmosphereLUT reference = RenderScene(scene, SimdLevel::Scalar, false);
+
+    // the scalar march has no fast path
+    CHECK(BitIdentical(reference, RenderScene(scene, SimdLevel::Scalar, true)));
+
+    for(SimdLevel level : GetPacketLevels()) {
+        const CloudImageComparison comparison = CompareCloudImages(reference, RenderScene(scene, level, true), 1e-4f);
+        std::cout << SimdLevelToString(level) << " fast math: max error " << comparison.maxAbsError << std::endl;
+        CHECK(comparison.numPixelsOverTolerance == 0);
+    }
+}
+
+TEST_CASE(EmptySpaceSkippingKeepsTheImage) {
+    CloudTestScene scene = MakeCloudTestScene(Width, Height);
+    // without jitter a leap lands exactly where the steps it replaces would have
+    scene.params.useBlueNoise = 0;
+    ClearWeather(scene);
+    const CloudOccupancyGrid grid = BuildCloudOccupancyGrid(scene.params, scene.GetTextures());
+
+    std::vector<SimdLevel> levels = GetPacketLevels();
+    levels.insert(levels.begin(), SimdLevel::Scalar);
+    for(SimdLevel level : levels) {
+        const AtmosphereLUT reference = RenderScene(scene, level, false);
+        for(bool leap : { false, true }) {
+            CloudRaymarcher::RenderStats stats;
+            CHECK(BitIdentical(reference, RenderScene(scene, level, false, &grid, leap, &stats)));
+            CHECK(stats.numSkippedSamples > 0 && stats.numSamples > 0);
+            CHECK(leap == (stats.numLeapedSamples > 0));
+        }
+    }
+}
+
+TEST_CASE(OccupancyGridIsConservative) {
+    CloudTestScene scene = MakeCloudTestScene(Width, Height);
+    ClearWeather(scene);
+    const CloudMarchTextures textures = scene.GetTextures();
+    const CloudOccupancyGrid grid = BuildCloudOccupancyGrid(scene.params, textures);
+    CHECK(grid.numEmptyCells > 0 && grid.numEmptyCells < grid.GetNumCells());
+
+    const CloudMarchParameters& params = scene.params;
+    const float innerShellRadius = CloudGroundRadius + params.innerShellRadius;
+    const float outerShellRadius = CloudGroundRadius + params.outerShellRadius;
+
+    // a few points per cell, close to its faces too, where the bilinear weather lookup reaches into the neighbours
+    const float fractions[] = { 0.02f, 0.35f, 0.65f, 0.98f };
+
+    CloudRaymarcher raymarcher(1);
+    size_t numCloudy = 0;
+    size_t numMissed = 0;
+    for(uint32_t z = 0; z < grid.depth; z++) {
+        for(uint32_t y = 0; y < grid.height; y++) {
+            for(uint32_t x = 0; x < grid.width; x++) {
+                for(float fz : fractions) {
+                    for(float fy : fractions) {
+                        for(float fx : fractions) {
+                            // inverse of the weather lookup and the height fraction
+                            const float px = (x + fx + 0.5f) / grid.width * params.weatherRadius.x - 150.f - params.weatherRadius.x / 2.f;
+                            const float py = (y + fy + 0.5f) / grid.height * params.weatherRadius.y - params.weatherRadius.y / 2.f;
+                            const float r = innerShellRadius + (z + fz) / grid.depth * (outerShellRadius - innerShellRadius);
+                            const Vector3f pos(px, py, std::sqrt(r * r - px * px - py * py));
+
+                            const float density = std::max(raymarcher.GetDensity(pos, params, textures, true),
+                                                           raymarcher.GetDensity(pos, params, textures, false));
+                            if(density > 0.f) {
+                                float emptyDistance;
+                                numCloudy++;
+                                numMissed += grid.IsEmpty(pos, emptyDistance);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    CHECK(numCloudy > 0);
+    CHECK(numMissed == 0);
+}
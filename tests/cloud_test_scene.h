@@ -0,0 +1,98 @@
+#ifndef TESTS_CLOUD_TEST_SCENE_H_
+#define TESTS_CLOUD_TEST_SCENE_H_
+
+#include <cmath>
+#include <cstdint>
+
+#include "cloudscapes/atmosphere_lut_baker.h"
+#include "cloudscapes/cloud_raymarcher.h"
+#include "cloudscapes/model_noise_baker.h"
+
+//
+// A small but complete cloud scene for the CPU raymarcher: baked noise volumes and
+// atmosphere LUTs, random weather and blue noise, and a camera above the cloud layer
+// looking down at it. Shared by the raymarcher test and benchmark.
+//
+struct CloudTestScene {
+    NoiseVolume modelNoise;
+    NoiseVolume detailNoise;
+    AtmosphereLUTBaker::AtmosphereLUTs atmosphereLUTs;
+    AtmosphereLUT weather;
+    AtmosphereLUT blueNoise;
+
+    CloudMarchParameters params = {};
+    CloudMarchView view = {};
+
+    CloudMarchTextures GetTextures() const {
+        return { &modelNoise, &detailNoise, &blueNoise, &weather, &atmosphereLUTs.skyView };
+    }
+};
+
+inline CloudTestScene MakeCloudTestScene(uint32_t width, uint32_t height) {
+    using namespace ninmath;
+
+    CloudTestScene scene;
+
+    ModelNoiseBaker noiseBaker;
+    scene.modelNoise = noiseBaker.Bake(64);
+    scene.detailNoise = noiseBaker.BakeDetail(32);
+
+    SkyBuffer sky = {};
+    sky.cameraPos = { 0.f, 0.f, 0.1f };
+    sky.lightDir = Vector3f(0.f, 1.f, 0.9f).Normal();
+    sky.sunIlluminance = { 1.f, 1.f, 1.f };
+    AtmosphereLUTBaker lutBaker({ CloudGroundRadius, CloudGroundRadius + 100.f });
+    scene.atmosphereLUTs = lutBaker.BakeAll(sky);
+
+    // xorshift, so the scene is the same on every platform
+    uint32_t state = 1;
+    auto random = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (float)(state & 0xffffff) / 16777216.f;
+    };
+
+    scene.weather = AtmosphereLUT(64, 64);
+    for(Vector4f& texel : scene.weather.texels) {
+        texel = Vector4f(0.3f + 0.7f * random(), 0.f, random(), 1.f);
+    }
+    scene.blueNoise = AtmosphereLUT(128, 128);
+    for(Vector4f& texel : scene.blueNoise.texels) {
+        texel = Vector4f(random(), random(), random(), 1.f);
+    }
+
+    CloudMarchParameters& p = scene.params;
+    p.lightColor = { 1.f, 1.f, 1.f };
+    p.phaseG = 0.5f;
+    p.modelNoiseScale = 0.55f;
+    p.cloudCoverage = 0.88f;
+    p.highFreqScale = 0.15f;
+    p.highFreqModScale = 0.3f;
+    p.highFreqHFScale = 10.f;
+    p.largeDtScale = 2.5f;
+    p.extinction = 10.f;
+    p.numSamples = 128;
+    p.beersScale = { 0.5f, 0.2f, 0.2f, 0.08f };
+    p.weatherRadius = { 700.f, 700.f };
+    p.minWeatherCoverage = 0.6f;
+    p.useBlueNoise = 1;
+    p.fixedDt = 1;
+    p.useAlpha = 1;
+    p.lodThresholds = { 0.5f, 1.1f, 1.1f, 0.5f };
+    p.innerShellRadius = 1.5f;
+    p.outerShellRadius = 7.f;
+    p.lightDir = Vector3f(0.f, std::sin(0.4f), std::cos(0.4f));
+
+    CloudMarchView& v = scene.view;
+    v.screenSize = { width, height };
+    v.cameraPos = { 3.f, 1.f, 20.f };
+    Matrix4x4f projection = PerspectiveProjectionMatrix4x4_RH_ZUp_ForwardY_HFOV((float)width / (float)height, 90.f, 0.1f, 1000.f, 0.f, 1.f);
+    Matrix4x4f viewMat = LookAtViewMatrix_RH_ZUp(v.cameraPos, Vector3f(0.f, 1.f, -0.6f).Normal());
+    v.invProjectionMat = projection.Inverse();
+    v.invViewMat = viewMat.Inverse();
+
+    return scene;
+}
+
+#endif // TESTS_CLOUD_TEST_SCENE_H_
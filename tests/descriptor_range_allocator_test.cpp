@@ -0,0 +1,143 @@
+#include <map>
+#include <random>
+#include <vector>
+
+#include "test_common.h"
+#include "memory/descriptor_range_allocator.h"
+
+TEST_CASE(BestFit) {
+    DescriptorRangeAllocator ranges(100);
+
+    const uint32_t a = ranges.Allocate(10);
+    const uint32_t b = ranges.Allocate(5);
+    const uint32_t c = ranges.Allocate(20);
+    const uint32_t d = ranges.Allocate(3);
+    CHECK(a == 0 && b == 10 && c == 15 && d == 35);
+
+    // free ranges of 5 and 20 (plus the tail of 62), a request for 4 takes the 5
+    ranges.Free(b, 5);
+    ranges.Free(c, 20);
+    CHECK(ranges.GetNumFreeRanges() == 2);
+    CHECK(ranges.Allocate(4) == b);
+
+    CHECK(ranges.Allocate(0) == DescriptorRangeAllocator::InvalidOffset);
+    CHECK(ranges.Allocate(101) == DescriptorRangeAllocator::InvalidOffset);
+}
+
+TEST_CASE(FreeCoalescesNeighbours) {
+    DescriptorRangeAllocator ranges(40);
+
+    uint32_t offsets[4];
+    for(uint32_t i = 0; i < 4; i++) {
+        offsets[i] = ranges.Allocate(10);
+        CHECK(offsets[i] == i * 10);
+    }
+    CHECK(ranges.GetNumFreeDescriptors() == 0);
+    CHECK(ranges.GetNumFreeRanges() == 0);
+
+    // no neighbours free yet
+    ranges.Free(offsets[0], 10);
+    ranges.Free(offsets[2], 10);
+    CHECK(ranges.GetNumFreeRanges() == 2);
+    CHECK(ranges.GetLargestFreeRange() == 10);
+
+    // merges with the range before and after it
+    ranges.Free(offsets[1], 10);
+    CHECK(ranges.GetNumFreeRanges() == 1);
+    CHECK(ranges.GetLargestFreeRange() == 30);
+
+    // merges with the range before it only
+    ranges.Free(offsets[3], 10);
+    CHECK(ranges.GetNumFreeRanges() == 1);
+    CHECK(ranges.GetLargestFreeRange() == 40);
+    CHECK(ranges.GetNumFreeDescriptors() == 40);
+    CHECK(ranges.Allocate(40) == 0);
+}
+
+TEST_CASE(DeferredFreeWaitsForFence) {
+    DescriptorRangeAllocator ranges(16);
+
+    const uint32_t a = ranges.Allocate(8);
+    const uint32_t b = ranges.Allocate(8);
+
+    // out of fence order on purpose
+    ranges.FreeDeferred(b, 8, 7);
+    ranges.FreeDeferred(a, 8, 5);
+    CHECK(ranges.GetNumPendingFrees() == 2);
+    CHECK(ranges.GetNumFreeDescriptors() == 0);
+    CHECK(ranges.Allocate(1) == DescriptorRangeAllocator::InvalidOffset);
+
+    // the GPU is still on frame 4
+    ranges.ReleaseCompleted(4);
+    CHECK(ranges.GetNumPendingFrees() == 2);
+    CHECK(ranges.GetNumFreeDescriptors() == 0);
+
+    ranges.ReleaseCompleted(5);
+    CHECK(ranges.GetNumPendingFrees() == 1);
+    CHECK(ranges.GetNumFreeDescriptors() == 8);
+    CHECK(ranges.Allocate(8) == a);
+    ranges.Free(a, 8);
+
+    // released ranges coalesce like immediate frees
+    ranges.ReleaseCompleted(9);
+    CHECK(ranges.GetNumPendingFrees() == 0);
+    CHECK(ranges.GetNumFreeRanges() == 1);
+    CHECK(ranges.GetLargestFreeRange() == 16);
+}
+
+TEST_CASE(RandomAllocationsStayConsistent) {
+    constexpr uint32_t HeapSize = 4096;
+    DescriptorRangeAllocator ranges(HeapSize);
+
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<uint32_t> sizeDist(1, 64);
+    std::uniform_int_distribution<int> actionDist(0, 3);
+
+    // offset -> size of the live ranges
+    std::map<uint32_t, uint32_t> live;
+    uint32_t liveDescriptors = 0;
+    uint64_t fence = 0;
+
+    for(int i = 0; i < 20000; i++) {
+        const int action = actionDist(rng);
+        if(action <= 1 || live.empty()) {
+            const uint32_t size = sizeDist(rng);
+            const uint32_t offset = ranges.Allocate(size);
+            if(offset == DescriptorRangeAllocator::InvalidOffset) {
+                CHECK(ranges.GetLargestFreeRange() < size);
+                continue;
+            }
+
+            const auto next = live.lower_bound(offset);
+            CHECK(next == live.end() || offset + size <= next->first);
+            if(next != live.begin()) {
+                CHECK(std::prev(next)->first + std::prev(next)->second <= offset);
+            }
+
+            live[offset] = size;
+            liveDescriptors += size;
+        }
+        else if(action == 2) {
+            auto it = live.begin();
+            std::advance(it, std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng));
+            ranges.FreeDeferred(it->first, it->second, fence + 2);
+            liveDescriptors -= it->second;
+            live.erase(it);
+        }
+        else {
+            // a frame boundary: the GPU finished everything up to two frames ago
+            fence++;
+            ranges.ReleaseCompleted(fence);
+        }
+
+        CHECK(ranges.GetNumFreeDescriptors() + liveDescriptors <= HeapSize);
+    }
+
+    ranges.ReleaseCompleted(fence + 2);
+    for(const auto& [offset, size] : live) {
+        ranges.Free(offset, size);
+    }
+    CHECK(ranges.GetNumPendingFrees() == 0);
+    CHECK(ranges.GetNumFreeRanges() == 1);
+    CHECK(ranges.GetNumFreeDescriptors() == HeapSize);
+}
@@ -0,0 +1,278 @@
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_common.h"
+#include "frame_graph.h"
+
+namespace states = frame_graph_states;
+
+namespace {
+
+    void LogPass(FrameGraphCommandList& cmdList, const std::string& event) {
+        static_cast<RecordingFrameGraphCommandList&>(cmdList).AddEvent("  " + event);
+    }
+
+    struct RendererGraph {
+        uint32_t cloudRT = 0;
+        uint32_t prevCloudRT = 0;
+        uint32_t blurPass = 0;
+    };
+
+    // the graph Cloudscaper::Render builds, frame 0 renders the clouds into RT0 and frame 1 into RT1,
+    // with the states the previous frame left the targets in. The compute queue leaves the SkyView LUT
+    // in NonPixelShaderResource.
+    RendererGraph BuildRendererGraph(FrameGraph& graph, uint32_t frame) {
+        RendererGraph rendererGraph;
+        const uint32_t skyView = graph.ImportResource("SkyView LUT", states::NonPixelShaderResource);
+        const uint32_t mainRT = graph.ImportResource("main_rt", frame == 0 ? states::RenderTarget : states::CopySource);
+        const uint32_t cloudRT0 = graph.ImportResource("RT0", frame == 0 ? states::Common : states::UnorderedAccess);
+        const uint32_t cloudRT1 = graph.ImportResource("RT1", states::Common);
+        const uint32_t blurOut = graph.ImportResource("Blur Output", states::Common);
+        const uint32_t swapChain = graph.ImportResource("swap chain", states::Present, true);
+        rendererGraph.cloudRT = frame == 0 ? cloudRT0 : cloudRT1;
+        rendererGraph.prevCloudRT = frame == 0 ? cloudRT1 : cloudRT0;
+
+        const uint32_t skyPass = graph.AddPass("Sky Render", [](FrameGraphCommandList& cmdList) { LogPass(cmdList, "draw sky"); });
+        graph.Read(skyPass, skyView, states::PixelShaderResource);
+        graph.Write(skyPass, mainRT, states::RenderTarget);
+
+        const uint32_t cloudsPass = graph.AddPass("Clouds Render", [](FrameGraphCommandList& cmdList) { LogPass(cmdList, "draw clouds"); });
+        graph.Read(cloudsPass, skyView, states::PixelShaderResource);
+        graph.Read(cloudsPass, rendererGraph.prevCloudRT, states::PixelShaderResource);
+        graph.Write(cloudsPass, rendererGraph.cloudRT, states::RenderTarget);
+
+        // nothing reads the blur output yet
+        rendererGraph.blurPass = graph.AddPass("blur cloud rt", [](FrameGraphCommandList& cmdList) { LogPass(cmdList, "blur"); });
+        graph.Read(rendererGraph.blurPass, rendererGraph.cloudRT, states::NonPixelShaderResource);
+        graph.Write(rendererGraph.blurPass, blurOut, states::UnorderedAccess);
+
+        const uint32_t blendPass = graph.AddPass("copy clouds to main", [](FrameGraphCommandList& cmdList) { LogPass(cmdList, "blend"); });
+        graph.Read(blendPass, rendererGraph.cloudRT, states::UnorderedAccess);
+        graph.Write(blendPass, mainRT, states::UnorderedAccess);
+
+        const uint32_t presentCopyPass = graph.AddPass("copy to swap chain", [](FrameGraphCommandList& cmdList) { LogPass(cmdList, "copy"); });
+        graph.Read(presentCopyPass, mainRT, states::CopySource);
+        graph.Write(presentCopyPass, swapChain, states::CopyDest);
+
+        graph.Compile();
+        return rendererGraph;
+    }
+
+} // namespace
+
+TEST_CASE(RendererGraphBarriers) {
+    FrameGraph graph;
+    const RendererGraph rendererGraph = BuildRendererGraph(graph, 0);
+    RecordingFrameGraphCommandList cmdList(graph);
+    graph.Execute(cmdList);
+
+    // both draws read the SkyView LUT in one state, the swap chain transition is split
+    // around the two levels it isn't used in
+    const std::vector<std::string> expected = {
+        "barriers",
+        "  SkyView LUT: NonPixelShaderResource -> PixelShaderResource",
+        "  RT0: Common -> RenderTarget",
+        "  RT1: Common -> PixelShaderResource",
+        "  swap chain: Common -> CopyDest (begin)",
+        "pass Sky Render",
+        "  draw sky",
+        "pass Clouds Render",
+        "  draw clouds",
+        "barriers",
+        "  main_rt: RenderTarget -> UnorderedAccess",
+        "  RT0: RenderTarget -> UnorderedAccess",
+        "pass copy clouds to main",
+        "  blend",
+        "barriers",
+        "  main_rt: UnorderedAccess -> CopySource",
+        "  swap chain: Common -> CopyDest (end)",
+        "pass copy to swap chain",
+        "  copy",
+    };
+    if(cmdList.GetEvents() != expected) {
+        cmdList.PrintEvents();
+    }
+    CHECK(cmdList.GetEvents() == expected);
+    CHECK(cmdList.GetBarrierBatches().size() == 3);
+
+    const FrameGraph::Stats& stats = graph.GetStats();
+    CHECK(stats.numPasses == 5 && stats.numLevels == 3 && stats.numBarrierBatches == 3);
+    CHECK(stats.numTransitions == 7 && stats.numSplitTransitions == 1 && stats.numUAVBarriers == 0);
+
+    CHECK(graph.GetFinalState(rendererGraph.cloudRT) == states::UnorderedAccess);
+    CHECK(graph.GetFinalState(rendererGraph.prevCloudRT) == states::PixelShaderResource);
+}
+
+TEST_CASE(RendererGraphSecondFrame) {
+    FrameGraph graph;
+    BuildRendererGraph(graph, 1);
+    RecordingFrameGraphCommandList cmdList(graph);
+    graph.Execute(cmdList);
+
+    // RT0 comes out of the previous frame's blend as a UAV, main_rt out of the present copy
+    const std::vector<std::vector<std::string>> expectedBatches = {
+        { "SkyView LUT: NonPixelShaderResource -> PixelShaderResource", "main_rt: CopySource -> RenderTarget", "RT0: UnorderedAccess -> PixelShaderResource", "RT1: Common -> RenderTarget", "swap chain: Common -> CopyDest (begin)" },
+        { "main_rt: RenderTarget -> UnorderedAccess", "RT1: RenderTarget -> UnorderedAccess" },
+        { "main_rt: UnorderedAccess -> CopySource", "swap chain: Common -> CopyDest (end)" },
+    };
+    const auto& batches = cmdList.GetBarrierBatches();
+    CHECK(batches.size() == expectedBatches.size());
+    for(size_t i = 0; i < batches.size(); i++) {
+        CHECK(batches[i].size() == expectedBatches[i].size());
+        for(size_t j = 0; j < batches[i].size(); j++) {
+            const FrameGraphBarrier& barrier = batches[i][j];
+            std::string text = graph.GetResourceName(barrier.resource) + ": " + states::ToString(barrier.before) + " -> " + states::ToString(barrier.after);
+            if(barrier.split == FrameGraphBarrier::Split::Begin) {
+                text += " (begin)";
+            } else if(barrier.split == FrameGraphBarrier::Split::End) {
+                text += " (end)";
+            }
+            CHECK(text == expectedBatches[i][j]);
+        }
+    }
+}
+
+TEST_CASE(UnusedBlurPassIsCulled) {
+    for(uint32_t frame = 0; frame < 2; frame++) {
+        FrameGraph graph;
+        const RendererGraph rendererGraph = BuildRendererGraph(graph, frame);
+        CHECK(graph.IsCulled(rendererGraph.blurPass));
+        CHECK(graph.GetStats().numCulledPasses == 1);
+
+        RecordingFrameGraphCommandList cmdList(graph);
+        graph.Execute(cmdList);
+        for(const std::string& event : cmdList.GetEvents()) {
+            CHECK(event != "pass blur cloud rt" && event != "  blur");
+            // its read of the cloud target doesn't widen the blend's state either
+            const bool cloudTarget = event.rfind("  RT0:", 0) == 0 || event.rfind("  RT1:", 0) == 0;
+            CHECK(!cloudTarget || event.find("NonPixelShaderResource") == std::string::npos);
+        }
+    }
+}
+
+TEST_CASE(LevelBatchesReadUnionAndUAVBarriers) {
+    FrameGraph graph;
+    const uint32_t a = graph.ImportResource("A", states::Common);
+    const uint32_t b = graph.ImportResource("B", states::Common);
+    const uint32_t c = graph.ImportResource("C", states::Common, true);
+    const uint32_t u = graph.ImportResource("U", states::UnorderedAccess);
+
+    const uint32_t writeA = graph.AddPass("write A", {});
+    graph.Write(writeA, a, states::RenderTarget);
+    const uint32_t writeB = graph.AddPass("write B", {});
+    graph.Write(writeB, b, states::UnorderedAccess);
+    const uint32_t readA = graph.AddPass("read A ps", {});
+    graph.Read(readA, a, states::PixelShaderResource);
+    graph.Write(readA, u, states::UnorderedAccess);
+    const uint32_t readAB = graph.AddPass("read A copy, B", {});
+    graph.Read(readAB, a, states::CopySource);
+    graph.Read(readAB, b, states::NonPixelShaderResource);
+    graph.Write(readAB, c, states::CopyDest);
+    const uint32_t readU = graph.AddPass("uav again", {});
+    graph.Read(readU, u, states::UnorderedAccess);
+    graph.Write(readU, c, states::RenderTarget);
+    // only reads, nothing depends on it
+    const uint32_t unused = graph.AddPass("read A npsr", {});
+    graph.Read(unused, a, states::NonPixelShaderResource);
+    graph.Compile();
+
+    CHECK(graph.IsCulled(unused));
+    CHECK((graph.GetPassOrder() == std::vector<uint32_t>{ writeA, writeB, readA, readAB, readU }));
+
+    RecordingFrameGraphCommandList cmdList(graph);
+    graph.Execute(cmdList);
+    const std::vector<std::string> expected = {
+        "barriers",
+        "  A: Common -> RenderTarget",
+        "  B: Common -> UnorderedAccess",
+        "  C: Common -> CopyDest (begin)",
+        "pass write A",
+        "pass write B",
+        "barriers",
+        "  A: RenderTarget -> PixelShaderResource|CopySource",
+        "  B: UnorderedAccess -> NonPixelShaderResource",
+        "  C: Common -> CopyDest (end)",
+        "pass read A ps",
+        "pass read A copy, B",
+        "barriers",
+        "  C: CopyDest -> RenderTarget",
+        "  U: UAV",
+        "pass uav again",
+    };
+    if(cmdList.GetEvents() != expected) {
+        cmdList.PrintEvents();
+    }
+    CHECK(cmdList.GetEvents() == expected);
+
+    const FrameGraph::Stats& stats = graph.GetStats();
+    CHECK(stats.numLevels == 3 && stats.numBarrierBatches == 3);
+    CHECK(stats.numTransitions == 6 && stats.numSplitTransitions == 1 && stats.numUAVBarriers == 1);
+    CHECK(graph.GetFinalState(a) == (states::PixelShaderResource | states::CopySource));
+    CHECK(graph.GetFinalState(c) == states::RenderTarget);
+}
+
+TEST_CASE(ParallelRecordingMatchesSerial) {
+    constexpr uint32_t NumResources = 16;
+    constexpr uint32_t NumPasses = 64;
+    constexpr uint32_t NumThreads = 4;
+
+    // the last resource is the output, every 7th pass writes it
+    FrameGraph graph;
+    std::vector<uint32_t> resources;
+    for(uint32_t i = 0; i < NumResources; i++) {
+        resources.push_back(graph.ImportResource("r" + std::to_string(i), states::Common, i == NumResources - 1));
+    }
+
+    const FrameGraphStates readStates[] = { states::PixelShaderResource, states::NonPixelShaderResource, states::CopySource, states::UnorderedAccess };
+    const FrameGraphStates writeStates[] = { states::RenderTarget, states::UnorderedAccess, states::CopyDest };
+    uint32_t seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+    for(uint32_t p = 0; p < NumPasses; p++) {
+        const uint32_t pass = graph.AddPass("p" + std::to_string(p), [p](FrameGraphCommandList& cmdList) { LogPass(cmdList, "work " + std::to_string(p)); });
+        const uint32_t written = random() % (NumResources - 1);
+        uint32_t read = random() % (NumResources - 1);
+        if(read == written) {
+            read = (read + 1) % (NumResources - 1);
+        }
+        graph.Read(pass, resources[read], readStates[random() % 4]);
+        graph.Write(pass, resources[written], writeStates[random() % 3]);
+        if(p % 7 == 0) {
+            graph.Write(pass, resources[NumResources - 1], states::UnorderedAccess);
+        }
+    }
+    graph.Compile();
+
+    RecordingFrameGraphCommandList serial(graph);
+    graph.Execute(serial);
+
+    // every pass into its own list, passes spread over the threads
+    const std::vector<uint32_t>& order = graph.GetPassOrder();
+    std::vector<std::unique_ptr<RecordingFrameGraphCommandList>> cmdLists;
+    for(size_t i = 0; i < order.size(); i++) {
+        cmdLists.push_back(std::make_unique<RecordingFrameGraphCommandList>(graph));
+    }
+    std::vector<std::thread> threads;
+    for(uint32_t t = 0; t < NumThreads; t++) {
+        threads.emplace_back([&, t]() {
+            for(size_t i = t; i < order.size(); i += NumThreads) {
+                graph.ExecutePass(order[i], *cmdLists[i]);
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<std::string> merged;
+    for(const auto& cmdList : cmdLists) {
+        merged.insert(merged.end(), cmdList->GetEvents().begin(), cmdList->GetEvents().end());
+    }
+    CHECK(!order.empty() && order.size() + graph.GetStats().numCulledPasses == NumPasses);
+    CHECK(graph.GetStats().numBarrierBatches > 1);
+    CHECK(merged == serial.GetEvents());
+}
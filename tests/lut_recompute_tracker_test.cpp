@@ -0,0 +1,122 @@
+#include <string>
+#include <vector>
+
+#include "test_common.h"
+#include "cloudscapes/lut_recompute_tracker.h"
+
+namespace {
+
+    // the atmosphere chain UpdateAtmosphereLUTs runs
+    struct AtmosphereChain {
+        LUTRecomputeTracker tracker;
+        uint32_t transmittance = tracker.AddLUT("transmittance");
+        uint32_t multiScattering = tracker.AddLUT("multiscattering", { transmittance });
+        uint32_t skyView = tracker.AddLUT("skyview", { transmittance, multiScattering });
+
+        std::vector<std::string> recomputed;
+
+        // one frame, returns which LUTs ran in order
+        std::vector<std::string> Update(uint64_t transmittanceHash, uint64_t multiScatteringHash, uint64_t skyViewHash) {
+            recomputed.clear();
+            for(const auto& [lut, hash] : { std::pair(transmittance, transmittanceHash),
+                                            std::pair(multiScattering, multiScatteringHash),
+                                            std::pair(skyView, skyViewHash) }) {
+                tracker.Update(lut, hash, [&, lut = lut]() {
+                    recomputed.push_back(tracker.GetName(lut));
+                    return true;
+                });
+            }
+            return recomputed;
+        }
+    };
+
+    const std::vector<std::string> All = { "transmittance", "multiscattering", "skyview" };
+
+} // namespace
+
+TEST_CASE(RecomputesOnlyWhenInputsChange) {
+    LUTRecomputeTracker tracker;
+    const uint32_t lut = tracker.AddLUT("lut");
+
+    int numRuns = 0;
+    auto run = [&]() {
+        numRuns++;
+        return true;
+    };
+
+    CHECK(tracker.IsOutOfDate(lut, 1));
+    CHECK(tracker.Update(lut, 1, run));
+    CHECK(!tracker.IsOutOfDate(lut, 1));
+    CHECK(!tracker.Update(lut, 1, run));
+    CHECK(!tracker.Update(lut, 1, run));
+    CHECK(numRuns == 1);
+
+    CHECK(tracker.Update(lut, 2, run));
+    CHECK(numRuns == 2);
+
+    // going back to earlier inputs is a change too, only one hash is remembered
+    CHECK(tracker.Update(lut, 1, run));
+    CHECK(numRuns == 3);
+
+    CHECK(tracker.GetStats(lut).numRecomputes == 3);
+    CHECK(tracker.GetStats(lut).numSkips == 2);
+}
+
+TEST_CASE(ChangesRippleDownTheChain) {
+    AtmosphereChain chain;
+    CHECK(chain.Update(1, 1, 1) == All);
+    CHECK(chain.Update(1, 1, 1).empty());
+
+    // only the LUT whose inputs changed and whatever reads it, in the same frame
+    CHECK(chain.Update(1, 1, 2) == std::vector<std::string> { "skyview" });
+    CHECK(chain.Update(1, 2, 2) == (std::vector<std::string> { "multiscattering", "skyview" }));
+    CHECK(chain.Update(2, 2, 2) == All);
+    CHECK(chain.Update(2, 2, 2).empty());
+}
+
+TEST_CASE(FailedRecomputeIsRetried) {
+    AtmosphereChain chain;
+    CHECK(chain.Update(1, 1, 1) == All);
+
+    // the multiscattering pipeline is still compiling: nothing is recorded, skyview keeps the old one
+    bool ready = false;
+    int numAttempts = 0;
+    auto tryRecompute = [&]() {
+        numAttempts++;
+        return ready;
+    };
+    CHECK(!chain.tracker.Update(chain.multiScattering, 2, tryRecompute));
+    CHECK(!chain.tracker.Update(chain.skyView, 1, []() { return true; }));
+    CHECK(chain.tracker.IsOutOfDate(chain.multiScattering, 2));
+    CHECK(!chain.tracker.Update(chain.multiScattering, 2, tryRecompute));
+    CHECK(numAttempts == 2);
+
+    ready = true;
+    CHECK(chain.tracker.Update(chain.multiScattering, 2, tryRecompute));
+    CHECK(chain.tracker.IsOutOfDate(chain.skyView, 1));
+    CHECK(chain.tracker.GetStats(chain.multiScattering).numRecomputes == 2);
+}
+
+TEST_CASE(WaitsForDependenciesThatWereNeverWritten) {
+    AtmosphereChain chain;
+
+    bool ran = false;
+    CHECK(!chain.tracker.Update(chain.skyView, 1, [&]() {
+        ran = true;
+        return true;
+    }));
+    CHECK(!ran);
+
+    // a dependency that failed its first recompute is still unwritten
+    CHECK(!chain.tracker.Update(chain.transmittance, 1, []() { return false; }));
+    CHECK(chain.Update(1, 1, 1) == All);
+}
+
+TEST_CASE(InvalidateForcesARecompute) {
+    AtmosphereChain chain;
+    CHECK(chain.Update(1, 1, 1) == All);
+
+    chain.tracker.Invalidate(chain.multiScattering);
+    CHECK(chain.Update(1, 1, 1) == (std::vector<std::string> { "multiscattering", "skyview" }));
+    CHECK(chain.Update(1, 1, 1).empty());
+}
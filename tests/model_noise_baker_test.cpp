@@ -0,0 +1,42 @@
+#include <atomic>
+
+#include "test_common.h"
+#include "cloudscapes/model_noise_baker.h"
+
+using namespace ninmath;
+using namespace ninmath::noise;
+
+TEST_CASE(BakeMatchesScalarModelNoise) {
+    ModelNoiseBaker baker({}, 2);
+    const NoiseVolume volume = baker.Bake(8);
+    const ModelNoiseParameters& params = baker.GetParameters();
+
+    for(uint32_t z = 0; z < volume.depth; z += 3) {
+        for(uint32_t y = 0; y < volume.height; y += 3) {
+            for(uint32_t x = 0; x < volume.width; x++) {
+                const Vector4f expected = ModelNoise(Vector3f((float)x, (float)y, (float)z) * params.coordScale, params);
+                const Vector4f& texel = volume.At(x, y, z);
+                CHECK(texel.x == expected.x && texel.y == expected.y && texel.z == expected.z && texel.w == expected.w);
+            }
+        }
+    }
+}
+
+TEST_CASE(CancelledBakeReturnsEarly) {
+    std::atomic_bool cancelled = true;
+
+    ModelNoiseBaker baker({}, 2);
+    baker.SetCancelFlag(&cancelled);
+
+    // no slice starts once the flag is set, so the volume stays zeroed
+    NoiseVolume volume(16, 16, 16);
+    CHECK(!baker.Bake(volume, NoiseVolumeType::Detail));
+    CHECK(baker.IsCancelled());
+    for(const Vector4f& texel : volume.texels) {
+        CHECK(texel.x == 0.f && texel.y == 0.f && texel.z == 0.f);
+    }
+
+    cancelled = false;
+    CHECK(baker.Bake(volume, NoiseVolumeType::Detail));
+    CHECK(!baker.IsCancelled());
+}
@@ -0,0 +1,114 @@
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "test_common.h"
+#include "ninmath/noise_simd.h"
+
+using namespace ninmath;
+using namespace ninmath::noise;
+
+namespace {
+
+    // 1031 isn't a multiple of any batch width, so the scalar tail runs as well
+    constexpr size_t NumSamples = 1031;
+
+    struct Samples {
+        std::vector<float> x, y, z;
+    };
+
+    Samples MakeSamples(float minCoord, float maxCoord, uint32_t rngSeed) {
+        std::mt19937 rng(rngSeed);
+        std::uniform_real_distribution<float> dist(minCoord, maxCoord);
+
+        Samples samples;
+        for(size_t i = 0; i < NumSamples; i++) {
+            samples.x.push_back(dist(rng));
+            samples.y.push_back(dist(rng));
+            samples.z.push_back(dist(rng));
+        }
+
+        // integral coordinates and cell borders
+        for(size_t i = 0; i < 16; i++) {
+            samples.x[i] = std::floor(samples.x[i]);
+            samples.y[i + 16] = std::floor(samples.y[i + 16]);
+        }
+        return samples;
+    }
+
+    bool BitIdentical(float a, float b) {
+        uint32_t ua, ub;
+        std::memcpy(&ua, &a, sizeof(float));
+        std::memcpy(&ub, &b, sizeof(float));
+        return ua == ub;
+    }
+
+    // every level the binary and the cpu support, scalar included
+    std::vector<SimdLevel> GetTestedLevels() {
+        std::vector<SimdLevel> levels;
+        for(int level = 0; level <= (int)GetSimdLevel(); level++) {
+            levels.push_back((SimdLevel)level);
+        }
+        return levels;
+    }
+
+    template <typename BatchFunc, typename ScalarFunc>
+    size_t CountMismatches(const Samples& samples, BatchFunc batchFunc, ScalarFunc scalarFunc) {
+        size_t mismatches = 0;
+        for(SimdLevel level : GetTestedLevels()) {
+            std::vector<float> out(NumSamples);
+            batchFunc(samples.x.data(), samples.y.data(), samples.z.data(), out.data(), NumSamples, level);
+
+            for(size_t i = 0; i < NumSamples; i++) {
+                const float expected = scalarFunc(Vector3f(samples.x[i], samples.y[i], samples.z[i]));
+                if(!BitIdentical(out[i], expected)) {
+                    if(mismatches == 0) {
+                        std::cerr << SimdLevelToString(level) << " sample " << i << ": " << out[i]
+                                  << " != " << expected << std::endl;
+                    }
+                    mismatches++;
+                }
+            }
+        }
+        return mismatches;
+    }
+
+} // namespace
+
+TEST_CASE(PerlinNMatchesScalar) {
+    // negative coordinates go through the signed hash path
+    const Samples samples = MakeSamples(-64.f, 64.f, 1);
+    const uint32_t seeds[] = { DefaultPerlinSeed, 0u, 0xdeadbeefU };
+
+    for(uint32_t seed : seeds) {
+        CHECK(CountMismatches(samples,
+            [seed](const float* x, const float* y, const float* z, float* out, size_t count, SimdLevel level) {
+                PerlinN(x, y, z, out, count, seed, level);
+            },
+            [seed](Vector3f p) { return Perlin(p, seed); }) == 0);
+    }
+}
+
+TEST_CASE(WorleyNMatchesScalar) {
+    const Samples samples = MakeSamples(-2.f, 2.f, 2);
+
+    // the model noise octaves, plus a non-integral scale that falls back to scalar
+    const float scales[] = { 4.f, 8.f, 16.f, 32.f, 56.f, 64.f, 3.5f };
+    for(float scale : scales) {
+        CHECK(CountMismatches(samples,
+            [scale](const float* x, const float* y, const float* z, float* out, size_t count, SimdLevel level) {
+                WorleyN(x, y, z, scale, out, count, level);
+            },
+            [scale](Vector3f p) { return Worley(p, scale); }) == 0);
+    }
+}
+
+TEST_CASE(PerlinFBMNMatchesScalar) {
+    const Samples samples = MakeSamples(-1.f, 1.f, 3);
+
+    CHECK(CountMismatches(samples,
+        [](const float* x, const float* y, const float* z, float* out, size_t count, SimdLevel level) {
+            PerlinFBMN(x, y, z, out, count, DefaultPerlinSeed, level);
+        },
+        [](Vector3f p) { return PerlinFBM(p); }) == 0);
+}
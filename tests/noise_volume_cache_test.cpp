@@ -0,0 +1,171 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "test_common.h"
+#include "noise_volume_cache.h"
+
+using ninmath::Vector4f;
+
+namespace {
+
+    constexpr uint32_t Resolution = 8;
+    constexpr uint32_t NumMips = 3;
+
+    // fresh cache directory per test case, in the system's temp directory
+    std::filesystem::path GetTestDirectory(const std::string& name) {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "cloudscaper_noise_volume_cache_test" / name;
+        std::filesystem::remove_all(dir);
+        return dir;
+    }
+
+    std::vector<NoiseVolume> MakeMips() {
+        NoiseVolume mip0(Resolution, Resolution, Resolution);
+        for(size_t i = 0; i < mip0.GetNumTexels(); i++) {
+            const float v = (float)(i % 97) / 96.f;
+            mip0.texels[i] = Vector4f(v, 1.f - v, v * v, 0.5f);
+        }
+        return GenerateNoiseVolumeMipChain(std::move(mip0), NumMips);
+    }
+
+    uint64_t GetKey() {
+        return ComputeNoiseVolumeKey(NoiseVolumeType::Model, ninmath::noise::ModelNoiseParameters(), Resolution, NumMips);
+    }
+
+} // namespace
+
+TEST_CASE(RoundTrip) {
+    const NoiseVolumeCache cache(GetTestDirectory("round_trip"));
+    const std::vector<NoiseVolume> mips = MakeMips();
+    CHECK(cache.Store(GetKey(), NoiseVolumeType::Model, mips));
+
+    const std::shared_ptr<MappedNoiseVolume> volume = cache.Load(GetKey());
+    CHECK(volume);
+    CHECK(volume->GetType() == NoiseVolumeType::Model);
+    CHECK(volume->GetFormat() == NoiseVolumeFormat::RGBA32F);
+    CHECK(volume->GetNumMips() == NumMips);
+
+    for(uint32_t i = 0; i < NumMips; i++) {
+        const NoiseVolumeMipInfo& info = volume->GetMipInfo(i);
+        CHECK(info.width == mips[i].width && info.height == mips[i].height && info.depth == mips[i].depth);
+        CHECK(info.offset % NoiseVolumeFileDataAlignment == 0);
+        CHECK(info.size == mips[i].GetNumTexels() * sizeof(Vector4f));
+        CHECK(std::memcmp(volume->GetMipData(i), mips[i].texels.data(), info.size) == 0);
+    }
+
+    // no temporary file left behind
+    std::filesystem::path tmpPath = cache.GetFilePath(GetKey());
+    tmpPath += ".tmp";
+    CHECK(!std::filesystem::exists(tmpPath));
+}
+
+TEST_CASE(EncodedRoundTrip) {
+    const NoiseVolumeCache cache(GetTestDirectory("encoded_round_trip"));
+    std::vector<EncodedNoiseVolume> mips;
+    for(const NoiseVolume& mip : MakeMips()) {
+        mips.push_back(EncodeNoiseVolume(mip, NoiseVolumeFormat::BC4Planes));
+    }
+    CHECK(cache.Store(GetKey(), NoiseVolumeType::Detail, mips));
+
+    const std::shared_ptr<MappedNoiseVolume> volume = cache.Load(GetKey());
+    CHECK(volume);
+    CHECK(volume->GetType() == NoiseVolumeType::Detail);
+    CHECK(volume->GetFormat() == NoiseVolumeFormat::BC4Planes);
+    for(uint32_t i = 0; i < NumMips; i++) {
+        CHECK(volume->GetMipInfo(i).size == mips[i].data.size());
+        CHECK(std::memcmp(volume->GetMipData(i), mips[i].data.data(), mips[i].data.size()) == 0);
+    }
+
+    // mixed formats can't share a file
+    mips[1] = EncodeNoiseVolume(MakeMips()[1], NoiseVolumeFormat::RGBA8);
+    CHECK(!cache.Store(GetKey(), NoiseVolumeType::Detail, mips));
+}
+
+TEST_CASE(WrongKey) {
+    const NoiseVolumeCache cache(GetTestDirectory("wrong_key"));
+    CHECK(cache.Store(GetKey(), NoiseVolumeType::Model, MakeMips()));
+
+    // other parameters hash to another file
+    ninmath::noise::ModelNoiseParameters params;
+    params.perlinSeed++;
+    const uint64_t otherKey = ComputeNoiseVolumeKey(NoiseVolumeType::Model, params, Resolution, NumMips);
+    CHECK(otherKey != GetKey());
+    CHECK(cache.Load(otherKey) == nullptr);
+
+    // a file whose header carries another key is stale, even under the right name
+    std::filesystem::copy_file(cache.GetFilePath(GetKey()), cache.GetFilePath(otherKey));
+    CHECK(cache.Load(otherKey) == nullptr);
+    CHECK(cache.Load(GetKey()) != nullptr);
+}
+
+TEST_CASE(TruncatedFile) {
+    const NoiseVolumeCache cache(GetTestDirectory("truncated"));
+    CHECK(cache.Store(GetKey(), NoiseVolumeType::Model, MakeMips()));
+
+    const std::filesystem::path path = cache.GetFilePath(GetKey());
+    const uintmax_t fileSize = std::filesystem::file_size(path);
+    std::vector<char> bytes(fileSize);
+    std::ifstream(path, std::ios::binary).read(bytes.data(), (std::streamsize)fileSize);
+
+    // inside the header, the padding, and every mip
+    const uintmax_t sizes[] = { 0, 4, sizeof(NoiseVolumeFileHeader) - 1, sizeof(NoiseVolumeFileHeader),
+                                NoiseVolumeFileDataAlignment + 1, fileSize / 2, fileSize - 1 };
+    for(uintmax_t size : sizes) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), (std::streamsize)size);
+        CHECK(cache.Load(GetKey()) == nullptr);
+    }
+}
+
+TEST_CASE(CorruptHeader) {
+    const NoiseVolumeCache cache(GetTestDirectory("corrupt"));
+    CHECK(cache.Store(GetKey(), NoiseVolumeType::Model, MakeMips()));
+
+    const std::filesystem::path path = cache.GetFilePath(GetKey());
+    const uintmax_t fileSize = std::filesystem::file_size(path);
+    std::vector<char> bytes(fileSize);
+    std::ifstream(path, std::ios::binary).read(bytes.data(), (std::streamsize)fileSize);
+
+    NoiseVolumeFileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    auto loadWith = [&](const NoiseVolumeFileHeader& changed) {
+        std::vector<char> corrupt = bytes;
+        std::memcpy(corrupt.data(), &changed, sizeof(changed));
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(corrupt.data(), (std::streamsize)corrupt.size());
+        return cache.Load(GetKey());
+    };
+
+    NoiseVolumeFileHeader changed = header;
+    changed.version++;
+    CHECK(loadWith(changed) == nullptr);
+
+    changed = header;
+    changed.magic = 0;
+    CHECK(loadWith(changed) == nullptr);
+
+    changed = header;
+    changed.numMips = NoiseVolumeFileMaxMips + 1;
+    CHECK(loadWith(changed) == nullptr);
+
+    // a mip size that doesn't match its dimensions, or runs past the end of the file
+    changed = header;
+    changed.mips[0].width *= 2;
+    CHECK(loadWith(changed) == nullptr);
+
+    changed = header;
+    changed.mips[NumMips - 1].offset = fileSize;
+    CHECK(loadWith(changed) == nullptr);
+
+    CHECK(loadWith(header) != nullptr);
+}
+
+TEST_CASE(MissingFile) {
+    const NoiseVolumeCache cache(GetTestDirectory("missing"));
+    CHECK(cache.Load(GetKey()) == nullptr);
+
+    // nothing to store, nothing written
+    CHECK(!cache.Store(GetKey(), NoiseVolumeType::Model, std::vector<NoiseVolume>()));
+    CHECK(!std::filesystem::exists(cache.GetFilePath(GetKey())));
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "test_common.h"
+#include "noise_volume_format.h"
+
+using ninmath::Vector4f;
+
+namespace {
+
+    float FromBits(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // smooth in x/y/z with a different range per channel, like the noise volumes
+    NoiseVolume MakeVolume(uint32_t width, uint32_t height, uint32_t depth) {
+        NoiseVolume volume(width, height, depth);
+        for(uint32_t z = 0; z < depth; z++) {
+            for(uint32_t y = 0; y < height; y++) {
+                for(uint32_t x = 0; x < width; x++) {
+                    const float s = std::sin((float)x * 0.7f + (float)y * 0.3f) * std::cos((float)z * 0.5f);
+                    volume.At(x, y, z) = Vector4f(0.5f + 0.5f * s, 0.25f + 0.1f * s, (float)x / (float)width, 0.75f);
+                }
+            }
+        }
+        return volume;
+    }
+
+} // namespace
+
+TEST_CASE(HalfKnownValues) {
+    CHECK(FloatToHalf(0.f) == 0x0000);
+    CHECK(FloatToHalf(-0.f) == 0x8000);
+    CHECK(FloatToHalf(1.f) == 0x3c00);
+    CHECK(FloatToHalf(-2.f) == 0xc000);
+    CHECK(FloatToHalf(0.5f) == 0x3800);
+    CHECK(FloatToHalf(65504.f) == 0x7bff);
+
+    // smallest normal, largest and smallest denormal
+    CHECK(FloatToHalf(std::ldexp(1.f, -14)) == 0x0400);
+    CHECK(FloatToHalf(std::ldexp(1023.f, -24)) == 0x03ff);
+    CHECK(FloatToHalf(std::ldexp(1.f, -24)) == 0x0001);
+    CHECK(FloatToHalf(-std::ldexp(3.f, -24)) == 0x8003);
+    CHECK(HalfToFloat(0x0001) == std::ldexp(1.f, -24));
+    CHECK(HalfToFloat(0x03ff) == std::ldexp(1023.f, -24));
+    CHECK(HalfToFloat(0x8400) == -std::ldexp(1.f, -14));
+
+    // below half the smallest denormal flushes to a signed zero, exactly half rounds to even (zero)
+    CHECK(FloatToHalf(std::ldexp(1.f, -26)) == 0x0000);
+    CHECK(FloatToHalf(-std::ldexp(1.f, -25)) == 0x8000);
+    CHECK(FloatToHalf(std::ldexp(1.5f, -25)) == 0x0001);
+    CHECK(FloatToHalf(std::ldexp(3.f, -25)) == 0x0002);
+    CHECK(FloatToHalf(std::ldexp(5.f, -25)) == 0x0002);
+    // a denormal that rounds up into the smallest normal
+    CHECK(FloatToHalf(std::ldexp(2047.f, -25)) == 0x0400);
+
+    // infinities, overflow and nans
+    const float inf = std::numeric_limits<float>::infinity();
+    CHECK(FloatToHalf(inf) == 0x7c00);
+    CHECK(FloatToHalf(-inf) == 0xfc00);
+    CHECK(FloatToHalf(1e6f) == 0x7c00);
+    CHECK(FloatToHalf(-1e6f) == 0xfc00);
+    CHECK(FloatToHalf(65519.f) == 0x7bff);
+    CHECK(FloatToHalf(65520.f) == 0x7c00);
+    const uint16_t nan = FloatToHalf(std::numeric_limits<float>::quiet_NaN());
+    CHECK((nan & 0x7c00) == 0x7c00 && (nan & 0x3ff) != 0);
+    CHECK(std::isnan(HalfToFloat(nan)));
+    // a signalling nan whose payload sits below the half mantissa doesn't turn into inf
+    CHECK((FloatToHalf(FromBits(0x7f800001)) & 0x3ff) != 0);
+    CHECK(HalfToFloat(0x7c00) == inf);
+    CHECK(HalfToFloat(0xfc00) == -inf);
+}
+
+TEST_CASE(HalfRoundsToNearestEven) {
+    // 1 + 2^-11 is halfway between 1 and the next half, 1 + 3 * 2^-11 halfway between the next two
+    CHECK(FloatToHalf(1.f + std::ldexp(1.f, -11)) == 0x3c00);
+    CHECK(FloatToHalf(1.f + std::ldexp(3.f, -11)) == 0x3c02);
+    CHECK(FloatToHalf(1.f + std::ldexp(1.f, -11) + std::ldexp(1.f, -20)) == 0x3c01);
+    CHECK(FloatToHalf(-(1.f + std::ldexp(3.f, -11))) == 0xbc02);
+    // the rounding carry moves into the exponent
+    CHECK(FloatToHalf(2.f - std::ldexp(1.f, -12)) == 0x4000);
+}
+
+TEST_CASE(HalfRoundTrip) {
+    // every finite half survives half -> float -> half
+    for(uint32_t h = 0; h < 0x10000; h++) {
+        if((h & 0x7c00) == 0x7c00) {
+            continue;
+        }
+        CHECK(FloatToHalf(HalfToFloat((uint16_t)h)) == h);
+    }
+}
+
+TEST_CASE(LosslessAndUnormFormats) {
+    const NoiseVolume volume = MakeVolume(8, 8, 4);
+
+    const NoiseVolumeQualityReport rgba32f = MeasureNoiseVolumeQuality(volume, EncodeNoiseVolume(volume, NoiseVolumeFormat::RGBA32F));
+    CHECK(rgba32f.maxErrorAll == 0.f && rgba32f.rmsErrorAll == 0.f);
+    CHECK(rgba32f.compressionRatio == 1.f);
+
+    // values in [0, 1]: half precision is at least 2^-11 relative
+    const NoiseVolumeQualityReport rgba16f = MeasureNoiseVolumeQuality(volume, EncodeNoiseVolume(volume, NoiseVolumeFormat::RGBA16F));
+    CHECK(rgba16f.maxErrorAll <= std::ldexp(1.f, -12));
+    CHECK(rgba16f.compressionRatio == 2.f);
+
+    const NoiseVolumeQualityReport rgba8 = MeasureNoiseVolumeQuality(volume, EncodeNoiseVolume(volume, NoiseVolumeFormat::RGBA8));
+    CHECK(rgba8.maxErrorAll <= 0.5f / 255.f + 1e-6f);
+    CHECK(rgba8.rmsErrorAll <= rgba8.maxErrorAll && rgba8.rmsErrorAll > 0.f);
+    CHECK(rgba8.compressionRatio == 4.f);
+}
+
+TEST_CASE(BC4RoundTripErrorBound) {
+    // 6x5 leaves partial blocks in x and y
+    for(const NoiseVolume& volume : { MakeVolume(16, 16, 4), MakeVolume(6, 5, 2) }) {
+        const EncodedNoiseVolume encoded = EncodeNoiseVolume(volume, NoiseVolumeFormat::BC4Planes);
+        CHECK(encoded.data.size() == 4 * encoded.GetPlaneSize());
+        const NoiseVolume decoded = DecodeNoiseVolume(encoded);
+
+        // within a block the error is at most half the palette step plus the endpoint quantization
+        for(uint32_t c = 0; c < 4; c++) {
+            for(uint32_t z = 0; z < volume.depth; z++) {
+                for(uint32_t by = 0; by < volume.height; by += 4) {
+                    for(uint32_t bx = 0; bx < volume.width; bx += 4) {
+                        float minVal = 1.f;
+                        float maxVal = 0.f;
+                        for(uint32_t y = by; y < std::min(by + 4, volume.height); y++) {
+                            for(uint32_t x = bx; x < std::min(bx + 4, volume.width); x++) {
+                                minVal = std::min(minVal, (&volume.At(x, y, z).x)[c]);
+                                maxVal = std::max(maxVal, (&volume.At(x, y, z).x)[c]);
+                            }
+                        }
+
+                        const float bound = (maxVal - minVal) / 14.f + 1.f / 255.f;
+                        for(uint32_t y = by; y < std::min(by + 4, volume.height); y++) {
+                            for(uint32_t x = bx; x < std::min(bx + 4, volume.width); x++) {
+                                CHECK(std::abs((&decoded.At(x, y, z).x)[c] - (&volume.At(x, y, z).x)[c]) <= bound);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // the constant alpha channel only carries the endpoint quantization
+        const NoiseVolumeQualityReport report = MeasureNoiseVolumeQuality(volume, encoded);
+        CHECK(report.maxError[3] <= 0.5f / 255.f + 1e-6f);
+        CHECK(report.maxErrorAll < 1.f / 14.f + 1.f / 255.f);
+        CHECK(report.rmsErrorAll <= report.maxErrorAll);
+    }
+
+    // four 1 byte channels -> four 8 byte blocks per 16 texels
+    const NoiseVolume volume = MakeVolume(16, 16, 4);
+    CHECK(MeasureNoiseVolumeQuality(volume, EncodeNoiseVolume(volume, NoiseVolumeFormat::BC4Planes)).compressionRatio == 8.f);
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "test_common.h"
+#include "memory/offset_allocator.h"
+
+namespace {
+    constexpr uint64_t KiB = 1024;
+    constexpr uint64_t MiB = 1024 * KiB;
+}
+
+TEST_CASE(ExactlySizedHeap) {
+    // what Commit() used to do: a heap exactly as large as its placements
+    OffsetAllocator allocator(3 * PlacementAlignment64K + 2 * PlacementAlignment64K);
+
+    const OffsetAllocation a = allocator.Allocate(3 * PlacementAlignment64K);
+    const OffsetAllocation b = allocator.Allocate(2 * PlacementAlignment64K);
+    CHECK(a.IsValid() && b.IsValid());
+    CHECK(a.offset == 0 && b.offset == 3 * PlacementAlignment64K);
+
+    const OffsetAllocatorStats stats = allocator.GetStats();
+    CHECK(stats.freeSize == 0 && stats.numFreeBlocks == 0 && stats.numAllocations == 2);
+
+    // nothing left for a resource placed after Commit()
+    CHECK(!allocator.Allocate(1).IsValid());
+
+    // freed space is handed out again
+    allocator.Free(a);
+    const OffsetAllocation c = allocator.Allocate(PlacementAlignment64K);
+    CHECK(c.IsValid() && c.offset == 0);
+}
+
+TEST_CASE(RoundsUpToGranularity) {
+    OffsetAllocator allocator(4 * MiB);
+
+    const OffsetAllocation a = allocator.Allocate(1);
+    const OffsetAllocation b = allocator.Allocate(PlacementAlignment64K + 1);
+    CHECK(a.size == PlacementAlignment64K);
+    CHECK(b.size == 2 * PlacementAlignment64K);
+    CHECK(b.offset == PlacementAlignment64K);
+
+    CHECK(!allocator.Allocate(0).IsValid());
+    CHECK(!allocator.Allocate(4 * MiB + 1).IsValid());
+}
+
+TEST_CASE(MSAAAlignment) {
+    OffsetAllocator allocator(16 * MiB);
+
+    // pushes the next free offset off the 4MB grid
+    const OffsetAllocation small = allocator.Allocate(PlacementAlignment64K);
+    const OffsetAllocation msaa = allocator.Allocate(4 * MiB, PlacementAlignment4M);
+    CHECK(small.IsValid() && msaa.IsValid());
+    CHECK(msaa.offset % PlacementAlignment4M == 0);
+    CHECK(msaa.offset == PlacementAlignment4M);
+
+    // the unaligned head between the two went back to the free list
+    const OffsetAllocatorStats stats = allocator.GetStats();
+    CHECK(stats.numFreeBlocks == 2);
+    CHECK(stats.freeSize == 16 * MiB - 4 * MiB - PlacementAlignment64K);
+
+    // good fit, a block from the head's bin (which only holds the head) is guaranteed to fit
+    const OffsetAllocation head = allocator.Allocate(PlacementAlignment4M - 2 * PlacementAlignment64K);
+    CHECK(head.IsValid() && head.offset == PlacementAlignment64K);
+}
+
+TEST_CASE(FreeMergesNeighbours) {
+    OffsetAllocator allocator(8 * PlacementAlignment64K);
+
+    std::vector<OffsetAllocation> allocations;
+    for(int i = 0; i < 8; i++) {
+        allocations.push_back(allocator.Allocate(PlacementAlignment64K));
+        CHECK(allocations.back().IsValid());
+    }
+
+    // every other block, nothing can merge yet
+    for(int i = 0; i < 8; i += 2) {
+        allocator.Free(allocations[i]);
+    }
+    CHECK(allocator.GetStats().numFreeBlocks == 4);
+    CHECK(allocator.GetStats().largestFreeBlock == PlacementAlignment64K);
+    CHECK(!allocator.Allocate(2 * PlacementAlignment64K).IsValid());
+
+    // each of these merges with both neighbours
+    for(int i = 1; i < 8; i += 2) {
+        allocator.Free(allocations[i]);
+    }
+    const OffsetAllocatorStats stats = allocator.GetStats();
+    CHECK(stats.numFreeBlocks == 1);
+    CHECK(stats.largestFreeBlock == 8 * PlacementAlignment64K);
+    CHECK(stats.usedSize == 0 && stats.numAllocations == 0);
+    CHECK(stats.GetFragmentation() == 0.0);
+
+    CHECK(allocator.Allocate(8 * PlacementAlignment64K).IsValid());
+}
+
+TEST_CASE(Reset) {
+    OffsetAllocator allocator(MiB);
+    allocator.Allocate(256 * KiB);
+    allocator.Allocate(256 * KiB);
+
+    allocator.Reset();
+    const OffsetAllocatorStats stats = allocator.GetStats();
+    CHECK(stats.usedSize == 0 && stats.numAllocations == 0 && stats.numFreeBlocks == 1);
+    CHECK(allocator.Allocate(MiB).IsValid());
+}
+
+TEST_CASE(RandomAllocationsNeverOverlap) {
+    constexpr uint64_t HeapSize = 256 * MiB;
+    OffsetAllocator allocator(HeapSize);
+
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<uint64_t> sizeDist(1, 8 * MiB);
+    std::uniform_int_distribution<int> actionDist(0, 2);
+
+    // offset -> allocation, to check for overlaps
+    std::map<uint64_t, OffsetAllocation> live;
+    uint64_t liveBytes = 0;
+
+    for(int i = 0; i < 20000; i++) {
+        if(actionDist(rng) != 0 || live.empty()) {
+            const uint64_t alignment = actionDist(rng) == 0 ? PlacementAlignment4M : PlacementAlignment64K;
+            const OffsetAllocation allocation = allocator.Allocate(sizeDist(rng), alignment);
+            if(!allocation.IsValid()) {
+                continue;
+            }
+
+            CHECK(allocation.offset % alignment == 0);
+            CHECK(allocation.offset + allocation.size <= HeapSize);
+
+            const auto next = live.lower_bound(allocation.offset);
+            CHECK(next == live.end() || allocation.offset + allocation.size <= next->first);
+            if(next != live.begin()) {
+                const auto prev = std::prev(next);
+                CHECK(prev->first + prev->second.size <= allocation.offset);
+            }
+
+            live[allocation.offset] = allocation;
+            liveBytes += allocation.size;
+        }
+        else {
+            auto it = live.begin();
+            std::advance(it, std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng));
+            allocator.Free(it->second);
+            liveBytes -= it->second.size;
+            live.erase(it);
+        }
+
+        const OffsetAllocatorStats stats = allocator.GetStats();
+        CHECK(stats.usedSize == liveBytes);
+        CHECK(stats.numAllocations == live.size());
+        CHECK(stats.usedSize + stats.freeSize == HeapSize);
+    }
+
+    for(const auto& [offset, allocation] : live) {
+        allocator.Free(allocation);
+    }
+    CHECK(allocator.GetStats().numFreeBlocks == 1);
+    CHECK(allocator.GetStats().largestFreeBlock == HeapSize);
+}
@@ -0,0 +1,119 @@
+#include <vector>
+
+#include "test_common.h"
+#include "frame_graph.h"
+#include "pending_barrier_list.h"
+
+namespace states = frame_graph_states;
+
+namespace {
+
+    // resources are plain ids, the states the D3D12 bits frame_graph_states mirrors
+    typedef PendingBarrierList<uint32_t, FrameGraphStates> BarrierList;
+    typedef BarrierList::Barrier Barrier;
+
+    bool IsTransition(const Barrier& barrier, uint32_t res, FrameGraphStates before, FrameGraphStates after,
+                      Barrier::Split split = Barrier::Split::None) {
+        return barrier.type == Barrier::Type::Transition && barrier.res == res && barrier.before == before &&
+               barrier.after == after && barrier.split == split;
+    }
+
+    bool IsUAV(const Barrier& barrier, uint32_t res) {
+        return barrier.type == Barrier::Type::UAV && barrier.res == res;
+    }
+
+} // namespace
+
+TEST_CASE(TransitionsBackToTheStartCancelOut) {
+    BarrierList list;
+    list.Transition(1, states::PixelShaderResource, states::RenderTarget);
+    list.Transition(2, states::Common, states::CopyDest);
+    list.Transition(1, states::RenderTarget, states::PixelShaderResource);
+    CHECK(list.HasPendingBarriers());
+
+    const std::vector<Barrier> barriers = list.Flush();
+    CHECK(barriers.size() == 1);
+    CHECK(IsTransition(barriers[0], 2, states::Common, states::CopyDest));
+    CHECK(list.GetStats().numCollapsed == 2);
+
+    // A -> B -> C only needs A -> C
+    list.Transition(1, states::PixelShaderResource, states::RenderTarget);
+    list.Transition(1, states::RenderTarget, states::UnorderedAccess);
+    CHECK(list.Flush().size() == 1);
+
+    // nothing left after a full round trip, so there's no ResourceBarrier call
+    list.Transition(1, states::UnorderedAccess, states::CopySource);
+    list.Transition(1, states::CopySource, states::UnorderedAccess);
+    CHECK(!list.HasPendingBarriers());
+    CHECK(list.Flush().empty());
+
+    const BarrierList::Stats& stats = list.GetStats();
+    CHECK(stats.numRequested == 7);
+    CHECK(stats.numCollapsed == 5);
+    CHECK(stats.numIssued == 2);
+    CHECK(stats.numFlushes == 2);
+}
+
+TEST_CASE(UAVBarrierBehindATransitionIsDropped) {
+    BarrierList list;
+    list.Transition(1, states::NonPixelShaderResource, states::UnorderedAccess);
+    list.UAV(1);
+    list.UAV(2);
+    list.UAV(2);
+
+    // the transition orders the accesses to 1 already, 2 keeps a single UAV barrier
+    const std::vector<Barrier> barriers = list.Flush();
+    CHECK(barriers.size() == 2);
+    CHECK(IsTransition(barriers[0], 1, states::NonPixelShaderResource, states::UnorderedAccess));
+    CHECK(IsUAV(barriers[1], 2));
+
+    // without a transition pending the UAV barrier goes out
+    list.UAV(1);
+    const std::vector<Barrier> uavOnly = list.Flush();
+    CHECK(uavOnly.size() == 1);
+    CHECK(IsUAV(uavOnly[0], 1));
+
+    // a cancelled transition doesn't hide it either
+    list.UAV(1);
+    list.Transition(1, states::UnorderedAccess, states::CopySource);
+    list.Transition(1, states::CopySource, states::UnorderedAccess);
+    const std::vector<Barrier> afterCancel = list.Flush();
+    CHECK(afterCancel.size() == 1);
+    CHECK(IsUAV(afterCancel[0], 1));
+}
+
+TEST_CASE(SplitTransitionWithoutAFlushIsPlain) {
+    BarrierList list;
+    list.BeginSplitTransition(1, states::RenderTarget, states::PixelShaderResource);
+    CHECK(list.HasOpenSplitTransitions());
+    list.EndSplitTransition(1);
+    CHECK(!list.HasOpenSplitTransitions());
+
+    const std::vector<Barrier> barriers = list.Flush();
+    CHECK(barriers.size() == 1);
+    CHECK(IsTransition(barriers[0], 1, states::RenderTarget, states::PixelShaderResource));
+    CHECK(list.GetStats().numSplit == 0);
+
+    // with a flush in between both halves go out
+    list.BeginSplitTransition(1, states::PixelShaderResource, states::RenderTarget);
+    const std::vector<Barrier> begin = list.Flush();
+    CHECK(begin.size() == 1);
+    CHECK(IsTransition(begin[0], 1, states::PixelShaderResource, states::RenderTarget, Barrier::Split::Begin));
+
+    list.EndSplitTransition(1);
+    const std::vector<Barrier> end = list.Flush();
+    CHECK(end.size() == 1);
+    CHECK(IsTransition(end[0], 1, states::PixelShaderResource, states::RenderTarget, Barrier::Split::End));
+    CHECK(list.GetStats().numSplit == 1);
+
+    // only the splits that were open during a flush stay split
+    list.BeginSplitTransition(2, states::Common, states::CopyDest);
+    CHECK(list.Flush().size() == 1);
+    list.BeginSplitTransition(3, states::Common, states::CopyDest);
+    list.EndSplitTransition(2);
+    list.EndSplitTransition(3);
+    const std::vector<Barrier> mixed = list.Flush();
+    CHECK(mixed.size() == 2);
+    CHECK(IsTransition(mixed[0], 3, states::Common, states::CopyDest));
+    CHECK(IsTransition(mixed[1], 2, states::Common, states::CopyDest, Barrier::Split::End));
+}
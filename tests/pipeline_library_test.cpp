@@ -0,0 +1,140 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "test_common.h"
+#include "pipeline_library.h"
+
+namespace {
+
+    class MockPipelineLibraryDevice : public PipelineLibraryDevice {
+    public:
+        MockPipelineLibraryDevice(uint64_t driverKey) : driverKey_(driverKey) {}
+
+        uint64_t GetDriverKey() const override { return driverKey_; }
+
+    private:
+        uint64_t driverKey_;
+    };
+
+    // fresh file path per test case, in the system's temp directory
+    std::filesystem::path GetTestFilePath(const std::string& name) {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "cloudscaper_pipeline_library_test";
+        std::filesystem::create_directories(dir);
+
+        const std::filesystem::path path = dir / (name + ".bin");
+        std::filesystem::remove(path);
+        return path;
+    }
+
+    std::vector<uint8_t> MakeBlob(size_t size, uint8_t seed) {
+        std::vector<uint8_t> blob(size);
+        for(size_t i = 0; i < size; i++) {
+            blob[i] = (uint8_t)(seed + i * 31);
+        }
+        return blob;
+    }
+
+    // library with two pipelines, saved to path
+    void WriteLibrary(const std::filesystem::path& path, uint64_t driverKey) {
+        PipelineLibrary library(path, std::make_shared<MockPipelineLibraryDevice>(driverKey));
+        const std::vector<uint8_t> skyBlob = MakeBlob(300, 1);
+        const std::vector<uint8_t> cloudsBlob = MakeBlob(17, 2);
+        library.Store("Sky", 0x1111, skyBlob.data(), skyBlob.size());
+        library.Store("Clouds", 0x2222, cloudsBlob.data(), cloudsBlob.size());
+        library.Save();
+    }
+
+} // namespace
+
+TEST_CASE(RoundTrip) {
+    const std::filesystem::path path = GetTestFilePath("round_trip");
+    WriteLibrary(path, 42);
+
+    PipelineLibrary library(path, std::make_shared<MockPipelineLibraryDevice>(42));
+    CHECK(library.Load());
+    CHECK(library.GetNumEntries() == 2);
+
+    const std::shared_ptr<const std::vector<uint8_t>> sky = library.Find("Sky", 0x1111);
+    const std::shared_ptr<const std::vector<uint8_t>> clouds = library.Find("Clouds", 0x2222);
+    CHECK(sky && *sky == MakeBlob(300, 1));
+    CHECK(clouds && *clouds == MakeBlob(17, 2));
+    CHECK(library.Find("Missing", 0x1111) == nullptr);
+
+    // removed entries are gone after the next save/load
+    library.Remove("Sky");
+    CHECK(library.Save());
+    CHECK(library.Load());
+    CHECK(library.GetNumEntries() == 1);
+    CHECK(library.Find("Sky", 0x1111) == nullptr);
+}
+
+TEST_CASE(StaleContentHash) {
+    const std::filesystem::path path = GetTestFilePath("stale_hash");
+    WriteLibrary(path, 42);
+
+    PipelineLibrary library(path, std::make_shared<MockPipelineLibraryDevice>(42));
+    CHECK(library.Load());
+
+    // the pipeline got rebuilt from other inputs, the old blob can't be used
+    CHECK(library.Find("Sky", 0x1112) == nullptr);
+
+    // storing the new hash replaces the entry
+    const std::vector<uint8_t> newBlob = MakeBlob(64, 3);
+    library.Store("Sky", 0x1112, newBlob.data(), newBlob.size());
+    CHECK(library.GetNumEntries() == 2);
+    CHECK(library.Find("Sky", 0x1111) == nullptr);
+    CHECK(library.Find("Sky", 0x1112) && *library.Find("Sky", 0x1112) == newBlob);
+}
+
+TEST_CASE(DriverKeyMismatch) {
+    const std::filesystem::path path = GetTestFilePath("driver_key");
+    WriteLibrary(path, 42);
+
+    PipelineLibrary library(path, std::make_shared<MockPipelineLibraryDevice>(43));
+    CHECK(!library.Load());
+    CHECK(library.GetNumEntries() == 0);
+
+    // the rebuilt library is written for the new driver
+    const std::vector<uint8_t> blob = MakeBlob(8, 4);
+    library.Store("Sky", 0x1111, blob.data(), blob.size());
+    CHECK(library.Save());
+
+    PipelineLibrary reloaded(path, std::make_shared<MockPipelineLibraryDevice>(43));
+    CHECK(reloaded.Load());
+    CHECK(reloaded.GetNumEntries() == 1);
+}
+
+TEST_CASE(TruncatedFile) {
+    const std::filesystem::path path = GetTestFilePath("truncated");
+    WriteLibrary(path, 42);
+    const uintmax_t fileSize = std::filesystem::file_size(path);
+
+    std::vector<char> bytes(fileSize);
+    std::ifstream(path, std::ios::binary).read(bytes.data(), (std::streamsize)fileSize);
+
+    // cut the file at every length, inside the header, an id and a blob
+    for(uintmax_t size = 0; size < fileSize; size++) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), (std::streamsize)size);
+
+        PipelineLibrary library(path, std::make_shared<MockPipelineLibraryDevice>(42));
+        CHECK(!library.Load());
+        CHECK(library.GetNumEntries() == 0);
+    }
+
+    // trailing garbage is rejected as well
+    bytes.push_back(0);
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), (std::streamsize)bytes.size());
+    PipelineLibrary library(path, std::make_shared<MockPipelineLibraryDevice>(42));
+    CHECK(!library.Load());
+}
+
+TEST_CASE(MissingFile) {
+    PipelineLibrary library(GetTestFilePath("missing"), std::make_shared<MockPipelineLibraryDevice>(42));
+    CHECK(!library.Load());
+    CHECK(library.GetNumEntries() == 0);
+
+    // nothing stored, nothing to write
+    CHECK(library.Save());
+}
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "test_common.h"
+#include "queue_scheduler.h"
+
+namespace {
+
+    struct Queues {
+        SimulatedGPUQueues sim;
+        QueueScheduler scheduler{ sim };
+
+        // one unit of work named name on queue
+        uint64_t Submit(GPUQueue queue, const std::vector<GPUQueueAccess>& accesses, const std::string& name, double duration = 1.0,
+                        bool joinOtherQueues = false) {
+            return scheduler.Submit(queue, accesses, [&]() { sim.Execute(queue, name, duration); }, joinOtherQueues);
+        }
+
+        const SimulatedGPUQueues::Work& GetWork(const std::string& name) const {
+            for(const SimulatedGPUQueues::Work& work : sim.GetWork()) {
+                if(work.name == name) {
+                    return work;
+                }
+            }
+            static const SimulatedGPUQueues::Work missing = { GPUQueue::Count, "missing", -1.0, -1.0 };
+            return missing;
+        }
+    };
+
+    // Frames like Cloudscaper::Tick: the LUTs on the compute queue, then the draws reading the
+    // SkyView LUT on the direct queue, joined with the compute queue. The CPU keeps one frame in
+    // flight. doubleBuffered alternates between two SkyView LUTs like the renderer does.
+    double RunFrames(uint32_t numFrames, bool doubleBuffered, QueueScheduler::Stats& outStats) {
+        constexpr double CPUFrameTime = 1.0;
+        constexpr double LUTTime = 2.0;
+        constexpr double DrawTime = 4.0;
+
+        Queues queues;
+        const uint32_t skyView[2] = { queues.scheduler.AddResource("SkyView LUT 0"), queues.scheduler.AddResource("SkyView LUT 1") };
+
+        std::vector<uint64_t> frameValues;
+        uint32_t readIndex = 0;
+        double cpuTime = 0.0;
+        for(uint32_t frame = 0; frame < numFrames; frame++) {
+            queues.sim.SetCPUTime(cpuTime);
+
+            const uint32_t writeIndex = doubleBuffered ? 1 - readIndex : 0;
+            queues.Submit(GPUQueue::Compute, { { skyView[writeIndex], true } }, "LUTs " + std::to_string(frame), LUTTime);
+            readIndex = writeIndex;
+            frameValues.push_back(queues.Submit(GPUQueue::Direct, { { skyView[readIndex], false } }, "Draws " + std::to_string(frame),
+                                                DrawTime, true));
+
+            cpuTime += CPUFrameTime;
+            if(frame > 0) {
+                cpuTime = std::max(cpuTime, queues.sim.GetSignalTime(GPUQueue::Direct, frameValues[frame - 1]));
+            }
+        }
+
+        outStats = queues.scheduler.GetStats();
+        return queues.sim.GetEndTime();
+    }
+
+} // namespace
+
+TEST_CASE(ReadAfterWriteWaits) {
+    Queues queues;
+    const uint32_t lut = queues.scheduler.AddResource("lut");
+
+    queues.Submit(GPUQueue::Compute, { { lut, true } }, "write");
+    queues.Submit(GPUQueue::Direct, { { lut, false } }, "read");
+
+    CHECK(queues.scheduler.GetStats().numWaits == 1);
+    CHECK(queues.GetWork("read").start == queues.GetWork("write").end);
+}
+
+TEST_CASE(WriteAfterReadWaits) {
+    Queues queues;
+    const uint32_t lut = queues.scheduler.AddResource("lut");
+
+    // the read runs on the direct queue while the compute queue is idle
+    queues.Submit(GPUQueue::Direct, { { lut, false } }, "read", 3.0);
+    queues.Submit(GPUQueue::Compute, { { lut, true } }, "write");
+
+    CHECK(queues.scheduler.GetStats().numWaits == 1);
+    CHECK(queues.GetWork("write").start == queues.GetWork("read").end);
+}
+
+TEST_CASE(WriteAfterWriteWaits) {
+    Queues queues;
+    const uint32_t lut = queues.scheduler.AddResource("lut");
+
+    queues.Submit(GPUQueue::Compute, { { lut, true } }, "compute write", 2.0);
+    queues.Submit(GPUQueue::Direct, { { lut, true } }, "direct write");
+
+    CHECK(queues.scheduler.GetStats().numWaits == 1);
+    CHECK(queues.GetWork("direct write").start == queues.GetWork("compute write").end);
+}
+
+TEST_CASE(IndependentWorkOverlaps) {
+    Queues queues;
+    const uint32_t a = queues.scheduler.AddResource("a");
+    const uint32_t b = queues.scheduler.AddResource("b");
+
+    queues.Submit(GPUQueue::Compute, { { a, true } }, "write a", 2.0);
+    queues.Submit(GPUQueue::Direct, { { b, true } }, "write b", 2.0);
+    // reads after reads don't depend on each other
+    queues.Submit(GPUQueue::Direct, { { a, false } }, "read a");
+    queues.Submit(GPUQueue::Compute, { { b, false } }, "read b");
+
+    CHECK(queues.GetWork("write b").start == 0.0);
+    CHECK(queues.sim.GetOverlapTime() > 0.0);
+    CHECK(queues.scheduler.GetStats().numWaits == 2);
+}
+
+TEST_CASE(WaitsAreSkipped) {
+    Queues queues;
+    const uint32_t lut = queues.scheduler.AddResource("lut");
+
+    queues.Submit(GPUQueue::Compute, { { lut, true } }, "write");
+    queues.Submit(GPUQueue::Direct, { { lut, false } }, "read");
+    CHECK(queues.scheduler.GetStats().numWaits == 1);
+
+    // the direct queue already waited for this value
+    queues.Submit(GPUQueue::Direct, { { lut, false } }, "read again");
+    CHECK(queues.scheduler.GetStats().numWaits == 1 && queues.scheduler.GetStats().numElidedWaits == 1);
+
+    // write after both reads on the direct queue waits for the last one
+    queues.Submit(GPUQueue::Compute, { { lut, true } }, "write again");
+    CHECK(queues.scheduler.GetStats().numWaits == 2);
+    CHECK(queues.GetWork("write again").start == queues.GetWork("read again").end);
+
+    // same queue, nothing to wait for
+    queues.Submit(GPUQueue::Compute, { { lut, false } }, "compute read");
+    CHECK(queues.scheduler.GetStats().numWaits == 2 && queues.scheduler.GetStats().numElidedWaits == 1);
+
+    // by the time this is submitted the compute queue's fence passed the write already
+    queues.sim.SetCPUTime(100.0);
+    CHECK(queues.sim.GetCompletedValue(GPUQueue::Compute) == queues.scheduler.GetLastSubmittedValue(GPUQueue::Compute));
+    queues.Submit(GPUQueue::Direct, { { lut, true } }, "late write");
+    CHECK(queues.scheduler.GetStats().numWaits == 2 && queues.scheduler.GetStats().numElidedWaits == 2);
+    CHECK(queues.GetWork("late write").start == 100.0);
+}
+
+TEST_CASE(JoinWaitsForOtherQueues) {
+    Queues queues;
+    const uint32_t a = queues.scheduler.AddResource("a");
+    const uint32_t b = queues.scheduler.AddResource("b");
+
+    queues.Submit(GPUQueue::Compute, { { a, true } }, "compute", 5.0);
+    const uint64_t value = queues.Submit(GPUQueue::Direct, { { b, true } }, "draws", 1.0, true);
+
+    // the draws don't wait, their fence value does
+    CHECK(queues.GetWork("draws").start == 0.0);
+    CHECK(queues.sim.GetSignalTime(GPUQueue::Direct, value) == queues.GetWork("compute").end);
+}
+
+TEST_CASE(DoubleBufferedLUTOverlapsFrames) {
+    constexpr uint32_t NumFrames = 100;
+
+    // with one LUT every frame's LUT write waits for the previous frame's draws
+    QueueScheduler::Stats singleStats;
+    const double singleEnd = RunFrames(NumFrames, false, singleStats);
+    QueueScheduler::Stats doubleStats;
+    const double doubleEnd = RunFrames(NumFrames, true, doubleStats);
+
+    std::cout << "one SkyView LUT: " << singleEnd / NumFrames << " per frame, two: " << doubleEnd / NumFrames << " per frame" << std::endl;
+    CHECK(singleEnd > NumFrames * 5.5);
+    // the draws are the bottleneck, the LUTs run next to them
+    CHECK(doubleEnd < NumFrames * 4.5);
+    CHECK(doubleStats.numSubmissions == 2 * NumFrames);
+    CHECK(doubleStats.numElidedWaits > 0);
+}
@@ -0,0 +1,204 @@
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_common.h"
+#include "multithreading/task_graph.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+    // a task that blocked on another one would deadlock a single worker, this turns that into a failure
+    constexpr auto Timeout = 10s;
+
+    std::shared_ptr<WorkStealingScheduler> StartScheduler(uint16_t numThreads) {
+        std::shared_ptr<WorkStealingScheduler> scheduler = std::make_shared<WorkStealingScheduler>(numThreads);
+        scheduler->Start();
+        return scheduler;
+    }
+
+    // the order tasks ran in
+    class RunLog {
+    public:
+        void Add(const std::string& name) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            names_.push_back(name);
+        }
+
+        // -1 if name never ran
+        int IndexOf(const std::string& name) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for(size_t i = 0; i < names_.size(); i++) {
+                if(names_[i] == name) {
+                    return (int)i;
+                }
+            }
+            return -1;
+        }
+
+        size_t GetSize() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return names_.size();
+        }
+
+    private:
+        mutable std::mutex mutex_;
+        std::vector<std::string> names_;
+    };
+
+} // namespace
+
+TEST_CASE(DiamondRunsInDependencyOrder) {
+    RunLog log;
+    std::promise<void> done;
+    std::shared_ptr<WorkStealingScheduler> scheduler = StartScheduler(1);
+    TaskGraph graph(scheduler);
+
+    // a -> b, a -> c, b -> d, c -> d
+    GraphTaskHandle a = graph.CreateTask([&]() { log.Add("a"); });
+    GraphTaskHandle b = graph.CreateTask([&]() { log.Add("b"); });
+    GraphTaskHandle c = graph.CreateTask([&]() { log.Add("c"); });
+    GraphTaskHandle d = graph.CreateTask([&]() {
+        log.Add("d");
+        done.set_value();
+    });
+    TaskGraph::AddDependency(a, b);
+    TaskGraph::AddDependency(a, c);
+    TaskGraph::AddDependency(b, d);
+    TaskGraph::AddDependency(c, d);
+
+    // successors first: nothing may run before its predecessors are submitted and finished
+    graph.Submit(d);
+    graph.Submit(c);
+    graph.Submit(b);
+    CHECK(!d->IsFinished() && !c->IsFinished() && !b->IsFinished());
+    graph.Submit(a);
+
+    CHECK(done.get_future().wait_for(Timeout) == std::future_status::ready);
+    CHECK(log.GetSize() == 4);
+    CHECK(log.IndexOf("a") == 0);
+    CHECK(log.IndexOf("b") < log.IndexOf("d") && log.IndexOf("c") < log.IndexOf("d"));
+    CHECK(a->IsFinished() && b->IsFinished() && c->IsFinished());
+}
+
+TEST_CASE(FanInWaitsForEveryPredecessor) {
+    constexpr uint32_t NumPredecessors = 64;
+
+    for(uint16_t numThreads : { 1, 4 }) {
+        // plain ints, the successor has to see every predecessor's write
+        std::vector<uint32_t> written(NumPredecessors, 0);
+        std::promise<uint32_t> sum;
+        std::shared_ptr<WorkStealingScheduler> scheduler = StartScheduler(numThreads);
+        TaskGraph graph(scheduler);
+
+        GraphTaskHandle sink = graph.CreateTask([&]() {
+            uint32_t total = 0;
+            for(uint32_t value : written) {
+                total += value;
+            }
+            sum.set_value(total);
+        });
+
+        std::vector<GraphTaskHandle> predecessors;
+        for(uint32_t i = 0; i < NumPredecessors; i++) {
+            predecessors.push_back(graph.CreateTask([&written, i]() { written[i] = i + 1; }));
+            TaskGraph::AddDependency(predecessors.back(), sink);
+        }
+
+        graph.Submit(sink);
+        for(const GraphTaskHandle& predecessor : predecessors) {
+            graph.Submit(predecessor);
+        }
+
+        std::future<uint32_t> result = sum.get_future();
+        CHECK(result.wait_for(Timeout) == std::future_status::ready);
+        CHECK(result.get() == NumPredecessors * (NumPredecessors + 1) / 2);
+    }
+}
+
+TEST_CASE(TasksBuildGraphsWithoutBlocking) {
+    // like PSO assembly waiting for shader compilation: a running task creates the next stage
+    // and hands it its dependencies instead of waiting for them, on a single worker
+    RunLog log;
+    std::promise<void> done;
+    std::shared_ptr<WorkStealingScheduler> scheduler = StartScheduler(1);
+    TaskGraph graph(scheduler);
+
+    GraphTaskHandle root = graph.CreateTask([&]() {
+        log.Add("root");
+        GraphTaskHandle vs = graph.CreateTask([&]() { log.Add("vs"); });
+        GraphTaskHandle ps = graph.CreateTask([&]() { log.Add("ps"); });
+        GraphTaskHandle pso = graph.CreateTask([&]() {
+            log.Add("pso");
+            done.set_value();
+        });
+        TaskGraph::AddDependency(vs, pso);
+        TaskGraph::AddDependency(ps, pso);
+        graph.Submit(pso);
+        graph.Submit(vs);
+        graph.Submit(ps);
+    });
+    graph.Submit(root);
+
+    CHECK(done.get_future().wait_for(Timeout) == std::future_status::ready);
+    CHECK(log.IndexOf("vs") < log.IndexOf("pso") && log.IndexOf("ps") < log.IndexOf("pso"));
+}
+
+TEST_CASE(FinishedPredecessorIsNoDependency) {
+    std::shared_ptr<WorkStealingScheduler> scheduler = StartScheduler(1);
+    TaskGraph graph(scheduler);
+
+    std::promise<void> first;
+    GraphTaskHandle predecessor = graph.CreateTask([&]() { first.set_value(); });
+    graph.Submit(predecessor);
+    CHECK(first.get_future().wait_for(Timeout) == std::future_status::ready);
+    // set_value() runs inside the task, finished_ is set right after it
+    for(int i = 0; i < 1000 && !predecessor->IsFinished(); i++) {
+        std::this_thread::sleep_for(1ms);
+    }
+    CHECK(predecessor->IsFinished());
+
+    std::promise<void> second;
+    GraphTaskHandle successor = graph.CreateTask([&]() { second.set_value(); });
+    TaskGraph::AddDependency(predecessor, successor);
+    graph.Submit(successor);
+    CHECK(second.get_future().wait_for(Timeout) == std::future_status::ready);
+}
+
+TEST_CASE(LongChainOnOneWorker) {
+    constexpr uint32_t ChainLength = 1000;
+
+    std::vector<uint32_t> order;
+    std::promise<void> done;
+    std::shared_ptr<WorkStealingScheduler> scheduler = StartScheduler(1);
+    TaskGraph graph(scheduler);
+
+    std::vector<GraphTaskHandle> chain;
+    for(uint32_t i = 0; i < ChainLength; i++) {
+        chain.push_back(graph.CreateTask([&, i]() {
+            order.push_back(i);
+            if(i == ChainLength - 1) {
+                done.set_value();
+            }
+        }));
+        if(i > 0) {
+            TaskGraph::AddDependency(chain[i - 1], chain[i]);
+        }
+    }
+
+    // back to front, so every task is submitted while its predecessor is still pending
+    for(uint32_t i = ChainLength; i > 0; i--) {
+        graph.Submit(chain[i - 1]);
+    }
+
+    CHECK(done.get_future().wait_for(Timeout) == std::future_status::ready);
+    CHECK(order.size() == ChainLength);
+    for(uint32_t i = 0; i < ChainLength; i++) {
+        CHECK(order[i] == i);
+    }
+}
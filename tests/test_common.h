@@ -0,0 +1,52 @@
+#ifndef TESTS_TEST_COMMON_H_
+#define TESTS_TEST_COMMON_H_
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+//
+// Minimal test harness. TEST_CASE registers a function that test_main.cpp runs,
+// CHECK stays active in release builds (unlike assert) and fails the test case.
+//
+namespace test {
+
+    struct TestCase {
+        const char* name;
+        std::function<void()> func;
+    };
+
+    inline std::vector<TestCase>& GetTestCases() {
+        static std::vector<TestCase> testCases;
+        return testCases;
+    }
+
+    inline int& GetFailureCount() {
+        static int failures = 0;
+        return failures;
+    }
+
+    struct TestRegistrar {
+        TestRegistrar(const char* name, std::function<void()> func) {
+            GetTestCases().push_back({ name, std::move(func) });
+        }
+    };
+
+} // namespace test
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static test::TestRegistrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+            test::GetFailureCount()++; \
+            return; \
+        } \
+    } while(0)
+
+#endif // TESTS_TEST_COMMON_H_
@@ -0,0 +1,19 @@
+#include "test_common.h"
+
+int main() {
+    int failedCases = 0;
+    for(const test::TestCase& testCase : test::GetTestCases()) {
+        const int failuresBefore = test::GetFailureCount();
+        testCase.func();
+
+        const bool passed = test::GetFailureCount() == failuresBefore;
+        std::cout << (passed ? "[PASS] " : "[FAIL] ") << testCase.name << std::endl;
+        if(!passed) {
+            failedCases++;
+        }
+    }
+
+    std::cout << test::GetTestCases().size() - failedCases << "/" << test::GetTestCases().size()
+              << " test cases passed" << std::endl;
+    return failedCases == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
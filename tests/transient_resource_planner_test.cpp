@@ -0,0 +1,199 @@
+#include <string>
+#include <vector>
+
+#include "test_common.h"
+#include "frame_graph.h"
+#include "memory/transient_resource_planner.h"
+
+namespace {
+
+    bool SameBarrier(const TransientAliasingBarrier& barrier, uint32_t pass, uint32_t before, uint32_t after) {
+        return barrier.pass == pass && barrier.resourceBefore == before && barrier.resourceAfter == after;
+    }
+
+} // namespace
+
+TEST_CASE(OverlappingLifetimesGetTheirOwnRanges) {
+    TransientResourcePlanner planner;
+    const uint32_t a = planner.AddResource("a", 256, 256);
+    const uint32_t b = planner.AddResource("b", 256, 256);
+    const uint32_t c = planner.AddResource("c", 256, 256);
+    for(uint32_t i = 0; i < 4; i++) {
+        planner.AddPass("pass " + std::to_string(i));
+    }
+
+    // a: 0-1, b: 1-2, c: 2-3. Only a and c never live at the same time
+    planner.Write(0, a);
+    planner.Read(1, a);
+    planner.Write(1, b);
+    planner.Read(2, b);
+    planner.Write(2, c);
+    planner.Read(3, c);
+
+    const TransientAliasingPlan plan = planner.Plan();
+    CHECK(plan.placements[a].firstPass == 0 && plan.placements[a].lastPass == 1);
+    CHECK(plan.placements[b].firstPass == 1 && plan.placements[b].lastPass == 2);
+    CHECK(plan.placements[c].firstPass == 2 && plan.placements[c].lastPass == 3);
+    CHECK(plan.placements[a].offset == 0);
+    CHECK(plan.placements[b].offset == 256);
+    CHECK(plan.placements[c].offset == 0);
+    CHECK(plan.heapSize == 512);
+    CHECK(plan.unaliasedSize == 768);
+}
+
+TEST_CASE(FirstFitRespectsAlignment) {
+    TransientResourcePlanner planner;
+    const uint32_t persistent = planner.AddResource("persistent", 64, 64, true);
+    const uint32_t a = planner.AddResource("a", 256, 256);
+    const uint32_t b = planner.AddResource("b", 128, 128);
+    const uint32_t c = planner.AddResource("c", 64, 64);
+    for(uint32_t i = 0; i < 4; i++) {
+        planner.AddPass("pass " + std::to_string(i));
+    }
+
+    planner.Write(0, a);
+    planner.Read(1, a);
+    planner.Write(1, c);
+    planner.Read(2, c);
+    planner.Write(2, b);
+    planner.Read(3, b);
+    planner.Read(3, persistent);
+
+    // Placed in order persistent, a, b, c. a doesn't fit below the persistent one and aligns up to 256,
+    // b (no overlap with a) goes to the first 128 aligned offset, c fits into the gap left below b
+    const TransientAliasingPlan plan = planner.Plan();
+    CHECK(!plan.placements[persistent].aliasable);
+    CHECK(plan.placements[persistent].firstPass == 0 && plan.placements[persistent].lastPass == 3);
+    CHECK(plan.placements[persistent].offset == 0);
+    CHECK(plan.placements[a].offset == 256);
+    CHECK(plan.placements[b].offset == 128);
+    CHECK(plan.placements[c].offset == 64);
+    CHECK(plan.heapSize == 512);
+    // 64, 256 aligned up to 256, 128, 64
+    CHECK(plan.unaliasedSize == 704);
+    // nothing shares a range, so no barriers
+    CHECK(plan.barriers.empty());
+}
+
+TEST_CASE(ReadFirstLivesForTheWholeFrame) {
+    TransientResourcePlanner planner;
+    const uint32_t history = planner.AddResource("history", 64, 64);
+    const uint32_t accumulated = planner.AddResource("accumulated", 64, 64);
+    const uint32_t transient = planner.AddResource("transient", 64, 64);
+    for(uint32_t i = 0; i < 4; i++) {
+        planner.AddPass("pass " + std::to_string(i));
+    }
+
+    // last frame's contents are read before anything writes them
+    planner.Read(1, history);
+    planner.Write(2, history);
+    // read-modify-write in its first pass
+    planner.Write(1, accumulated);
+    planner.Read(1, accumulated);
+    planner.Write(2, transient);
+    planner.Read(3, transient);
+
+    const TransientAliasingPlan plan = planner.Plan();
+    CHECK(!plan.placements[history].aliasable);
+    CHECK(plan.placements[history].firstPass == 0 && plan.placements[history].lastPass == 3);
+    CHECK(!plan.placements[accumulated].aliasable);
+    CHECK(plan.placements[transient].aliasable);
+    CHECK(plan.heapSize == plan.unaliasedSize);
+}
+
+TEST_CASE(BarriersBeforeTheFirstPassOfEverySharingResource) {
+    TransientResourcePlanner planner;
+    const uint32_t a = planner.AddResource("a", 64, 64);
+    const uint32_t b = planner.AddResource("b", 64, 64);
+    const uint32_t persistent = planner.AddResource("persistent", 64, 64, true);
+    for(uint32_t i = 0; i < 6; i++) {
+        planner.AddPass("pass " + std::to_string(i));
+    }
+
+    planner.Write(0, a);
+    planner.Read(1, a);
+    planner.Write(2, b);
+    planner.Read(3, b);
+    planner.Write(0, persistent);
+
+    // a and b share a range: b takes it over from a, and a from last frame's b
+    TransientAliasingPlan plan = planner.Plan();
+    CHECK(plan.placements[a].offset == plan.placements[b].offset);
+    CHECK(plan.placements[persistent].offset != plan.placements[a].offset);
+    CHECK(plan.barriers.size() == 2);
+    CHECK(SameBarrier(plan.barriers[0], 0, b, a));
+    CHECK(SameBarrier(plan.barriers[1], 2, a, b));
+
+    // with a third one in the same range no barrier can name a single resource before it
+    const uint32_t c = planner.AddResource("c", 64, 64);
+    planner.Write(4, c);
+    planner.Read(5, c);
+
+    plan = planner.Plan();
+    CHECK(plan.placements[c].offset == plan.placements[a].offset);
+    CHECK(plan.barriers.size() == 3);
+    CHECK(SameBarrier(plan.barriers[0], 0, TransientResourcePlanner::InvalidIndex, a));
+    CHECK(SameBarrier(plan.barriers[1], 2, TransientResourcePlanner::InvalidIndex, b));
+    CHECK(SameBarrier(plan.barriers[2], 4, TransientResourcePlanner::InvalidIndex, c));
+    CHECK(plan.heapSize == 128);
+    CHECK(plan.unaliasedSize == 256);
+}
+
+TEST_CASE(CulledFrameGraphPassesDropOut) {
+    namespace states = frame_graph_states;
+
+    FrameGraph graph;
+    const uint32_t a = graph.ImportResource("a", states::Common);
+    const uint32_t b = graph.ImportResource("b", states::Common);
+    const uint32_t c = graph.ImportResource("c", states::Common);
+    const uint32_t unread = graph.ImportResource("unread", states::Common);
+    const uint32_t output = graph.ImportResource("output", states::Common, true);
+
+    const uint32_t writeA = graph.AddPass("write a", nullptr);
+    graph.Write(writeA, a, states::RenderTarget);
+    const uint32_t aToB = graph.AddPass("a to b", nullptr);
+    graph.Read(aToB, a, states::PixelShaderResource);
+    graph.Write(aToB, b, states::RenderTarget);
+    const uint32_t bToC = graph.AddPass("b to c", nullptr);
+    graph.Read(bToC, b, states::PixelShaderResource);
+    graph.Write(bToC, c, states::RenderTarget);
+    // culled, would keep a alive until after c is written
+    const uint32_t culled = graph.AddPass("culled", nullptr);
+    graph.Read(culled, a, states::PixelShaderResource);
+    graph.Write(culled, unread, states::UnorderedAccess);
+    const uint32_t present = graph.AddPass("present", nullptr);
+    graph.Read(present, c, states::CopySource);
+    graph.Write(present, output, states::CopyDest);
+    graph.Compile();
+    CHECK(graph.IsCulled(culled));
+
+    // the output keeps alignment 0, it isn't in the heap
+    std::vector<TransientResourceDesc> descs(graph.GetNumResources());
+    for(uint32_t resource : { a, b, c, unread }) {
+        descs[resource].size = 256;
+        descs[resource].alignment = 256;
+    }
+
+    TransientResourcePlanner planner;
+    const std::vector<uint32_t> indices = planner.AddFrameGraph(graph, descs);
+    CHECK(indices.size() == graph.GetNumResources());
+    CHECK(indices[output] == TransientResourcePlanner::InvalidIndex);
+    CHECK(planner.GetNumResources() == 4);
+    CHECK(planner.GetResourceName(indices[c]) == "c");
+
+    CHECK(planner.GetNumPasses() == 4);
+    CHECK(planner.GetPassName(0) == "write a");
+    CHECK(planner.GetPassName(3) == "present");
+
+    const TransientAliasingPlan plan = planner.Plan();
+    const TransientResourcePlacement& placementA = plan.placements[indices[a]];
+    const TransientResourcePlacement& placementC = plan.placements[indices[c]];
+    CHECK(placementA.firstPass == 0 && placementA.lastPass == 1);
+    CHECK(placementC.firstPass == 2 && placementC.lastPass == 3);
+    CHECK(placementA.offset == placementC.offset);
+
+    // nothing uses the culled pass's output this frame, it keeps its own range
+    CHECK(!plan.placements[indices[unread]].aliasable);
+    CHECK(plan.heapSize == 768);
+    CHECK(plan.unaliasedSize == 1024);
+}
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "test_common.h"
+#include "multithreading/chase_lev_deque.h"
+#include "multithreading/work_stealing_scheduler.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+    // a lost wake-up shows up as a timeout instead of a hanging test
+    constexpr auto Timeout = 10s;
+
+    // Owner pushes 0..numItems-1 (popping every few pushes), numThieves steal until the owner
+    // has emptied the deque. Returns how often every item came out.
+    std::vector<uint32_t> RunDequeStress(uint32_t numItems, uint32_t numThieves, int64_t capacity) {
+        ChaseLevDeque<uint32_t> deque(capacity);
+        std::atomic_bool ownerDone = false;
+
+        std::vector<std::vector<uint32_t>> stolen(numThieves);
+        std::vector<std::thread> thieves;
+        for(uint32_t t = 0; t < numThieves; t++) {
+            thieves.emplace_back([&, t]() {
+                uint32_t item;
+                while(!ownerDone.load() || !deque.IsEmpty()) {
+                    if(deque.Steal(item)) {
+                        stolen[t].push_back(item);
+                    }
+                }
+            });
+        }
+
+        std::vector<uint32_t> popped;
+        uint32_t item;
+        for(uint32_t i = 0; i < numItems; i++) {
+            deque.Push(i);
+            // bursts of pushes make the deque grow past its capacity while it's being stolen from
+            if(i % 3 == 0 && (i / 1024) % 2 == 1 && deque.Pop(item)) {
+                popped.push_back(item);
+            }
+        }
+        // false once the deque is empty, or a thief won the last item
+        while(deque.Pop(item)) {
+            popped.push_back(item);
+        }
+        ownerDone = true;
+
+        for(std::thread& thief : thieves) {
+            thief.join();
+        }
+
+        std::vector<uint32_t> counts(numItems, 0);
+        for(uint32_t i : popped) {
+            counts[i]++;
+        }
+        for(const std::vector<uint32_t>& items : stolen) {
+            for(uint32_t i : items) {
+                counts[i]++;
+            }
+        }
+        return counts;
+    }
+
+    bool AllOnce(const std::vector<uint32_t>& counts) {
+        for(uint32_t count : counts) {
+            if(count != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // namespace
+
+TEST_CASE(DequeOrderAndGrowth) {
+    ChaseLevDeque<uint32_t> deque(2);
+    for(uint32_t i = 0; i < 1000; i++) {
+        deque.Push(i);
+    }
+
+    // thieves take the oldest items, the owner the newest
+    uint32_t item;
+    for(uint32_t i = 0; i < 500; i++) {
+        CHECK(deque.Steal(item) && item == i);
+    }
+    for(uint32_t i = 999; i >= 500; i--) {
+        CHECK(deque.Pop(item) && item == i);
+    }
+    CHECK(deque.IsEmpty());
+    CHECK(!deque.Pop(item));
+    CHECK(!deque.Steal(item));
+
+    // still usable after running empty
+    deque.Push(7);
+    CHECK(deque.Pop(item) && item == 7);
+}
+
+TEST_CASE(DequeStressEveryItemOnce) {
+    const uint32_t numThieves = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    for(int run = 0; run < 4; run++) {
+        CHECK(AllOnce(RunDequeStress(1 << 16, numThieves, 4)));
+    }
+    // the owner racing a single thief for the last item
+    for(int run = 0; run < 50; run++) {
+        CHECK(AllOnce(RunDequeStress(64, 1, 2)));
+    }
+}
+
+TEST_CASE(TasksFromManyThreadsAllRun) {
+    constexpr uint32_t NumSubmitters = 4;
+    constexpr uint32_t TasksPerSubmitter = 20000;
+
+    std::vector<std::atomic<uint32_t>> runs(NumSubmitters * TasksPerSubmitter);
+    std::atomic<uint32_t> numDone = 0;
+    std::promise<void> allDone;
+
+    // declared last, so its workers are joined before the state above goes away
+    WorkStealingScheduler scheduler(4);
+    scheduler.Start();
+
+    std::vector<std::thread> submitters;
+    for(uint32_t s = 0; s < NumSubmitters; s++) {
+        submitters.emplace_back([&, s]() {
+            for(uint32_t i = 0; i < TasksPerSubmitter; i++) {
+                const uint32_t index = s * TasksPerSubmitter + i;
+                scheduler.AddTask(std::packaged_task<void()>([&, index]() {
+                    runs[index]++;
+                    if(numDone.fetch_add(1) + 1 == NumSubmitters * TasksPerSubmitter) {
+                        allDone.set_value();
+                    }
+                }));
+            }
+        });
+    }
+    for(std::thread& submitter : submitters) {
+        submitter.join();
+    }
+
+    CHECK(allDone.get_future().wait_for(Timeout) == std::future_status::ready);
+    for(const std::atomic<uint32_t>& count : runs) {
+        CHECK(count == 1);
+    }
+}
+
+TEST_CASE(TasksFromWorkersAllRun) {
+    constexpr uint32_t NumRoots = 16;
+    constexpr uint32_t ChildrenPerRoot = 1000;
+
+    std::atomic<uint32_t> numDone = 0;
+    std::atomic_bool onWorker = true;
+    std::promise<void> allDone;
+
+    WorkStealingScheduler scheduler(4);
+    scheduler.Start();
+    CHECK(scheduler.GetCurrentWorkerIndex() == -1);
+
+    // children go to the submitting worker's deque and get stolen from there
+    for(uint32_t r = 0; r < NumRoots; r++) {
+        scheduler.Submit([&]() {
+            for(uint32_t c = 0; c < ChildrenPerRoot; c++) {
+                scheduler.Submit([&]() {
+                    const int index = scheduler.GetCurrentWorkerIndex();
+                    if(index < 0 || index >= scheduler.GetNumThreads()) {
+                        onWorker = false;
+                    }
+                    if(numDone.fetch_add(1) + 1 == NumRoots * ChildrenPerRoot) {
+                        allDone.set_value();
+                    }
+                });
+            }
+        });
+    }
+
+    CHECK(allDone.get_future().wait_for(Timeout) == std::future_status::ready);
+    CHECK(numDone == NumRoots * ChildrenPerRoot);
+    CHECK(onWorker);
+}
+
+TEST_CASE(WorkersWakeUpAfterIdle) {
+    for(uint16_t numThreads : { 1, 4 }) {
+        WorkStealingScheduler scheduler(numThreads);
+        scheduler.Start();
+
+        for(int round = 0; round < 5; round++) {
+            // long enough for every worker to stop searching and park
+            std::this_thread::sleep_for(20ms);
+
+            // a single task has to wake a parked worker on its own
+            std::packaged_task<int()> single([]() { return 42; });
+            std::future<int> result = single.get_future();
+            scheduler.AddTask(std::move(single));
+            CHECK(result.wait_for(Timeout) == std::future_status::ready && result.get() == 42);
+
+            std::this_thread::sleep_for(20ms);
+
+            // a burst ramps the workers back up
+            std::vector<std::future<void>> burst;
+            for(int i = 0; i < 1000; i++) {
+                std::packaged_task<void()> task([]() {});
+                burst.push_back(task.get_future());
+                scheduler.AddTask(std::move(task));
+            }
+            for(std::future<void>& done : burst) {
+                CHECK(done.wait_for(Timeout) == std::future_status::ready);
+            }
+        }
+    }
+}
+
+TEST_CASE(ParallelForRunsEveryIndexOnce) {
+    constexpr uint32_t Count = 10000;
+
+    WorkStealingScheduler scheduler(4);
+    scheduler.Start();
+
+    for(uint32_t numSlots : { 1u, 3u, 4u, 8u }) {
+        std::vector<std::atomic<uint32_t>> runs(Count);
+        std::atomic_bool slotsInRange = true;
+        scheduler.ParallelFor(Count, numSlots, [&](uint32_t index, uint32_t slot) {
+            runs[index]++;
+            if(slot >= numSlots) {
+                slotsInRange = false;
+            }
+        });
+
+        // everything finished before ParallelFor returned
+        for(const std::atomic<uint32_t>& count : runs) {
+            CHECK(count == 1);
+        }
+        CHECK(slotsInRange);
+    }
+
+    // nothing to do, and fewer items than slots
+    scheduler.ParallelFor(0, 4, [](uint32_t, uint32_t) {});
+    std::vector<uint32_t> slotUses(4, 0);
+    scheduler.ParallelFor(1, 4, [&](uint32_t, uint32_t slot) { slotUses[slot]++; });
+    CHECK(slotUses[0] == 1);
+}
+
+TEST_CASE(ParallelForFromWorkersAndWithoutThem) {
+    std::atomic<uint32_t> numRuns = 0;
+    std::promise<void> done;
+
+    {
+        // never started: the caller does everything
+        WorkStealingScheduler idle(2);
+        idle.ParallelFor(100, 2, [&](uint32_t, uint32_t) { numRuns++; });
+        CHECK(numRuns == 100);
+    }
+
+    // a single worker running a nested ParallelFor doesn't wait on its own queued helpers
+    WorkStealingScheduler scheduler(1);
+    scheduler.Start();
+    scheduler.Submit([&]() {
+        scheduler.ParallelFor(100, 4, [&](uint32_t, uint32_t) { numRuns++; });
+        done.set_value();
+    });
+    CHECK(done.get_future().wait_for(Timeout) == std::future_status::ready);
+    CHECK(numRuns == 200);
+}
+
+TEST_CASE(StopDropsPendingTasks) {
+    std::future<void> result;
+    {
+        // never started, so nothing runs
+        WorkStealingScheduler scheduler(2);
+        std::packaged_task<void()> task([]() {});
+        result = task.get_future();
+        scheduler.AddTask(std::move(task));
+        scheduler.Stop();
+    }
+
+    bool broken = false;
+    try {
+        result.get();
+    }
+    catch(const std::future_error& e) {
+        broken = e.code() == std::future_errc::broken_promise;
+    }
+    CHECK(broken);
+}